@@ -0,0 +1,150 @@
+#include "Bench.hpp"
+
+#include <glaze/glaze.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#ifndef CPPPWN_BENCH_VERSION
+#define CPPPWN_BENCH_VERSION "unknown"
+#endif
+
+namespace cpppwn::bench {
+  namespace {
+
+    //----------------------------------------
+    // top level of the JSON report
+    //----------------------------------------
+    struct Report {
+      std::string library = "cpppwn";
+      std::string version = CPPPWN_BENCH_VERSION;
+      std::string compiler;
+      std::string timestamp;
+      std::vector<BenchResult> results;
+    };
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    std::string compiler_id() {
+#if defined(__clang__)
+      return "clang " __clang_version__;
+#elif defined(__GNUC__)
+      return "gcc " __VERSION__;
+#else
+      return "unknown";
+#endif
+    }
+
+    //----------------------------------------
+    // UTC, ISO 8601
+    //----------------------------------------
+    std::string utc_timestamp() {
+      const std::time_t now = std::time(nullptr);
+      std::tm tm{};
+      gmtime_r(&now, &tm);
+
+      char buffer[32];
+      const size_t len = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
+      return std::string(buffer, len);
+    }
+  }
+
+//----------------------------------------
+//
+//----------------------------------------
+BenchRunner::BenchRunner(BenchOptions options) : options_(std::move(options)) {
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool BenchRunner::selected(std::string_view name) const noexcept {
+  return options_.filter.empty() || name.find(options_.filter) != std::string_view::npos;
+}
+
+//----------------------------------------
+// progress goes to stderr, stdout is left to the report
+//----------------------------------------
+void BenchRunner::record(BenchResult result) {
+  if(result.iterations > 0 && result.seconds > 0) {
+    result.ns_per_op = result.seconds * 1e9 / static_cast<double>(result.iterations);
+    result.ops_per_sec = static_cast<double>(result.iterations) / result.seconds;
+  }
+
+  std::fprintf(stderr, "%-36s %14.1f ns/op %14.0f op/s", result.name.c_str(), result.ns_per_op, result.ops_per_sec);
+  if(result.bytes_per_sec > 0) {
+    std::fprintf(stderr, " %10.1f MiB/s", result.bytes_per_sec / (1 << 20));
+  }
+  if(result.p99_us > 0) {
+    std::fprintf(stderr, "  p50 %.0fus p99 %.0fus", result.p50_us, result.p99_us);
+  }
+  std::fputc('\n', stderr);
+
+  results_.push_back(std::move(result));
+}
+
+//----------------------------------------
+// nearest-rank percentiles
+//----------------------------------------
+void BenchRunner::set_latencies(BenchResult& result, std::vector<std::chrono::nanoseconds>& latencies) {
+  if(latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  auto percentile = [&latencies](double p) {
+    const auto index = static_cast<size_t>(p * static_cast<double>(latencies.size() - 1));
+    return std::chrono::duration<double, std::micro>(latencies[index]).count();
+  };
+
+  result.p50_us = percentile(0.50);
+  result.p90_us = percentile(0.90);
+  result.p99_us = percentile(0.99);
+  result.p999_us = percentile(0.999);
+  result.max_us = std::chrono::duration<double, std::micro>(latencies.back()).count();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string BenchRunner::to_json() const {
+  Report report;
+  report.compiler = compiler_id();
+  report.timestamp = utc_timestamp();
+  report.results = results_;
+
+  std::string json;
+  if(const auto error = glz::write<glz::opts{.prettify = true}>(report, json)) {
+    throw std::runtime_error("Failed to write report: " + glz::format_error(error, json));
+  }
+  return json;
+}
+
+//----------------------------------------
+// the parent waits for "ready" before it scans
+//----------------------------------------
+int memory_target_main(size_t mib) {
+  std::vector<std::byte> memory(mib << 20);
+  std::mt19937_64 rng(42);
+  for(size_t i = 0; i + sizeof(uint64_t) <= memory.size(); i += sizeof(uint64_t)) {
+    const uint64_t word = rng();
+    std::memcpy(memory.data() + i, &word, sizeof(word));
+  }
+  std::memcpy(memory.data() + memory.size() - planted_bytes.size() - 64, planted_bytes.data(), planted_bytes.size());
+
+  std::cout << "ready" << std::endl;
+
+  std::string line;
+  while(std::getline(std::cin, line)) {
+  }
+  do_not_optimize(memory.data());
+  return 0;
+}
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpppwn::bench {
+
+struct BenchOptions {
+  std::string filter;                              // only benchmarks whose name contains this
+  std::chrono::milliseconds min_time{500};         // timed per micro benchmark
+  std::chrono::milliseconds load_duration{3000};   // timed per load or throughput test
+  size_t connections = 16;                         // concurrent clients of a load test
+};
+
+//----------------------------------------
+// one line of the JSON report. fields that don't apply to a
+// benchmark stay 0.
+//----------------------------------------
+struct BenchResult {
+  std::string name;
+  uint64_t iterations = 0;
+  double seconds = 0;
+  double ns_per_op = 0;
+  double ops_per_sec = 0;
+  double bytes_per_sec = 0;
+  uint64_t errors = 0;
+  double p50_us = 0;        // latency percentiles, load tests only
+  double p90_us = 0;
+  double p99_us = 0;
+  double p999_us = 0;
+  double max_us = 0;
+};
+
+//----------------------------------------
+// keeps the compiler from dropping a computation whose result
+// is otherwise unused
+//----------------------------------------
+template<typename T>
+inline void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchRunner {
+public:
+    explicit BenchRunner(BenchOptions options);
+
+    [[nodiscard]] const BenchOptions& options() const noexcept { return options_; }
+
+    [[nodiscard]] bool selected(std::string_view name) const noexcept;
+
+    //----------------------------------------
+    // runs op in doubling batches until min_time has passed.
+    // bytes_per_op turns the result into a throughput too.
+    //----------------------------------------
+    template<typename F>
+    void measure(const std::string& name, F&& op, uint64_t bytes_per_op = 0) {
+      if(not selected(name)) {
+        return;
+      }
+
+      using clock = std::chrono::steady_clock;
+      op();
+
+      uint64_t batch = 1;
+      uint64_t iterations = 0;
+      clock::duration elapsed{};
+      while(elapsed < options_.min_time) {
+        const auto start = clock::now();
+        for(uint64_t i = 0; i < batch; ++i) {
+          op();
+        }
+        elapsed += clock::now() - start;
+        iterations += batch;
+        batch *= 2;
+      }
+
+      BenchResult result;
+      result.name = name;
+      result.iterations = iterations;
+      result.seconds = std::chrono::duration<double>(elapsed).count();
+      result.bytes_per_sec = static_cast<double>(bytes_per_op * iterations) / result.seconds;
+      record(std::move(result));
+    }
+
+    //----------------------------------------
+    // adds a result of a benchmark that timed itself. fills in
+    // the rates from iterations and seconds.
+    //----------------------------------------
+    void record(BenchResult result);
+
+    //----------------------------------------
+    // percentile fields of result from per-request latencies
+    //----------------------------------------
+    static void set_latencies(BenchResult& result, std::vector<std::chrono::nanoseconds>& latencies);
+
+    [[nodiscard]] std::string to_json() const;
+
+private:
+    BenchOptions options_;
+    std::vector<BenchResult> results_;
+};
+
+void run_micro_benchmarks(BenchRunner& runner);
+void run_macro_benchmarks(BenchRunner& runner);
+
+//----------------------------------------
+// entry point of the child process findSignature scans. holds
+// mib of pseudo-random memory with the pattern planted at the
+// end until its stdin closes.
+//----------------------------------------
+int memory_target_main(size_t mib);
+
+inline constexpr std::string_view planted_signature = "48 8B 05 ?? ?? ?? ?? 48 85 C0 74 ?? C3";
+
+//----------------------------------------
+// what the child plants. it never builds a Signature, whose
+// copy of the pattern on the heap would match first.
+//----------------------------------------
+inline constexpr std::array<unsigned char, 13> planted_bytes{
+  0x48, 0x8B, 0x05, 0x10, 0x20, 0x30, 0x40, 0x48, 0x85, 0xC0, 0x74, 0x05, 0xC3
+};
+
+}
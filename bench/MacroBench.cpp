@@ -0,0 +1,248 @@
+#include "Bench.hpp"
+
+#include <HttpParser.hpp>
+#include <HttpServer.hpp>
+#include <RESTServer.hpp>
+#include <Remote.hpp>
+#include <Stream.hpp>
+
+#include <asio.hpp>
+
+#include <atomic>
+#include <charconv>
+#include <mutex>
+#include <thread>
+
+namespace cpppwn::bench {
+
+//----------------------------------------
+// body of the REST load test
+//----------------------------------------
+struct Greeting {
+  std::string message;
+  uint64_t id = 0;
+};
+
+  namespace {
+
+    using clock = std::chrono::steady_clock;
+
+    //----------------------------------------
+    // a port nothing listens on right now
+    //----------------------------------------
+    uint16_t free_port() {
+      asio::io_context io;
+      asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+      return acceptor.local_endpoint().port();
+    }
+
+    //----------------------------------------
+    // true once port accepts, false after a few seconds
+    //----------------------------------------
+    bool wait_listening(uint16_t port) {
+      const auto deadline = clock::now() + std::chrono::seconds(5);
+      while(clock::now() < deadline) {
+        try {
+          Remote probe("127.0.0.1", port);
+          return true;
+        } catch (const std::exception&) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+      return false;
+    }
+
+    //----------------------------------------
+    // reads one response off remote, false if it was not a 200
+    //----------------------------------------
+    bool read_response(Remote& remote, HttpParser& parser, HttpHead& head) {
+      const std::string_view raw = remote.recvuntil_view("\r\n\r\n", 64 << 10);
+      parser.reset();
+      if(parser.parse_response(raw, head) != ParseResult::Complete) {
+        throw std::runtime_error("Malformed response");
+      }
+      const int status = head.status;
+
+      size_t length = 0;
+      if(auto value = head.header("content-length")) {
+        std::from_chars(value->data(), value->data() + value->size(), length);
+      }
+      do_not_optimize(remote.recv_view(length).data());
+      return status == 200;
+    }
+
+    //----------------------------------------
+    // options().connections keep-alive clients send request
+    // back to back for options().load_duration
+    //----------------------------------------
+    void load_test(BenchRunner& runner, const std::string& name, uint16_t port, const std::string& request) {
+      const auto duration = runner.options().load_duration;
+      const size_t connections = std::max<size_t>(1, runner.options().connections);
+
+      std::mutex mutex;
+      std::vector<std::chrono::nanoseconds> latencies;
+      std::atomic<uint64_t> errors{0};
+
+      const auto start = clock::now();
+      const auto deadline = start + duration;
+
+      std::vector<std::thread> clients;
+      for(size_t i = 0; i < connections; ++i) {
+        clients.emplace_back([&] {
+          std::vector<std::chrono::nanoseconds> local;
+          local.reserve(1 << 16);
+          HttpParser parser;
+          HttpHead head;
+
+          while(clock::now() < deadline) {
+            try {
+              Remote remote("127.0.0.1", port);
+              while(clock::now() < deadline) {
+                const auto sent = clock::now();
+                remote.send(request);
+                if(not read_response(remote, parser, head)) {
+                  ++errors;
+                }
+                local.push_back(clock::now() - sent);
+              }
+            } catch (const std::exception&) {
+              ++errors;
+            }
+          }
+
+          std::lock_guard lock(mutex);
+          latencies.insert(latencies.end(), local.begin(), local.end());
+        });
+      }
+      for(auto& client : clients) {
+        client.join();
+      }
+
+      BenchResult result;
+      result.name = name;
+      result.iterations = latencies.size();
+      result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+      result.errors = errors;
+      BenchRunner::set_latencies(result, latencies);
+      runner.record(std::move(result));
+    }
+
+    //----------------------------------------
+    // runs server.start() on a thread for the duration of body
+    //----------------------------------------
+    template<typename TServer, typename F>
+    void with_running(TServer& server, uint16_t port, F&& body) {
+      std::thread thread([&server] { server.start(); });
+      if(wait_listening(port)) {
+        body();
+      }
+      server.stop();
+      thread.join();
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void bench_http_server(BenchRunner& runner) {
+      if(not runner.selected("http_server/plaintext")) {
+        return;
+      }
+
+      const uint16_t port = free_port();
+      HttpServer server(port, "127.0.0.1");
+      server.get("/plaintext", [](const HttpRequest&) {
+        return HttpResponse(200).set_header("Content-Type", "text/plain").set_body("Hello, World!");
+      });
+
+      with_running(server, port, [&] {
+        load_test(runner, "http_server/plaintext", port,
+          "GET /plaintext HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n");
+      });
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void bench_rest_server(BenchRunner& runner) {
+      if(not runner.selected("rest_server/json")) {
+        return;
+      }
+
+      const uint16_t port = free_port();
+      RESTServer server(port, "127.0.0.1");
+      server.get<Greeting>("/greeting", [](const HttpRequest&) {
+        return Greeting{"Hello, World!", 42};
+      });
+
+      with_running(server, port, [&] {
+        load_test(runner, "rest_server/json", port,
+          "GET /greeting HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept: application/json\r\n\r\n");
+      });
+    }
+
+    //----------------------------------------
+    // bytes written into one end of a bridged pair of loopback
+    // connections until load_duration, read off the other end
+    //----------------------------------------
+    void bench_bridge(BenchRunner& runner, const std::string& name, BridgeMode mode) {
+      if(not runner.selected(name)) {
+        return;
+      }
+
+      asio::io_context io;
+      asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+
+      asio::ip::tcp::socket source(io);
+      asio::ip::tcp::socket sink(io);
+      source.connect(acceptor.local_endpoint());
+      Remote a(acceptor.accept());
+      sink.connect(acceptor.local_endpoint());
+      Remote b(acceptor.accept());
+
+      std::thread bridging([&] { bridge(a, b, mode); });
+
+      const auto start = clock::now();
+      const auto deadline = start + runner.options().load_duration;
+
+      std::thread writer([&] {
+        const std::string chunk(1 << 20, 'x');
+        asio::error_code ec;
+        while(clock::now() < deadline && not ec) {
+          asio::write(source, asio::buffer(chunk), ec);
+        }
+        source.shutdown(asio::ip::tcp::socket::shutdown_send, ec);
+      });
+
+      std::vector<char> buffer(1 << 20);
+      uint64_t received = 0;
+      asio::error_code ec;
+      while(not ec) {
+        received += sink.read_some(asio::buffer(buffer), ec);
+      }
+      const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+      writer.join();
+      source.close(ec);
+      sink.close(ec);
+      bridging.join();
+
+      BenchResult result;
+      result.name = name;
+      result.iterations = received >> 20;
+      result.seconds = seconds;
+      result.bytes_per_sec = static_cast<double>(received) / seconds;
+      runner.record(std::move(result));
+    }
+  }
+
+//----------------------------------------
+//
+//----------------------------------------
+void run_macro_benchmarks(BenchRunner& runner) {
+  bench_http_server(runner);
+  bench_rest_server(runner);
+  bench_bridge(runner, "bridge/threads", BridgeMode::Threads);
+  bench_bridge(runner, "bridge/epoll", BridgeMode::Epoll);
+}
+
+}
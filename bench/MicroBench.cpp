@@ -0,0 +1,192 @@
+#include "Bench.hpp"
+
+#include <Helpers.hpp>
+#include <HttpParser.hpp>
+#include <HttpUtils.hpp>
+#include <Process.hpp>
+#include <Remote.hpp>
+#include <Signature.hpp>
+
+#include <asio.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace cpppwn::bench {
+  namespace {
+
+    constexpr std::string_view sample_request =
+      "GET /api/v1/items?page=2&per_page=50&sort=-created HTTP/1.1\r\n"
+      "Host: api.example.com\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+      "Accept: application/json, text/plain, */*\r\n"
+      "Accept-Language: en-US,en;q=0.9\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Connection: keep-alive\r\n"
+      "Referer: https://example.com/items\r\n"
+      "Cookie: session=4f2a9c1e7b3d8a6f; theme=dark; consent=1\r\n"
+      "Sec-Fetch-Dest: empty\r\n"
+      "Sec-Fetch-Mode: cors\r\n"
+      "Sec-Fetch-Site: same-site\r\n"
+      "\r\n";
+
+    constexpr std::string_view sample_response =
+      "HTTP/1.1 200 OK\r\n"
+      "Date: Mon, 01 Jan 2024 00:00:00 GMT\r\n"
+      "Server: nginx\r\n"
+      "Content-Type: application/json; charset=utf-8\r\n"
+      "Content-Length: 1234\r\n"
+      "Connection: keep-alive\r\n"
+      "Cache-Control: private, max-age=0\r\n"
+      "ETag: \"5f2b-1a9c7e\"\r\n"
+      "Vary: Accept-Encoding\r\n"
+      "Set-Cookie: session=4f2a9c1e7b3d8a6f; Path=/; HttpOnly; Secure\r\n"
+      "X-Request-Id: 0d2c5e1b-8a7f-4c3e-9b6d-1f0a2e3c4d5b\r\n"
+      "\r\n";
+
+    //----------------------------------------
+    // HttpServer and HttpClient both read message heads
+    // through HttpParser
+    //----------------------------------------
+    void bench_http(BenchRunner& runner) {
+      HttpParser parser;
+      HttpHead head;
+
+      runner.measure("http/parse_request", [&] {
+        parser.reset();
+        do_not_optimize(parser.parse_request(sample_request, head));
+      }, sample_request.size());
+
+      runner.measure("http/parse_response", [&] {
+        parser.reset();
+        do_not_optimize(parser.parse_response(sample_response, head));
+      }, sample_response.size());
+
+      HttpResponse response(200);
+      response.set_json(R"({"id":42,"name":"widget","tags":["a","b","c"],"price":9.99})");
+      response.set_header("Cache-Control", "no-store");
+      response.set_header("X-Request-Id", "0d2c5e1b-8a7f-4c3e-9b6d-1f0a2e3c4d5b");
+
+      runner.measure("http/response_to_string", [&] {
+        do_not_optimize(response.to_string());
+      });
+
+      std::string head_buffer;
+      runner.measure("http/response_serialize_head", [&] {
+        head_buffer.clear();
+        response.serialize_head(head_buffer);
+        do_not_optimize(head_buffer.data());
+      });
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void bench_helpers(BenchRunner& runner) {
+      std::string text;
+      for(int i = 0; text.size() < 1024; ++i) {
+        text += "name=J\xC3\xBCrgen M\xC3\xBCller&city=Z\xC3\xBCrich/" + std::to_string(i) + " ";
+      }
+      runner.measure("helpers/url_encode_1k", [&] {
+        do_not_optimize(url_encode(text));
+      }, text.size());
+
+      std::string binary(64 << 10, '\0');
+      std::mt19937 rng(7);
+      for(char& c : binary) {
+        c = static_cast<char>(rng());
+      }
+      runner.measure("helpers/base64_encode_64k", [&] {
+        do_not_optimize(base64_encode(binary));
+      }, binary.size());
+    }
+
+    //----------------------------------------
+    // Signature on a local buffer, then Process::findSignature
+    // on a child holding the same kind of memory
+    //----------------------------------------
+    void bench_signature(BenchRunner& runner) {
+      constexpr size_t mib = 64;
+      const Signature signature(planted_signature);
+
+      if(runner.selected("signature/find_64m")) {
+        std::vector<std::byte> memory(mib << 20);
+        std::mt19937_64 rng(42);
+        for(size_t i = 0; i + sizeof(uint64_t) <= memory.size(); i += sizeof(uint64_t)) {
+          const uint64_t word = rng();
+          std::memcpy(memory.data() + i, &word, sizeof(word));
+        }
+        std::memcpy(memory.data() + memory.size() - planted_bytes.size() - 64, planted_bytes.data(), planted_bytes.size());
+
+        runner.measure("signature/find_64m", [&] {
+          do_not_optimize(signature.find(memory));
+        }, memory.size());
+      }
+
+      if(runner.selected("process/find_signature_64m")) {
+        ScanFilter filter;
+        filter.permissions = "rw";
+
+        Process target("/proc/self/exe", {"/proc/self/exe", "--memory-target", std::to_string(mib)});
+        if(target.recvline().starts_with("ready") && target.findSignature(signature, filter)) {
+          runner.measure("process/find_signature_64m", [&] {
+            do_not_optimize(target.findSignature(signature, filter));
+          }, mib << 20);
+        }
+        target.close();
+      }
+    }
+
+    //----------------------------------------
+    // a peer streams 64 byte lines as fast as it can, the
+    // Remote reads them one recvline() at a time
+    //----------------------------------------
+    void bench_recvline(BenchRunner& runner) {
+      if(not runner.selected("remote/recvline_64b")) {
+        return;
+      }
+
+      asio::io_context io;
+      asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+      const uint16_t port = acceptor.local_endpoint().port();
+
+      std::string block;
+      while(block.size() < (64 << 10)) {
+        block += std::string(63, 'x') + "\n";
+      }
+
+      std::atomic<bool> done{false};
+      std::thread writer([&] {
+        asio::ip::tcp::socket peer(io);
+        acceptor.accept(peer);
+        asio::error_code ec;
+        while(not done && not ec) {
+          asio::write(peer, asio::buffer(block), ec);
+        }
+      });
+
+      {
+        Remote remote("127.0.0.1", port);
+        runner.measure("remote/recvline_64b", [&] {
+          do_not_optimize(remote.recvline());
+        }, 64);
+        done = true;
+        remote.close();
+      }
+      writer.join();
+    }
+  }
+
+//----------------------------------------
+//
+//----------------------------------------
+void run_micro_benchmarks(BenchRunner& runner) {
+  bench_http(runner);
+  bench_helpers(runner);
+  bench_signature(runner);
+  bench_recvline(runner);
+}
+
+}
@@ -0,0 +1,77 @@
+#include "Bench.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace {
+
+//----------------------------------------
+//
+//----------------------------------------
+void usage(const char* self) {
+  std::fprintf(stderr,
+    "usage: %s [--filter <substring>] [--min-time <ms>] [--duration <ms>]\n"
+    "          [--connections <n>] [--micro | --macro] [--out <file>]\n"
+    "writes the results as JSON to stdout or --out\n", self);
+}
+
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+int main(int argc, char** argv) {
+  using namespace cpppwn::bench;
+
+  if(argc == 3 && std::string_view(argv[1]) == "--memory-target") {
+    return memory_target_main(std::strtoull(argv[2], nullptr, 10));
+  }
+
+  BenchOptions options;
+  std::string out_path;
+  bool micro = true;
+  bool macro = true;
+
+  for(int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+
+    if(arg == "--filter" && has_value) {
+      options.filter = argv[++i];
+    } else if(arg == "--min-time" && has_value) {
+      options.min_time = std::chrono::milliseconds(std::strtoll(argv[++i], nullptr, 10));
+    } else if(arg == "--duration" && has_value) {
+      options.load_duration = std::chrono::milliseconds(std::strtoll(argv[++i], nullptr, 10));
+    } else if(arg == "--connections" && has_value) {
+      options.connections = std::strtoull(argv[++i], nullptr, 10);
+    } else if(arg == "--out" && has_value) {
+      out_path = argv[++i];
+    } else if(arg == "--micro") {
+      macro = false;
+    } else if(arg == "--macro") {
+      micro = false;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  BenchRunner runner(options);
+  if(micro) {
+    run_micro_benchmarks(runner);
+  }
+  if(macro) {
+    run_macro_benchmarks(runner);
+  }
+
+  const std::string json = runner.to_json();
+  if(out_path.empty()) {
+    std::cout << json << std::endl;
+  } else {
+    std::ofstream(out_path) << json << '\n';
+  }
+  return 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Remote.hpp"
+#include "HttpUtils.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace cpppwn {
+
+//----------------------------------------
+// pulls a request body off the connection piece by piece,
+// removing the chunked framing on the way. nothing is read
+// (and no 100 Continue sent) before the first call.
+//----------------------------------------
+class BodyReader {
+public:
+    //----------------------------------------
+    // limit 0 means none. throws std::invalid_argument for a
+    // Content-Length that isn't a number, a Transfer-Encoding
+    // not ending in chunked or one sent with Content-Length, and
+    // std::domain_error for transfer codings besides chunked.
+    //----------------------------------------
+    BodyReader(Remote& client, const HttpRequest& request, uint64_t limit = 0);
+
+    BodyReader(const BodyReader&) = delete;
+    BodyReader& operator=(const BodyReader&) = delete;
+
+    //----------------------------------------
+    // fills up to buffer.size() bytes, 0 once the body ended.
+    // throws std::length_error past the limit.
+    //----------------------------------------
+    [[nodiscard]] size_t read(std::span<char> buffer);
+
+    //----------------------------------------
+    // hands every piece to sink until the body ended
+    //----------------------------------------
+    void for_each_chunk(const std::function<void(std::string_view)>& sink);
+
+    [[nodiscard]] std::string read_all();
+
+    [[nodiscard]] bool chunked() const noexcept { return chunked_; }
+
+    //----------------------------------------
+    // nullopt for chunked bodies
+    //----------------------------------------
+    [[nodiscard]] std::optional<uint64_t> content_length() const noexcept { return length_; }
+
+    [[nodiscard]] uint64_t received() const noexcept { return received_; }
+    [[nodiscard]] bool finished() const noexcept { return finished_; }
+
+private:
+    Remote& client_;
+    bool chunked_ = false;
+    std::optional<uint64_t> length_;
+    uint64_t limit_;
+    uint64_t received_ = 0;
+    uint64_t chunk_left_ = 0;   // bytes left of the current chunk
+    bool expect_continue_ = false;
+    bool started_ = false;
+    bool finished_ = false;
+
+    bool next_chunk();
+    void count(uint64_t bytes);
+};
+
+}
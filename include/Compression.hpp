@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cpppwn {
+
+//----------------------------------------
+// Content-Encoding values the library knows about. Brotli is
+// only available when the library was built with it.
+//----------------------------------------
+enum class ContentCoding {
+  Identity,
+  Gzip,
+  Deflate,
+  Brotli
+};
+
+//----------------------------------------
+// "gzip", "x-gzip", "deflate", "br" or "identity", any case.
+// nullopt for anything else.
+//----------------------------------------
+[[nodiscard]] std::optional<ContentCoding> parse_content_coding(std::string_view token) noexcept;
+
+//----------------------------------------
+// the token used in Content-Encoding
+//----------------------------------------
+[[nodiscard]] std::string_view content_coding_name(ContentCoding coding) noexcept;
+
+[[nodiscard]] bool content_coding_supported(ContentCoding coding) noexcept;
+
+//----------------------------------------
+// the best supported coding an Accept-Encoding header allows,
+// by q-value and then br, gzip, deflate. Identity if none is.
+//----------------------------------------
+[[nodiscard]] ContentCoding negotiate_content_coding(std::string_view accept_encoding) noexcept;
+
+//----------------------------------------
+// the whole of data in coding. level -1 picks a default suited
+// to per-request use, otherwise 1-9 for zlib and 0-11 for brotli.
+//----------------------------------------
+[[nodiscard]] std::string compress(std::string_view data, ContentCoding coding, int level = -1);
+
+//----------------------------------------
+// decodes a body as it arrives. input may be split anywhere.
+//----------------------------------------
+class Decompressor {
+public:
+    //----------------------------------------
+    // max_output 0 means no limit. throws std::invalid_argument
+    // for a coding this build can't decode.
+    //----------------------------------------
+    explicit Decompressor(ContentCoding coding, uint64_t max_output = 0);
+
+    ~Decompressor();
+
+    Decompressor(const Decompressor&) = delete;
+    Decompressor& operator=(const Decompressor&) = delete;
+
+    //----------------------------------------
+    // appends what data decodes to out. throws std::runtime_error
+    // for corrupt input and std::length_error past max_output.
+    //----------------------------------------
+    void feed(std::string_view data, std::string& out);
+
+    //----------------------------------------
+    // throws std::runtime_error unless the encoded stream ended
+    //----------------------------------------
+    void finish() const;
+
+    [[nodiscard]] uint64_t produced() const noexcept { return produced_; }
+
+private:
+    class Impl;
+
+    std::unique_ptr<Impl> impl_;
+    uint64_t max_output_;
+    uint64_t produced_ = 0;
+};
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <asio.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cpppwn {
+
+struct DnsCacheConfig {
+  std::chrono::seconds ttl{60};    // how long a lookup is reused, getaddrinfo() reports no record TTLs
+  size_t max_entries = 1024;       // cached host names
+};
+
+//----------------------------------------
+// host name lookups shared by every connection of the process.
+// only successful lookups are cached. thread safe.
+//----------------------------------------
+class DnsCache {
+public:
+    explicit DnsCache(DnsCacheConfig config = {});
+
+    DnsCache(const DnsCache&) = delete;
+    DnsCache& operator=(const DnsCache&) = delete;
+
+    //----------------------------------------
+    // the cache Remote connects through
+    //----------------------------------------
+    [[nodiscard]] static DnsCache& global();
+
+    //----------------------------------------
+    // replaces the limits and drops every entry
+    //----------------------------------------
+    void configure(const DnsCacheConfig& config);
+
+    //----------------------------------------
+    // host's addresses in getaddrinfo() order with port filled in.
+    // IP literals skip the cache. throws asio::system_error when
+    // the name does not resolve.
+    //----------------------------------------
+    [[nodiscard]] std::vector<asio::ip::tcp::endpoint> resolve(const std::string& host, uint16_t port);
+
+    //----------------------------------------
+    // what resolve() would return without a lookup, nullopt when
+    // host is not cached. for callers resolving asynchronously.
+    //----------------------------------------
+    [[nodiscard]] std::optional<std::vector<asio::ip::tcp::endpoint>> find(const std::string& host, uint16_t port);
+
+    //----------------------------------------
+    // caches the addresses of a lookup done elsewhere
+    //----------------------------------------
+    void insert(const std::string& host, const std::vector<asio::ip::tcp::endpoint>& endpoints);
+
+    //----------------------------------------
+    // drops host, e.g. after none of its addresses accepted
+    //----------------------------------------
+    void forget(const std::string& host);
+
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Entry {
+      std::vector<asio::ip::address> addresses;
+      std::chrono::steady_clock::time_point expires;
+    };
+
+    mutable std::mutex mutex_;
+    DnsCacheConfig config_;
+    std::unordered_map<std::string, Entry> entries_;
+
+    void evict(std::chrono::steady_clock::time_point now);
+};
+
+}
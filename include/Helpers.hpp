@@ -2,12 +2,23 @@
 
 #include <atomic>
 #include <Stream.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/use_awaitable.hpp>
 #include <iostream>
 #include <ostream>
 #include <iomanip>
 #include <string>
+#include <string_view>
 #include <map>
 #include <filesystem>
+#include <chrono>
+#include <system_error>
+#include <memory>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -93,71 +104,72 @@ std::string url_encode(const std::string& value) {
 //
 //----------------------------------------
 inline constexpr
-std::string url_decode(const std::string& str) {
+std::string url_decode(std::string_view str) {
   std::string result;
   result.reserve(str.size());
-        
+
+  const auto hex = [](char c) -> int {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+
   for(size_t i = 0; i < str.size(); ++i) {
-    if(str[i] == '%' && i + 2 < str.size()) {
-      int value;
-      std::istringstream iss(str.substr(i + 1, 2));
-      if(iss >> std::hex >> value) {
-        result += static_cast<char>(value);
-        i += 2;
-      } else {
-        result += str[i];
-      }
+    if(str[i] == '%' && i + 2 < str.size() && hex(str[i + 1]) >= 0 && hex(str[i + 2]) >= 0) {
+      result += static_cast<char>(hex(str[i + 1]) * 16 + hex(str[i + 2]));
+      i += 2;
     } else if(str[i] == '+') {
       result += ' ';
     } else {
       result += str[i];
     }
   }
-        
+
   return result;
 }
+
 //----------------------------------------
 //
 //----------------------------------------
 inline constexpr
-std::map<std::string, std::string> parse_query_string(const std::string& query) {
+std::map<std::string, std::string> parse_query_string(std::string_view query) {
   std::map<std::string, std::string> params;
-      
-  std::istringstream stream(query);
-  std::string pair;
-      
-  while(std::getline(stream, pair, '&')) {
-    size_t eq = pair.find('=');
-    if(eq != std::string::npos) {
-      std::string key = url_decode(pair.substr(0, eq));
-      std::string value = url_decode(pair.substr(eq + 1));
-      params[key] = value;
+
+  while(not query.empty()) {
+    const size_t amp = query.find('&');
+    const std::string_view pair = query.substr(0, amp);
+    query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+    if(pair.empty()) continue;
+
+    const size_t eq = pair.find('=');
+    if(eq != std::string_view::npos) {
+      params.insert_or_assign(url_decode(pair.substr(0, eq)), url_decode(pair.substr(eq + 1)));
     } else {
-      params[url_decode(pair)] = "";
+      params.insert_or_assign(url_decode(pair), "");
     }
   }
   return params;
 }
-  
+
 //----------------------------------------
 //
 //----------------------------------------
 inline constexpr
-std::map<std::string, std::string> parse_cookies(const std::string& cookie_header) {
+std::map<std::string, std::string> parse_cookies(std::string_view cookie_header) {
   std::map<std::string, std::string> cookies;
-      
-  std::istringstream stream(cookie_header);
-  std::string pair;
-      
-  while(std::getline(stream, pair, ';')) {
-    pair.erase(0, pair.find_first_not_of(" \t"));
-    pair.erase(pair.find_last_not_of(" \t") + 1);
-          
-    size_t eq = pair.find('=');
-    if(eq != std::string::npos) {
-      std::string key = pair.substr(0, eq);
-      std::string value = pair.substr(eq + 1);
-      cookies[key] = value;
+
+  while(not cookie_header.empty()) {
+    const size_t semi = cookie_header.find(';');
+    std::string_view pair = cookie_header.substr(0, semi);
+    cookie_header = semi == std::string_view::npos ? std::string_view{} : cookie_header.substr(semi + 1);
+
+    while(not pair.empty() && (pair.front() == ' ' || pair.front() == '\t')) pair.remove_prefix(1);
+    while(not pair.empty() && (pair.back() == ' ' || pair.back() == '\t')) pair.remove_suffix(1);
+
+    const size_t eq = pair.find('=');
+    if(eq != std::string_view::npos) {
+      cookies.insert_or_assign(std::string(pair.substr(0, eq)), std::string(pair.substr(eq + 1)));
     }
   }
   return cookies;
@@ -216,3 +228,131 @@ std::string get_http_date() {
   return std::string(buffer);
 }
 
+//----------------------------------------
+// waits until fd is readable, hung up or the deadline passes.
+// EINTR resumes the wait with whatever time is left.
+//----------------------------------------
+inline bool wait_readable(int fd, std::chrono::steady_clock::time_point deadline) {
+  pollfd pfd{fd, POLLIN, 0};
+
+  while(true) {
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    const int timeout_ms = static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, remaining.count()));
+
+    const int ready = ::poll(&pfd, 1, timeout_ms);
+    if(ready > 0) return true;
+    if(ready == 0) return false;
+    if(errno != EINTR) {
+      throw std::system_error(errno, std::system_category(), "poll() failed");
+    }
+  }
+}
+
+//----------------------------------------
+// blocks until fd is ready for events, for blocking calls on a
+// descriptor asio may have switched to non-blocking mode
+//----------------------------------------
+inline void wait_ready(int fd, short events) {
+  pollfd pfd{fd, events, 0};
+  while(::poll(&pfd, 1, -1) < 0) {
+    if(errno != EINTR) {
+      throw std::system_error(errno, std::system_category(), "poll() failed");
+    }
+  }
+}
+
+//----------------------------------------
+// awaits operation(), an asynchronous read on io_object, until
+// the deadline. false if the deadline came first, cancelling
+// what io_object had pending. a read that completed anyway
+// counts as in time.
+//----------------------------------------
+template<typename IoObject, typename Operation>
+asio::awaitable<bool> await_until(IoObject& io_object, std::chrono::steady_clock::time_point deadline,
+                                  Operation operation) {
+  struct Race {
+    bool done = false;
+    bool expired = false;
+  };
+  auto race = std::make_shared<Race>();
+
+  asio::steady_timer timer(io_object.get_executor(), deadline);
+  timer.async_wait([&io_object, race](const asio::error_code& ec) {
+    if(ec || race->done) {
+      return;
+    }
+    race->expired = true;
+    io_object.cancel();
+  });
+
+  try {
+    co_await operation();
+  } catch (const asio::system_error& e) {
+    race->done = true;
+    timer.cancel();
+    if(race->expired && e.code() == asio::error::operation_aborted) {
+      co_return false;
+    }
+    throw;
+  }
+
+  race->done = true;
+  timer.cancel();
+  co_return true;
+}
+
+//----------------------------------------
+// the pipe splice() moves data through. a pipe is needed since
+// splice() requires one end of every transfer to be one.
+//----------------------------------------
+class SplicePipe {
+  public:
+    explicit SplicePipe(std::size_t capacity) {
+      if(pipe2(fds_, O_CLOEXEC) < 0) {
+        throw std::system_error(errno, std::system_category(), "pipe2() failed");
+      }
+      // best effort, the kernel caps it at pipe-max-size
+      fcntl(fds_[1], F_SETPIPE_SZ, static_cast<int>(capacity));
+    }
+
+    ~SplicePipe() {
+      ::close(fds_[0]);
+      ::close(fds_[1]);
+    }
+
+    SplicePipe(const SplicePipe&) = delete;
+    SplicePipe& operator=(const SplicePipe&) = delete;
+
+    [[nodiscard]] int read_end() const noexcept { return fds_[0]; }
+    [[nodiscard]] int write_end() const noexcept { return fds_[1]; }
+
+  private:
+    int fds_[2];
+};
+
+//----------------------------------------
+// turns SIGPIPE into EPIPE for raw writes on this thread. any
+// SIGPIPE raised meanwhile is discarded before unblocking.
+//----------------------------------------
+class SigpipeBlock {
+  public:
+    SigpipeBlock() {
+      sigemptyset(&sigpipe_);
+      sigaddset(&sigpipe_, SIGPIPE);
+      pthread_sigmask(SIG_BLOCK, &sigpipe_, &previous_);
+    }
+
+    ~SigpipeBlock() {
+      const timespec no_wait{0, 0};
+      while(sigtimedwait(&sigpipe_, nullptr, &no_wait) > 0) {
+      }
+      pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+    }
+
+    SigpipeBlock(const SigpipeBlock&) = delete;
+    SigpipeBlock& operator=(const SigpipeBlock&) = delete;
+
+  private:
+    sigset_t sigpipe_;
+    sigset_t previous_;
+};
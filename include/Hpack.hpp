@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpppwn {
+
+//----------------------------------------
+// one field of an HTTP/2 header block. names are lowercase,
+// pseudo-headers like :path start with a colon.
+//----------------------------------------
+struct HpackField {
+  std::string name;
+  std::string value;
+};
+
+//----------------------------------------
+// the dynamic table of RFC 7541, behind the static one. encoder
+// and decoder of a connection keep theirs in step by applying
+// the same inserts and evictions.
+//----------------------------------------
+class HpackTable {
+public:
+    explicit HpackTable(size_t max_size = 4096) : max_size_(max_size) {}
+
+    //----------------------------------------
+    // entry at a 1-based HPACK index, static entries first.
+    // nullptr past the end.
+    //----------------------------------------
+    [[nodiscard]] const HpackField* at(size_t index) const noexcept;
+
+    //----------------------------------------
+    // index of an entry matching name and value, or else of one
+    // matching name only. 0 if neither exists.
+    //----------------------------------------
+    [[nodiscard]] size_t find(std::string_view name, std::string_view value, bool& value_matched) const noexcept;
+
+    //----------------------------------------
+    // adds a field in front, evicting the oldest ones to make
+    // room. one bigger than the table empties it.
+    //----------------------------------------
+    void insert(std::string name, std::string value);
+
+    void set_max_size(size_t max_size);
+
+    [[nodiscard]] size_t max_size() const noexcept { return max_size_; }
+
+    //----------------------------------------
+    // what an entry counts against the table size
+    //----------------------------------------
+    [[nodiscard]] static size_t entry_size(std::string_view name, std::string_view value) noexcept {
+      return name.size() + value.size() + 32;
+    }
+
+    static constexpr size_t static_size = 61;
+
+private:
+    void evict(size_t limit);
+
+    std::deque<HpackField> entries_;   // newest first
+    size_t size_ = 0;
+    size_t max_size_;
+};
+
+//----------------------------------------
+// header block compression of one connection's requests
+//----------------------------------------
+class HpackEncoder {
+public:
+    //----------------------------------------
+    // follows the peer's SETTINGS_HEADER_TABLE_SIZE, keeping at
+    // most 4096 bytes. the next block starts with the size update
+    // the peer's decoder has to see.
+    //----------------------------------------
+    void set_max_table_size(size_t size);
+
+    //----------------------------------------
+    // appends the block of fields to out. fields go in as
+    // indexed where the table has them, the rest are added to it,
+    // credentials excepted. literals are Huffman coded if shorter.
+    //----------------------------------------
+    void encode(std::span<const HpackField> fields, std::string& out);
+
+private:
+    HpackTable table_;
+    std::optional<size_t> pending_update_;   // smallest size since the last block
+    size_t pending_final_ = 4096;
+};
+
+//----------------------------------------
+// header block decompression of one connection's responses
+//----------------------------------------
+class HpackDecoder {
+public:
+    //----------------------------------------
+    // limit is the SETTINGS_HEADER_TABLE_SIZE we announced, the
+    // most a size update of the peer may ask for
+    //----------------------------------------
+    explicit HpackDecoder(size_t limit = 4096) : limit_(limit) {}
+
+    //----------------------------------------
+    // the fields of a complete header block. throws
+    // std::runtime_error on a malformed block, after which the
+    // table is out of step and the connection unusable.
+    //----------------------------------------
+    [[nodiscard]] std::vector<HpackField> decode(std::string_view block);
+
+private:
+    HpackTable table_;
+    size_t limit_;
+};
+
+//----------------------------------------
+// the Huffman code of RFC 7541 appendix B. decoding fails on
+// EOS inside the data and on padding that is not all ones or
+// longer than 7 bits.
+//----------------------------------------
+[[nodiscard]] size_t huffman_encoded_size(std::string_view data) noexcept;
+void huffman_encode(std::string_view data, std::string& out);
+[[nodiscard]] bool huffman_decode(std::string_view data, std::string& out);
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "Hpack.hpp"
+#include "HttpUtils.hpp"
+#include "Remote.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cpppwn {
+
+//----------------------------------------
+// SETTINGS parameters of RFC 9113 section 6.5.2
+//----------------------------------------
+enum class Http2Setting : uint16_t {
+  HeaderTableSize = 1,
+  EnablePush = 2,
+  MaxConcurrentStreams = 3,
+  InitialWindowSize = 4,
+  MaxFrameSize = 5,
+  MaxHeaderListSize = 6
+};
+
+//----------------------------------------
+// a stream dependency, as sent in PRIORITY frames and on HEADERS
+//----------------------------------------
+struct Http2Priority {
+  uint32_t stream = 0;       // the stream a PRIORITY frame is about, unused on HEADERS
+  uint32_t depends_on = 0;
+  uint16_t weight = 16;      // 1 to 256
+  bool exclusive = false;
+};
+
+//----------------------------------------
+// how a browser opens a connection and its streams. servers
+// fingerprint the SETTINGS order and values, the connection
+// window, the priority frames and the pseudo-header order.
+//----------------------------------------
+struct Http2Profile {
+  std::vector<std::pair<Http2Setting, uint32_t>> settings;   // in the order sent
+  uint32_t window_update = 0;                                // connection window increment, 0 sends none
+  std::vector<Http2Priority> priority_frames;                // sent right after the preface
+  std::optional<Http2Priority> headers_priority;             // priority flag on each HEADERS
+  std::string pseudo_header_order = "masp";                  // :method :authority :scheme :path
+};
+
+//----------------------------------------
+// a client connection that negotiated h2. requests from any
+// number of threads run as streams side by side. there is no
+// I/O thread: frames to send are queued, and whoever waits for
+// something drives the socket for everyone, one thread at a
+// time, sending the queue and dispatching what came in. a
+// connection costs nothing while idle, and a server that stops
+// reading never blocks a thread that has frames to read.
+//----------------------------------------
+class Http2Connection {
+public:
+    //----------------------------------------
+    // takes over remote and sends the preface profile describes
+    //----------------------------------------
+    Http2Connection(std::unique_ptr<Remote> remote, const Http2Profile& profile);
+
+    //----------------------------------------
+    // sends GOAWAY and closes the connection
+    //----------------------------------------
+    ~Http2Connection();
+
+    Http2Connection(const Http2Connection&) = delete;
+    Http2Connection& operator=(const Http2Connection&) = delete;
+
+    //----------------------------------------
+    // opens a stream and sends fields and body on it, returning
+    // the stream id. pseudo-headers are put first in the order
+    // of the profile. waits while the server's stream limit is
+    // reached and while flow control holds the body back.
+    //----------------------------------------
+    [[nodiscard]] uint32_t send_request(std::vector<HpackField> fields, std::string_view body);
+
+    //----------------------------------------
+    // status and header fields of the response on stream, once
+    // they are in. interim 1xx responses are skipped.
+    //----------------------------------------
+    [[nodiscard]] HttpResponse read_head(uint32_t stream);
+
+    //----------------------------------------
+    // the next piece of the body, empty once it ended. handing
+    // a piece out lets the server send that much more.
+    //----------------------------------------
+    [[nodiscard]] std::string read_body(uint32_t stream);
+
+    //----------------------------------------
+    // forgets stream, resetting it if the response is not
+    // complete yet
+    //----------------------------------------
+    void close_stream(uint32_t stream) noexcept;
+
+    //----------------------------------------
+    // whether another stream can be opened: false once the
+    // connection failed or the server sent GOAWAY. reads what
+    // arrived while nobody was waiting.
+    //----------------------------------------
+    [[nodiscard]] bool is_usable();
+
+    [[nodiscard]] size_t open_streams() const;
+
+    [[nodiscard]] const ConnectTiming& connect_timing() const noexcept { return remote_->connect_timing(); }
+
+private:
+    struct Stream {
+      HttpResponse head;
+      bool head_done = false;
+      std::string data;            // received and not handed out yet
+      bool ended = false;          // END_STREAM arrived
+      int64_t send_window = 0;
+      uint32_t unacked = 0;        // handed out, not yet returned with WINDOW_UPDATE
+      std::string error;
+    };
+
+    using Lock = std::unique_lock<std::mutex>;
+
+    void pump(Lock& lock, const std::function<bool()>& done);
+    void drive(Lock& lock, std::chrono::milliseconds wait);
+    void read_frames(std::string_view data);
+    void handle_frame(uint8_t type, uint8_t flags, uint32_t stream, std::string_view payload, std::string& reply);
+    void handle_header_block(uint32_t stream, bool end_stream, std::string& reply);
+    void credit(uint32_t id, Stream* stream, size_t bytes, std::string& reply);
+    void fail(const std::string& reason);
+    Stream& stream(uint32_t id);
+    size_t active_streams() const noexcept;
+    void enqueue(std::string_view frames);
+
+    std::unique_ptr<Remote> remote_;     // used by the driving thread only
+
+    mutable std::mutex mutex_;           // everything below
+    std::condition_variable cv_;
+    HpackEncoder encoder_;
+    HpackDecoder decoder_;
+    std::unordered_map<uint32_t, Stream> streams_;
+    std::string input_;                  // frames read but incomplete
+    bool driving_ = false;
+    std::string outbox_;                 // frames waiting for the driving thread, in sending order
+    size_t unsent_ = 0;                  // queued on remote_ and not written yet, as of the last drive
+    std::string failure_;                // why the connection is dead, empty while it is not
+
+    std::string header_block_;           // HEADERS or PUSH_PROMISE waiting for CONTINUATION
+    uint32_t header_stream_ = 0;
+    uint32_t promised_stream_ = 0;
+    bool header_end_stream_ = false;
+
+    bool goaway_ = false;
+    uint32_t next_stream_ = 1;
+
+    Http2Profile profile_;
+    uint32_t local_window_ = 65535;      // the INITIAL_WINDOW_SIZE we announced
+    uint32_t local_max_frame_ = 16384;
+    uint32_t local_max_header_block_ = 256 << 10;   // the MAX_HEADER_LIST_SIZE we announced, if any
+    uint32_t connection_window_ = 65535;
+    uint32_t connection_unacked_ = 0;
+
+    uint32_t peer_max_streams_ = 100;    // assumed until the server's SETTINGS
+    uint32_t peer_window_ = 65535;
+    uint32_t peer_max_frame_ = 16384;
+    uint32_t peer_table_size_ = 4096;
+    int64_t send_window_ = 65535;
+};
+
+}
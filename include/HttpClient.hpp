@@ -6,18 +6,65 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <future>
+#include <functional>
+#include <exception>
+#include <utility>
+#include <cstdint>
 
 namespace cpppwn {
 
+class ConnectionPool;
+class BatchExecutor;
+struct ResponseSink;
+
+//----------------------------------------
+// One entry of HttpClient::request_batch
+//----------------------------------------
+struct BatchRequest {
+  std::string method = "GET";
+  std::string url;
+  HttpHeaders headers;
+  std::string body;
+};
+
+//----------------------------------------
+// how HttpClient::download fetches a file
+//----------------------------------------
+struct DownloadOptions {
+  size_t segments = 1;                        // Parallel range requests, if the server accepts ranges
+  uint64_t min_segment_size = 4 << 20;        // Smaller files are split into fewer segments
+  bool resume = false;                        // Continue a partial file at output_path with a Range request
+
+  //----------------------------------------
+  // bytes written so far and the file size, 0 while unknown.
+  // may run on worker threads, but never two calls at once.
+  //----------------------------------------
+  std::function<void(uint64_t received, uint64_t total)> progress;
+};
+
 //----------------------------------------
 //
 //----------------------------------------
 class HttpClient {
 public:
+    //----------------------------------------
+    // called once per batch entry with its index; error is set
+    // instead of a response when the request threw
+    //----------------------------------------
+    using BatchCallback = std::function<void(std::size_t index, HttpResponse response, std::exception_ptr error)>;
+
     HttpClient() : HttpClient(HttpConfig{}) {
     }
     
     explicit HttpClient(const HttpConfig& config);
+
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
     
     [[nodiscard]] HttpResponse request(
       const std::string& method,
@@ -76,7 +123,34 @@ public:
       const HttpHeaders& headers = {}
     );
     
+    //----------------------------------------
+    // queues requests on the client's own worker pool and returns
+    // at once. batches bypass any event loop: each request runs
+    // the blocking client on a pool thread, so the caller sizes
+    // the pool with max_concurrent_requests, which is also how
+    // many run together. no more than max_requests_per_host go
+    // against the same host.
+    //----------------------------------------
+    [[nodiscard]] std::vector<std::future<HttpResponse>> request_batch(
+      const std::vector<BatchRequest>& requests
+    );
+
+    //----------------------------------------
+    // same as above, but reports each completion to on_complete.
+    // the callback runs on a worker thread.
+    //----------------------------------------
+    void request_batch(
+      const std::vector<BatchRequest>& requests,
+      BatchCallback on_complete
+    );
+    
+    //----------------------------------------
+    // streams the body straight to output_path through a fixed
+    // size buffer. false (and a message on stderr) on failure.
+    //----------------------------------------
     bool download(const std::string& url, const std::string& output_path);
+
+    bool download(const std::string& url, const std::string& output_path, const DownloadOptions& options);
     
     static std::map<std::string, std::string> get_cookies(const HttpResponse& response);
     
@@ -89,29 +163,66 @@ public:
     
     void set_config(const HttpConfig& config) { config_ = config; }
     
+    //----------------------------------------
+    // not synchronized with a running batch, use cookies_snapshot()
+    //----------------------------------------
     [[nodiscard]] const std::map<std::string, std::string>& cookies() const noexcept { 
       return cookie_jar_; 
     }
+
+    [[nodiscard]] std::map<std::string, std::string> cookies_snapshot() const {
+      std::lock_guard lock(cookie_mutex_);
+      return cookie_jar_;
+    }
     
     void set_cookies(const std::map<std::string, std::string>& cookies) {
+      std::lock_guard lock(cookie_mutex_);
       cookie_jar_ = cookies;
     }
     
     void clear_cookies() { 
+      std::lock_guard lock(cookie_mutex_);
       cookie_jar_.clear(); 
     }
+    
+    //----------------------------------------
+    // drops every kept-alive connection of this client
+    //----------------------------------------
+    void close_idle_connections();
 
 private:
-  std::string build_request(
+  std::vector<std::pair<std::string, std::string>> request_headers(
     const std::string& method,
     const ParsedUrl& url,
     const HttpHeaders& headers,
     const std::string& body
   ) const;
+
+  std::unique_ptr<Remote> connect(const ParsedUrl& url) const;
+
+  HttpResponse perform(
+    const std::string& method,
+    const ParsedUrl& url,
+    const HttpHeaders& headers,
+    const std::string& body,
+    const ResponseSink* sink = nullptr
+  );
+
+  HttpResponse fetch(
+    std::string& url,
+    const std::string& method,
+    const HttpHeaders& headers,
+    const ResponseSink* sink
+  );
+
+  bool download_segmented(const std::string& url, int fd, const DownloadOptions& options);
+  bool download_stream(const std::string& url, int fd, uint64_t existing, const DownloadOptions& options);
     
   HttpConfig config_;
-  std::unique_ptr<Remote> remote_;
+  std::shared_ptr<ConnectionPool> pool_;
   std::map<std::string, std::string> cookie_jar_;
+  mutable std::mutex cookie_mutex_;
+  std::unique_ptr<BatchExecutor> batch_;
 };
 
 }
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace cpppwn {
+
+//----------------------------------------
+//
+//----------------------------------------
+struct HttpHeaderView {
+  std::string_view name;
+  std::string_view value;   // surrounding whitespace removed
+};
+
+//----------------------------------------
+// request or status line plus header fields of one message, as
+// slices of the parsed buffer. valid for as long as it is.
+//----------------------------------------
+struct HttpHead {
+  static constexpr size_t max_headers = 128;
+
+  std::string_view method;    // requests only
+  std::string_view target;    // requests only, path and query
+  std::string_view path;
+  std::string_view query;     // without the '?'
+  int status = 0;             // responses only
+  std::string_view reason;    // responses only
+  int version_minor = 1;      // the x of HTTP/1.x
+  std::array<HttpHeaderView, max_headers> headers;
+  size_t header_count = 0;
+  size_t size = 0;            // bytes of the head, empty line included
+
+  [[nodiscard]] std::span<const HttpHeaderView> fields() const noexcept {
+    return {headers.data(), header_count};
+  }
+
+  //----------------------------------------
+  // the first field called name, ignoring case
+  //----------------------------------------
+  [[nodiscard]] std::optional<std::string_view> header(std::string_view name) const noexcept;
+};
+
+enum class ParseResult {
+  Complete,     // head filled in, the body starts at head.size
+  Incomplete,   // call again once more bytes arrived
+  Invalid       // not HTTP/1.x, or more than max_headers fields
+};
+
+//----------------------------------------
+// parser of HTTP/1.x message heads in the style of picohttpparser.
+// hand it everything received for the message so far, again after
+// every read. the search for the end of the head picks up where
+// the previous call gave up, the head is tokenised in one pass
+// once it is complete and nothing is copied or allocated.
+// accepts bare LF line endings like most servers do.
+//----------------------------------------
+class HttpParser {
+public:
+    [[nodiscard]] ParseResult parse_request(std::string_view buffer, HttpHead& head);
+    [[nodiscard]] ParseResult parse_response(std::string_view buffer, HttpHead& head);
+
+    //----------------------------------------
+    // forgets the progress, for the next message
+    //----------------------------------------
+    void reset() noexcept { scanned_ = 0; }
+
+private:
+    size_t scanned_ = 0;    // bytes known not to hold the end of the head
+
+    [[nodiscard]] size_t find_end(std::string_view buffer);
+};
+
+}
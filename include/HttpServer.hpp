@@ -3,24 +3,74 @@
 #include "Server.hpp"
 #include "Remote.hpp"
 #include "HttpUtils.hpp"
+#include "HttpParser.hpp"
+#include "Router.hpp"
+#include "BodyReader.hpp"
+#include "StaticFileCache.hpp"
+#include "Metrics.hpp"
 
 #include <string>
 #include <map>
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
 
 namespace cpppwn {
 
+//----------------------------------------
+// responses are compressed when the client accepts a coding,
+// the body is at least min_size bytes and its Content-Type
+// starts with one of mime_types
+//----------------------------------------
+struct CompressionConfig {
+  bool enabled = false;
+  size_t min_size = 1024;                     // Smaller bodies go out as they are
+  int level = -1;                             // Per-request level, -1 for the coding's default
+  std::vector<std::string> mime_types = {     // Content-Type prefixes worth compressing
+    "text/",
+    "application/json",
+    "application/javascript",
+    "application/xml",
+    "application/xhtml+xml",
+    "image/svg+xml"
+  };
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+struct HttpServerConfig {
+  size_t worker_threads = std::max(1u, std::thread::hardware_concurrency()); // Threads running the event loop
+  size_t max_connections = 1024;                                             // In-flight connections before accept pauses
+  std::chrono::seconds keep_alive_timeout{5};                                // Idle time before a persistent connection is closed
+  size_t max_keep_alive_requests = 100;                                      // Requests served on one connection before closing it
+  size_t max_header_size = 64 << 10;                                         // Request line and headers, larger ones get a 431
+  std::chrono::seconds header_timeout{10};                                   // Time to send the request head, slower clients get a 408 (0 = unlimited)
+  std::chrono::seconds body_read_timeout{30};                                // Longest wait for more of a request body before a 408 (0 = unlimited)
+  std::chrono::seconds send_timeout{30};                                     // Longest wait for the client to take more of a response before dropping it (0 = unlimited)
+  uint64_t max_body_size = 64 << 20;                                         // Buffered request bodies, larger ones get a 413 (0 = unlimited)
+  uint64_t max_streamed_body_size = 0;                                       // Bodies read by streaming routes (0 = unlimited)
+  StaticFileCacheConfig static_files;                                        // Cache behind serve_static()
+  CompressionConfig compression;                                             // Content-Encoding of responses
+};
+
 //----------------------------------------
 //
 //----------------------------------------
 class HttpServer {
 public:
-  explicit HttpServer(uint16_t port, const std::string& bind_addr = "0.0.0.0");
+  explicit HttpServer(uint16_t port, const std::string& bind_addr = "0.0.0.0",
+      const ServerOptions& options = {});
 
   explicit HttpServer(uint16_t port, const TlsConfig& tls_config,
-      const std::string& bind_addr = "0.0.0.0");
+      const std::string& bind_addr = "0.0.0.0", const ServerOptions& options = {});
   
   ~HttpServer();
   
@@ -35,13 +85,54 @@ public:
   void del(const std::string& path, RouteHandler handler);
   
   void patch(const std::string& path, RouteHandler handler);
+
+  //----------------------------------------
+  // the handler reads the body itself through the BodyReader,
+  // for uploads too large to hold in memory. middlewares see
+  // the request with an empty body.
+  //----------------------------------------
+  void route_stream(const std::string& method, const std::string& path, StreamingHandler handler);
+
+  void post_stream(const std::string& path, StreamingHandler handler);
+
+  void put_stream(const std::string& path, StreamingHandler handler);
   
   void use_middleware(Middleware middleware);
   
+  //----------------------------------------
+  // serves directory below url_prefix for any method. routes
+  // registered under the prefix take precedence. answers Range
+  // and conditional requests, large files go out with sendfile().
+  //----------------------------------------
   void serve_static(const std::string& url_prefix, const std::string& directory);
   
+  //----------------------------------------
+  // answers GET path with the server's metrics in the Prometheus
+  // text format. does nothing when metrics are compiled out.
+  //----------------------------------------
+  void serve_metrics(const std::string& path = "/metrics");
+
+  [[nodiscard]] const ServerMetrics& metrics() const noexcept { return metrics_; }
+  
+  [[nodiscard]] const HttpServerConfig& config() const noexcept { return config_; }
+  
+  void set_config(const HttpServerConfig& config) {
+    config_ = config;
+    static_cache_.configure(config_.static_files);
+  }
+  
+  //----------------------------------------
+  // runs the event loop on config().worker_threads threads
+  // (including the calling one). blocks until stop() has drained
+  // every in-flight connection.
+  //----------------------------------------
   void start();
   
+  //----------------------------------------
+  // stops accepting, closes idle connections and lets in-flight
+  // requests finish. when called from outside a handler it
+  // blocks until start() has returned.
+  //----------------------------------------
   void stop();
   
   [[nodiscard]] bool is_running() const noexcept;
@@ -51,15 +142,40 @@ public:
   HttpServer& operator=(const HttpServer&) = delete;
     
 private:
-  void handle_client(std::unique_ptr<Remote> client);
-  HttpRequest parse_request(const std::string& raw_request) const;
-  HttpResponse handle_static_file(const HttpRequest& request) const;
+  void do_accept(size_t acceptor);
+  void serve_connection(std::shared_ptr<Remote> client, size_t served = 0);
+  void release_connection();
+  void sweep_idle_connections();
+  void run_worker();
+  asio::awaitable<bool> handle_client(Remote& client, size_t served);
+  HttpRequest parse_request(std::string_view raw_request) const;
+  HttpResponse handle_static_file(const HttpRequest& request, const std::string& directory,
+      const std::string& relative_path) const;
+  HttpResponse not_found(const HttpRequest& request) const;
+  bool compressible(const HttpResponse& response) const;
+  void compress_response(const HttpRequest& request, HttpResponse& response) const;
   
   std::unique_ptr<Server> server_;
-  std::map<std::string, RouteHandler> routes_;
+  Router router_;
   std::vector<Middleware> middlewares_;
-  std::map<std::string, std::string> static_routes_;
+  mutable StaticFileCache static_cache_;
+  ServerMetrics metrics_;
   std::atomic<bool> running_;
+
+  HttpServerConfig config_;
+  std::vector<std::thread> workers_;
+
+  // connection accounting for backpressure and draining
+  std::mutex connections_mutex_;
+  std::unordered_map<Remote*, std::chrono::steady_clock::time_point> idle_connections_;
+  size_t active_connections_ = 0;
+  std::deque<size_t> paused_acceptors_;  // waiting for a free connection slot
+  asio::steady_timer idle_timer_;
+
+  // signalled once start() has joined its workers
+  std::mutex loop_mutex_;
+  std::condition_variable loop_cv_;
+  bool loop_active_ = false;
 };
 
 }
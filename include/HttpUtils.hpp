@@ -1,19 +1,128 @@
 # pragma once
 
 #include <string>
+#include <string_view>
+#include <array>
 #include <map>
 #include <algorithm>
 #include <functional>
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <inttypes.h>
 
 class HttpRequest;
 class HttpResponse;
 class CookieOptions;
 
-using HttpHeaders = std::map<std::string, std::string>;
+//----------------------------------------
+// ASCII case-insensitive equality, for header names and tokens
+//----------------------------------------
+[[nodiscard]] inline bool iequals(std::string_view a, std::string_view b) noexcept {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+    return (x | (x >= 'A' && x <= 'Z' ? 0x20 : 0)) == (y | (y >= 'A' && y <= 'Z' ? 0x20 : 0));
+  });
+}
+
+//----------------------------------------
+// orders header names ignoring ASCII case. transparent, so a
+// lookup takes any string_view without a lowercased copy.
+//----------------------------------------
+struct CaseInsensitiveLess {
+  using is_transparent = void;
+
+  [[nodiscard]] bool operator()(std::string_view a, std::string_view b) const noexcept {
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+      return (x | (x >= 'A' && x <= 'Z' ? 0x20 : 0)) < (y | (y >= 'A' && y <= 'Z' ? 0x20 : 0));
+    });
+  }
+};
+
+using HttpHeaders = std::map<std::string, std::string, CaseInsensitiveLess>;
 using RouteHandler = std::function<HttpResponse(const HttpRequest&)>;
 using Middleware = std::function<bool(const HttpRequest&, HttpResponse&)>;
 
+//----------------------------------------
+// a value captured by a :name or *name route segment, kept as
+// a range of the request path so copies of the request stay valid
+//----------------------------------------
+struct PathParam {
+  std::string_view name;
+  size_t offset = 0;
+  size_t length = 0;
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+struct PathParams {
+  static constexpr size_t max_params = 8;
+
+  std::array<PathParam, max_params> items{};
+  size_t count = 0;
+};
+
+//----------------------------------------
+// a query string, Cookie header or form body that is only split
+// into its map the first time something looks at it. reads like
+// a const std::map, assigning a map replaces the source. the
+// first look mutates, so it is not safe from two threads at once.
+//----------------------------------------
+class LazyParams {
+public:
+    using map_type = std::map<std::string, std::string>;
+
+    enum class Syntax {
+      Query,    // a=1&b=2, percent-decoded
+      Cookies   // a=1; b=2
+    };
+
+    LazyParams() = default;
+
+    LazyParams(map_type params) : params_(std::move(params)) {}
+
+    LazyParams& operator=(map_type params) {
+      params_ = std::move(params);
+      source_.clear();
+      parsed_ = true;
+      return *this;
+    }
+
+    //----------------------------------------
+    // keeps source to be parsed on first access
+    //----------------------------------------
+    void assign(std::string source, Syntax syntax) {
+      source_ = std::move(source);
+      syntax_ = syntax;
+      params_.clear();
+      parsed_ = source_.empty();
+    }
+
+    [[nodiscard]] const map_type& get() const;
+
+    operator const map_type&() const { return get(); }
+
+    [[nodiscard]] auto begin() const { return get().begin(); }
+    [[nodiscard]] auto end() const { return get().end(); }
+    [[nodiscard]] auto find(const std::string& key) const { return get().find(key); }
+    [[nodiscard]] size_t count(const std::string& key) const { return get().count(key); }
+    [[nodiscard]] bool contains(const std::string& key) const { return get().contains(key); }
+    [[nodiscard]] const std::string& at(const std::string& key) const { return get().at(key); }
+    [[nodiscard]] size_t size() const { return get().size(); }
+    [[nodiscard]] bool empty() const { return get().empty(); }
+
+    std::string& operator[](const std::string& key) {
+      static_cast<void>(get());
+      return params_[key];
+    }
+
+private:
+    mutable std::string source_;
+    mutable map_type params_;
+    Syntax syntax_ = Syntax::Query;
+    mutable bool parsed_ = true;
+};
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -21,11 +130,12 @@ struct HttpRequest {
   std::string method;                              // HTTP method (GET, POST, etc.)
   std::string path;                                // Request path (e.g., "/api/users")
   std::string http_version;                        // HTTP version (e.g., "HTTP/1.1")
-  std::map<std::string, std::string> headers;      // Request headers (lowercase keys)
-  std::map<std::string, std::string> query_params; // Query parameters
-  std::map<std::string, std::string> cookies;      // Parsed cookies
-  std::map<std::string, std::string> form_data;    // Parsed form data
+  HttpHeaders headers;                             // Request headers (case-insensitive keys)
+  LazyParams query_params;                         // Query parameters, parsed on first use
+  LazyParams cookies;                              // Parsed cookies, parsed on first use
+  LazyParams form_data;                            // Parsed form data, parsed on first use
   std::string body;                                // Raw request body
+  PathParams path_params;                          // Captured by the matched route
                                                    
   [[nodiscard]] std::string get_header(const std::string& name) const;
     
@@ -34,6 +144,8 @@ struct HttpRequest {
   [[nodiscard]] std::string get_cookie(const std::string& name) const;
     
   [[nodiscard]] std::string get_param(const std::string& name) const;
+
+  [[nodiscard]] std::string get_path_param(const std::string& name) const;
 };
 
 //----------------------------------------
@@ -48,6 +160,31 @@ struct CookieOptions {
   std::string same_site = "Lax";  // SameSite attribute (Strict, Lax, None)
 };
 
+//----------------------------------------
+// a byte range of an open file, sent after the headers in place
+// of the body. copies of the response share the descriptor,
+// which closes with the last of them.
+//----------------------------------------
+struct FileBody {
+  std::shared_ptr<const int> fd;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+};
+
+//----------------------------------------
+// where the time of a client request went. the connection
+// phases stay zero when a kept-alive connection was reused,
+// everything does when the library was built without metrics.
+//----------------------------------------
+struct RequestTiming {
+  std::chrono::nanoseconds dns{0};            // name lookup, next to nothing when cached
+  std::chrono::nanoseconds connect{0};        // TCP connect, a proxy's handshake included
+  std::chrono::nanoseconds tls_handshake{0};
+  std::chrono::nanoseconds first_byte{0};     // request sent until the first response byte
+  std::chrono::nanoseconds total{0};          // request built until the body was read
+  bool reused_connection = false;
+};
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -57,6 +194,8 @@ struct HttpResponse {
   HttpHeaders headers;
   std::string body;
   std::vector<std::string> cookies;
+  std::optional<FileBody> file;
+  RequestTiming timing;   // set by HttpClient
 
   explicit HttpResponse(int code = 200);
     
@@ -74,6 +213,12 @@ struct HttpResponse {
                            const CookieOptions& options = {});
   
   HttpResponse& set_body(const std::string& content);
+
+  //----------------------------------------
+  // takes ownership of fd. the body is left empty, servers
+  // stream the range from disk after the headers.
+  //----------------------------------------
+  HttpResponse& set_file(int fd, uint64_t offset, uint64_t length);
   
   HttpResponse& set_json(const std::string& json);
   
@@ -82,6 +227,13 @@ struct HttpResponse {
   HttpResponse& redirect(const std::string& location, int code = 302);
   
   [[nodiscard]] std::string to_string() const;
+
+  //----------------------------------------
+  // writes the status line and headers, up to and including the
+  // blank line, into out. servers send the body after it as a
+  // separate buffer instead of copying it in.
+  //----------------------------------------
+  void serialize_head(std::string& out) const;
   
   static std::string get_status_message(int code);
 };
@@ -115,6 +267,17 @@ struct HttpConfig {
   bool send_dnt = false;                           // Send Do-Not-Track header
   std::string referer;                             // Referer header for navigation
   bool auto_store_cookies = true;                  // Automatically store cookies
+  bool decode_content = true;                      // Decode gzip, deflate and br bodies (br if built with brotli)
+  uint64_t max_decoded_size = 1ull << 30;          // Decoded body size past which the request throws (0 = unlimited)
+  bool enable_http2 = true;                        // Offer h2 over ALPN and multiplex requests when it is picked
+
+  std::chrono::milliseconds connect_timeout{0};    // Connect to a host's addresses, 0 leaves it to the OS
+  bool reuse_connections = true;                   // Keep connections open between requests
+  size_t max_idle_connections = 16;                // Idle connections kept across all hosts
+  std::chrono::seconds idle_timeout{30};           // Idle time before a kept connection is dropped
+
+  size_t max_concurrent_requests = 8;              // Worker threads serving request_batch
+  size_t max_requests_per_host = 6;                // Batch requests in flight per host
     
   //----------------------------------------
   //
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+namespace cpppwn {
+
+using address_t = size_t;
+
+//----------------------------------------
+// one mapping from /proc/[pid]/maps
+//----------------------------------------
+struct MemoryRegion {
+  address_t start;
+  address_t end;
+  std::string permissions;  // "r-xp" style flags
+  size_t offset;            // offset into the mapped file
+  std::string path;         // file, [heap], [stack] etc., empty if anonymous
+
+  [[nodiscard]] size_t size() const noexcept { return end - start; }
+  [[nodiscard]] bool contains(address_t address) const noexcept { return address >= start && address < end; }
+
+  [[nodiscard]] bool readable() const noexcept { return permissions.size() > 0 && permissions[0] == 'r'; }
+  [[nodiscard]] bool writable() const noexcept { return permissions.size() > 1 && permissions[1] == 'w'; }
+  [[nodiscard]] bool executable() const noexcept { return permissions.size() > 2 && permissions[2] == 'x'; }
+};
+
+//----------------------------------------
+// limits a memory scan to some of the process's mappings
+//----------------------------------------
+struct ScanFilter {
+  std::string module;       // only mappings whose path contains this (empty: all)
+  std::string permissions;  // flags every mapping must have, e.g. "rx" or "r-xp"
+};
+
+//----------------------------------------
+// the mappings of a process, sorted by address. refresh() re-reads
+// the maps file but only reparses it when its content changed.
+//----------------------------------------
+class MemoryMap {
+public:
+    explicit MemoryMap(pid_t pid);
+
+    //----------------------------------------
+    // re-reads /proc/[pid]/maps, true if the mappings changed
+    //----------------------------------------
+    bool refresh();
+
+    [[nodiscard]] pid_t pid() const noexcept { return pid_; }
+    [[nodiscard]] std::span<const MemoryRegion> regions() const noexcept { return regions_; }
+
+    //----------------------------------------
+    // region holding address, nullptr if address is unmapped
+    //----------------------------------------
+    [[nodiscard]] const MemoryRegion* region_at(address_t address) const noexcept;
+
+    //----------------------------------------
+    // lowest address module is mapped at. module is looked up as
+    // a full path or file name first, then as part of a path.
+    //----------------------------------------
+    [[nodiscard]] std::optional<address_t> module_base(std::string_view module) const;
+
+    //----------------------------------------
+    // readable regions passing filter, without the kernel pages
+    // that can't be read. valid until the next refresh().
+    //----------------------------------------
+    [[nodiscard]] std::vector<const MemoryRegion*> readable_regions(const ScanFilter& filter) const;
+
+private:
+    void parse(std::string_view content);
+
+    pid_t pid_;
+    size_t content_hash_ = 0;
+    size_t content_size_ = 0;
+    std::vector<MemoryRegion> regions_;
+    std::vector<std::pair<std::string, address_t>> modules_;  // path and file name -> base, sorted
+};
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpppwn {
+
+//----------------------------------------
+// false when the library was built with CPPPWN_WITH_METRICS off.
+// the instrumentation sits behind if constexpr on this, so
+// nothing of it is left in such a build.
+//----------------------------------------
+#ifdef CPPPWN_METRICS
+inline constexpr bool metrics_enabled = true;
+#else
+inline constexpr bool metrics_enabled = false;
+#endif
+
+//----------------------------------------
+// durations bucketed by fixed upper bounds, Prometheus style.
+// observe() is a couple of relaxed atomic adds.
+//----------------------------------------
+class LatencyHistogram {
+public:
+    // upper bounds in microseconds, 0.1ms to 10s
+    static constexpr std::array<uint64_t, 14> bounds_us{
+      100, 250, 500, 1'000, 2'500, 5'000, 10'000, 25'000,
+      50'000, 100'000, 250'000, 500'000, 1'000'000, 10'000'000
+    };
+
+    void observe(std::chrono::nanoseconds elapsed) noexcept;
+
+    //----------------------------------------
+    // appends the _bucket, _sum and _count series of name.
+    // labels go inside the braces, e.g. method="GET".
+    //----------------------------------------
+    void render(std::string& out, std::string_view name, std::string_view labels) const;
+
+private:
+    std::array<std::atomic<uint64_t>, bounds_us.size() + 1> buckets_{};   // the last one is +Inf
+    std::atomic<uint64_t> sum_ns_{0};
+};
+
+//----------------------------------------
+// counters of one route. HttpServer keeps a pointer next to
+// the route's handler, so counting needs no lookup.
+//----------------------------------------
+struct RouteMetrics {
+  std::string method;
+  std::string route;                                  // the pattern the route was registered with
+  std::array<std::atomic<uint64_t>, 5> responses{};   // by status class, 1xx to 5xx
+  LatencyHistogram latency;
+
+  void observe(int status, std::chrono::nanoseconds elapsed) noexcept;
+};
+
+//----------------------------------------
+// what HttpServer counts. updates are lock-free, the mutex only
+// guards registering routes and rendering.
+//----------------------------------------
+class ServerMetrics {
+public:
+    ServerMetrics();
+
+    ServerMetrics(const ServerMetrics&) = delete;
+    ServerMetrics& operator=(const ServerMetrics&) = delete;
+
+    //----------------------------------------
+    // the counters of method and pattern, created on first use.
+    // null when metrics are compiled out.
+    //----------------------------------------
+    [[nodiscard]] std::shared_ptr<RouteMetrics> route(std::string_view method, std::string_view pattern);
+
+    //----------------------------------------
+    // where requests no route took are counted, 404s and 405s
+    // as well as requests rejected before routing
+    //----------------------------------------
+    [[nodiscard]] RouteMetrics& unmatched() noexcept { return *unmatched_; }
+
+    void connection_opened() noexcept;
+    void connection_closed() noexcept;
+
+    void add_received(uint64_t bytes) noexcept { bytes_received_.fetch_add(bytes, std::memory_order_relaxed); }
+    void add_sent(uint64_t bytes) noexcept { bytes_sent_.fetch_add(bytes, std::memory_order_relaxed); }
+    void count_error() noexcept { errors_.fetch_add(1, std::memory_order_relaxed); }
+
+    //----------------------------------------
+    // everything in the Prometheus text exposition format
+    //----------------------------------------
+    [[nodiscard]] std::string render() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<RouteMetrics>> routes_;
+    std::shared_ptr<RouteMetrics> unmatched_;
+
+    std::atomic<int64_t> active_connections_{0};
+    std::atomic<uint64_t> connections_{0};
+    std::atomic<uint64_t> bytes_received_{0};
+    std::atomic<uint64_t> bytes_sent_{0};
+    std::atomic<uint64_t> errors_{0};
+};
+
+}
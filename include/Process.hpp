@@ -1,20 +1,44 @@
 #pragma once
 
 #include "Stream.hpp"
+#include "RecvBuffer.hpp"
+#include "Signature.hpp"
+#include "MemoryMap.hpp"
 
+#include <asio/awaitable.hpp>
+#include <asio/posix/stream_descriptor.hpp>
 #include <string>
 #include <vector>
 #include <optional>
+#include <span>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <cstdint>
+#include <type_traits>
 #include <unistd.h>
 
 namespace cpppwn {
 
 using handle_t = int;
-using address_t = size_t;
 using buffer_t = std::vector<std::byte>;
 
 class Process;
 
+//----------------------------------------
+// one range of a batched memory read or write
+//----------------------------------------
+struct MemoryRead {
+  address_t address;
+  std::span<std::byte> data;
+};
+
+struct MemoryWrite {
+  address_t address;
+  std::span<const std::byte> data;
+};
+
 class Process : public Stream {
 public:
     explicit Process(const std::string& process_name);
@@ -28,6 +52,34 @@ public:
     [[nodiscard]] std::string recvline() override;
     [[nodiscard]] std::string recvall() override;
 
+    [[nodiscard]] std::string recv(std::size_t size, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] std::string recvuntil(const std::string& delim, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] std::string recvline(std::chrono::milliseconds timeout) override;
+    [[nodiscard]] bool can_recv(std::chrono::milliseconds timeout = std::chrono::milliseconds{0}) override;
+
+    [[nodiscard]] std::size_t recv_into(std::span<char> buffer) override;
+    void send_bytes(std::span<const char> data) override;
+
+    //----------------------------------------
+    // the pipes are bound to the executor of the first coroutine
+    // awaiting one of these calls, later ones run there too
+    //----------------------------------------
+    [[nodiscard]] asio::awaitable<void> async_send(std::string data) override;
+    [[nodiscard]] asio::awaitable<void> async_sendline(std::string data) override;
+
+    [[nodiscard]] asio::awaitable<std::string> async_recv(std::size_t size) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvuntil(std::string delim) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvline() override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvall() override;
+
+    [[nodiscard]] asio::awaitable<std::string> async_recv(std::size_t size, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvuntil(std::string delim, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvline(std::chrono::milliseconds timeout) override;
+
+    [[nodiscard]] int read_fd() noexcept override { return child_stdout_; }
+    [[nodiscard]] int write_fd() noexcept override { return child_stdin_; }
+    [[nodiscard]] std::string take_buffered() override;
+
     [[nodiscard]] bool is_alive() const noexcept override;
     void close() override;
 
@@ -36,23 +88,87 @@ public:
 
     void interactive() override;
 
-    std::optional<address_t> findSignature(const std::string& signature);
+    std::optional<address_t> findSignature(const std::string& signature, const ScanFilter& filter = {});
+    std::optional<address_t> findSignature(const Signature& signature, const ScanFilter& filter = {});
+
+    //----------------------------------------
+    // all matches in readable memory, lowest addresses first.
+    // regions are read in 1 MiB chunks and scanned on all cores.
+    //----------------------------------------
+    std::vector<address_t> findSignatureAll(const Signature& signature, size_t max_matches = SIZE_MAX,
+      const ScanFilter& filter = {});
+
+    //----------------------------------------
+    // lowest match of every signature, found in a single pass.
+    // entry i is empty if signatures[i] did not match.
+    //----------------------------------------
+    std::vector<std::optional<address_t>> findSignatures(std::span<const Signature> signatures,
+      const ScanFilter& filter = {});
 
     void writeMemory(const address_t address, const buffer_t& buffer);
+    void writeMemory(const address_t address, std::span<const std::byte> data);
 
     buffer_t readMemory(const address_t address, size_t size);
+    void readMemory(const address_t address, std::span<std::byte> buffer);
+
+    //----------------------------------------
+    // many ranges per process_vm_readv/writev call. ranges the
+    // syscalls cannot reach, e.g. writes to read-only pages, go
+    // through /proc/[pid]/mem instead. safe to call from several
+    // threads at once.
+    //----------------------------------------
+    void readMemory(std::span<const MemoryRead> reads);
+    void writeMemory(std::span<const MemoryWrite> writes);
+
+    //----------------------------------------
+    // typed access without a heap allocation
+    //----------------------------------------
+    template<typename T>
+      requires std::is_trivially_copyable_v<T>
+    T read(const address_t address) {
+      std::array<std::byte, sizeof(T)> raw;
+      readMemory(address, std::span<std::byte>(raw));
+      return std::bit_cast<T>(raw);
+    }
+
+    template<typename T>
+      requires std::is_trivially_copyable_v<T>
+    void write(const address_t address, const T& value) {
+      writeMemory(address, std::as_bytes(std::span(&value, 1)));
+    }
 
     void loadLibrary(const std::string& path); //call dlopen()
 
+    //----------------------------------------
+    // mappings of the process, re-read on every call but only
+    // reparsed when they changed
+    //----------------------------------------
+    const MemoryMap& memoryMap();
+
     ~Process() override;
 
 private:
     std::string process_name_;
-    handle_t process_handle_;
+    handle_t process_handle_;   // cached /proc/[pid]/mem, see memoryHandle()
     handle_t child_stdin_;
     handle_t child_stdout_;
     pid_t pid_;
+    RecvBuffer recv_buf_{64 * 1024};
+    std::optional<MemoryMap> memory_map_;
     
+    std::atomic<bool> vm_rw_available_{true};   // false once process_vm_readv/writev are refused
+    std::mutex memory_handle_mutex_;
+
+    // child_stdin_ and child_stdout_ once awaited, see bind_pipes()
+    std::optional<asio::posix::stream_descriptor> async_stdin_;
+    std::optional<asio::posix::stream_descriptor> async_stdout_;
+
+    bool fill_recv_buffer();
+    asio::awaitable<void> bind_pipes();
+    void release_pipes() noexcept;
+    asio::awaitable<bool> async_fill_recv_buffer();
+    asio::awaitable<bool> async_fill_recv_buffer(std::chrono::steady_clock::time_point deadline, bool& eof);
+    int memoryHandle();
     address_t getBaseAddress(const std::string& module_name = "");
 };
 
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "HttpClient.hpp"
+#include "RESTCodec.hpp"
 #include <glaze/glaze.hpp>
 #include <string>
 #include <map>
 #include <optional>
 #include <stdexcept>
+#include <vector>
+#include <future>
 
 namespace cpppwn {
 
@@ -28,10 +31,11 @@ class RESTException : public std::runtime_error {
 //
 //----------------------------------------
 struct PaginatedResponse {
-    std::string data;  // JSON data
-    int page = 1;      // Current page
-    int per_page = 20; // Items per page
-    int total = 0;     // Total items
+    std::string data;          // Response body, JSON or BEVE
+    std::string content_type;  // Content-Type of data
+    int page = 1;              // Current page
+    int per_page = 20;         // Items per page
+    int total = 0;             // Total items
 };
 
 //----------------------------------------
@@ -49,136 +53,89 @@ public:
     
   void set_header(const std::string& name, const std::string& value);
     
+  //----------------------------------------
+  // format of request bodies, and the one asked for in replies.
+  // replies are decoded by their own Content-Type either way.
+  //----------------------------------------
+  void set_wire_format(WireFormat format) { format_ = format; }
+
+  [[nodiscard]] WireFormat wire_format() const noexcept { return format_; }
+    
   template<typename T>
   T get(const std::string& endpoint, const HttpHeaders& headers = {}) {
-    std::string json = get(endpoint, headers);
-    
-    T result;
-    auto error = glz::read_json(result, json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, json));
-    }
-        
-    return result;
+    return decode_response<T>(send("GET", endpoint, nullptr, headers));
   }
     
   template<typename TRequest, typename TResponse = TRequest>
   TResponse post(const std::string& endpoint, const TRequest& data, const HttpHeaders& headers = {}) {
-    std::string json = glz::write_json(data);
-    std::string response_json = post(endpoint, json, headers);
-        
-    TResponse result;
-    auto error = glz::read_json(result, response_json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response_json));
-    }
-        
-    return result;
+    return decode_response<TResponse>(send("POST", endpoint, &encode(data, format_), headers));
   }
     
   template<typename TRequest, typename TResponse = TRequest>
   TResponse put(const std::string& endpoint, const TRequest& data, const HttpHeaders& headers = {}) {
-    std::string json = glz::write_json(data);
-    std::string response_json = put(endpoint, json, headers);
-        
-    TResponse result;
-    auto error = glz::read_json(result, response_json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response_json));
-    }
-    
-    return result;
+    return decode_response<TResponse>(send("PUT", endpoint, &encode(data, format_), headers));
   }
     
   template<typename TRequest, typename TResponse = TRequest>
   TResponse patch(const std::string& endpoint, const TRequest& data, const HttpHeaders& headers = {}) {
-    std::string json = glz::write_json(data);
-    std::string response_json = patch(endpoint, json, headers);
-        
-    TResponse result;
-    auto error = glz::read_json(result, response_json);
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response_json));
-    }
-    
-    return result;
+    return decode_response<TResponse>(send("PATCH", endpoint, &encode(data, format_), headers));
   }
     
   template<typename T>
   std::vector<T> list(const std::string& resource, 
     const std::map<std::string, std::string>& query_params = {}, const HttpHeaders& headers = {}) {
-        std::string json = list(resource, query_params, headers);
-        
-        std::vector<T> result;
-        auto error = glz::read_json(result, json);
-
-        if(error) {
-          throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, json));
-        }
-        
-        return result;
+        return decode_response<std::vector<T>>(send("GET", list_endpoint(resource, query_params), nullptr, headers));
   }
     
   template<typename T>
   T retrieve(const std::string& resource, const std::string& id, const HttpHeaders& headers = {}) {
-    std::string json = retrieve(resource, id, headers);
-        
-    T result;
-    auto error = glz::read_json(result, json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, json));
-    }
-        
-    return result;
+    return decode_response<T>(send("GET", "/" + resource + "/" + id, nullptr, headers));
   }
     
   template<typename T>
   T create(const std::string& resource, const T& data, const HttpHeaders& headers = {}) {
-    std::string json = glz::write_json(data);
-    std::string response_json = create(resource, json, headers);
-        
-    T result;
-    auto error = glz::read_json(result, response_json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response_json));
-    }
-        
-    return result;
+    return decode_response<T>(send("POST", "/" + resource, &encode(data, format_), headers));
   }
     
   template<typename T>
   T update(const std::string& resource, const std::string& id, const T& data, const HttpHeaders& headers = {}) {
-    std::string json = glz::write_json(data);
-    std::string response_json = update(resource, id, json, headers);
-        
-    T result;
-    auto error = glz::read_json(result, response_json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response_json));
-    }
-        
-    return result;
+    return decode_response<T>(send("PUT", "/" + resource + "/" + id, &encode(data, format_), headers));
   }
     
   template<typename T>
   T partial_update(const std::string& resource, const std::string& id, const T& data, const HttpHeaders& headers = {}) {
-    std::string json = glz::write_json(data);
-    std::string response_json = partial_update(resource, id, json, headers);
-        
-    T result;
-    auto error = glz::read_json(result, response_json);
-
-    if(error) {
-      throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response_json));
-    }
+    return decode_response<T>(send("PATCH", "/" + resource + "/" + id, &encode(data, format_), headers));
+  }
     
-    return result;
+  //----------------------------------------
+  // GETs every endpoint concurrently through http_client()'s
+  // batch pool. decoding happens when a future is read.
+  //----------------------------------------
+  template<typename T>
+  std::vector<std::future<T>> get_batch(const std::vector<std::string>& endpoints, const HttpHeaders& headers = {}) {
+    std::vector<std::pair<std::string, std::string>> requests;
+    requests.reserve(endpoints.size());
+
+    for(const auto& endpoint : endpoints) {
+      requests.emplace_back(endpoint, std::string{});
+    }
+
+    return decode_batch<T>(send_batch("GET", requests, headers));
+  }
+
+  //----------------------------------------
+  // POSTs each item to endpoint concurrently
+  //----------------------------------------
+  template<typename TRequest, typename TResponse = TRequest>
+  std::vector<std::future<TResponse>> post_batch(const std::string& endpoint, const std::vector<TRequest>& items, const HttpHeaders& headers = {}) {
+    std::vector<std::pair<std::string, std::string>> requests;
+    requests.reserve(items.size());
+
+    for(const auto& item : items) {
+      requests.emplace_back(endpoint, encode(item, format_));
+    }
+
+    return decode_batch<TResponse>(send_batch("POST", requests, headers));
   }
     
   void destroy(const std::string& resource, const std::string& id, const HttpHeaders& headers = {});
@@ -187,48 +144,67 @@ public:
   std::pair<std::vector<T>, PaginatedResponse> get_paginated(
     const std::string& endpoint, int page = 1, int per_page = 20, const HttpHeaders& headers = {}) {
       auto response = get_paginated(endpoint, page, per_page, headers);
-        
-      std::vector<T> items;
-      auto error = glz::read_json(items, response.data);
-
-      if(error) {
-        throw std::runtime_error("JSON deserialization failed: " + glz::format_error(error, response.data));
-      }
-        
-      return {items, response};
+      auto items = decode_body<std::vector<T>>(response.data, wire_format_of(response.content_type));
+      return {std::move(items), std::move(response)};
   }
     
   HttpClient& http_client();
   const HttpClient& http_client() const;
 
 private:
-  std::string get(const std::string& endpoint, const HttpHeaders& headers);
-
-  std::string post(const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers);
-
-  std::string put(const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers);
-
-  std::string patch(const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers);
-
   std::string del(const std::string& endpoint, const HttpHeaders& headers);
   
-  std::string list(const std::string& resource, const std::map<std::string, std::string>& query_params, const HttpHeaders& headers);
-
-  std::string retrieve(const std::string& resource, const std::string& id, const HttpHeaders& headers);
-
-  std::string create(const std::string& resource, const std::string& json_body, const HttpHeaders& headers);
-
-  std::string update(const std::string& resource, const std::string& id, const std::string& json_body, const HttpHeaders& headers);
-
-  std::string partial_update(const std::string& resource, const std::string& id, const std::string& json_body, const HttpHeaders& headers);
-  
   PaginatedResponse get_paginated(const std::string& endpoint, int page, int per_page, const HttpHeaders& headers);
   
   HttpHeaders build_headers(const HttpHeaders& additional) const;
 
   std::string build_url(const std::string& endpoint) const;
 
-  std::string request_json(const std::string& method, const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers);
+  static std::string list_endpoint(const std::string& resource, const std::map<std::string, std::string>& query_params);
+
+  //----------------------------------------
+  // one request in format_, throws RESTException unless the
+  // reply is a 2xx. body is null for requests without one.
+  //----------------------------------------
+  HttpResponse send(const std::string& method, const std::string& endpoint, const std::string* body, const HttpHeaders& headers);
+
+  std::vector<std::future<HttpResponse>> send_batch(const std::string& method, 
+    const std::vector<std::pair<std::string, std::string>>& requests, const HttpHeaders& headers);
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  template<typename T>
+  static T decode_body(const std::string& body, WireFormat format) {
+    T result{};
+    if(auto error = decode(result, body, format)) {
+      throw std::runtime_error(std::string(format == WireFormat::Beve ? "BEVE" : "JSON")
+        + " deserialization failed: " + glz::format_error(error, body));
+    }
+    return result;
+  }
+
+  //----------------------------------------
+  // parses the reply body in place, in the format it declares
+  //----------------------------------------
+  template<typename T>
+  static T decode_response(const HttpResponse& response) {
+    return decode_body<T>(response.body, wire_format_of(response.get_header("content-type")));
+  }
+
+  template<typename T>
+  static std::vector<std::future<T>> decode_batch(std::vector<std::future<HttpResponse>> responses) {
+    std::vector<std::future<T>> results;
+    results.reserve(responses.size());
+
+    for(auto& response : responses) {
+      results.push_back(std::async(std::launch::deferred, [response = std::move(response)]() mutable {
+        return decode_response<T>(response.get());
+      }));
+    }
+
+    return results;
+  }
 
   enum class AuthType { None, Bearer, Basic, ApiKey };
   
@@ -242,6 +218,7 @@ private:
   std::string auth_password_;
   std::string api_key_;
   std::string api_key_header_ = "X-API-Key";
+  WireFormat format_ = WireFormat::Json;
 };
 
 } 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "HttpUtils.hpp"
+
+#include <glaze/glaze.hpp>
+#include <glaze/beve.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace cpppwn {
+
+//----------------------------------------
+// body formats of the REST layer. BEVE is glaze's binary
+// format, meant for calls between our own services.
+//----------------------------------------
+enum class WireFormat {
+  Json,
+  Beve
+};
+
+inline constexpr std::string_view json_content_type = "application/json";
+inline constexpr std::string_view beve_content_type = "application/x-beve";
+
+//----------------------------------------
+// Json for anything but a BEVE media type
+//----------------------------------------
+[[nodiscard]] inline WireFormat wire_format_of(std::string_view content_type) noexcept {
+  content_type = content_type.substr(0, content_type.find(';'));
+  while(not content_type.empty() && content_type.back() == ' ') content_type.remove_suffix(1);
+  return iequals(content_type, beve_content_type) ? WireFormat::Beve : WireFormat::Json;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+[[nodiscard]] inline std::string_view content_type_of(WireFormat format) noexcept {
+  return format == WireFormat::Beve ? beve_content_type : json_content_type;
+}
+
+//----------------------------------------
+// per-thread serialization buffer. it keeps its capacity, so
+// steady traffic of similar messages stops allocating in glaze.
+//----------------------------------------
+[[nodiscard]] inline std::string& codec_buffer() {
+  thread_local std::string buffer;
+  return buffer;
+}
+
+//----------------------------------------
+// value serialized into codec_buffer(). the result is only
+// valid until the calling thread's next encode().
+//----------------------------------------
+template<typename T>
+[[nodiscard]] const std::string& encode(const T& value, WireFormat format) {
+  std::string& buffer = codec_buffer();
+  buffer.clear();
+
+  const auto error = format == WireFormat::Beve ? glz::write_beve(value, buffer) : glz::write_json(value, buffer);
+  if(error) {
+    throw std::runtime_error("Serialization failed: " + glz::format_error(error, buffer));
+  }
+  return buffer;
+}
+
+//----------------------------------------
+// parses data in place, without copying it first
+//----------------------------------------
+template<typename T>
+[[nodiscard]] glz::error_ctx decode(T& value, const std::string& data, WireFormat format) {
+  return format == WireFormat::Beve ? glz::read_beve(value, data) : glz::read_json(value, data);
+}
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "HttpServer.hpp"
+#include "RESTCodec.hpp"
 #include <glaze/glaze.hpp>
 #include <functional>
 #include <string>
@@ -31,9 +32,10 @@ struct ResourceHandlers {
 //----------------------------------------
 class RESTServer {
 public:
-  explicit RESTServer(uint16_t port, const std::string& bind_addr = "0.0.0.0");
+  explicit RESTServer(uint16_t port, const std::string& bind_addr = "0.0.0.0", const ServerOptions& options = {});
     
-  explicit RESTServer(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr = "0.0.0.0");
+  explicit RESTServer(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr = "0.0.0.0",
+      const ServerOptions& options = {});
 
   template<typename T>
   struct TypedResourceHandlers {
@@ -45,74 +47,35 @@ public:
     std::function<void(const HttpRequest&, const std::string& id)> destroy;
   };
     
+  //----------------------------------------
+  // typed routes. bodies are read as BEVE when the request's
+  // Content-Type says so and as JSON otherwise, replies are BEVE
+  // when the client Accepts it or sent BEVE without an Accept.
+  //----------------------------------------
   template<typename TResponse>
   void get(const std::string& path, std::function<TResponse(const HttpRequest&)> handler) {
     server_.get(path, [handler](const HttpRequest& req) {
       try {
-        TResponse response = handler(req);
-        std::string json = glz::write_json(response);
-        return HttpResponse().set_json(json);
+        return encode_response(200, handler(req), reply_format(req));
       } catch (const std::exception& e) {
-        return HttpResponse(500).set_json(R"({"error":")" + std::string(e.what()) + R"("})");
+        return json_response(500, {{"error", e.what()}});
       }
     });
   }
     
   template<typename TRequest, typename TResponse = TRequest>
   void post(const std::string& path, std::function<TResponse(const HttpRequest&, const TRequest&)> handler) {
-    server_.post(path, [handler](const HttpRequest& req) {
-      try {
-        TRequest request_data;
-        auto error = glz::read_json(request_data, req.body);
-        if(error) {
-          return HttpResponse(400).set_json(R"({"error":"Invalid JSON"})");
-        }
-                
-        TResponse response = handler(req, request_data);
-        std::string json = glz::write_json(response);
-        return HttpResponse(201).set_json(json);
-      } catch (const std::exception& e) {
-        return HttpResponse(500).set_json(R"({"error":")" + std::string(e.what()) + R"("})");
-      }
-    });
+    server_.post(path, typed_route<TRequest, TResponse>(std::move(handler), 201));
   }
     
   template<typename TRequest, typename TResponse = TRequest>
   void put(const std::string& path, std::function<TResponse(const HttpRequest&, const TRequest&)> handler) {
-    server_.put(path, [handler](const HttpRequest& req) {
-      try {
-        TRequest request_data;
-        auto error = glz::read_json(request_data, req.body);
-        if(error) {
-          return HttpResponse(400).set_json(R"({"error":"Invalid JSON"})");
-        }
-                
-        TResponse response = handler(req, request_data);
-        std::string json = glz::write_json(response);
-        return HttpResponse().set_json(json);
-      } catch (const std::exception& e) {
-        return HttpResponse(500).set_json(R"({"error":")" + std::string(e.what()) + R"("})");
-      }
-    });
+    server_.put(path, typed_route<TRequest, TResponse>(std::move(handler), 200));
   }
     
   template<typename TRequest, typename TResponse = TRequest>
   void patch(const std::string& path, std::function<TResponse(const HttpRequest&, const TRequest&)> handler) {
-    server_.patch(path, [handler](const HttpRequest& req) {
-      try {
-        TRequest request_data;
-        auto error = glz::read_json(request_data, req.body);
-        if(error) {
-          return HttpResponse(400).set_json(R"({"error":"Invalid JSON"})");
-        }
-                
-        TResponse response = handler(req, request_data);
-        std::string json = glz::write_json(response);
-        return HttpResponse().set_json(json);
-      } catch (const std::exception& e) {
-        return HttpResponse(500).set_json(R"({"error":")" + std::string(e.what()) + R"("})");
-      }
-    });
+    server_.patch(path, typed_route<TRequest, TResponse>(std::move(handler), 200));
   }
     
   template<typename TRequest, typename TResponse = TRequest>
@@ -122,7 +85,7 @@ public:
         handler(req);
         return HttpResponse(204); // No Content
       } catch (const std::exception& e) {
-        return HttpResponse(500).set_json(R"({"error":")" + std::string(e.what()) + R"("})");
+        return json_response(500, {{"error", e.what()}});
       }
     });
   }
@@ -147,32 +110,32 @@ public:
         
     // RETRIEVE: GET /resource/:id
     if(handlers.retrieve) {
-      get<T>(id_path, [handlers, name](const HttpRequest& req) {
-        std::string id = extract_id_from_path(req.path, name);
+      get<T>(id_path, [handlers](const HttpRequest& req) {
+        std::string id = req.get_path_param("id");
         return handlers.retrieve(req, id);
       });
     }
         
     // UPDATE: PUT /resource/:id
     if(handlers.update) {
-      put<T, T>(id_path, [handlers, name](const HttpRequest& req, const T& data) {
-        std::string id = extract_id_from_path(req.path, name);
+      put<T, T>(id_path, [handlers](const HttpRequest& req, const T& data) {
+        std::string id = req.get_path_param("id");
         return handlers.update(req, id, data);
       });
     }
         
     // PARTIAL_UPDATE: PATCH /resource/:id
     if(handlers.partial_update) {
-      patch<T, T>(id_path, [handlers, name](const HttpRequest& req, const T& data) {
-        std::string id = extract_id_from_path(req.path, name);
+      patch<T, T>(id_path, [handlers](const HttpRequest& req, const T& data) {
+        std::string id = req.get_path_param("id");
         return handlers.partial_update(req, id, data);
       });
     }
         
     // DESTROY: DELETE /resource/:id
     if(handlers.destroy) {
-      del(id_path, [handlers, name](const HttpRequest& req) {
-        std::string id = extract_id_from_path(req.path, name);
+      del(id_path, [handlers](const HttpRequest& req) {
+        std::string id = req.get_path_param("id");
         handlers.destroy(req, id);
       });
     }
@@ -214,10 +177,44 @@ public:
 private:
   HttpResponse handle_json_request(const HttpRequest& req, JsonHandler handler);
 
+  static WireFormat reply_format(const HttpRequest& req);
+
+  //----------------------------------------
+  // value serialized through the thread's codec buffer, so only
+  // the final body is allocated
+  //----------------------------------------
+  template<typename T>
+  static HttpResponse encode_response(int status_code, const T& value, WireFormat format) {
+    HttpResponse response(status_code);
+    response.set_header("Content-Type", std::string(content_type_of(format)));
+    response.set_body(encode(value, format));
+    return response;
+  }
+
+  //----------------------------------------
+  // decodes the body straight from the request, calls handler
+  // and encodes what it returns
+  //----------------------------------------
+  template<typename TRequest, typename TResponse>
+  static RouteHandler typed_route(std::function<TResponse(const HttpRequest&, const TRequest&)> handler, int status_code) {
+    return [handler = std::move(handler), status_code](const HttpRequest& req) {
+      try {
+        const WireFormat format = wire_format_of(req.get_header("content-type"));
+
+        TRequest request_data{};
+        if(decode(request_data, req.body, format)) {
+          return json_response(400, {{"error", format == WireFormat::Beve ? "Invalid BEVE" : "Invalid JSON"}});
+        }
+                
+        return encode_response(status_code, handler(req, request_data), reply_format(req));
+      } catch (const std::exception& e) {
+        return json_response(500, {{"error", e.what()}});
+      }
+    };
+  }
+
   void setup_error_handlers();
     
-  static std::string extract_id_from_path(const std::string& path, const std::string& resource);
-    
   HttpServer server_;
   JsonHandler not_found_handler_;
   std::function<HttpResponse(const HttpRequest&, const std::exception&)> error_handler_;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string_view>
+#include <span>
+#include <vector>
+#include <cstddef>
+
+namespace cpppwn {
+
+//----------------------------------------
+// Growable receive buffer that keeps unread bytes between calls.
+// bytes are appended at the tail through prepare()/commit() and
+// handed out from the head through data()/consume(). views into
+// data() stay valid until the next prepare().
+//----------------------------------------
+class RecvBuffer {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    explicit RecvBuffer(std::size_t initial_capacity = 8192);
+
+    [[nodiscard]] std::string_view data() const noexcept {
+      return {storage_.data() + begin_, end_ - begin_};
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return end_ - begin_; }
+    [[nodiscard]] bool empty() const noexcept { return begin_ == end_; }
+
+    //----------------------------------------
+    // drops n bytes from the head
+    //----------------------------------------
+    void consume(std::size_t n) noexcept;
+
+    void clear() noexcept { begin_ = end_ = 0; }
+
+    //----------------------------------------
+    // returns at least min_size writable bytes at the tail,
+    // compacting or growing the storage as needed
+    //----------------------------------------
+    [[nodiscard]] std::span<char> prepare(std::size_t min_size);
+
+    //----------------------------------------
+    // marks n bytes of the last prepare() as received
+    //----------------------------------------
+    void commit(std::size_t n) noexcept { end_ += n; }
+
+    //----------------------------------------
+    // offset of delim in data(), searching from offset from
+    //----------------------------------------
+    [[nodiscard]] std::size_t find(std::string_view delim, std::size_t from = 0) const noexcept;
+
+private:
+    std::vector<char> storage_;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Stream.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace cpppwn {
+
+//----------------------------------------
+// bytes a relay session moved so far
+//----------------------------------------
+struct RelayStats {
+  std::uint64_t a_to_b = 0;
+  std::uint64_t b_to_a = 0;
+};
+
+using RelaySessionId = std::uint64_t;
+
+struct RelayHubConfig {
+  std::size_t threads = 1;                // event loops, sessions are spread over them
+  std::size_t buffer_size = 256 * 1024;   // per direction, reading stops while it is full
+  std::function<void(RelaySessionId, const RelayStats&)> on_close;  // runs on the loop's thread
+};
+
+//----------------------------------------
+// relays any number of stream pairs from a few epoll loops
+// instead of two threads per pair. both streams need read_fd()
+// and write_fd(), they are spliced and fully non-blocking. TLS
+// streams would block the loop and belong to bridge(). a
+// session ends, closing both streams, once either side closes
+// or fails.
+//----------------------------------------
+class RelayHub {
+public:
+    explicit RelayHub(RelayHubConfig config = {});
+    ~RelayHub();
+
+    RelayHub(const RelayHub&) = delete;
+    RelayHub& operator=(const RelayHub&) = delete;
+
+    //----------------------------------------
+    // hands the pair to one of the loops, which owns them from now
+    // on. throws std::invalid_argument for streams without raw
+    // descriptors.
+    //----------------------------------------
+    RelaySessionId add(std::unique_ptr<Stream> a, std::unique_ptr<Stream> b);
+
+    //----------------------------------------
+    // ends a session as if one side had closed
+    //----------------------------------------
+    void close(RelaySessionId id);
+
+    [[nodiscard]] std::optional<RelayStats> stats(RelaySessionId id) const;
+
+    //----------------------------------------
+    // sessions that have not ended yet
+    //----------------------------------------
+    [[nodiscard]] std::size_t size() const;
+
+    //----------------------------------------
+    // ends every session and joins the loops
+    //----------------------------------------
+    void stop();
+
+private:
+    class Worker;
+    struct Counters;
+    struct Session;
+
+    RelayHubConfig config_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<RelaySessionId> next_id_{1};
+
+    mutable std::mutex counters_mutex_;
+    std::unordered_map<RelaySessionId, std::shared_ptr<Counters>> counters_;
+
+    void session_closed(RelaySessionId id, const RelayStats& stats);
+};
+
+}
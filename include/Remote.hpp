@@ -1,27 +1,52 @@
 #pragma once
 
 #include "Stream.hpp"
+#include "RecvBuffer.hpp"
 #include <asio.hpp>
 #include <asio/ssl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <functional>
 
 namespace cpppwn {
 
+//----------------------------------------
+// how Remote connects to a host with several addresses. attempts
+// race RFC 8305 style, alternating address families and starting
+// the next one attempt_delay after the last.
+//----------------------------------------
+struct ConnectOptions {
+  std::chrono::milliseconds timeout{0};          // whole connect, 0 leaves it to the OS
+  std::chrono::milliseconds attempt_delay{250};  // head start of each attempt over the next
+};
+
+//----------------------------------------
+// how long the phases of opening a Remote took. zero for a
+// Remote built around a socket, or without metrics.
+//----------------------------------------
+struct ConnectTiming {
+  std::chrono::nanoseconds dns{0};
+  std::chrono::nanoseconds connect{0};
+  std::chrono::nanoseconds tls_handshake{0};
+};
+
 class Remote : public Stream {
 public:
     class SocketImpl;
 
-    explicit Remote(const std::string& host, uint16_t port);
+    explicit Remote(const std::string& host, uint16_t port, const ConnectOptions& connect = {});
 
     explicit Remote(const std::string& host, uint16_t port, 
-        bool use_tls, bool verify_certificate = false
+        bool use_tls, bool verify_certificate = false, const ConnectOptions& connect = {}
     );
 
     explicit Remote(const std::string& host, uint16_t port, 
-        const std::string& proxy, bool use_tls = false);
+        const std::string& proxy, bool use_tls = false, const ConnectOptions& connect = {});
 
     explicit Remote(const std::string& host, uint16_t port,
-                   std::shared_ptr<asio::ssl::context> ssl_ctx);
+                   std::shared_ptr<asio::ssl::context> ssl_ctx, const ConnectOptions& connect = {});
 
     explicit Remote(asio::ip::tcp::socket socket);
     explicit Remote(asio::ssl::stream<asio::ip::tcp::socket> ssl_socket);
@@ -34,6 +59,115 @@ public:
     [[nodiscard]] std::string recvline() override;
     [[nodiscard]] std::string recvall() override;
 
+    [[nodiscard]] std::string recv(std::size_t size, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] std::string recvuntil(const std::string& delim, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] std::string recvline(std::chrono::milliseconds timeout) override;
+    [[nodiscard]] bool can_recv(std::chrono::milliseconds timeout = std::chrono::milliseconds{0}) override;
+
+    [[nodiscard]] std::size_t recv_into(std::span<char> buffer) override;
+    void send_bytes(std::span<const char> data) override;
+
+    //----------------------------------------
+    // the awaitable calls run on the executor the socket is bound
+    // to: the awaiting coroutine's for async_connect, the server's
+    // for accepted ones. Remotes the blocking constructors opened
+    // sit on a private io_context nobody runs and throw.
+    //----------------------------------------
+    [[nodiscard]] asio::awaitable<void> async_send(std::string data) override;
+    [[nodiscard]] asio::awaitable<void> async_sendline(std::string data) override;
+
+    [[nodiscard]] asio::awaitable<std::string> async_recv(std::size_t size) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvuntil(std::string delim) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvline() override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvall() override;
+
+    [[nodiscard]] asio::awaitable<std::string> async_recv(std::size_t size, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvuntil(std::string delim, std::chrono::milliseconds timeout) override;
+    [[nodiscard]] asio::awaitable<std::string> async_recvline(std::chrono::milliseconds timeout) override;
+
+    //----------------------------------------
+    // connect on the executor of the awaiting coroutine, through
+    // the DnsCache and racing the addresses like the blocking
+    // constructors do
+    //----------------------------------------
+    [[nodiscard]] static asio::awaitable<std::unique_ptr<Remote>> async_connect(
+        std::string host, uint16_t port, bool use_tls = false, bool verify_certificate = false,
+        ConnectOptions connect = {});
+
+    [[nodiscard]] static asio::awaitable<std::unique_ptr<Remote>> async_connect(
+        std::string host, uint16_t port, std::shared_ptr<asio::ssl::context> ssl_ctx, ConnectOptions connect = {});
+
+    //----------------------------------------
+    // sends parts in order with one gather write, e.g. a
+    // response head and its body without joining them first
+    //----------------------------------------
+    void send_parts(std::span<const std::string_view> parts);
+
+    //----------------------------------------
+    // sends length bytes of fd starting at offset. plain sockets
+    // use sendfile(), TLS reads the file in chunks. fd's own
+    // offset is left alone.
+    //----------------------------------------
+    void send_file(int fd, std::uint64_t offset, std::uint64_t length);
+
+    //----------------------------------------
+    // awaitable send_parts() and send_file(). each wait for the
+    // peer to take more gives up after timeout with an
+    // asio::system_error holding asio::error::timed_out, zero
+    // waits as long as it takes. parts and the memory they point
+    // to have to outlive the call.
+    //----------------------------------------
+    [[nodiscard]] asio::awaitable<void> async_send_parts(std::span<const std::string_view> parts,
+                                                         std::chrono::milliseconds timeout);
+    [[nodiscard]] asio::awaitable<void> async_send_file(int fd, std::uint64_t offset, std::uint64_t length,
+                                                        std::chrono::milliseconds timeout);
+
+    [[nodiscard]] int read_fd() noexcept override;
+    [[nodiscard]] int write_fd() noexcept override;
+    [[nodiscard]] std::string take_buffered() override;
+
+    //----------------------------------------
+    // allocation-free variants of recv/recvuntil. the views point
+    // into the receive buffer and stay valid until the next call
+    // that reads from this Remote. recvuntil_view throws
+    // std::length_error once max_size bytes arrived without delim.
+    //----------------------------------------
+    [[nodiscard]] std::string_view recv_view(std::size_t size);
+    [[nodiscard]] std::string_view recvuntil_view(std::string_view delim, std::size_t max_size = SIZE_MAX);
+
+    //----------------------------------------
+    // waits until size bytes are buffered and returns them
+    // without consuming anything
+    //----------------------------------------
+    [[nodiscard]] std::string_view peek(std::size_t size);
+
+    //----------------------------------------
+    // bounds the blocking reads: each wait for data gives up after
+    // idle, and none runs past deadline. either throws an
+    // asio::system_error with asio::error::timed_out. a zero idle
+    // and time_point::max() lift the bound.
+    //----------------------------------------
+    void set_read_timeout(std::chrono::milliseconds idle,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    //----------------------------------------
+    // non-blocking I/O for a caller that multiplexes a Remote the
+    // blocking constructors opened, e.g. an HTTP/2 connection.
+    // queue_send() puts data behind what is still going out and
+    // run_io() sends and receives whatever the socket allows,
+    // waiting up to timeout for either to make progress. what
+    // arrived is left for take_buffered(). TLS records wait inside
+    // the stream until the socket takes them, so a full send
+    // buffer neither blocks the caller nor loses data. one thread
+    // at a time may use these, wake_io() from any thread cuts a
+    // run_io() wait short. run_io() throws the first error either
+    // direction hit, again on every later call.
+    //----------------------------------------
+    void queue_send(std::string_view data);
+    [[nodiscard]] std::size_t unsent() const noexcept;
+    void run_io(std::chrono::milliseconds timeout);
+    void wake_io();
+
     [[nodiscard]] bool is_alive() const noexcept override;
     void close() override;
 
@@ -44,13 +178,54 @@ public:
 
     void swap_socket(asio::ip::tcp::socket&& socket);
 
+    [[nodiscard]] const ConnectTiming& connect_timing() const noexcept { return connect_timing_; }
+
+    //----------------------------------------
+    // the protocol the server picked over ALPN, e.g. "h2".
+    // empty without TLS or when nothing was negotiated.
+    //----------------------------------------
+    [[nodiscard]] std::string alpn_protocol() const;
+
+    //----------------------------------------
+    // makes Remotes built from ssl_ctx remember sessions per
+    // host:port and offer them on the next connect. cached
+    // sessions are freed together with the context.
+    //----------------------------------------
+    static void enable_session_resumption(asio::ssl::context& ssl_ctx);
+
+    //----------------------------------------
+    // waits asynchronously until data can be read without blocking.
+    // the handler runs on the executor the socket was created on.
+    //----------------------------------------
+    void async_wait(std::function<void(const asio::error_code&)> handler);
+
     ~Remote() override;
 
     Remote(const Remote&) = delete;
     Remote& operator=(const Remote&) = delete;
 
 private:
+    asio::ip::tcp::socket connect_to(const std::string& host, uint16_t port, const ConnectOptions& connect);
+    static asio::awaitable<asio::ip::tcp::socket> async_connect_to(std::string host, uint16_t port,
+        ConnectOptions connect, ConnectTiming& timing);
+
+    std::size_t fill_recv_buffer();
+    bool fill_recv_buffer(std::chrono::steady_clock::time_point deadline);
+    std::chrono::steady_clock::time_point read_deadline() const;
+
+    void require_shared_executor();
+    void require_own_executor();
+    asio::awaitable<void> async_fill_recv_buffer();
+    asio::awaitable<bool> async_fill_recv_buffer(std::chrono::steady_clock::time_point deadline);
+
+    struct DrivenIo;
+
     asio::io_context io_;
+    std::unique_ptr<DrivenIo> driven_;   // queue_send()/run_io() state, outlives the socket's operations
     std::unique_ptr<SocketImpl> socket_;
+    RecvBuffer recv_buf_;
+    ConnectTiming connect_timing_;
+    std::chrono::milliseconds read_timeout_{0};
+    std::chrono::steady_clock::time_point read_deadline_ = std::chrono::steady_clock::time_point::max();
 };
 } 
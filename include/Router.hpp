@@ -0,0 +1,78 @@
+#pragma once
+
+#include "HttpUtils.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace cpppwn {
+
+class BodyReader;
+struct RouteMetrics;
+
+using StreamingHandler = std::function<HttpResponse(const HttpRequest&, BodyReader&)>;
+
+//----------------------------------------
+// one of the two handlers is set
+//----------------------------------------
+struct Route {
+  RouteHandler handler;                   // gets the request with its body read
+  StreamingHandler streaming;             // reads the body itself
+  std::shared_ptr<RouteMetrics> metrics;  // null when metrics are compiled out
+};
+
+enum class RouteStatus {
+  Found,              // route is set
+  MethodNotAllowed,   // the path exists, allow lists the methods it takes
+  NotFound
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+struct RouteMatch {
+  RouteStatus status = RouteStatus::NotFound;
+  const Route* route = nullptr;
+  std::string_view allow;
+};
+
+//----------------------------------------
+// segment trie of routes. a pattern segment ":name" captures
+// one non-empty path segment, a last segment "*name" captures
+// the rest of the path (slashes included, possibly empty).
+// literal segments win over :name, which wins over *name.
+// every node keeps the handlers of all methods, so telling a
+// 405 from a 404 costs no second walk.
+//----------------------------------------
+class Router {
+public:
+    Router();
+    ~Router();
+
+    Router(Router&&) noexcept;
+    Router& operator=(Router&&) noexcept;
+
+    //----------------------------------------
+    // method "*" answers every method the pattern has no
+    // handler of its own for. replaces an existing handler.
+    //----------------------------------------
+    void add(std::string_view method, std::string_view pattern, Route route);
+
+    //----------------------------------------
+    // walks the path once, backing up only where a literal
+    // branch dead-ends. captures go to params as ranges of path,
+    // nothing is allocated.
+    //----------------------------------------
+    [[nodiscard]] RouteMatch match(std::string_view method, std::string_view path, PathParams& params) const;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+private:
+    struct Node;
+
+    std::unique_ptr<Node> root_;
+};
+
+}
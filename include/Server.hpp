@@ -4,7 +4,9 @@
 
 #include <memory>
 #include <string>
+#include <functional>
 #include <optional>
+#include <chrono>
 #include <cstdint>
 
 namespace cpppwn {
@@ -23,6 +25,24 @@ struct TlsConfig {
   }
 };
 
+//----------------------------------------
+// how Server listens and sets up accepted sockets. more than one
+// acceptor opens that many sockets on the port with SO_REUSEPORT,
+// the kernel spreads new connections across them and each has an
+// accept of its own in flight. options the platform lacks are
+// ignored, except SO_REUSEPORT.
+//----------------------------------------
+struct ServerOptions {
+  size_t acceptors = 1;                                      // Listening sockets sharing the port, e.g. one per worker thread
+  int backlog = asio::socket_base::max_listen_connections;   // Pending connections each listening socket queues
+  bool tcp_nodelay = true;                                   // Send small writes at once instead of coalescing them
+  int tcp_fastopen = 0;                                      // TCP_FASTOPEN queue length, 0 disables it
+  int defer_accept = 0;                                      // Seconds TCP_DEFER_ACCEPT waits for the first data, 0 disables it
+  int receive_buffer_size = 0;                               // SO_RCVBUF of accepted sockets, 0 keeps the system default
+  int send_buffer_size = 0;                                  // SO_SNDBUF of accepted sockets, 0 keeps the system default
+  std::chrono::milliseconds handshake_timeout{10000};        // async TLS handshakes taking longer fail, 0 waits forever
+};
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -30,11 +50,37 @@ class Server {
 public:
   class ServerImpl; 
 
-  explicit Server(uint16_t port, const std::string& bind_addr = "0.0.0.0");
+  using AcceptHandler = std::function<void(const asio::error_code&, std::unique_ptr<Remote>)>;
+  using ConnectHandler = std::function<void()>;
+
+  explicit Server(uint16_t port, const std::string& bind_addr = "0.0.0.0", const ServerOptions& options = {});
     
-  explicit Server(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr = "0.0.0.0");
+  explicit Server(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr = "0.0.0.0",
+      const ServerOptions& options = {});
     
+  //----------------------------------------
+  // waits for a connection on any acceptor. for TLS the
+  // handshake runs in here too.
+  //----------------------------------------
   [[nodiscard]] std::unique_ptr<Remote> accept();
+
+  //----------------------------------------
+  // accepts one connection on acceptor without blocking. the
+  // handlers run on whichever thread is running context().
+  // on_connect runs as soon as the TCP connection is in, before
+  // the TLS handshake, so the next accept can be armed without
+  // waiting for a slow client. handler gets the connection, or
+  // the error of the accept or the handshake.
+  //----------------------------------------
+  void async_accept(size_t acceptor, AcceptHandler handler, ConnectHandler on_connect = {});
+
+  void async_accept(AcceptHandler handler, ConnectHandler on_connect = {}) {
+    async_accept(0, std::move(handler), std::move(on_connect));
+  }
+
+  [[nodiscard]] size_t acceptor_count() const noexcept;
+
+  [[nodiscard]] asio::io_context& context() noexcept;
     
   void close();
     
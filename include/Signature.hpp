@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace cpppwn {
+
+//----------------------------------------
+// IDA-style byte pattern such as "48 8B ?? ?? 89 05", parsed
+// once and reusable across scans. the rarest fixed byte of the
+// pattern (by typical x86-64 byte frequency) anchors the search,
+// a second fixed byte filters candidates before a full compare.
+//----------------------------------------
+class Signature {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    explicit Signature(std::string_view pattern);
+
+    [[nodiscard]] std::size_t size() const noexcept { return bytes_.size(); }
+    [[nodiscard]] bool empty() const noexcept { return bytes_.empty(); }
+
+    //----------------------------------------
+    // pattern bytes, wildcards are zero with a zero mask
+    //----------------------------------------
+    [[nodiscard]] std::span<const std::byte> bytes() const noexcept { return bytes_; }
+    [[nodiscard]] std::span<const std::byte> mask() const noexcept { return mask_; }
+
+    [[nodiscard]] bool is_wildcard(std::size_t i) const noexcept { return mask_[i] == std::byte{0}; }
+
+    //----------------------------------------
+    // true if the pattern matches at data, which must hold size() bytes
+    //----------------------------------------
+    [[nodiscard]] bool matches(const std::byte* data) const noexcept;
+
+    //----------------------------------------
+    // appends the offsets of matches in buffer to out, stopping
+    // once out holds max_matches entries
+    //----------------------------------------
+    void scan(std::span<const std::byte> buffer, std::vector<std::size_t>& out, std::size_t max_matches = npos) const;
+
+    [[nodiscard]] std::optional<std::size_t> find(std::span<const std::byte> buffer) const;
+
+private:
+    std::vector<std::byte> bytes_;
+    std::vector<std::byte> mask_;
+    std::size_t anchor_ = 0;   // offset of the rarest fixed byte
+    std::size_t filter_ = 0;   // offset of the second rarest fixed byte
+    bool has_fixed_ = false;
+};
+
+//----------------------------------------
+// Several signatures matched in a single pass. the longest run
+// of fixed bytes of each signature (up to 16) goes into an
+// Aho-Corasick automaton, every key hit is then verified
+// against the full pattern.
+//----------------------------------------
+class SignatureSet {
+public:
+    using MatchHandler = std::function<void(std::size_t index, std::size_t offset)>;
+
+    explicit SignatureSet(std::span<const Signature> signatures);
+
+    [[nodiscard]] std::size_t size() const noexcept { return signatures_.size(); }
+    [[nodiscard]] const Signature& operator[](std::size_t i) const noexcept { return signatures_[i]; }
+
+    //----------------------------------------
+    // length of the longest signature, the overlap needed
+    // between consecutive chunks of a scan
+    //----------------------------------------
+    [[nodiscard]] std::size_t max_size() const noexcept { return max_size_; }
+
+    //----------------------------------------
+    // reports every (signature index, offset) match fully
+    // contained in buffer
+    //----------------------------------------
+    void scan(std::span<const std::byte> buffer, const MatchHandler& on_match) const;
+
+private:
+    std::vector<Signature> signatures_;
+    std::vector<std::size_t> key_end_;          // end of the key inside each signature
+    std::vector<std::size_t> unanchored_;       // signatures made of wildcards only
+    std::vector<std::uint32_t> transitions_;    // state * 256 + byte -> state
+    std::vector<std::uint32_t> output_begin_;   // per state, into outputs_
+    std::vector<std::uint32_t> outputs_;        // signature indices ending in a state
+    std::size_t max_size_ = 0;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Compression.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+
+namespace cpppwn {
+
+struct StaticFileCacheConfig {
+  size_t max_bytes = 64 << 20;                        // file contents kept in memory
+  size_t max_file_size = 256 << 10;                   // larger files are always streamed from disk
+  size_t max_entries = 4096;                          // cached stat results, files of any size
+  std::chrono::milliseconds revalidate_after{1000};   // an entry is trusted this long before the next stat()
+  int compression_level = -1;                         // level of compressed copies, -1 for the coding's default
+};
+
+//----------------------------------------
+// what serving a file needs, worked out once per change of the
+// file rather than once per request
+//----------------------------------------
+struct StaticFile {
+  std::string path;             // the regular file, a directory's index.html resolved
+  uint64_t size = 0;
+  dev_t device = 0;
+  ino_t inode = 0;
+  timespec modified{};
+  std::string etag;             // quoted, ready for the ETag header
+  std::string last_modified;    // HTTP date, ready for the Last-Modified header
+  std::string content_type;
+  std::shared_ptr<const std::string> content;  // set for files up to max_file_size
+
+  // compressed copies of content by ContentCoding, filled in by
+  // StaticFileCache::encoded() under the cache's lock
+  mutable std::array<std::shared_ptr<const std::string>, 4> encoded;
+  mutable bool cached = false;
+};
+
+//----------------------------------------
+// LRU of static files. contents of small files are kept too,
+// bounded by max_bytes. thread safe.
+//----------------------------------------
+class StaticFileCache {
+public:
+    explicit StaticFileCache(StaticFileCacheConfig config = {});
+
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    //----------------------------------------
+    // replaces the limits and drops every entry
+    //----------------------------------------
+    void configure(const StaticFileCacheConfig& config);
+
+    //----------------------------------------
+    // null unless path is a regular file or a directory with an
+    // index.html. misses are not cached.
+    //----------------------------------------
+    [[nodiscard]] std::shared_ptr<const StaticFile> lookup(const std::filesystem::path& path);
+
+    //----------------------------------------
+    // file's content in coding, compressed on first use and kept
+    // with the file until it changes. null for files that are
+    // streamed from disk. the first request waits for the
+    // compression, so the level stays moderate by default.
+    //----------------------------------------
+    [[nodiscard]] std::shared_ptr<const std::string> encoded(const StaticFile& file, ContentCoding coding);
+
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Entry {
+      std::shared_ptr<const StaticFile> file;
+      std::chrono::steady_clock::time_point checked;
+      std::list<std::string>::iterator lru;
+    };
+
+    mutable std::mutex mutex_;
+    StaticFileCacheConfig config_;
+    std::list<std::string> lru_;    // most recently used first
+    std::unordered_map<std::string, Entry> entries_;
+    size_t content_bytes_ = 0;
+
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+    void evict();
+};
+
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <asio/awaitable.hpp>
 #include <string>
 #include <cstddef>
+#include <chrono>
+#include <span>
 
 namespace cpppwn {
 
@@ -17,6 +20,70 @@ public:
     [[nodiscard]] virtual std::string recvline() = 0;
     [[nodiscard]] virtual std::string recvall() = 0;
 
+    //----------------------------------------
+    // timed variants. recv returns whatever arrived, at most size
+    // bytes, and recvuntil the data through delim. both return an
+    // empty string on timeout and keep buffered bytes for later.
+    // the default recv waits with can_recv(); recvuntil has no
+    // buffer to keep a partial match in and throws
+    // std::logic_error unless overridden.
+    //----------------------------------------
+    [[nodiscard]] virtual std::string recv(std::size_t size, std::chrono::milliseconds timeout);
+    [[nodiscard]] virtual std::string recvuntil(const std::string& delim, std::chrono::milliseconds timeout);
+    [[nodiscard]] virtual std::string recvline(std::chrono::milliseconds timeout);
+
+    //----------------------------------------
+    // awaitable variants of the calls above, for driving many
+    // streams from one thread. they run on an io_context the
+    // caller runs and share buffered bytes with the blocking
+    // calls, which must not be used on the stream meanwhile.
+    // arguments are taken by value so a temporary outlives the
+    // suspension. the defaults make the blocking call and hold up
+    // the io_context until it returns.
+    //----------------------------------------
+    [[nodiscard]] virtual asio::awaitable<void> async_send(std::string data);
+    [[nodiscard]] virtual asio::awaitable<void> async_sendline(std::string data);
+
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recv(std::size_t size);
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recvuntil(std::string delim);
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recvline();
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recvall();
+
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recv(std::size_t size, std::chrono::milliseconds timeout);
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recvuntil(std::string delim, std::chrono::milliseconds timeout);
+    [[nodiscard]] virtual asio::awaitable<std::string> async_recvline(std::chrono::milliseconds timeout);
+
+    //----------------------------------------
+    // true if data (or EOF) can be read within timeout. the
+    // default polls read_fd() and throws std::logic_error for
+    // streams without one.
+    //----------------------------------------
+    [[nodiscard]] virtual bool can_recv(std::chrono::milliseconds timeout = std::chrono::milliseconds{0});
+
+    //----------------------------------------
+    // receives whatever is available, at most buffer.size()
+    // bytes, into buffer. returns 0 at EOF.
+    //----------------------------------------
+    [[nodiscard]] virtual std::size_t recv_into(std::span<char> buffer);
+
+    //----------------------------------------
+    // send without building a std::string first
+    //----------------------------------------
+    virtual void send_bytes(std::span<const char> data);
+
+    //----------------------------------------
+    // descriptors carrying the stream's bytes unchanged, which
+    // bridge() can splice. -1 if there are none, e.g. with TLS.
+    //----------------------------------------
+    [[nodiscard]] virtual int read_fd() noexcept { return -1; }
+    [[nodiscard]] virtual int write_fd() noexcept { return -1; }
+
+    //----------------------------------------
+    // hands out and drops the bytes already read ahead, which a
+    // read on read_fd() would miss
+    //----------------------------------------
+    [[nodiscard]] virtual std::string take_buffered() { return {}; }
+
     [[nodiscard]] virtual int getInputStream() noexcept = 0;
     [[nodiscard]] virtual int getOutputStream() noexcept = 0;
 
@@ -26,10 +93,17 @@ public:
     virtual void interactive() = 0;
 };
 
+enum class BridgeMode {
+  Threads,  // one blocking thread per direction
+  Epoll     // a single thread, if both streams have read_fd()/write_fd()
+};
+
 //----------------------------------------
 // bridges streams a and b indefinitely.
 // blocks until a connection drops.
+// streams with raw descriptors are spliced in the kernel,
+// others are copied through a reused buffer.
 //----------------------------------------
-void bridge(Stream& a, Stream& b);
+void bridge(Stream& a, Stream& b, BridgeMode mode = BridgeMode::Threads);
 
 }
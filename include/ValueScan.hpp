@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Process.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace cpppwn {
+
+enum class ValueType {
+  Int8,
+  Int16,
+  Int32,
+  Int64,
+  Float,
+  Double,
+  Bytes
+};
+
+enum class ScanCompare {
+  Equal,      // equal to the given value
+  Changed,    // differs from the last scan
+  Unchanged,  // same as the last scan
+  Increased,  // greater than at the last scan
+  Decreased   // less than at the last scan
+};
+
+struct ValueScanOptions {
+  ScanFilter filter{"", "rw"};        // mappings the first scan looks at
+  size_t alignment = 0;               // step between candidates, 0 for the value size
+  size_t memory_limit = 256 << 20;    // candidate bytes kept in memory, the rest spills to disk
+  std::filesystem::path spill_directory;  // where spilled candidates go, empty for the temp directory
+};
+
+//----------------------------------------
+// Cheat-Engine style value search. a first scan collects every
+// address holding a value (or snapshots all of memory for an
+// unknown initial value), each next scan keeps the candidates
+// whose value compares as asked against the previous scan.
+//----------------------------------------
+class ValueScan {
+public:
+    //----------------------------------------
+    // value_size is only needed for ValueType::Bytes
+    //----------------------------------------
+    ValueScan(Process& process, ValueType type, size_t value_size = 0, ValueScanOptions options = {});
+    ~ValueScan();
+
+    ValueScan(const ValueScan&) = delete;
+    ValueScan& operator=(const ValueScan&) = delete;
+
+    void first_scan(std::span<const std::byte> value);
+    void first_scan_unknown();
+
+    //----------------------------------------
+    // value is required by ScanCompare::Equal and ignored by
+    // the other comparisons
+    //----------------------------------------
+    void next_scan(ScanCompare compare, std::span<const std::byte> value = {});
+
+    template<typename T>
+      requires std::is_trivially_copyable_v<T>
+    void first_scan(const T& value) {
+      first_scan(std::as_bytes(std::span(&value, 1)));
+    }
+
+    template<typename T>
+      requires std::is_trivially_copyable_v<T>
+    void next_scan(ScanCompare compare, const T& value) {
+      next_scan(compare, std::as_bytes(std::span(&value, 1)));
+    }
+
+    [[nodiscard]] ValueType type() const noexcept { return type_; }
+    [[nodiscard]] size_t value_size() const noexcept { return value_size_; }
+
+    //----------------------------------------
+    // false until the first scan ran
+    //----------------------------------------
+    [[nodiscard]] bool started() const noexcept;
+    [[nodiscard]] size_t count() const noexcept;
+
+    //----------------------------------------
+    // current candidates, lowest addresses first
+    //----------------------------------------
+    [[nodiscard]] std::vector<address_t> addresses(size_t max_results = SIZE_MAX) const;
+
+    //----------------------------------------
+    // drops all candidates, the next scan has to be a first scan
+    //----------------------------------------
+    void reset();
+
+private:
+    class Candidates;
+
+    Process& process_;
+    ValueType type_;
+    size_t value_size_;
+    size_t stride_;
+    ValueScanOptions options_;
+    std::unique_ptr<Candidates> candidates_;
+
+    void check_value(std::span<const std::byte> value) const;
+    void scan_memory(std::span<const std::byte> value);
+};
+
+}
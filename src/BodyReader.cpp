@@ -0,0 +1,195 @@
+#include <BodyReader.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <vector>
+
+namespace cpppwn {
+namespace {
+
+// longest chunk size line (extensions included) or trailer line
+constexpr size_t kMaxLine = 4096;
+
+constexpr size_t kChunkSize = 64 * 1024;
+
+//----------------------------------------
+//
+//----------------------------------------
+bool contains_token(std::string value, std::string_view token) {
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+  return value.find(token) != std::string::npos;
+}
+
+//----------------------------------------
+// the codings of a Transfer-Encoding list in the order they
+// were applied, empty list elements skipped
+//----------------------------------------
+std::vector<std::string_view> transfer_codings(std::string_view value) {
+  std::vector<std::string_view> codings;
+  while(not value.empty()) {
+    const size_t comma = value.find(',');
+    std::string_view coding = value.substr(0, comma);
+    value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+
+    while(not coding.empty() && (coding.front() == ' ' || coding.front() == '\t')) coding.remove_prefix(1);
+    while(not coding.empty() && (coding.back() == ' ' || coding.back() == '\t')) coding.remove_suffix(1);
+    if(not coding.empty()) {
+      codings.push_back(coding);
+    }
+  }
+  return codings;
+}
+
+} // anonymous namespace
+
+//----------------------------------------
+//
+//----------------------------------------
+BodyReader::BodyReader(Remote& client, const HttpRequest& request, uint64_t limit)
+  : client_(client), limit_(limit) {
+
+  // a body framed two ways, or one whose end chunked doesn't
+  // mark, is read differently by every hop (RFC 9112 6.1)
+  const std::string transfer_encoding = request.get_header("transfer-encoding");
+  const auto codings = transfer_codings(transfer_encoding);
+  if(not codings.empty()) {
+    if(request.has_header("content-length")) {
+      throw std::invalid_argument("Transfer-Encoding together with Content-Length");
+    }
+    if(not iequals(codings.back(), "chunked")) {
+      throw std::invalid_argument("Transfer-Encoding does not end in chunked: " + transfer_encoding);
+    }
+
+    const auto earlier = std::span(codings).first(codings.size() - 1);
+    if(std::ranges::any_of(earlier, [](std::string_view coding) { return iequals(coding, "chunked"); })) {
+      throw std::invalid_argument("Transfer-Encoding applies chunked twice: " + transfer_encoding);
+    }
+    if(not earlier.empty()) {
+      throw std::domain_error("Unsupported transfer coding: " + std::string(earlier.front()));
+    }
+    chunked_ = true;
+  }
+  expect_continue_ = contains_token(request.get_header("expect"), "100-continue");
+
+  if(not chunked_) {
+    // no length and no chunking means no body on a request
+    uint64_t length = 0;
+    const std::string header = request.get_header("content-length");
+    if(not header.empty()) {
+      auto [end, ec] = std::from_chars(header.data(), header.data() + header.size(), length);
+      if(ec != std::errc() || end != header.data() + header.size()) {
+        throw std::invalid_argument("Invalid Content-Length: " + header);
+      }
+    }
+    length_ = length;
+    finished_ = length == 0;
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+size_t BodyReader::read(std::span<char> buffer) {
+  if(finished_ || buffer.empty()) {
+    return 0;
+  }
+
+  if(not started_) {
+    started_ = true;
+    if(expect_continue_) {
+      client_.send("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+  }
+
+  if(chunked_ && chunk_left_ == 0 && not next_chunk()) {
+    return 0;
+  }
+
+  const uint64_t left = chunked_ ? chunk_left_ : *length_ - received_;
+  const size_t wanted = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+
+  const size_t len = client_.recv_into(buffer.first(wanted));
+  if(len == 0) {
+    throw std::runtime_error("Connection closed before the request body ended");
+  }
+  count(len);
+
+  if(chunked_) {
+    chunk_left_ -= len;
+    if(chunk_left_ == 0 && client_.recv_view(2) != "\r\n") {
+      throw std::runtime_error("Malformed chunked request body");
+    }
+  } else if(received_ == *length_) {
+    finished_ = true;
+  }
+  return len;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void BodyReader::for_each_chunk(const std::function<void(std::string_view)>& sink) {
+  std::vector<char> buffer(kChunkSize);
+  while(const size_t len = read(buffer)) {
+    sink(std::string_view(buffer.data(), len));
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string BodyReader::read_all() {
+  std::string body;
+  if(length_) {
+    body.resize(static_cast<size_t>(*length_ - received_));
+    size_t done = 0;
+    while(const size_t len = read(std::span<char>(body.data() + done, body.size() - done))) {
+      done += len;
+    }
+    body.resize(done);
+    return body;
+  }
+
+  for_each_chunk([&](std::string_view piece) { body += piece; });
+  return body;
+}
+
+//----------------------------------------
+// reads the next chunk size line. false after the last chunk,
+// whose trailers are skipped.
+//----------------------------------------
+bool BodyReader::next_chunk() {
+  const std::string_view line = client_.recvuntil_view("\r\n", kMaxLine);
+
+  uint64_t size = 0;
+  auto [end, ec] = std::from_chars(line.data(), line.data() + line.size() - 2, size, 16);
+  if(ec != std::errc() || end == line.data() || (*end != ';' && *end != '\r' && *end != ' ' && *end != '\t')) {
+    throw std::runtime_error("Malformed chunk size in request body");
+  }
+
+  if(size == 0) {
+    while(client_.recvuntil_view("\r\n", kMaxLine).size() > 2) {
+    }
+    finished_ = true;
+    return false;
+  }
+
+  if(limit_ != 0 && size > limit_ - std::min(limit_, received_)) {
+    throw std::length_error("Request body exceeds " + std::to_string(limit_) + " bytes");
+  }
+  chunk_left_ = size;
+  return true;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void BodyReader::count(uint64_t bytes) {
+  received_ += bytes;
+  if(limit_ != 0 && received_ > limit_) {
+    throw std::length_error("Request body exceeds " + std::to_string(limit_) + " bytes");
+  }
+}
+
+} // namespace cpppwn
@@ -0,0 +1,406 @@
+#include <Compression.hpp>
+#include <HttpUtils.hpp>
+
+#include <array>
+#include <charconv>
+#include <climits>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#ifdef CPPPWN_HAVE_BROTLI
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#endif
+
+namespace cpppwn {
+namespace {
+
+constexpr size_t kBlock = 16 << 10;
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string_view trim(std::string_view text) noexcept {
+  while(not text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+  while(not text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+  return text;
+}
+
+//----------------------------------------
+// the q parameter of one Accept-Encoding element, 1 without
+//----------------------------------------
+double quality(std::string_view params) noexcept {
+  while(not params.empty()) {
+    const size_t semicolon = params.find(';');
+    const std::string_view param = trim(params.substr(0, semicolon));
+    params = semicolon == std::string_view::npos ? std::string_view{} : params.substr(semicolon + 1);
+
+    if(param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+      double value = 0;
+      const auto [end, ec] = std::from_chars(param.data() + 2, param.data() + param.size(), value);
+      return ec == std::errc() ? value : 0;
+    }
+  }
+  return 1;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string deflate_all(std::string_view data, bool gzip, int level) {
+  if(data.size() > UINT_MAX) {
+    throw std::length_error("Body too large to compress in one piece");
+  }
+
+  z_stream zs{};
+  if(deflateInit2(&zs, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+                  gzip ? MAX_WBITS + 16 : MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("deflateInit2() failed");
+  }
+
+  // the bound is enough to finish in one call
+  std::string out(deflateBound(&zs, static_cast<uLong>(data.size())), '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = static_cast<uInt>(data.size());
+  zs.next_out = reinterpret_cast<Bytef*>(out.data());
+  zs.avail_out = static_cast<uInt>(out.size());
+
+  const int rc = deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  if(rc != Z_STREAM_END) {
+    throw std::runtime_error("deflate() failed");
+  }
+  return out;
+}
+
+} // anonymous namespace
+
+//----------------------------------------
+//
+//----------------------------------------
+std::optional<ContentCoding> parse_content_coding(std::string_view token) noexcept {
+  token = trim(token);
+  if(iequals(token, "gzip") || iequals(token, "x-gzip")) return ContentCoding::Gzip;
+  if(iequals(token, "deflate")) return ContentCoding::Deflate;
+  if(iequals(token, "br")) return ContentCoding::Brotli;
+  if(iequals(token, "identity")) return ContentCoding::Identity;
+  return std::nullopt;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string_view content_coding_name(ContentCoding coding) noexcept {
+  switch(coding) {
+    case ContentCoding::Gzip: return "gzip";
+    case ContentCoding::Deflate: return "deflate";
+    case ContentCoding::Brotli: return "br";
+    case ContentCoding::Identity: break;
+  }
+  return "identity";
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool content_coding_supported([[maybe_unused]] ContentCoding coding) noexcept {
+#ifdef CPPPWN_HAVE_BROTLI
+  return true;
+#else
+  return coding != ContentCoding::Brotli;
+#endif
+}
+
+//----------------------------------------
+// codings the header doesn't list are only acceptable through
+// a "*" element
+//----------------------------------------
+ContentCoding negotiate_content_coding(std::string_view accept_encoding) noexcept {
+  constexpr std::array preference{ContentCoding::Brotli, ContentCoding::Gzip, ContentCoding::Deflate};
+
+  std::array<double, 4> q{-1, -1, -1, -1};  // by ContentCoding, -1 if not listed
+  double any = -1;
+
+  while(not accept_encoding.empty()) {
+    const size_t comma = accept_encoding.find(',');
+    const std::string_view element = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma + 1);
+
+    const size_t semicolon = element.find(';');
+    const std::string_view token = trim(element.substr(0, semicolon));
+    const double value = semicolon == std::string_view::npos ? 1 : quality(element.substr(semicolon + 1));
+
+    if(token == "*") {
+      any = value;
+    } else if(const auto coding = parse_content_coding(token)) {
+      q[static_cast<size_t>(*coding)] = value;
+    }
+  }
+
+  ContentCoding best = ContentCoding::Identity;
+  double best_q = 0;
+  for(const ContentCoding coding : preference) {
+    if(not content_coding_supported(coding)) continue;
+
+    const double listed = q[static_cast<size_t>(coding)];
+    const double value = listed >= 0 ? listed : std::max(any, 0.0);
+    if(value > best_q) {
+      best = coding;
+      best_q = value;
+    }
+  }
+  return best;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string compress(std::string_view data, ContentCoding coding, int level) {
+  switch(coding) {
+    case ContentCoding::Identity:
+      return std::string(data);
+
+    case ContentCoding::Gzip:
+    case ContentCoding::Deflate:
+      return deflate_all(data, coding == ContentCoding::Gzip, level);
+
+    case ContentCoding::Brotli:
+#ifdef CPPPWN_HAVE_BROTLI
+    {
+      size_t size = BrotliEncoderMaxCompressedSize(data.size());
+      if(size == 0) {
+        throw std::length_error("Body too large to compress in one piece");
+      }
+
+      // quality 5 is far cheaper than the maximum of 11 and already beats gzip
+      std::string out(size, '\0');
+      if(not BrotliEncoderCompress(level < 0 ? 5 : level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                                   data.size(), reinterpret_cast<const uint8_t*>(data.data()),
+                                   &size, reinterpret_cast<uint8_t*>(out.data()))) {
+        throw std::runtime_error("BrotliEncoderCompress() failed");
+      }
+      out.resize(size);
+      return out;
+    }
+#else
+      break;
+#endif
+  }
+  throw std::invalid_argument("Unsupported content coding: " + std::string(content_coding_name(coding)));
+}
+
+//----------------------------------------
+// zlib for gzip and deflate, the brotli decoder for br
+//----------------------------------------
+class Decompressor::Impl {
+  public:
+    //----------------------------------------
+    //
+    //----------------------------------------
+    explicit Impl(ContentCoding coding) : coding_(coding) {
+      if(coding_ == ContentCoding::Brotli) {
+#ifdef CPPPWN_HAVE_BROTLI
+        brotli_ = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+        if(not brotli_) {
+          throw std::bad_alloc();
+        }
+        return;
+#else
+        throw std::invalid_argument("Brotli support was not built in");
+#endif
+      }
+      if(coding_ == ContentCoding::Identity) {
+        throw std::invalid_argument("Nothing to decode for identity");
+      }
+      init_zlib(coding_ == ContentCoding::Gzip ? MAX_WBITS + 16 : MAX_WBITS);
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    ~Impl() {
+      if(zlib_ready_) {
+        inflateEnd(&zs_);
+      }
+#ifdef CPPPWN_HAVE_BROTLI
+      if(brotli_) {
+        BrotliDecoderDestroyInstance(brotli_);
+      }
+#endif
+    }
+
+    //----------------------------------------
+    // budget is how much more output is allowed
+    //----------------------------------------
+    void feed(std::string_view data, std::string& out, uint64_t budget) {
+      if(coding_ == ContentCoding::Brotli) {
+        feed_brotli(data, out, budget);
+      } else {
+        feed_zlib(data, out, budget);
+      }
+    }
+
+    [[nodiscard]] bool ended() const noexcept { return ended_; }
+
+  private:
+    ContentCoding coding_;
+    z_stream zs_{};
+    bool zlib_ready_ = false;
+    bool raw_deflate_ = false;
+    uint64_t fed_ = 0;
+    bool ended_ = false;
+#ifdef CPPPWN_HAVE_BROTLI
+    BrotliDecoderState* brotli_ = nullptr;
+#endif
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void init_zlib(int window_bits) {
+      if(zlib_ready_) {
+        inflateEnd(&zs_);
+        zlib_ready_ = false;
+      }
+      zs_ = z_stream{};
+      if(inflateInit2(&zs_, window_bits) != Z_OK) {
+        throw std::runtime_error("inflateInit2() failed");
+      }
+      zlib_ready_ = true;
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    static void take(const char* data, size_t size, std::string& out, uint64_t& budget) {
+      if(size > budget) {
+        throw std::length_error("Decoded body exceeds the size limit");
+      }
+      budget -= size;
+      out.append(data, size);
+    }
+
+    //----------------------------------------
+    // some servers send raw deflate for "deflate", so a stream
+    // that fails on its very first bytes is retried without the
+    // zlib wrapper. gzip bodies may hold several members. budget
+    // is charged as output is taken, so input split in halves
+    // shares one allowance.
+    //----------------------------------------
+    void feed_zlib(std::string_view data, std::string& out, uint64_t& budget) {
+      if(data.size() > UINT_MAX) {
+        feed_zlib(data.substr(0, UINT_MAX), out, budget);
+        feed_zlib(data.substr(UINT_MAX), out, budget);
+        return;
+      }
+
+      const bool first_feed = fed_ == 0;
+      fed_ += data.size();
+
+      zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+      zs_.avail_in = static_cast<uInt>(data.size());
+
+      std::array<char, kBlock> block;
+      while(true) {
+        if(ended_) {
+          if(coding_ != ContentCoding::Gzip || zs_.avail_in == 0 || *zs_.next_in != '\x1f') {
+            return;   // anything after the stream is ignored
+          }
+          inflateReset(&zs_);
+          ended_ = false;
+        }
+
+        zs_.next_out = reinterpret_cast<Bytef*>(block.data());
+        zs_.avail_out = static_cast<uInt>(block.size());
+
+        const int rc = inflate(&zs_, Z_NO_FLUSH);
+        const size_t produced = block.size() - zs_.avail_out;
+
+        if(rc == Z_DATA_ERROR && coding_ == ContentCoding::Deflate && not raw_deflate_
+            && first_feed && zs_.total_out == 0) {
+          init_zlib(-MAX_WBITS);
+          raw_deflate_ = true;
+          feed_zlib(data, out, budget);
+          return;
+        }
+
+        take(block.data(), produced, out, budget);
+
+        if(rc == Z_STREAM_END) {
+          ended_ = true;
+          continue;
+        }
+        if(rc == Z_BUF_ERROR || (rc == Z_OK && zs_.avail_in == 0 && zs_.avail_out != 0)) {
+          return;   // waiting for more input
+        }
+        if(rc != Z_OK) {
+          throw std::runtime_error("Corrupt compressed body");
+        }
+      }
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void feed_brotli([[maybe_unused]] std::string_view data, [[maybe_unused]] std::string& out,
+                     [[maybe_unused]] uint64_t budget) {
+#ifdef CPPPWN_HAVE_BROTLI
+      const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data.data());
+      size_t avail_in = data.size();
+
+      std::array<char, kBlock> block;
+      while(not ended_) {
+        uint8_t* next_out = reinterpret_cast<uint8_t*>(block.data());
+        size_t avail_out = block.size();
+
+        const BrotliDecoderResult result = BrotliDecoderDecompressStream(brotli_, &avail_in, &next_in,
+                                                                         &avail_out, &next_out, nullptr);
+        take(block.data(), block.size() - avail_out, out, budget);
+
+        if(result == BROTLI_DECODER_RESULT_ERROR) {
+          throw std::runtime_error(std::string("Corrupt brotli body: ")
+            + BrotliDecoderErrorString(BrotliDecoderGetErrorCode(brotli_)));
+        }
+        if(result == BROTLI_DECODER_RESULT_SUCCESS) {
+          ended_ = true;
+        } else if(result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+          return;
+        }
+      }
+#endif
+    }
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+Decompressor::Decompressor(ContentCoding coding, uint64_t max_output)
+  : impl_(std::make_unique<Impl>(coding)), max_output_(max_output == 0 ? UINT64_MAX : max_output) {
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+Decompressor::~Decompressor() = default;
+
+//----------------------------------------
+//
+//----------------------------------------
+void Decompressor::feed(std::string_view data, std::string& out) {
+  const size_t before = out.size();
+  impl_->feed(data, out, max_output_ - produced_);
+  produced_ += out.size() - before;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Decompressor::finish() const {
+  if(not impl_->ended()) {
+    throw std::runtime_error("Compressed body ended early");
+  }
+}
+
+}
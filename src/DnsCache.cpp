@@ -0,0 +1,201 @@
+#include "DnsCache.hpp"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+namespace cpppwn {
+  namespace {
+
+    //----------------------------------------
+    // the codes asio's own resolver reports for these failures
+    //----------------------------------------
+    asio::error_code addrinfo_error(int rc) {
+      switch(rc) {
+        case EAI_NONAME: return asio::error::host_not_found;
+        case EAI_AGAIN:  return asio::error::host_not_found_try_again;
+        case EAI_FAIL:   return asio::error::no_recovery;
+        case EAI_MEMORY: return asio::error::no_memory;
+        case EAI_SYSTEM: return asio::error_code(errno, asio::error::get_system_category());
+        default:         return asio::error_code(rc, asio::error::get_addrinfo_category());
+      }
+    }
+
+    //----------------------------------------
+    // every TCP address of host, in the order getaddrinfo() sorted
+    // them for this machine
+    //----------------------------------------
+    std::vector<asio::ip::address> lookup(const std::string& host) {
+      addrinfo hints{};
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      hints.ai_protocol = IPPROTO_TCP;
+      hints.ai_flags = AI_ADDRCONFIG;
+
+      addrinfo* found = nullptr;
+      const int rc = ::getaddrinfo(host.c_str(), nullptr, &hints, &found);
+      if(rc != 0) {
+        throw asio::system_error(addrinfo_error(rc), host);
+      }
+      std::unique_ptr<addrinfo, decltype(&::freeaddrinfo)> guard(found, ::freeaddrinfo);
+
+      std::vector<asio::ip::address> addresses;
+      for(const addrinfo* ai = found; ai; ai = ai->ai_next) {
+        if(ai->ai_family == AF_INET) {
+          sockaddr_in sa;
+          std::memcpy(&sa, ai->ai_addr, sizeof(sa));
+          asio::ip::address_v4::bytes_type bytes;
+          std::memcpy(bytes.data(), &sa.sin_addr, bytes.size());
+          addresses.emplace_back(asio::ip::address_v4(bytes));
+        } else if(ai->ai_family == AF_INET6) {
+          sockaddr_in6 sa;
+          std::memcpy(&sa, ai->ai_addr, sizeof(sa));
+          asio::ip::address_v6::bytes_type bytes;
+          std::memcpy(bytes.data(), &sa.sin6_addr, bytes.size());
+          addresses.emplace_back(asio::ip::address_v6(bytes, sa.sin6_scope_id));
+        }
+      }
+
+      if(addresses.empty()) {
+        throw asio::system_error(asio::error::host_not_found, host);
+      }
+      return addresses;
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    std::vector<asio::ip::tcp::endpoint> with_port(const std::vector<asio::ip::address>& addresses, uint16_t port) {
+      std::vector<asio::ip::tcp::endpoint> endpoints;
+      endpoints.reserve(addresses.size());
+      for(const auto& address : addresses) {
+        endpoints.emplace_back(address, port);
+      }
+      return endpoints;
+    }
+  }
+
+//----------------------------------------
+//
+//----------------------------------------
+DnsCache::DnsCache(DnsCacheConfig config) : config_(std::move(config)) {
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+DnsCache& DnsCache::global() {
+  static DnsCache cache;
+  return cache;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void DnsCache::configure(const DnsCacheConfig& config) {
+  std::lock_guard lock(mutex_);
+  config_ = config;
+  entries_.clear();
+}
+
+//----------------------------------------
+// the lookup itself runs unlocked, so a slow name never holds
+// up hosts that are already cached
+//----------------------------------------
+std::vector<asio::ip::tcp::endpoint> DnsCache::resolve(const std::string& host, uint16_t port) {
+  if(auto endpoints = find(host, port)) {
+    return std::move(*endpoints);
+  }
+
+  auto endpoints = with_port(lookup(host), port);
+  insert(host, endpoints);
+  return endpoints;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::optional<std::vector<asio::ip::tcp::endpoint>> DnsCache::find(const std::string& host, uint16_t port) {
+  asio::error_code ec;
+  const auto literal = asio::ip::make_address(host, ec);
+  if(not ec) {
+    return std::vector<asio::ip::tcp::endpoint>{asio::ip::tcp::endpoint(literal, port)};
+  }
+
+  std::lock_guard lock(mutex_);
+  if(auto it = entries_.find(host); it != entries_.end()) {
+    if(it->second.expires > std::chrono::steady_clock::now()) {
+      return with_port(it->second.addresses, port);
+    }
+    entries_.erase(it);
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void DnsCache::insert(const std::string& host, const std::vector<asio::ip::tcp::endpoint>& endpoints) {
+  if(endpoints.empty()) {
+    return;
+  }
+
+  std::vector<asio::ip::address> addresses;
+  addresses.reserve(endpoints.size());
+  for(const auto& endpoint : endpoints) {
+    addresses.push_back(endpoint.address());
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard lock(mutex_);
+  if(config_.ttl.count() > 0 && config_.max_entries > 0) {
+    if(entries_.size() >= config_.max_entries && not entries_.contains(host)) {
+      evict(now);
+    }
+    entries_.insert_or_assign(host, Entry{std::move(addresses), now + config_.ttl});
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void DnsCache::forget(const std::string& host) {
+  std::lock_guard lock(mutex_);
+  entries_.erase(host);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void DnsCache::clear() {
+  std::lock_guard lock(mutex_);
+  entries_.clear();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+size_t DnsCache::size() const {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+//----------------------------------------
+// expired entries first. if all are current the one closest to
+// expiring goes, it would have been looked up again soonest.
+//----------------------------------------
+void DnsCache::evict(std::chrono::steady_clock::time_point now) {
+  std::erase_if(entries_, [now](const auto& entry) { return entry.second.expires <= now; });
+
+  while(not entries_.empty() && entries_.size() >= config_.max_entries) {
+    auto oldest = entries_.begin();
+    for(auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if(it->second.expires < oldest->second.expires) oldest = it;
+    }
+    entries_.erase(oldest);
+  }
+}
+
+}
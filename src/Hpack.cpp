@@ -0,0 +1,453 @@
+#include "Hpack.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <utility>
+
+namespace cpppwn {
+  namespace {
+
+    //----------------------------------------
+    // RFC 7541 appendix A
+    //----------------------------------------
+    const std::array<HpackField, HpackTable::static_size> static_table{{
+      {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+      {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+      {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+      {":status", "404"}, {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+      {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+      {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+      {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+      {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+      {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+      {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+      {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+      {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+      {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""},
+      {"retry-after", ""}, {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""},
+      {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+      {"www-authenticate", ""}
+    }};
+
+    //----------------------------------------
+    // RFC 7541 appendix B, code and bit length per symbol.
+    // symbol 256 is EOS.
+    //----------------------------------------
+    constexpr std::array<std::pair<uint32_t, uint8_t>, 257> huffman_codes{{
+      {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+      {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+      {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+      {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+      {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+      {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+      {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+      {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+      {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+      {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+      {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+      {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+      {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+      {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+      {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+      {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+      {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+      {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+      {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+      {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+      {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+      {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+      {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+      {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+      {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+      {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+      {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+      {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+      {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+      {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+      {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+      {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+      {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+      {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+      {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+      {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+      {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+      {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+      {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+      {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+      {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+      {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+      {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+    }};
+
+    //----------------------------------------
+    // the code as a binary tree, for decoding bit by bit
+    //----------------------------------------
+    struct HuffmanNode {
+      std::array<int16_t, 2> next{-1, -1};
+      int16_t symbol = -1;
+    };
+
+    const std::vector<HuffmanNode>& huffman_tree() {
+      static const std::vector<HuffmanNode> tree = [] {
+        std::vector<HuffmanNode> nodes(1);
+        nodes.reserve(2 * huffman_codes.size());
+
+        for(size_t symbol = 0; symbol < huffman_codes.size(); ++symbol) {
+          const auto [code, length] = huffman_codes[symbol];
+          size_t node = 0;
+          for(int bit = length - 1; bit >= 0; --bit) {
+            const size_t branch = (code >> bit) & 1;
+            if(nodes[node].next[branch] < 0) {
+              nodes[node].next[branch] = static_cast<int16_t>(nodes.size());
+              nodes.emplace_back();
+            }
+            node = static_cast<size_t>(nodes[node].next[branch]);
+          }
+          nodes[node].symbol = static_cast<int16_t>(symbol);
+        }
+        return nodes;
+      }();
+      return tree;
+    }
+
+    //----------------------------------------
+    // an integer with an N-bit prefix, section 5.1. first holds
+    // the bits in front of the prefix.
+    //----------------------------------------
+    void encode_integer(std::string& out, uint8_t first, int prefix, uint64_t value) {
+      const uint64_t limit = (uint64_t{1} << prefix) - 1;
+      if(value < limit) {
+        out += static_cast<char>(first | value);
+        return;
+      }
+
+      out += static_cast<char>(first | limit);
+      value -= limit;
+      while(value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      out += static_cast<char>(value);
+    }
+
+    //----------------------------------------
+    // nothing sane needs more than 32 bits
+    //----------------------------------------
+    uint64_t decode_integer(std::string_view& in, int prefix) {
+      if(in.empty()) {
+        throw std::runtime_error("Truncated HPACK integer");
+      }
+
+      const uint64_t limit = (uint64_t{1} << prefix) - 1;
+      uint64_t value = static_cast<uint8_t>(in.front()) & limit;
+      in.remove_prefix(1);
+      if(value < limit) {
+        return value;
+      }
+
+      for(int shift = 0; shift <= 28; shift += 7) {
+        if(in.empty()) {
+          throw std::runtime_error("Truncated HPACK integer");
+        }
+        const auto byte = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if(not (byte & 0x80)) {
+          return value;
+        }
+      }
+      throw std::runtime_error("HPACK integer too large");
+    }
+
+    //----------------------------------------
+    // a string literal, section 5.2, Huffman coded if shorter
+    //----------------------------------------
+    void encode_string(std::string& out, std::string_view value) {
+      const size_t huffman_size = huffman_encoded_size(value);
+      if(huffman_size < value.size()) {
+        encode_integer(out, 0x80, 7, huffman_size);
+        huffman_encode(value, out);
+      } else {
+        encode_integer(out, 0x00, 7, value.size());
+        out.append(value);
+      }
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    std::string decode_string(std::string_view& in) {
+      const bool huffman = not in.empty() && (static_cast<uint8_t>(in.front()) & 0x80);
+      const uint64_t length = decode_integer(in, 7);
+      if(length > in.size()) {
+        throw std::runtime_error("Truncated HPACK string");
+      }
+
+      std::string value;
+      if(huffman) {
+        if(not huffman_decode(in.substr(0, length), value)) {
+          throw std::runtime_error("Invalid Huffman code in HPACK string");
+        }
+      } else {
+        value.assign(in.substr(0, length));
+      }
+      in.remove_prefix(length);
+      return value;
+    }
+  }
+
+//----------------------------------------
+//
+//----------------------------------------
+const HpackField* HpackTable::at(size_t index) const noexcept {
+  if(index == 0) {
+    return nullptr;
+  }
+  if(index <= static_size) {
+    return &static_table[index - 1];
+  }
+  index -= static_size + 1;
+  return index < entries_.size() ? &entries_[index] : nullptr;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+size_t HpackTable::find(std::string_view name, std::string_view value, bool& value_matched) const noexcept {
+  size_t name_index = 0;
+  value_matched = false;
+
+  for(size_t i = 0; i < static_size; ++i) {
+    if(static_table[i].name != name) continue;
+    if(static_table[i].value == value) {
+      value_matched = true;
+      return i + 1;
+    }
+    if(name_index == 0) name_index = i + 1;
+  }
+
+  for(size_t i = 0; i < entries_.size(); ++i) {
+    if(entries_[i].name != name) continue;
+    if(entries_[i].value == value) {
+      value_matched = true;
+      return static_size + i + 1;
+    }
+    if(name_index == 0) name_index = static_size + i + 1;
+  }
+  return name_index;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HpackTable::insert(std::string name, std::string value) {
+  const size_t size = entry_size(name, value);
+  if(size > max_size_) {
+    entries_.clear();
+    size_ = 0;
+    return;
+  }
+
+  evict(max_size_ - size);
+  entries_.push_front({std::move(name), std::move(value)});
+  size_ += size;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HpackTable::set_max_size(size_t max_size) {
+  max_size_ = max_size;
+  evict(max_size_);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HpackTable::evict(size_t limit) {
+  while(size_ > limit && not entries_.empty()) {
+    size_ -= entry_size(entries_.back().name, entries_.back().value);
+    entries_.pop_back();
+  }
+}
+
+//----------------------------------------
+// a shrink and a regrowth between two blocks take two updates,
+// so the decoder evicts what the encoder did
+//----------------------------------------
+void HpackEncoder::set_max_table_size(size_t size) {
+  size = std::min<size_t>(size, 4096);
+  if(size == table_.max_size()) {
+    return;
+  }
+
+  if(not pending_update_ || size < *pending_update_) {
+    pending_update_ = size;
+  }
+  pending_final_ = size;
+  table_.set_max_size(size);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HpackEncoder::encode(std::span<const HpackField> fields, std::string& out) {
+  if(pending_update_) {
+    encode_integer(out, 0x20, 5, *pending_update_);
+    if(pending_final_ != *pending_update_) {
+      encode_integer(out, 0x20, 5, pending_final_);
+    }
+    pending_update_.reset();
+  }
+
+  for(const auto& field : fields) {
+    bool value_matched = false;
+    const size_t index = table_.find(field.name, field.value, value_matched);
+    if(value_matched) {
+      encode_integer(out, 0x80, 7, index);
+      continue;
+    }
+
+    const bool sensitive = field.name == "authorization" || field.name == "proxy-authorization";
+    const bool indexing = not sensitive && HpackTable::entry_size(field.name, field.value) <= table_.max_size();
+
+    if(indexing) {
+      encode_integer(out, 0x40, 6, index);
+    } else {
+      encode_integer(out, sensitive ? 0x10 : 0x00, 4, index);
+    }
+    if(index == 0) {
+      encode_string(out, field.name);
+    }
+    encode_string(out, field.value);
+
+    if(indexing) {
+      table_.insert(field.name, field.value);
+    }
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::vector<HpackField> HpackDecoder::decode(std::string_view block) {
+  std::vector<HpackField> fields;
+  bool leading = true;
+
+  while(not block.empty()) {
+    const auto first = static_cast<uint8_t>(block.front());
+
+    if(first & 0x80) {
+      const HpackField* field = table_.at(decode_integer(block, 7));
+      if(not field) {
+        throw std::runtime_error("HPACK index out of range");
+      }
+      fields.push_back(*field);
+      leading = false;
+      continue;
+    }
+
+    if((first & 0xe0) == 0x20) {
+      // size updates may only open a block
+      const uint64_t size = decode_integer(block, 5);
+      if(not leading || size > limit_) {
+        throw std::runtime_error("Invalid HPACK table size update");
+      }
+      table_.set_max_size(size);
+      continue;
+    }
+
+    const bool indexing = first & 0x40;
+    const uint64_t index = decode_integer(block, indexing ? 6 : 4);
+
+    HpackField field;
+    if(index != 0) {
+      const HpackField* indexed = table_.at(index);
+      if(not indexed) {
+        throw std::runtime_error("HPACK index out of range");
+      }
+      field.name = indexed->name;
+    } else {
+      field.name = decode_string(block);
+    }
+    field.value = decode_string(block);
+
+    if(indexing) {
+      table_.insert(field.name, field.value);
+    }
+    fields.push_back(std::move(field));
+    leading = false;
+  }
+  return fields;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+size_t huffman_encoded_size(std::string_view data) noexcept {
+  size_t bits = 0;
+  for(const char c : data) {
+    bits += huffman_codes[static_cast<uint8_t>(c)].second;
+  }
+  return (bits + 7) / 8;
+}
+
+//----------------------------------------
+// the last byte is padded with the most significant bits of
+// EOS, which are all ones
+//----------------------------------------
+void huffman_encode(std::string_view data, std::string& out) {
+  uint64_t bits = 0;
+  int count = 0;
+
+  for(const char c : data) {
+    const auto [code, length] = huffman_codes[static_cast<uint8_t>(c)];
+    bits = (bits << length) | code;
+    count += length;
+    while(count >= 8) {
+      count -= 8;
+      out += static_cast<char>(bits >> count);
+    }
+  }
+
+  if(count > 0) {
+    out += static_cast<char>((bits << (8 - count)) | (0xff >> count));
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool huffman_decode(std::string_view data, std::string& out) {
+  const auto& tree = huffman_tree();
+  size_t node = 0;
+  int depth = 0;
+  bool all_ones = true;
+
+  for(const char c : data) {
+    for(int bit = 7; bit >= 0; --bit) {
+      const size_t branch = (static_cast<uint8_t>(c) >> bit) & 1;
+      const int16_t next = tree[node].next[branch];
+      if(next < 0) {
+        return false;
+      }
+      node = static_cast<size_t>(next);
+      ++depth;
+      all_ones = all_ones && branch;
+
+      if(tree[node].symbol >= 0) {
+        if(tree[node].symbol == 256) {
+          return false;
+        }
+        out += static_cast<char>(tree[node].symbol);
+        node = 0;
+        depth = 0;
+        all_ones = true;
+      }
+    }
+  }
+  return depth < 8 && all_ones;
+}
+
+}
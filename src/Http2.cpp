@@ -0,0 +1,810 @@
+#include "Http2.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <stdexcept>
+
+namespace cpppwn {
+  namespace {
+
+    constexpr std::string_view client_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    constexpr uint32_t max_stream_id = 0x7fffffff;
+
+    enum FrameType : uint8_t {
+      Data = 0x0,
+      Headers = 0x1,
+      Priority = 0x2,
+      RstStream = 0x3,
+      Settings = 0x4,
+      PushPromise = 0x5,
+      Ping = 0x6,
+      Goaway = 0x7,
+      WindowUpdate = 0x8,
+      Continuation = 0x9
+    };
+
+    enum FrameFlag : uint8_t {
+      EndStream = 0x1,
+      Ack = 0x1,
+      EndHeaders = 0x4,
+      Padded = 0x8,
+      PriorityFlag = 0x20
+    };
+
+    constexpr uint32_t cancel_error = 0x8;
+    constexpr uint32_t calm_error = 0xb;   // ENHANCE_YOUR_CALM
+
+    // header blocks may grow this large unless the profile
+    // announces a SETTINGS_MAX_HEADER_LIST_SIZE
+    constexpr uint32_t default_max_header_block = 256 << 10;
+
+    // how long a waiting thread drives the socket before it looks
+    // at its condition again, and how long the destructor tries
+    // to get its GOAWAY out
+    constexpr std::chrono::milliseconds drive_interval{50};
+    constexpr std::chrono::milliseconds close_timeout{1000};
+
+    // DATA frames are queued while less than this is unsent
+    constexpr size_t max_unsent = 256 << 10;
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_u16(std::string& out, uint16_t value) {
+      out += static_cast<char>(value >> 8);
+      out += static_cast<char>(value);
+    }
+
+    void append_u32(std::string& out, uint32_t value) {
+      out += static_cast<char>(value >> 24);
+      out += static_cast<char>(value >> 16);
+      out += static_cast<char>(value >> 8);
+      out += static_cast<char>(value);
+    }
+
+    uint32_t read_u32(std::string_view data) {
+      return static_cast<uint32_t>(static_cast<uint8_t>(data[0])) << 24
+           | static_cast<uint32_t>(static_cast<uint8_t>(data[1])) << 16
+           | static_cast<uint32_t>(static_cast<uint8_t>(data[2])) << 8
+           | static_cast<uint32_t>(static_cast<uint8_t>(data[3]));
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_frame_header(std::string& out, size_t length, FrameType type, uint8_t flags, uint32_t stream) {
+      out += static_cast<char>(length >> 16);
+      out += static_cast<char>(length >> 8);
+      out += static_cast<char>(length);
+      out += static_cast<char>(type);
+      out += static_cast<char>(flags);
+      append_u32(out, stream);
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_priority(std::string& out, const Http2Priority& priority) {
+      append_u32(out, (priority.exclusive ? 0x80000000u : 0) | (priority.depends_on & max_stream_id));
+      out += static_cast<char>(std::clamp<uint16_t>(priority.weight, 1, 256) - 1);
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_window_update(std::string& out, uint32_t stream, uint32_t increment) {
+      append_frame_header(out, 4, WindowUpdate, 0, stream);
+      append_u32(out, increment);
+    }
+
+    //----------------------------------------
+    // a client's GOAWAY, it never accepts streams the server opens
+    //----------------------------------------
+    void append_goaway(std::string& out, uint32_t error) {
+      append_frame_header(out, 8, Goaway, 0, 0);
+      append_u32(out, 0);
+      append_u32(out, error);
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_rst_stream(std::string& out, uint32_t stream, uint32_t error) {
+      append_frame_header(out, 4, RstStream, 0, stream);
+      append_u32(out, error);
+    }
+
+    //----------------------------------------
+    // the payload of a PADDED frame without the pad length and
+    // the padding
+    //----------------------------------------
+    std::string_view strip_padding(std::string_view payload, uint8_t flags) {
+      if(not (flags & Padded)) {
+        return payload;
+      }
+      if(payload.empty()) {
+        throw std::runtime_error("HTTP/2 padded frame without pad length");
+      }
+
+      const auto padding = static_cast<uint8_t>(payload.front());
+      if(padding >= payload.size()) {
+        throw std::runtime_error("HTTP/2 padding exceeds the frame");
+      }
+      return payload.substr(1, payload.size() - 1 - padding);
+    }
+  }
+
+//----------------------------------------
+// the preface goes out without waiting for the server's
+// SETTINGS, like browsers do
+//----------------------------------------
+Http2Connection::Http2Connection(std::unique_ptr<Remote> remote, const Http2Profile& profile)
+  : remote_(std::move(remote)), profile_(profile) {
+
+  for(const auto& [setting, value] : profile_.settings) {
+    if(setting == Http2Setting::HeaderTableSize) decoder_ = HpackDecoder(value);
+    if(setting == Http2Setting::InitialWindowSize) local_window_ = value;
+    if(setting == Http2Setting::MaxFrameSize) local_max_frame_ = value;
+    if(setting == Http2Setting::MaxHeaderListSize) local_max_header_block_ = value;
+  }
+  connection_window_ = 65535 + profile_.window_update;
+
+  // streams named in PRIORITY frames stay idle, ours come after them
+  for(const auto& priority : profile_.priority_frames) {
+    next_stream_ = std::max(next_stream_, (priority.stream + 2) | 1);
+  }
+
+  std::string preface(client_preface);
+  append_frame_header(preface, profile_.settings.size() * 6, Settings, 0, 0);
+  for(const auto& [setting, value] : profile_.settings) {
+    append_u16(preface, static_cast<uint16_t>(setting));
+    append_u32(preface, value);
+  }
+  if(profile_.window_update != 0) {
+    append_window_update(preface, 0, profile_.window_update);
+  }
+  for(const auto& priority : profile_.priority_frames) {
+    append_frame_header(preface, 5, Priority, 0, priority.stream);
+    append_priority(preface, priority);
+  }
+
+  remote_->send(preface);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+Http2Connection::~Http2Connection() {
+  std::string frames;
+  {
+    std::lock_guard lock(mutex_);
+    // a connection error we detected queued its own GOAWAY
+    if(failure_.empty()) {
+      append_goaway(outbox_, 0);
+    }
+    frames.swap(outbox_);
+  }
+
+  try {
+    remote_->queue_send(frames);
+    const auto deadline = std::chrono::steady_clock::now() + close_timeout;
+    while(remote_->unsent() > 0 && std::chrono::steady_clock::now() < deadline) {
+      remote_->run_io(drive_interval);
+    }
+  } catch (...) {
+    // the server may have gone already
+  }
+  remote_->close();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+uint32_t Http2Connection::send_request(std::vector<HpackField> fields, std::string_view body) {
+  const std::string& order = profile_.pseudo_header_order;
+  const auto rank = [&](const HpackField& field) {
+    if(not field.name.starts_with(':')) return order.size() + 1;
+    const size_t position = order.find(field.name.size() > 1 ? field.name[1] : '\0');
+    return position == std::string::npos ? order.size() : position;
+  };
+  std::stable_sort(fields.begin(), fields.end(), [&](const HpackField& a, const HpackField& b) {
+    return rank(a) < rank(b);
+  });
+
+  uint32_t id = 0;
+  {
+    // ids have to go out in order, and header blocks in the
+    // order the encoder produced them
+    Lock lock(mutex_);
+    pump(lock, [&] {
+      return not failure_.empty() || goaway_ || active_streams() < peer_max_streams_;
+    });
+    if(not failure_.empty()) {
+      throw std::runtime_error(failure_);
+    }
+    if(goaway_ || next_stream_ > max_stream_id) {
+      throw std::runtime_error("HTTP/2 connection takes no more streams");
+    }
+
+    id = next_stream_;
+    next_stream_ += 2;
+    streams_[id].send_window = peer_window_;
+    encoder_.set_max_table_size(peer_table_size_);
+
+    std::string block;
+    encoder_.encode(fields, block);
+
+    const auto& priority = profile_.headers_priority;
+    const size_t priority_size = priority ? 5 : 0;
+    std::string_view rest = block;
+    const size_t first = std::min(rest.size(), peer_max_frame_ - priority_size);
+
+    std::string frames;
+    frames.reserve(block.size() + 64);
+    append_frame_header(frames, first + priority_size, Headers,
+      (body.empty() ? EndStream : 0) | (first == rest.size() ? EndHeaders : 0) | (priority ? PriorityFlag : 0), id);
+    if(priority) {
+      append_priority(frames, *priority);
+    }
+    frames.append(rest.substr(0, first));
+    rest.remove_prefix(first);
+
+    while(not rest.empty()) {
+      const size_t length = std::min<size_t>(rest.size(), peer_max_frame_);
+      append_frame_header(frames, length, Continuation, length == rest.size() ? EndHeaders : 0, id);
+      frames.append(rest.substr(0, length));
+      rest.remove_prefix(length);
+    }
+    enqueue(frames);
+  }
+
+  try {
+    size_t offset = 0;
+    while(offset < body.size()) {
+      Lock lock(mutex_);
+      pump(lock, [&] {
+        const Stream& s = stream(id);
+        return not s.error.empty() || s.ended
+          || (send_window_ > 0 && s.send_window > 0 && outbox_.size() + unsent_ < max_unsent);
+      });
+
+      Stream& s = stream(id);
+      if(not s.error.empty()) {
+        throw std::runtime_error(s.error);
+      }
+      if(s.ended) {
+        // the server answered without waiting for the rest
+        break;
+      }
+
+      const size_t length = std::min<size_t>({body.size() - offset, static_cast<size_t>(send_window_),
+                                              static_cast<size_t>(s.send_window), peer_max_frame_});
+      send_window_ -= static_cast<int64_t>(length);
+      s.send_window -= static_cast<int64_t>(length);
+
+      std::string frame;
+      frame.reserve(9 + length);
+      append_frame_header(frame, length, Data, offset + length == body.size() ? EndStream : 0, id);
+      frame.append(body.substr(offset, length));
+      enqueue(frame);
+      offset += length;
+    }
+  } catch (...) {
+    close_stream(id);
+    throw;
+  }
+  return id;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+HttpResponse Http2Connection::read_head(uint32_t id) {
+  Lock lock(mutex_);
+  pump(lock, [&] {
+    const Stream& s = stream(id);
+    return s.head_done || not s.error.empty() || s.ended;
+  });
+
+  Stream& s = stream(id);
+  if(not s.error.empty()) {
+    throw std::runtime_error(s.error);
+  }
+  if(not s.head_done) {
+    throw std::runtime_error("HTTP/2 stream ended without a response");
+  }
+  return std::move(s.head);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Http2Connection::read_body(uint32_t id) {
+  Lock lock(mutex_);
+  pump(lock, [&] {
+    const Stream& s = stream(id);
+    return not s.data.empty() || s.ended || not s.error.empty();
+  });
+
+  Stream& s = stream(id);
+  if(not s.error.empty()) {
+    throw std::runtime_error(s.error);
+  }
+
+  std::string piece;
+  piece.swap(s.data);
+  std::string reply;
+  credit(id, &s, piece.size(), reply);
+  enqueue(reply);
+  return piece;
+}
+
+//----------------------------------------
+// what the stream received but nobody read still counts
+// against the connection window, so it is returned here
+//----------------------------------------
+void Http2Connection::close_stream(uint32_t id) noexcept {
+  {
+    std::lock_guard lock(mutex_);
+    auto it = streams_.find(id);
+    if(it == streams_.end()) {
+      return;
+    }
+
+    try {
+      Stream& s = it->second;
+      std::string reply;
+      if(not s.ended && s.error.empty() && failure_.empty()) {
+        append_rst_stream(reply, id, cancel_error);
+      }
+      credit(0, nullptr, s.data.size(), reply);
+      enqueue(reply);
+    } catch (...) {
+      // the stream is forgotten all the same
+    }
+    streams_.erase(it);
+  }
+  cv_.notify_all();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool Http2Connection::is_usable() {
+  Lock lock(mutex_);
+  if(not driving_ && failure_.empty()) {
+    drive(lock, std::chrono::milliseconds{0});
+  }
+  return failure_.empty() && not goaway_ && next_stream_ <= max_stream_id;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+size_t Http2Connection::open_streams() const {
+  std::lock_guard lock(mutex_);
+  return active_streams();
+}
+
+//----------------------------------------
+// streams the server has not ended, the ones its
+// MAX_CONCURRENT_STREAMS counts
+//----------------------------------------
+size_t Http2Connection::active_streams() const noexcept {
+  return static_cast<size_t>(std::count_if(streams_.begin(), streams_.end(), [](const auto& entry) {
+    return not entry.second.ended && entry.second.error.empty();
+  }));
+}
+
+//----------------------------------------
+// waits until done() holds. the first waiter to find nobody
+// driving the socket drives it, the others sleep until it has
+// dispatched what came in.
+//----------------------------------------
+void Http2Connection::pump(Lock& lock, const std::function<bool()>& done) {
+  while(not done() && failure_.empty()) {
+    if(driving_) {
+      cv_.wait(lock);
+      continue;
+    }
+    drive(lock, drive_interval);
+  }
+}
+
+//----------------------------------------
+// hands the queued frames to remote_ and lets it send and read
+// for up to wait, outside the lock so other threads can queue
+// more meanwhile
+//----------------------------------------
+void Http2Connection::drive(Lock& lock, std::chrono::milliseconds wait) {
+  driving_ = true;
+  std::string frames;
+  frames.swap(outbox_);
+  lock.unlock();
+
+  std::string data;
+  size_t unsent = 0;
+  std::string error;
+  try {
+    remote_->queue_send(frames);
+    remote_->run_io(wait);
+    data = remote_->take_buffered();
+    unsent = remote_->unsent();
+  } catch (const std::exception& e) {
+    error = e.what();
+  }
+
+  lock.lock();
+  driving_ = false;
+  unsent_ = unsent;
+  if(error.empty()) {
+    try {
+      read_frames(data);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+  }
+  if(not error.empty()) {
+    fail(error);
+  }
+  cv_.notify_all();
+}
+
+//----------------------------------------
+// dispatches every complete frame of what has arrived so far.
+// called with mutex_ held.
+//----------------------------------------
+void Http2Connection::read_frames(std::string_view data) {
+  input_ += data;
+
+  size_t offset = 0;
+  while(input_.size() - offset >= 9) {
+    const std::string_view header = std::string_view(input_).substr(offset, 9);
+    const size_t length = read_u32(header) >> 8;
+    if(length > local_max_frame_) {
+      throw std::runtime_error("HTTP/2 frame larger than SETTINGS_MAX_FRAME_SIZE");
+    }
+    if(input_.size() - offset - 9 < length) {
+      break;
+    }
+
+    std::string reply;
+    handle_frame(static_cast<uint8_t>(header[3]), static_cast<uint8_t>(header[4]),
+                 read_u32(header.substr(5)) & max_stream_id,
+                 std::string_view(input_).substr(offset + 9, length), reply);
+    enqueue(reply);
+    offset += 9 + length;
+  }
+  input_.erase(0, offset);
+}
+
+//----------------------------------------
+// control frames are answered through reply, queued behind
+// whatever is waiting already
+//----------------------------------------
+void Http2Connection::handle_frame(uint8_t type, uint8_t flags, uint32_t id, std::string_view payload, std::string& reply) {
+  if(header_stream_ != 0 && (type != Continuation || id != header_stream_)) {
+    throw std::runtime_error("HTTP/2 header block interrupted");
+  }
+
+  switch(type) {
+    case Data: {
+      if(id == 0) {
+        throw std::runtime_error("HTTP/2 DATA on stream 0");
+      }
+
+      const std::string_view data = strip_padding(payload, flags);
+      auto it = streams_.find(id);
+      if(it == streams_.end() || it->second.ended || not it->second.error.empty()) {
+        credit(0, nullptr, payload.size(), reply);
+        break;
+      }
+
+      Stream& s = it->second;
+      s.data.append(data);
+      credit(id, &s, payload.size() - data.size(), reply);
+      if(flags & EndStream) {
+        s.ended = true;
+      }
+      break;
+    }
+
+    case Headers: {
+      if(id == 0) {
+        throw std::runtime_error("HTTP/2 HEADERS on stream 0");
+      }
+
+      std::string_view fragment = strip_padding(payload, flags);
+      if(flags & PriorityFlag) {
+        if(fragment.size() < 5) {
+          throw std::runtime_error("HTTP/2 HEADERS too short for its priority");
+        }
+        fragment.remove_prefix(5);
+      }
+
+      header_block_.assign(fragment);
+      header_end_stream_ = flags & EndStream;
+      promised_stream_ = 0;
+      if(flags & EndHeaders) {
+        handle_header_block(id, header_end_stream_, reply);
+      } else {
+        header_stream_ = id;
+      }
+      break;
+    }
+
+    case Continuation: {
+      if(header_stream_ == 0) {
+        throw std::runtime_error("HTTP/2 CONTINUATION without a header block");
+      }
+
+      // an endless block would keep all of it in memory
+      if(header_block_.size() + payload.size() > local_max_header_block_) {
+        append_goaway(outbox_, calm_error);
+        throw std::runtime_error("HTTP/2 header block larger than " + std::to_string(local_max_header_block_) + " bytes");
+      }
+
+      header_block_.append(payload);
+      if(flags & EndHeaders) {
+        header_stream_ = 0;
+        handle_header_block(id, header_end_stream_, reply);
+      }
+      break;
+    }
+
+    case PushPromise: {
+      // the block still has to pass the decoder to keep its
+      // table in step, then the pushed stream is refused
+      const std::string_view fragment = strip_padding(payload, flags);
+      if(fragment.size() < 4) {
+        throw std::runtime_error("HTTP/2 PUSH_PROMISE too short");
+      }
+
+      header_block_.assign(fragment.substr(4));
+      header_end_stream_ = false;
+      promised_stream_ = read_u32(fragment) & max_stream_id;
+      if(flags & EndHeaders) {
+        handle_header_block(id, false, reply);
+      } else {
+        header_stream_ = id;
+      }
+      break;
+    }
+
+    case RstStream: {
+      if(payload.size() != 4) {
+        throw std::runtime_error("HTTP/2 RST_STREAM of wrong size");
+      }
+
+      auto it = streams_.find(id);
+      if(it != streams_.end() && not it->second.ended && it->second.error.empty()) {
+        it->second.error = "HTTP/2 stream reset by the server, error code " + std::to_string(read_u32(payload));
+      }
+      break;
+    }
+
+    case Settings: {
+      if(id != 0 || (payload.size() % 6) != 0) {
+        throw std::runtime_error("Malformed HTTP/2 SETTINGS");
+      }
+      if(flags & Ack) {
+        break;
+      }
+
+      for(size_t i = 0; i < payload.size(); i += 6) {
+        const auto setting = static_cast<Http2Setting>(
+          static_cast<uint8_t>(payload[i]) << 8 | static_cast<uint8_t>(payload[i + 1]));
+        const uint32_t value = read_u32(payload.substr(i + 2));
+
+        switch(setting) {
+          case Http2Setting::HeaderTableSize:
+            peer_table_size_ = value;
+            break;
+          case Http2Setting::MaxConcurrentStreams:
+            peer_max_streams_ = value;
+            break;
+          case Http2Setting::InitialWindowSize: {
+            if(value > max_stream_id) {
+              throw std::runtime_error("HTTP/2 INITIAL_WINDOW_SIZE out of range");
+            }
+            // applies to the windows of open streams as well
+            const int64_t delta = static_cast<int64_t>(value) - peer_window_;
+            for(auto& [stream_id, s] : streams_) {
+              s.send_window += delta;
+            }
+            peer_window_ = value;
+            break;
+          }
+          case Http2Setting::MaxFrameSize:
+            if(value < 16384 || value > 16777215) {
+              throw std::runtime_error("HTTP/2 MAX_FRAME_SIZE out of range");
+            }
+            peer_max_frame_ = value;
+            break;
+          default:
+            break;
+        }
+      }
+      append_frame_header(reply, 0, Settings, Ack, 0);
+      break;
+    }
+
+    case Ping: {
+      if(id != 0 || payload.size() != 8) {
+        throw std::runtime_error("Malformed HTTP/2 PING");
+      }
+      if(not (flags & Ack)) {
+        append_frame_header(reply, 8, Ping, Ack, 0);
+        reply.append(payload);
+      }
+      break;
+    }
+
+    case Goaway: {
+      if(payload.size() < 8) {
+        throw std::runtime_error("HTTP/2 GOAWAY too short");
+      }
+
+      // streams past the last one the server took are safe to retry
+      const uint32_t last = read_u32(payload) & max_stream_id;
+      goaway_ = true;
+      for(auto& [stream_id, s] : streams_) {
+        if(stream_id > last && not s.ended && s.error.empty()) {
+          s.error = "HTTP/2 stream refused by GOAWAY";
+        }
+      }
+      break;
+    }
+
+    case WindowUpdate: {
+      if(payload.size() != 4) {
+        throw std::runtime_error("HTTP/2 WINDOW_UPDATE of wrong size");
+      }
+
+      const uint32_t increment = read_u32(payload) & max_stream_id;
+      if(id == 0) {
+        send_window_ += increment;
+      } else if(auto it = streams_.find(id); it != streams_.end()) {
+        it->second.send_window += increment;
+      }
+      break;
+    }
+
+    default:
+      // PRIORITY and unknown frame types are ignored
+      break;
+  }
+}
+
+//----------------------------------------
+// the first complete block of a stream, after any 1xx ones,
+// is the response head. a later one holds trailers, which are
+// dropped like HttpClient drops chunked trailers.
+//----------------------------------------
+void Http2Connection::handle_header_block(uint32_t id, bool end_stream, std::string& reply) {
+  std::vector<HpackField> fields = decoder_.decode(header_block_);
+  header_block_.clear();
+
+  if(promised_stream_ != 0) {
+    append_rst_stream(reply, promised_stream_, cancel_error);
+    promised_stream_ = 0;
+    return;
+  }
+
+  auto it = streams_.find(id);
+  if(it == streams_.end()) {
+    return;
+  }
+
+  Stream& s = it->second;
+  if(not s.head_done) {
+    int status = 0;
+    for(const auto& field : fields) {
+      if(field.name == ":status") {
+        std::from_chars(field.value.data(), field.value.data() + field.value.size(), status);
+      }
+    }
+    if(status < 100 || status > 999) {
+      s.error = "HTTP/2 response without a valid :status";
+      return;
+    }
+    if(status < 200) {
+      return;
+    }
+
+    s.head = HttpResponse(status);
+    s.head.status_message = HttpResponse::get_status_message(status);
+
+    for(auto& field : fields) {
+      if(field.name.starts_with(':')) {
+        continue;
+      }
+
+      if(field.name == "set-cookie") {
+        s.head.cookies.push_back(field.value);
+        s.head.headers.insert_or_assign(field.name, std::move(field.value));
+        continue;
+      }
+
+      auto [entry, inserted] = s.head.headers.try_emplace(field.name, field.value);
+      if(not inserted) {
+        entry->second.append(", ").append(field.value);
+      }
+    }
+    s.head_done = true;
+  }
+
+  if(end_stream) {
+    s.ended = true;
+  }
+}
+
+//----------------------------------------
+// bytes consumed from the flow control windows. they go back
+// to the server in batches of half a window.
+//----------------------------------------
+void Http2Connection::credit(uint32_t id, Stream* stream, size_t bytes, std::string& reply) {
+  if(bytes == 0) {
+    return;
+  }
+
+  connection_unacked_ += static_cast<uint32_t>(bytes);
+  if(connection_unacked_ >= connection_window_ / 2) {
+    append_window_update(reply, 0, connection_unacked_);
+    connection_unacked_ = 0;
+  }
+
+  if(stream && not stream->ended) {
+    stream->unacked += static_cast<uint32_t>(bytes);
+    if(stream->unacked >= local_window_ / 2) {
+      append_window_update(reply, id, stream->unacked);
+      stream->unacked = 0;
+    }
+  }
+}
+
+//----------------------------------------
+// marks the connection dead and fails the streams still
+// waiting for something. called with mutex_ held.
+//----------------------------------------
+void Http2Connection::fail(const std::string& reason) {
+  if(not failure_.empty()) {
+    return;
+  }
+
+  failure_ = "HTTP/2 connection failed: " + reason;
+  for(auto& [id, s] : streams_) {
+    if(not s.ended && s.error.empty()) {
+      s.error = failure_;
+    }
+  }
+  cv_.notify_all();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+Http2Connection::Stream& Http2Connection::stream(uint32_t id) {
+  auto it = streams_.find(id);
+  if(it == streams_.end()) {
+    throw std::invalid_argument("Unknown HTTP/2 stream " + std::to_string(id));
+  }
+  return it->second;
+}
+
+//----------------------------------------
+// queues frames for the next drive, waking a thread that is
+// driving already. called with mutex_ held.
+//----------------------------------------
+void Http2Connection::enqueue(std::string_view frames) {
+  if(frames.empty()) {
+    return;
+  }
+  outbox_.append(frames);
+  if(driving_) {
+    remote_->wake_io();
+  }
+}
+
+}
@@ -1,4 +1,8 @@
 #include <HttpClient.hpp>
+#include <HttpParser.hpp>
+#include <Http2.hpp>
+#include <Compression.hpp>
+#include <Metrics.hpp>
 #include "Helpers.hpp"
 
 #include <sstream>
@@ -9,6 +13,22 @@
 #include <random>
 #include <chrono>
 #include <fstream>
+#include <list>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <mutex>
+#include <charconv>
+#include <array>
+#include <span>
+#include <system_error>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace cpppwn {
 
@@ -27,6 +47,7 @@ struct BrowserProfile {
   std::string sec_ch_ua_mobile;
   std::string sec_ch_ua_platform;
   bool send_sec_fetch;
+  Http2Profile http2;
 };
   
 //----------------------------------------
@@ -61,7 +82,19 @@ BrowserProfile get_chrome_profile() {
     .sec_ch_ua = "\"Not_A Brand\";v=\"8\", \"Chromium\";v=\"120\", \"Google Chrome\";v=\"120\"",
     .sec_ch_ua_mobile = "?0",
     .sec_ch_ua_platform = "\"Windows\"",
-    .send_sec_fetch = true
+    .send_sec_fetch = true,
+    .http2 = {
+      .settings = {
+        {Http2Setting::HeaderTableSize, 65536},
+        {Http2Setting::EnablePush, 0},
+        {Http2Setting::InitialWindowSize, 6291456},
+        {Http2Setting::MaxHeaderListSize, 262144}
+      },
+      .window_update = 15663105,
+      .priority_frames = {},
+      .headers_priority = Http2Priority{.depends_on = 0, .weight = 256, .exclusive = true},
+      .pseudo_header_order = "masp"
+    }
   };
 }
   
@@ -96,7 +129,26 @@ BrowserProfile get_firefox_profile() {
      .sec_ch_ua = "",
      .sec_ch_ua_mobile = "",
      .sec_ch_ua_platform = "",
-     .send_sec_fetch = false
+     .send_sec_fetch = false,
+     .http2 = {
+       .settings = {
+         {Http2Setting::HeaderTableSize, 65536},
+         {Http2Setting::InitialWindowSize, 131072},
+         {Http2Setting::MaxFrameSize, 16384}
+       },
+       .window_update = 12517377,
+       // the dependency tree Firefox sets up on idle streams
+       .priority_frames = {
+         {.stream = 3, .depends_on = 0, .weight = 201},
+         {.stream = 5, .depends_on = 0, .weight = 101},
+         {.stream = 7, .depends_on = 0, .weight = 1},
+         {.stream = 9, .depends_on = 7, .weight = 1},
+         {.stream = 11, .depends_on = 3, .weight = 1},
+         {.stream = 13, .depends_on = 0, .weight = 241}
+       },
+       .headers_priority = Http2Priority{.depends_on = 13, .weight = 42},
+       .pseudo_header_order = "mpas"
+     }
   };
 }
   
@@ -131,7 +183,18 @@ BrowserProfile get_safari_profile() {
     .sec_ch_ua = "",
     .sec_ch_ua_mobile = "",
     .sec_ch_ua_platform = "",
-    .send_sec_fetch = false
+    .send_sec_fetch = false,
+    .http2 = {
+      .settings = {
+        {Http2Setting::EnablePush, 0},
+        {Http2Setting::InitialWindowSize, 4194304},
+        {Http2Setting::MaxConcurrentStreams, 100}
+      },
+      .window_update = 10485760,
+      .priority_frames = {},
+      .headers_priority = Http2Priority{.depends_on = 0, .weight = 255},
+      .pseudo_header_order = "mspa"
+    }
   };
 }
   
@@ -169,7 +232,19 @@ BrowserProfile get_edge_profile() {
     .sec_ch_ua = "\"Not_A Brand\";v=\"8\", \"Chromium\";v=\"120\", \"Microsoft Edge\";v=\"120\"",
     .sec_ch_ua_mobile = "?0",
     .sec_ch_ua_platform = "\"Windows\"",
-    .send_sec_fetch = true
+    .send_sec_fetch = true,
+    .http2 = {
+      .settings = {
+        {Http2Setting::HeaderTableSize, 65536},
+        {Http2Setting::EnablePush, 0},
+        {Http2Setting::InitialWindowSize, 6291456},
+        {Http2Setting::MaxHeaderListSize, 262144}
+      },
+      .window_update = 15663105,
+      .priority_frames = {},
+      .headers_priority = Http2Priority{.depends_on = 0, .weight = 256, .exclusive = true},
+      .pseudo_header_order = "masp"
+    }
   };
 }
   
@@ -186,6 +261,84 @@ BrowserProfile get_profile_for_type(BrowserType type) {
   }
 }
 
+//----------------------------------------
+// builds the TLS context matching a browser fingerprint
+//----------------------------------------
+std::shared_ptr<asio::ssl::context> make_tls_context(const BrowserProfile& profile, bool verify_ssl, bool http2) {
+  auto ssl_ctx = std::make_shared<asio::ssl::context>(asio::ssl::context::tls_client);
+        
+  // Set TLS version to match browser (TLS 1.2 or 1.3)
+  SSL_CTX_set_min_proto_version(ssl_ctx->native_handle(), TLS1_2_VERSION);
+  SSL_CTX_set_max_proto_version(ssl_ctx->native_handle(), TLS1_3_VERSION);
+        
+  // Set cipher suites to match browser fingerprint
+  if(not profile.tls_cipher_suites.empty()) {
+    std::ostringstream cipher_string;
+
+    for(size_t i = 0; i < profile.tls_cipher_suites.size(); ++i) {
+      if(i > 0) cipher_string << ":";
+      cipher_string << profile.tls_cipher_suites[i];
+    }
+    SSL_CTX_set_cipher_list(ssl_ctx->native_handle(), cipher_string.str().c_str());
+  }
+        
+  // Set supported curves to match browser
+  if(not profile.tls_curves.empty()) {
+    std::ostringstream curves_string;
+
+    for (size_t i = 0; i < profile.tls_curves.size(); ++i) {
+      if (i > 0) curves_string << ":";
+        curves_string << profile.tls_curves[i];
+    }
+
+    SSL_CTX_set1_groups_list(ssl_ctx->native_handle(), curves_string.str().c_str());
+  }
+        
+  // Enable ALPN (Application-Layer Protocol Negotiation) like browsers
+  if(http2) {
+    const unsigned char alpn[] = "\x02h2\x08http/1.1";
+    SSL_CTX_set_alpn_protos(ssl_ctx->native_handle(), alpn, sizeof(alpn) - 1);
+  } else {
+    const unsigned char alpn[] = "\x08http/1.1";
+    SSL_CTX_set_alpn_protos(ssl_ctx->native_handle(), alpn, sizeof(alpn) - 1);
+  }
+
+  // Only advertise session tickets if the browser does, resumption
+  // falls back to session ids and TLS 1.3 PSKs otherwise
+  if(std::find(profile.tls_extensions.begin(), profile.tls_extensions.end(), "session_ticket")
+      == profile.tls_extensions.end()) {
+    SSL_CTX_set_options(ssl_ctx->native_handle(), SSL_OP_NO_TICKET);
+  }
+
+  Remote::enable_session_resumption(*ssl_ctx);
+        
+  // Set certificate verification
+  if(verify_ssl) {
+    ssl_ctx->set_default_verify_paths();
+    ssl_ctx->set_verify_mode(asio::ssl::verify_peer);
+  } else {
+    ssl_ctx->set_verify_mode(asio::ssl::verify_none);
+  }
+
+  return ssl_ctx;
+}
+
+//----------------------------------------
+// one context per fingerprint profile, built on first use and
+// shared by every client in the process
+//----------------------------------------
+std::shared_ptr<asio::ssl::context> shared_tls_context(BrowserType type, bool verify_ssl, bool http2) {
+  static std::mutex mutex;
+  static std::map<std::tuple<BrowserType, bool, bool>, std::shared_ptr<asio::ssl::context>> contexts;
+
+  std::lock_guard lock(mutex);
+  auto& ssl_ctx = contexts[{type, verify_ssl, http2}];
+  if(not ssl_ctx) {
+    ssl_ctx = make_tls_context(get_profile_for_type(type), verify_ssl, http2);
+  }
+  return ssl_ctx;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -223,122 +376,898 @@ ParsedUrl parse_url(const std::string& url) {
   return result;
 }
   
+//----------------------------------------
+// status line and headers of a complete head. Set-Cookie fields
+// go to cookies as well, the headers map could only keep one.
+//----------------------------------------
+HttpResponse parse_response(std::string_view data, int& version_minor) {
+  HttpParser parser;
+  HttpHead head;
+  if(parser.parse_response(data, head) != ParseResult::Complete) {
+    throw std::runtime_error("Malformed response head");
+  }
+
+  HttpResponse response(head.status);
+  response.status_message = head.reason;
+  version_minor = head.version_minor;
+
+  for(const auto& field : head.fields()) {
+    if(iequals(field.name, "set-cookie")) {
+      response.cookies.emplace_back(field.value);
+      response.headers.insert_or_assign(std::string(field.name), std::string(field.value));
+      continue;
+    }
+
+    auto [it, inserted] = response.headers.try_emplace(std::string(field.name), field.value);
+    if(not inserted) {
+      // repeated fields fold into one list
+      it->second.append(", ").append(field.value);
+    }
+  }
+  return response;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
-HttpResponse parse_response(const std::string& response_data) {
-  HttpResponse response;
-  std::istringstream stream(response_data);
-      
-  // Parse status line
-  std::string http_version;
-  stream >> http_version >> response.status_code;
-  std::getline(stream, response.status_message);
-      
-  // Trim status message
-  response.status_message.erase(0, response.status_message.find_first_not_of(" \t"));
-  response.status_message.erase(response.status_message.find_last_not_of("\r\n") + 1);
-      
-  // Parse headers
-  std::string line;
-  while(std::getline(stream, line) && line != "\r") {
-    if(line.back() == '\r') line.pop_back();
-    if(line.empty()) break;
-          
-    size_t colon = line.find(':');
-    if(colon != std::string::npos) {
-      std::string key = line.substr(0, colon);
-      std::string value = line.substr(colon + 1);
-              
-      // Trim whitespace
-      value.erase(0, value.find_first_not_of(" \t"));
-      value.erase(value.find_last_not_of(" \t\r\n") + 1);
-              
-      // Convert header name to lowercase
-      std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-      response.headers[key] = value;
+bool is_redirect(int status) {
+  return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+//----------------------------------------
+// methods that may be sent again without the server acting on
+// them twice (RFC 9110 9.2.2)
+//----------------------------------------
+bool is_idempotent(const std::string& method) {
+  return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE"
+    || method == "PUT" || method == "DELETE";
+}
+
+//----------------------------------------
+// a Location value as an absolute URL, relative to base
+//----------------------------------------
+std::string resolve_location(const ParsedUrl& base, const std::string& location) {
+  if(location.empty() || location[0] != '/') {
+    return location;
+  }
+  return base.scheme + "://" + base.host + (base.port != 0 ? ":" + std::to_string(base.port) : "") + location;
+}
+
+//----------------------------------------
+// nullopt without a valid Content-Length
+//----------------------------------------
+std::optional<uint64_t> content_length(const HttpResponse& response) {
+  const std::string value = response.get_header("content-length");
+  uint64_t length = 0;
+  const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+  if(value.empty() || ec != std::errc() || ptr != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  return length;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+struct ContentRange {
+  uint64_t first = 0;
+  uint64_t total = 0;   // 0 for "*"
+};
+
+//----------------------------------------
+// "bytes first-last/total" or "bytes */total"
+//----------------------------------------
+std::optional<ContentRange> content_range(const HttpResponse& response) {
+  const std::string header = response.get_header("content-range");
+  std::string_view value = header;
+  if(not value.starts_with("bytes ")) return std::nullopt;
+  value.remove_prefix(6);
+
+  const size_t slash = value.find('/');
+  if(slash == std::string_view::npos) return std::nullopt;
+
+  ContentRange range;
+  const std::string_view total = value.substr(slash + 1);
+  if(total != "*") {
+    const auto [ptr, ec] = std::from_chars(total.data(), total.data() + total.size(), range.total);
+    if(ec != std::errc()) return std::nullopt;
+  }
+
+  const std::string_view span = value.substr(0, slash);
+  if(span != "*") {
+    const auto [ptr, ec] = std::from_chars(span.data(), span.data() + span.size(), range.first);
+    if(ec != std::errc() || ptr == span.data() + span.size() || *ptr != '-') return std::nullopt;
+  }
+  return range;
+}
+
+//----------------------------------------
+// all of data at offset of fd
+//----------------------------------------
+void write_at(int fd, std::string_view data, uint64_t offset) {
+  while(not data.empty()) {
+    const ssize_t written = ::pwrite(fd, data.data(), data.size(), static_cast<off_t>(offset));
+    if(written < 0 && errno == EINTR) continue;
+    if(written < 0) {
+      throw std::system_error(errno, std::system_category(), "pwrite() failed");
     }
+    data.remove_prefix(static_cast<size_t>(written));
+    offset += static_cast<uint64_t>(written);
   }
-      
-  // Get body (rest of the stream)
-  std::ostringstream body_stream;
-  body_stream << stream.rdbuf();
-  response.body = body_stream.str();
-      
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+struct OutputFile {
+  int fd = -1;
+
+  ~OutputFile() {
+    if(fd >= 0) ::close(fd);
+  }
+};
+
+//----------------------------------------
+// counts downloaded bytes across segments and reports them
+// through the callback, one call at a time
+//----------------------------------------
+class DownloadProgress {
+  public:
+    explicit DownloadProgress(const std::function<void(uint64_t, uint64_t)>& callback) : callback_(callback) {
+    }
+
+    void start(uint64_t received, uint64_t total) {
+      std::lock_guard lock(mutex_);
+      received_ = received;
+      total_ = total;
+      if(callback_) callback_(received_, total_);
+    }
+
+    void add(uint64_t bytes) {
+      std::lock_guard lock(mutex_);
+      received_ += bytes;
+      if(callback_) callback_(received_, total_);
+    }
+
+  private:
+    const std::function<void(uint64_t, uint64_t)>& callback_;
+    std::mutex mutex_;
+    uint64_t received_ = 0;
+    uint64_t total_ = 0;
+};
+
+//----------------------------------------
+// Idle keep-alive connections, keyed by scheme, host, port and proxy
+//----------------------------------------
+class ConnectionPool {
+  public:
+    //----------------------------------------
+    // hands out the most recently used live connection for key
+    //----------------------------------------
+    std::unique_ptr<Remote> acquire(const std::string& key, std::chrono::seconds idle_timeout) {
+      std::lock_guard lock(mutex_);
+      const auto expired = std::chrono::steady_clock::now() - idle_timeout;
+
+      while(not idle_.empty() && idle_.front().since < expired) {
+        idle_.pop_front();
+      }
+
+      for(auto it = idle_.end(); it != idle_.begin();) {
+        --it;
+        if(it->key != key) continue;
+
+        std::unique_ptr<Remote> remote = std::move(it->remote);
+        it = idle_.erase(it);
+
+        if(is_usable(*remote)) {
+          return remote;
+        }
+      }
+      return nullptr;
+    }
+
+    //----------------------------------------
+    // keeps remote around, dropping the oldest past max_idle
+    //----------------------------------------
+    void release(const std::string& key, std::unique_ptr<Remote> remote, size_t max_idle) {
+      std::lock_guard lock(mutex_);
+      idle_.push_back({key, std::move(remote), std::chrono::steady_clock::now()});
+
+      while(idle_.size() > max_idle) {
+        idle_.pop_front();
+      }
+    }
+
+    //----------------------------------------
+    // the HTTP/2 connection requests to key share, if there is a
+    // usable one. while another request is connecting to key this
+    // waits for it, the new connection may well speak h2. if not,
+    // claimed tells the caller to connect and report back through
+    // settle(). origins known to pick HTTP/1.1 are not waited for.
+    //----------------------------------------
+    std::shared_ptr<Http2Connection> acquire_shared(const std::string& key, std::chrono::seconds idle_timeout,
+                                                    bool& claimed) {
+      std::unique_lock lock(mutex_);
+      claimed = false;
+
+      while(true) {
+        const auto now = std::chrono::steady_clock::now();
+        if(auto it = shared_.find(key); it != shared_.end()) {
+          SharedConnection& entry = it->second;
+          const bool expired = entry.since < now - idle_timeout && entry.connection->open_streams() == 0;
+          if(not expired && entry.connection->is_usable()) {
+            entry.since = now;
+            return entry.connection;
+          }
+          shared_.erase(it);
+        }
+
+        if(http1_.contains(key)) {
+          return nullptr;
+        }
+        if(connecting_.insert(key).second) {
+          claimed = true;
+          return nullptr;
+        }
+        connected_.wait(lock);
+      }
+    }
+
+    //----------------------------------------
+    // what a fresh connection to key turned out to be: connection
+    // if it speaks h2, http1 if it does not, neither if connecting
+    // failed. claimed ends the caller's claim on key.
+    //----------------------------------------
+    void settle(const std::string& key, bool claimed, std::shared_ptr<Http2Connection> connection, bool http1) {
+      {
+        std::lock_guard lock(mutex_);
+        if(claimed) {
+          connecting_.erase(key);
+        }
+
+        if(connection) {
+          http1_.erase(key);
+          shared_.insert_or_assign(key, SharedConnection{std::move(connection), std::chrono::steady_clock::now()});
+        } else if(http1) {
+          if(http1_.size() >= max_http1_origins) {
+            http1_.clear();
+          }
+          http1_.insert(key);
+        }
+      }
+      connected_.notify_all();
+    }
+
+    //----------------------------------------
+    // stops handing out an HTTP/2 connection a request failed on,
+    // unless key already moved on to another one
+    //----------------------------------------
+    void discard(const std::string& key, const std::shared_ptr<Http2Connection>& connection) {
+      std::lock_guard lock(mutex_);
+      if(auto it = shared_.find(key); it != shared_.end() && it->second.connection == connection) {
+        shared_.erase(it);
+      }
+    }
+
+    //----------------------------------------
+    // streams still running keep their HTTP/2 connection alive
+    //----------------------------------------
+    void clear() {
+      std::lock_guard lock(mutex_);
+      idle_.clear();
+      shared_.clear();
+    }
+
+  private:
+    struct IdleConnection {
+      std::string key;
+      std::unique_ptr<Remote> remote;
+      std::chrono::steady_clock::time_point since;
+    };
+
+    struct SharedConnection {
+      std::shared_ptr<Http2Connection> connection;
+      std::chrono::steady_clock::time_point since;   // last handed out
+    };
+
+    static constexpr size_t max_http1_origins = 4096;
+
+    //----------------------------------------
+    // an idle connection has nothing to say. if it is readable
+    // the server closed it, reset it or sent garbage.
+    //----------------------------------------
+    static bool is_usable(Remote& remote) {
+      if(not remote.is_alive()) return false;
+
+      pollfd pfd{remote.getInputStream(), POLLIN, 0};
+      return ::poll(&pfd, 1, 0) == 0;
+    }
+
+    std::mutex mutex_;
+    std::list<IdleConnection> idle_; // oldest first
+    std::unordered_map<std::string, SharedConnection> shared_;
+    std::unordered_set<std::string> connecting_;
+    std::unordered_set<std::string> http1_;
+    std::condition_variable connected_;
+};
+
+//----------------------------------------
+// hands the next length bytes of the body to sink as they
+// arrive, through a buffer of bounded size
+//----------------------------------------
+template <typename Sink>
+void read_body_bytes(Remote& remote, size_t length, Sink& sink) {
+  std::array<char, 16 << 10> block;
+  while(length > 0) {
+    const size_t count = remote.recv_into(std::span(block.data(), std::min(length, block.size())));
+    if(count == 0) {
+      throw std::runtime_error("Connection closed in the middle of the body");
+    }
+    sink(std::string_view(block.data(), count));
+    length -= count;
+  }
+}
+
+//----------------------------------------
+// for bodies delimited by the server closing the connection
+//----------------------------------------
+template <typename Sink>
+void read_body_to_eof(Remote& remote, Sink& sink) {
+  std::array<char, 16 << 10> block;
+  while(true) {
+    size_t count = 0;
+    try {
+      count = remote.recv_into(block);
+    } catch (const asio::system_error& e) {
+      // recvall() takes a reset as the end as well
+      if(e.code() != asio::error::connection_reset) throw;
+    }
+    if(count == 0) {
+      return;
+    }
+    sink(std::string_view(block.data(), count));
+  }
+}
+
+//----------------------------------------
+// removes the chunked framing, consuming the trailer section
+//----------------------------------------
+template <typename Sink>
+void read_chunked_body(Remote& remote, Sink& sink) {
+  while(true) {
+    std::string size_line = remote.recvuntil("\r\n");
+    size_line.resize(size_line.size() - 2);
+
+    // chunk extensions follow a ';' and are ignored
+    const size_t ext = size_line.find(';');
+    if(ext != std::string::npos) size_line.resize(ext);
+
+    size_t chunk_size = 0;
+    const auto* first = size_line.data();
+    const auto* last = first + size_line.size();
+    while(first != last && (*first == ' ' || *first == '\t')) ++first;
+    while(last != first && (last[-1] == ' ' || last[-1] == '\t')) --last;
+
+    const auto [ptr, ec] = std::from_chars(first, last, chunk_size, 16);
+    if(ec != std::errc() || ptr != last) {
+      throw std::runtime_error("Invalid chunk size: " + size_line);
+    }
+
+    if(chunk_size == 0) {
+      break;
+    }
+
+    read_body_bytes(remote, chunk_size, sink);
+
+    if(remote.recvuntil("\r\n") != "\r\n") {
+      throw std::runtime_error("Malformed chunked encoding");
+    }
+  }
+
+  // trailer fields end with an empty line
+  while(remote.recvuntil("\r\n") != "\r\n") {
+  }
+}
+
+//----------------------------------------
+// a decoder for the response's Content-Encoding, or nullopt if
+// the body is to be kept as sent: no coding, several stacked,
+// or one this build can't decode. decoding more than max_output
+// bytes throws std::length_error.
+//----------------------------------------
+std::optional<Decompressor> body_decoder(const HttpResponse& response, uint64_t max_output) {
+  const std::string encoding = response.get_header("content-encoding");
+  if(encoding.empty() || encoding.find(',') != std::string::npos || response.status_code == 206) {
+    return std::nullopt;
+  }
+
+  const auto coding = parse_content_coding(encoding);
+  if(not coding || *coding == ContentCoding::Identity || not content_coding_supported(*coding)) {
+    return std::nullopt;
+  }
+  return std::optional<Decompressor>(std::in_place, *coding, max_output);
+}
+
+//----------------------------------------
+// where request() puts the body of a response accept() takes,
+// instead of response.body
+//----------------------------------------
+struct ResponseSink {
+  std::function<bool(const HttpResponse&)> accept;
+  std::function<void(std::string_view)> write;
+};
+
+//----------------------------------------
+// where the body of a response goes as it arrives: through the
+// decoder of its Content-Encoding if decode is set, then to the
+// target if it accepts the response, into response.body otherwise
+//----------------------------------------
+class BodyDestination {
+  public:
+    BodyDestination(HttpResponse& response, bool decode, uint64_t max_decoded, const ResponseSink* target)
+      : response_(response),
+        decoder_(decode ? body_decoder(response, max_decoded) : std::nullopt),
+        to_target_(target && target->accept(response)),
+        target_(target) {
+    }
+
+    //----------------------------------------
+    // false while pieces go into response.body unchanged
+    //----------------------------------------
+    [[nodiscard]] bool transforms() const noexcept {
+      return decoder_ || to_target_;
+    }
+
+    void operator()(std::string_view piece) {
+      if(to_target_ && decoder_) {
+        decoded_.clear();
+        decoder_->feed(piece, decoded_);
+        target_->write(decoded_);
+      } else if(to_target_) {
+        target_->write(piece);
+      } else if(decoder_) {
+        decoder_->feed(piece, response_.body);
+      } else {
+        response_.body.append(piece);
+      }
+    }
+
+    //----------------------------------------
+    // a decoded body lost the coding and length it was sent with
+    //----------------------------------------
+    void finish() {
+      if(decoder_) {
+        decoder_->finish();
+        response_.headers.erase("content-encoding");
+        response_.headers.erase("content-length");
+      }
+    }
+
+  private:
+    HttpResponse& response_;
+    std::optional<Decompressor> decoder_;
+    bool to_target_;
+    const ResponseSink* target_;
+    std::string decoded_;
+};
+
+//----------------------------------------
+// reads one response off the connection and returns as soon as
+// the message is complete. interim 1xx responses are skipped, the
+// body is framed by Transfer-Encoding: chunked or Content-Length,
+// and only a response without either runs until the server closes.
+// chunked bodies are handed back decoded, and with decode set so
+// is a gzip, deflate or br Content-Encoding, piece by piece as the
+// body arrives. Content-Encoding and Content-Length are dropped then.
+// a body target accepts is passed to it and left out of the response.
+//----------------------------------------
+HttpResponse read_response(Remote& remote, const std::string& method, bool& reusable, bool decode,
+                           uint64_t max_decoded, const ResponseSink* target = nullptr) {
+  int version_minor = 1;
+  HttpResponse response = parse_response(remote.recvuntil_view("\r\n\r\n"), version_minor);
+
+  // 101 hands the connection over to another protocol
+  while(response.status_code >= 100 && response.status_code < 200 && response.status_code != 101) {
+    response = parse_response(remote.recvuntil_view("\r\n\r\n"), version_minor);
+  }
+
+  std::string connection = response.get_header("connection");
+  std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+  const bool keep_alive = version_minor >= 1 ? connection.find("close") == std::string::npos
+                                             : connection.find("keep-alive") != std::string::npos;
+
+  reusable = false;
+
+  if(method == "HEAD" || response.status_code == 101 || response.status_code == 204 || response.status_code == 304) {
+    reusable = keep_alive && response.status_code != 101;
+    return response;
+  }
+
+  BodyDestination sink(response, decode, max_decoded, target);
+
+  if(response.has_header("transfer-encoding")) {
+    std::string encoding = response.get_header("transfer-encoding");
+    std::transform(encoding.begin(), encoding.end(), encoding.begin(), ::tolower);
+
+    // chunked must be the final coding to delimit the message
+    const size_t last_coding = encoding.find_last_not_of(" \t");
+    if(last_coding != std::string::npos && encoding.substr(0, last_coding + 1).ends_with("chunked")) {
+      read_chunked_body(remote, sink);
+      sink.finish();
+      reusable = keep_alive;
+      return response;
+    }
+
+    read_body_to_eof(remote, sink);
+    sink.finish();
+    return response;
+  }
+
+  if(response.has_header("content-length")) {
+    const std::string value = response.get_header("content-length");
+    size_t length = 0;
+    const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+    if(ec != std::errc() || ptr != value.data() + value.size()) {
+      throw std::runtime_error("Invalid Content-Length: " + value);
+    }
+
+    if(sink.transforms()) {
+      read_body_bytes(remote, length, sink);
+      sink.finish();
+    } else if(length > 0) {
+      response.body = remote.recv(length);
+    }
+    reusable = keep_alive;
+    return response;
+  }
+
+  read_body_to_eof(remote, sink);
+  sink.finish();
+  return response;
+}
+
+//----------------------------------------
+// closes a stream however its exchange ends
+//----------------------------------------
+struct StreamGuard {
+  Http2Connection& connection;
+  uint32_t stream;
+
+  ~StreamGuard() {
+    connection.close_stream(stream);
+  }
+};
+
+//----------------------------------------
+// one request on a stream of connection. the body goes where
+// read_response would put it, HTTP/2 frames it by itself.
+//----------------------------------------
+HttpResponse exchange_h2(Http2Connection& connection, const std::string& method, std::vector<HpackField> fields,
+                         const std::string& body, bool decode, uint64_t max_decoded, const ResponseSink* target,
+                         RequestTiming& timing) {
+  const StreamGuard guard{connection, connection.send_request(std::move(fields), body)};
+
+  const auto sent = metrics_enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+  HttpResponse response = connection.read_head(guard.stream);
+  if constexpr(metrics_enabled) {
+    timing.first_byte = std::chrono::steady_clock::now() - sent;
+  }
+
+  if(method == "HEAD" || response.status_code == 204 || response.status_code == 304) {
+    return response;
+  }
+
+  BodyDestination sink(response, decode, max_decoded, target);
+  for(std::string piece = connection.read_body(guard.stream); not piece.empty();
+      piece = connection.read_body(guard.stream)) {
+    sink(piece);
+  }
+  sink.finish();
   return response;
 }
 
+//----------------------------------------
+// Worker pool behind request_batch. jobs wait in submission order
+// and start once a worker is free and their host is below the
+// per-host limit. all workers share the client's connection pool.
+// it is built with the client, so concurrent first batches don't
+// race to create it. workers only start with the first job.
+//----------------------------------------
+class BatchExecutor {
+  public:
+    using Completion = std::function<void(HttpResponse, std::exception_ptr)>;
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    explicit BatchExecutor(HttpClient& client) : client_(client) {
+    }
+
+    //----------------------------------------
+    // lets running requests finish and cancels the queued ones
+    //----------------------------------------
+    ~BatchExecutor() {
+      std::deque<Job> cancelled;
+      {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        cancelled.swap(queue_);
+      }
+      cv_.notify_all();
+
+      for(auto& worker : workers_) {
+        worker.join();
+      }
+
+      for(auto& job : cancelled) {
+        finish(job, HttpResponse(), std::make_exception_ptr(std::runtime_error("Batch request cancelled")));
+      }
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void submit(BatchRequest request, Completion complete) {
+      std::string host;
+      try {
+        const auto url = parse_url(request.url);
+        host = url.host + ":" + std::to_string(url.get_port());
+      } catch (const std::exception&) {
+        host = request.url; // request() reports the error
+      }
+
+      {
+        std::lock_guard lock(mutex_);
+        if(workers_.empty()) {
+          const size_t count = std::max<size_t>(1, client_.config().max_concurrent_requests);
+          for(size_t i = 0; i < count; ++i) {
+            workers_.emplace_back([this] { run(); });
+          }
+        }
+        queue_.push_back(Job{std::move(host), std::move(request), std::move(complete)});
+      }
+      cv_.notify_one();
+    }
+
+  private:
+    struct Job {
+      std::string host;
+      BatchRequest request;
+      Completion complete;
+    };
+
+    //----------------------------------------
+    // first queued job whose host has a free slot
+    //----------------------------------------
+    std::deque<Job>::iterator next_runnable() {
+      const size_t per_host = client_.config().max_requests_per_host;
+      if(per_host == 0) {
+        return queue_.begin();
+      }
+
+      return std::find_if(queue_.begin(), queue_.end(), [&](const Job& job) {
+        auto it = active_.find(job.host);
+        return it == active_.end() || it->second < per_host;
+      });
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void run() {
+      std::unique_lock lock(mutex_);
+
+      while(true) {
+        auto next = queue_.end();
+        cv_.wait(lock, [&] {
+          if(stopping_) return true;
+          next = next_runnable();
+          return next != queue_.end();
+        });
+
+        if(stopping_) {
+          return;
+        }
+
+        Job job = std::move(*next);
+        queue_.erase(next);
+        ++active_[job.host];
+        lock.unlock();
+
+        HttpResponse response;
+        std::exception_ptr error;
+        try {
+          const auto& r = job.request;
+          response = client_.request(r.method, r.url, r.headers, r.body);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        finish(job, std::move(response), error);
+
+        lock.lock();
+        if(--active_[job.host] == 0) {
+          active_.erase(job.host);
+        }
+        // a host slot opened up, queued jobs may be runnable now
+        cv_.notify_all();
+      }
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    static void finish(Job& job, HttpResponse response, std::exception_ptr error) noexcept {
+      try {
+        job.complete(std::move(response), error);
+      } catch (...) {
+        // a throwing callback must not take the worker down
+      }
+    }
+
+    HttpClient& client_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    std::unordered_map<std::string, size_t> active_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
 //----------------------------------------
 // Constructor
 //----------------------------------------
-HttpClient::HttpClient(const HttpConfig& config): config_(config), remote_(nullptr) {
+HttpClient::HttpClient(const HttpConfig& config)
+  : config_(config), pool_(std::make_shared<ConnectionPool>()), batch_(std::make_unique<BatchExecutor>(*this)) {
+}
+
+//----------------------------------------
+// Destructor
+//----------------------------------------
+HttpClient::~HttpClient() = default;
+
+//----------------------------------------
+// Open a fresh connection with TLS fingerprint emulation
+//----------------------------------------
+std::unique_ptr<Remote> HttpClient::connect(const ParsedUrl& url) const {
+  ConnectOptions options;
+  options.timeout = config_.connect_timeout;
+
+  // Create connection with TLS configuration
+  if(config_.proxy_url.empty()) {
+    // Direct connection
+    if (url.is_https()) {
+      // Shared, prebuilt SSL context for fingerprint emulation
+      auto ssl_ctx = shared_tls_context(config_.browser_type, config_.verify_ssl, config_.enable_http2);
+            
+      return std::make_unique<Remote>(
+        url.host, 
+        url.get_port(),
+        std::move(ssl_ctx),
+        options
+      );
+    } else {
+      return std::make_unique<Remote>(
+        url.host,
+        url.get_port(),
+        options
+      );
+    }
+  } else {
+    // Connection through proxy
+    return std::make_unique<Remote>(
+      url.host, url.get_port(),
+      config_.proxy_url, url.is_https(),
+      options
+    );
+  }
+}
+
+//----------------------------------------
+// Drop kept-alive connections
+//----------------------------------------
+void HttpClient::close_idle_connections() {
+  pool_->clear();
 }
 
 //----------------------------------------
-// Build HTTP request with browser-like headers
+// Run requests concurrently, one future per request
 //----------------------------------------
-std::string HttpClient::build_request(
+std::vector<std::future<HttpResponse>> HttpClient::request_batch(const std::vector<BatchRequest>& requests) {
+  std::vector<std::future<HttpResponse>> futures;
+  futures.reserve(requests.size());
+
+  for(const auto& request : requests) {
+    auto promise = std::make_shared<std::promise<HttpResponse>>();
+    futures.push_back(promise->get_future());
+
+    batch_->submit(request, [promise](HttpResponse response, std::exception_ptr error) {
+      if(error) {
+        promise->set_exception(error);
+      } else {
+        promise->set_value(std::move(response));
+      }
+    });
+  }
+
+  return futures;
+}
+
+//----------------------------------------
+// Run requests concurrently, report each through a callback
+//----------------------------------------
+void HttpClient::request_batch(const std::vector<BatchRequest>& requests, BatchCallback on_complete) {
+  auto callback = std::make_shared<BatchCallback>(std::move(on_complete));
+
+  for(size_t i = 0; i < requests.size(); ++i) {
+    batch_->submit(requests[i], [callback, i](HttpResponse response, std::exception_ptr error) {
+      (*callback)(i, std::move(response), error);
+    });
+  }
+}
+
+//----------------------------------------
+// Browser-like header fields of a request, in sending order
+//----------------------------------------
+std::vector<std::pair<std::string, std::string>> HttpClient::request_headers(
   const std::string& method,
   const ParsedUrl& url,
   const HttpHeaders& headers,
   const std::string& body) const {
     
-  std::ostringstream request;
+  std::vector<std::pair<std::string, std::string>> fields;
+  fields.reserve(16 + headers.size());
   const auto& profile = get_profile_for_type(config_.browser_type);
     
-  // Request line
-  request << method << " " << url.get_path_with_query() << " HTTP/1.1\r\n";
-    
   // Host header (required for HTTP/1.1)
-  request << "Host: " << url.host;
+  std::string host = url.host;
   if((url.is_https() && url.get_port()     != 443) 
   || (not url.is_https() && url.get_port() != 80)) {
-    request << ":" << url.get_port();
+    host += ":" + std::to_string(url.get_port());
   }
-  request << "\r\n";
+  fields.emplace_back("Host", std::move(host));
     
   // Connection header
   if(headers.find("connection") == headers.end() 
   && headers.find("Connection") == headers.end()) {
-    request << "Connection: keep-alive\r\n";
+    fields.emplace_back("Connection", "keep-alive");
   }
     
   // Browser-like headers in realistic order
   if(headers.find("cache-control") == headers.end()
   && headers.find("Cache-Control") == headers.end()) {
     if(method == "GET") {
-      request << "Cache-Control: max-age=0\r\n";
+      fields.emplace_back("Cache-Control", "max-age=0");
     }
   }
     
   // Sec-CH-UA headers (Chrome/Edge only)
   if(not profile.sec_ch_ua.empty() && config_.send_browser_headers) {
     if(headers.find("sec-ch-ua") == headers.end()) {
-      request << "sec-ch-ua: " << profile.sec_ch_ua << "\r\n";
+      fields.emplace_back("sec-ch-ua", profile.sec_ch_ua);
     }
         
     if(headers.find("sec-ch-ua-mobile") == headers.end()) {
-      request << "sec-ch-ua-mobile: " << profile.sec_ch_ua_mobile << "\r\n";
+      fields.emplace_back("sec-ch-ua-mobile", profile.sec_ch_ua_mobile);
     }
 
     if(headers.find("sec-ch-ua-platform") == headers.end()) {
-      request << "sec-ch-ua-platform: " << profile.sec_ch_ua_platform << "\r\n";
+      fields.emplace_back("sec-ch-ua-platform", profile.sec_ch_ua_platform);
     }
   }
     
   // Upgrade-Insecure-Requests
   if (config_.send_browser_headers && method == "GET"
   && headers.find("upgrade-insecure-requests") == headers.end()) {
-    request << "Upgrade-Insecure-Requests: 1\r\n";
+    fields.emplace_back("Upgrade-Insecure-Requests", "1");
   }
     
   // User-Agent
   if(headers.find("user-agent") == headers.end()
   && headers.find("User-Agent") == headers.end()) {
     if(config_.send_browser_headers) {
-      request << "User-Agent: " << profile.user_agent << "\r\n";
+      fields.emplace_back("User-Agent", profile.user_agent);
     } else {
-      request << "User-Agent: " << config_.user_agent << "\r\n";
+      fields.emplace_back("User-Agent", config_.user_agent);
     }
   }
     
@@ -346,19 +1275,19 @@ std::string HttpClient::build_request(
   if(headers.find("accept") == headers.end()
   && headers.find("Accept") == headers.end()) {
     if(config_.send_browser_headers) {
-      request << "Accept: " << profile.accept << "\r\n";
+      fields.emplace_back("Accept", profile.accept);
     } else {
-      request << "Accept: */*\r\n";
+      fields.emplace_back("Accept", "*/*");
     }
   }
     
   // Sec-Fetch headers (Chrome/Edge only)
   if(profile.send_sec_fetch && config_.send_browser_headers) {
     if(headers.find("sec-fetch-site") == headers.end()) {
-      request << "Sec-Fetch-Site: none\r\n";
-      request << "Sec-Fetch-Mode: navigate\r\n";
-      request << "Sec-Fetch-User: ?1\r\n";
-      request << "Sec-Fetch-Dest: document\r\n";
+      fields.emplace_back("Sec-Fetch-Site", "none");
+      fields.emplace_back("Sec-Fetch-Mode", "navigate");
+      fields.emplace_back("Sec-Fetch-User", "?1");
+      fields.emplace_back("Sec-Fetch-Dest", "document");
     }
   }
     
@@ -366,7 +1295,7 @@ std::string HttpClient::build_request(
   if(headers.find("accept-encoding") == headers.end()
   && headers.find("Accept-Encoding") == headers.end()) {
     if(config_.send_browser_headers) {
-      request << "Accept-Encoding: " << profile.accept_encoding << "\r\n";
+      fields.emplace_back("Accept-Encoding", profile.accept_encoding);
     }
   }
     
@@ -374,7 +1303,7 @@ std::string HttpClient::build_request(
   if(headers.find("accept-language") == headers.end()
   && headers.find("Accept-Language") == headers.end()) {
     if(config_.send_browser_headers) {
-      request << "Accept-Language: " << profile.accept_language << "\r\n";
+      fields.emplace_back("Accept-Language", profile.accept_language);
     }
   }
     
@@ -382,155 +1311,268 @@ std::string HttpClient::build_request(
   if(config_.send_browser_headers && not config_.referer.empty() &&
     headers.find("referer") == headers.end() &&
     headers.find("Referer") == headers.end()) {
-    request << "Referer: " << config_.referer << "\r\n";
+    fields.emplace_back("Referer", config_.referer);
   }
     
   // Content-Length for body
   if(not body.empty() && headers.find("content-length") == headers.end()
   && headers.find("Content-Length") == headers.end()) {
-    request << "Content-Length: " << body.size() << "\r\n";
+    fields.emplace_back("Content-Length", std::to_string(body.size()));
   }
     
   // Custom headers (maintain order and case sensitivity)
   for(const auto& [key, value] : headers) {
-    request << key << ": " << value << "\r\n";
+    fields.emplace_back(key, value);
   }
     
   // DNT (Do Not Track) - some browsers send this
   if(config_.send_browser_headers && config_.send_dnt &&
     headers.find("dnt") == headers.end() &&
     headers.find("DNT") == headers.end()) {
-    request << "DNT: 1\r\n";
+    fields.emplace_back("DNT", "1");
   }
     
-  // End of headers
-  request << "\r\n";
-    
-  if(not body.empty()) {
-    request << body;
+  return fields;
+}
+
+//----------------------------------------
+// an HTTP/1.1 request carrying fields in the order given
+//----------------------------------------
+std::string serialize_request(const std::string& method, const ParsedUrl& url,
+                              const std::vector<std::pair<std::string, std::string>>& fields,
+                              const std::string& body) {
+  std::string request;
+  request.reserve(512 + body.size());
+  request.append(method).append(" ").append(url.get_path_with_query()).append(" HTTP/1.1\r\n");
+  for(const auto& [name, value] : fields) {
+    request.append(name).append(": ").append(value).append("\r\n");
   }
-    
-  return request.str();
+  request.append("\r\n").append(body);
+  return request;
 }
 
 //----------------------------------------
-// Perform HTTP request with TLS fingerprinting
+// the same fields for an HTTP/2 stream. Host turns into
+// :authority, names are lowercased, and what only means
+// something on an HTTP/1.1 connection is left out.
 //----------------------------------------
-HttpResponse HttpClient::request(
+std::vector<HpackField> h2_fields(const std::string& method, const ParsedUrl& url,
+                                  const std::vector<std::pair<std::string, std::string>>& fields) {
+  std::vector<HpackField> result;
+  result.reserve(fields.size() + 4);
+  result.push_back({":method", method});
+  result.push_back({":authority", url.host});
+  result.push_back({":scheme", url.scheme});
+  result.push_back({":path", url.get_path_with_query()});
+
+  for(const auto& [name, value] : fields) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    if(lower == "host") {
+      result[1].value = value;
+      continue;
+    }
+    if(lower == "connection" || lower == "keep-alive" || lower == "proxy-connection"
+    || lower == "transfer-encoding" || lower == "upgrade" || (lower == "te" && not iequals(value, "trailers"))) {
+      continue;
+    }
+    result.push_back({std::move(lower), value});
+  }
+  return result;
+}
+
+
+//----------------------------------------
+// one request/response exchange, without following redirects.
+// a kept connection can be closed by the server at any moment,
+// so a failure on a reused one is retried once on a fresh
+// connection, unless part of the body already went to sink or
+// the method is not idempotent. the server may have acted on a
+// POST before the connection dropped.
+// a server that picks h2 gets a connection every request to its
+// origin shares, each one a stream of its own.
+//----------------------------------------
+HttpResponse HttpClient::perform(
   const std::string& method,
-  const std::string& url,
+  const ParsedUrl& parsed_url,
   const HttpHeaders& headers,
-  const std::string& body) {
+  const std::string& body,
+  const ResponseSink* sink) {
 
-  auto parsed_url = parse_url(url);
+  const auto started = metrics_enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+  RequestTiming timing;
 
-  const auto& profile = get_profile_for_type(config_.browser_type);
-    
-  // Create connection with TLS configuration
-  if(config_.proxy_url.empty()) {
-    // Direct connection
-    if (parsed_url.is_https()) {
-      // Create custom SSL context for fingerprint emulation
-      auto ssl_ctx = std::make_shared<asio::ssl::context>(asio::ssl::context::tls_client);
-            
-      // Set TLS version to match browser (TLS 1.2 or 1.3)
-      SSL_CTX_set_min_proto_version(ssl_ctx->native_handle(), TLS1_2_VERSION);
-      SSL_CTX_set_max_proto_version(ssl_ctx->native_handle(), TLS1_3_VERSION);
-            
-      // Set cipher suites to match browser fingerprint
-      if(not profile.tls_cipher_suites.empty()) {
-        std::ostringstream cipher_string;
+  const auto fields = request_headers(method, parsed_url, headers, body);
+  std::string request_str;
+
+  const std::string pool_key = parsed_url.scheme + "://" + parsed_url.host + ":" 
+    + std::to_string(parsed_url.get_port()) + "|" + config_.proxy_url;
+
+  // only direct TLS connections offer h2
+  const bool shareable = config_.reuse_connections && config_.enable_http2
+    && parsed_url.is_https() && config_.proxy_url.empty();
 
-        for(size_t i = 0; i < profile.tls_cipher_suites.size(); ++i) {
-          if(i > 0) cipher_string << ":";
-          cipher_string << profile.tls_cipher_suites[i];
+  std::unique_ptr<Remote> remote;
+  std::shared_ptr<Http2Connection> h2;
+
+  HttpResponse response;
+  bool reusable = false;
+
+  bool delivered = false;
+  ResponseSink counted;
+  if(sink) {
+    counted.accept = sink->accept;
+    counted.write = [&](std::string_view piece) {
+      delivered = true;
+      sink->write(piece);
+    };
+  }
+
+  for(int attempt = 0;; ++attempt) {
+    bool claimed = false;
+    if(shareable) {
+      h2 = pool_->acquire_shared(pool_key, config_.idle_timeout, claimed);
+    }
+    if(not h2 && not claimed && attempt == 0 && config_.reuse_connections) {
+      remote = pool_->acquire(pool_key, config_.idle_timeout);
+    }
+    const bool reused = remote || h2;
+
+    if(not reused) {
+      try {
+        remote = connect(parsed_url);
+        if(config_.enable_http2 && remote->alpn_protocol() == "h2") {
+          h2 = std::make_shared<Http2Connection>(std::move(remote), get_profile_for_type(config_.browser_type).http2);
         }
-        SSL_CTX_set_cipher_list(ssl_ctx->native_handle(), cipher_string.str().c_str());
+      } catch (...) {
+        if(claimed) {
+          pool_->settle(pool_key, true, nullptr, false);
+        }
+        throw;
       }
-            
-      // Set supported curves to match browser
-      if(not profile.tls_curves.empty()) {
-        std::ostringstream curves_string;
+      if(shareable) {
+        pool_->settle(pool_key, claimed, h2, h2 == nullptr);
+      }
+    }
+
+    if constexpr(metrics_enabled) {
+      const ConnectTiming connected = reused ? ConnectTiming{} : h2 ? h2->connect_timing() : remote->connect_timing();
+      timing.dns = connected.dns;
+      timing.connect = connected.connect;
+      timing.tls_handshake = connected.tls_handshake;
+      timing.reused_connection = reused;
+    }
+    
+    // Add random delay to mimic human behavior
+    if(config_.human_like_timing) {
+      std::random_device rd;
+      std::mt19937 gen(rd());
+      std::uniform_int_distribution<> dis(50, 300);
+      std::this_thread::sleep_for(std::chrono::milliseconds(dis(gen)));
+    }
 
-        for (size_t i = 0; i < profile.tls_curves.size(); ++i) {
-          if (i > 0) curves_string << ":";
-            curves_string << profile.tls_curves[i];
+    try {
+      if(h2) {
+        auto stream_fields = h2_fields(method, parsed_url, fields);
+        if(config_.verbose) {
+          std::cout << "=== Request (HTTP/2) ===\n";
+          for(const auto& field : stream_fields) {
+            std::cout << field.name << ": " << field.value << "\n";
+          }
+          std::cout << "\n" << body << "\n";
         }
 
-        SSL_CTX_set1_groups_list(ssl_ctx->native_handle(), curves_string.str().c_str());
+        response = exchange_h2(*h2, method, std::move(stream_fields), body, config_.decode_content,
+                               config_.max_decoded_size, sink ? &counted : nullptr, timing);
+        break;
       }
-            
-      // Enable ALPN (Application-Layer Protocol Negotiation) like browsers
-      const unsigned char alpn[] = "\x02h2\x08http/1.1";
-      SSL_CTX_set_alpn_protos(ssl_ctx->native_handle(), alpn, sizeof(alpn) - 1);
-            
-      // Set certificate verification
-      if(config_.verify_ssl) {
-        ssl_ctx->set_default_verify_paths();
-        ssl_ctx->set_verify_mode(asio::ssl::verify_peer);
-      } else {
-        ssl_ctx->set_verify_mode(asio::ssl::verify_none);
+
+      if(request_str.empty()) {
+        request_str = serialize_request(method, parsed_url, fields, body);
+      }
+      if(config_.verbose) {
+        std::cout << "=== Request ===\n" << request_str << "\n";
+      }
+
+      remote->send(request_str);
+      if constexpr(metrics_enabled) {
+        const auto sent = std::chrono::steady_clock::now();
+        (void)remote->peek(1);
+        timing.first_byte = std::chrono::steady_clock::now() - sent;
+      }
+      response = read_response(*remote, method, reusable, config_.decode_content, config_.max_decoded_size,
+                               sink ? &counted : nullptr);
+      break;
+    } catch (const std::length_error&) {
+      throw;   // an oversized body would be just as large again
+    } catch (const std::exception&) {
+      // the retry must not be handed the same connection again
+      if(h2 && shareable) {
+        pool_->discard(pool_key, h2);
+      }
+      remote.reset();
+      h2.reset();
+      if(attempt > 0 || not reused || delivered || not is_idempotent(method)) {
+        throw;
       }
-            
-      remote_ = std::make_unique<Remote>(
-        parsed_url.host, 
-        parsed_url.get_port(),
-        std::move(ssl_ctx)
-      );
-    } else {
-      remote_ = std::make_unique<Remote>(
-        parsed_url.host,
-        parsed_url.get_port()
-      );
     }
-  } else {
-    // Connection through proxy
-    remote_ = std::make_unique<Remote>(
-      parsed_url.host, parsed_url.get_port(),
-      config_.proxy_url, parsed_url.is_https()
-    );
   }
     
-  // Add random delay to mimic human behavior
-  if(config_.human_like_timing) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(50, 300);
-    std::this_thread::sleep_for(std::chrono::milliseconds(dis(gen)));
+  if constexpr(metrics_enabled) {
+    timing.total = std::chrono::steady_clock::now() - started;
+    response.timing = timing;
   }
-    
-  // Build and send request
-  std::string request_str = build_request(method, parsed_url, headers, body);
-    
+
   if(config_.verbose) {
-    std::cout << "=== Request ===\n" << request_str << "\n";
+    std::cout << "=== Response ===\n" << response.status_code << " " << response.status_message << "\n";
+    for(const auto& [name, value] : response.headers) {
+      std::cout << name << ": " << value << "\n";
+    }
+    std::cout << "\n" << response.body << "\n";
+
+    if constexpr(metrics_enabled) {
+      auto ms = [](std::chrono::nanoseconds d) { return std::chrono::duration<double, std::milli>(d).count(); };
+      std::cout << "=== Timing (ms) ===\n"
+                << "dns " << ms(timing.dns) << ", connect " << ms(timing.connect)
+                << ", tls " << ms(timing.tls_handshake) << ", first byte " << ms(timing.first_byte)
+                << ", total " << ms(timing.total) << (timing.reused_connection ? " (reused)" : "") << "\n";
+    }
   }
     
-  remote_->send(request_str);
-    
-  // Receive response (read until connection closes)
-  std::string response_data = remote_->recvall();
-    
-  if(config_.verbose) {
-    std::cout << "=== Response ===\n" << response_data << "\n";
+  // an h2 connection stays with the pool, or closes with its last stream
+  if(remote) {
+    if(reusable && config_.reuse_connections) {
+      pool_->release(pool_key, std::move(remote), config_.max_idle_connections);
+    } else {
+      remote->close();
+    }
   }
     
-  remote_->close();
-    
-  // Parse response
-  HttpResponse response = parse_response(response_data);
-    
   // Store cookies automatically if enabled
   if(config_.auto_store_cookies) {
     auto new_cookies = get_cookies(response);
+    std::lock_guard lock(cookie_mutex_);
     cookie_jar_.insert(new_cookies.begin(), new_cookies.end());
   }
+
+  return response;
+}
+
+//----------------------------------------
+// Perform HTTP request with TLS fingerprinting
+//----------------------------------------
+HttpResponse HttpClient::request(
+  const std::string& method,
+  const std::string& url,
+  const HttpHeaders& headers,
+  const std::string& body) {
+
+  auto parsed_url = parse_url(url);
+  HttpResponse response = perform(method, parsed_url, headers, body);
     
   // Handle redirects
-  if(config_.follow_redirects && 
-      (response.status_code == 301 || response.status_code == 302 ||
-       response.status_code == 303 || response.status_code == 307 ||
-       response.status_code == 308)) {
+  if(config_.follow_redirects && is_redirect(response.status_code)) {
         
     if(config_.redirect_count >= config_.max_redirects) {
       throw std::runtime_error(
@@ -546,26 +1588,51 @@ HttpResponse HttpClient::request(
         redirect_config.referer = url; // Set referer to current page
             
         HttpClient redirect_client(redirect_config);
-        redirect_client.cookie_jar_ = cookie_jar_; // Copy cookies
+        redirect_client.cookie_jar_ = cookies_snapshot(); // Copy cookies
+        redirect_client.pool_ = pool_;             // Share kept connections
             
         // For 303, always use GET
         std::string redirect_method = (response.status_code == 303) ? "GET" : method;
         std::string redirect_body = (response.status_code == 303) ? "" : body;
             
-        // Resolve relative URLs
-        std::string redirect_url = location_it->second;
-      if(redirect_url[0] == '/') {
-        redirect_url = parsed_url.scheme + "://" + parsed_url.host + 
-          (parsed_url.port != 0 ? ":" + std::to_string(parsed_url.port) : "") + redirect_url;
-      }
-            
-      return redirect_client.request(redirect_method, redirect_url, headers, redirect_body);
+      return redirect_client.request(redirect_method, resolve_location(parsed_url, location_it->second),
+                                     headers, redirect_body);
     }
   }
     
   return response;
 }
 
+//----------------------------------------
+// perform() that follows redirects itself, leaving url at the
+// location that answered. with a sink the body never lands in
+// a redirected client's response.
+//----------------------------------------
+HttpResponse HttpClient::fetch(
+  std::string& url,
+  const std::string& method,
+  const HttpHeaders& headers,
+  const ResponseSink* sink) {
+
+  for(size_t redirects = config_.redirect_count;; ++redirects) {
+    const ParsedUrl parsed_url = parse_url(url);
+    HttpResponse response = perform(method, parsed_url, headers, "", sink);
+
+    auto location_it = response.headers.find("location");
+    if(not config_.follow_redirects || not is_redirect(response.status_code)
+        || location_it == response.headers.end()) {
+      return response;
+    }
+
+    if(redirects >= config_.max_redirects) {
+      throw std::runtime_error(
+          "Too many redirects (max: " + std::to_string(config_.max_redirects) + ")"
+      );
+    }
+    url = resolve_location(parsed_url, location_it->second);
+  }
+}
+
 //----------------------------------------
 // GET request
 //----------------------------------------
@@ -664,27 +1731,181 @@ HttpResponse HttpClient::options(const std::string& url, const HttpHeaders& head
 // Download file
 //----------------------------------------
 bool HttpClient::download(const std::string& url, const std::string& output_path) {
+  return download(url, output_path, DownloadOptions{});
+}
+
+//----------------------------------------
+// a partial file is continued from where it stops, otherwise
+// the file is split across segments when the server allows it
+//----------------------------------------
+bool HttpClient::download(const std::string& url, const std::string& output_path,
+                          const DownloadOptions& options) {
   try {
-    auto response = get(url);
-        
-    if(response.status_code != 200) {
-      std::cerr << "Download failed: HTTP " << response.status_code << "\n";
+    const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.resume ? 0 : O_TRUNC);
+    const OutputFile file{::open(output_path.c_str(), flags, 0644)};
+    if(file.fd < 0) {
+      std::cerr << "Cannot open file for writing: " << output_path << "\n";
       return false;
     }
+
+    struct stat info{};
+    const uint64_t existing = options.resume && ::fstat(file.fd, &info) == 0
+      ? static_cast<uint64_t>(info.st_size) : 0;
+
+    if(options.segments > 1 && existing == 0) {
+      return download_segmented(url, file.fd, options);
+    }
+    return download_stream(url, file.fd, existing, options);
         
-    std::ofstream file(output_path, std::ios::binary);
-    if(not file) {
-      std::cerr << "Cannot open file for writing: " << output_path << "\n";
+  } catch (const std::exception& e) {
+    std::cerr << "Download error: " << e.what() << "\n";
+    return false;
+  }
+}
+
+//----------------------------------------
+// GETs url into fd, asking for the bytes past existing if there
+// are any. a server that ignores the Range sends the whole file,
+// which replaces what was there.
+//----------------------------------------
+bool HttpClient::download_stream(const std::string& url, int fd, uint64_t existing,
+                                 const DownloadOptions& options) {
+  HttpHeaders headers{{"Accept-Encoding", "identity"}};
+  if(existing > 0) {
+    headers["Range"] = "bytes=" + std::to_string(existing) + "-";
+  }
+
+  DownloadProgress progress(options.progress);
+  uint64_t offset = 0;
+  uint64_t expected = 0;    // final size, 0 while unknown
+
+  ResponseSink sink;
+  sink.accept = [&](const HttpResponse& response) {
+    if(response.status_code == 200) {
+      if(::ftruncate(fd, 0) < 0) {
+        throw std::system_error(errno, std::system_category(), "ftruncate() failed");
+      }
+      offset = 0;
+      expected = content_length(response).value_or(0);
+    } else if(response.status_code == 206) {
+      const auto range = content_range(response);
+      if(not range || range->first != existing) return false;
+      offset = existing;
+      expected = range->total;
+    } else {
       return false;
     }
-        
-    file.write(response.body.data(), response.body.size());
-    return file.good();
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Download error: " << e.what() << "\n";
-        return false;
+    progress.start(offset, expected);
+    return true;
+  };
+  sink.write = [&](std::string_view piece) {
+    write_at(fd, piece, offset);
+    offset += piece.size();
+    progress.add(piece.size());
+  };
+
+  std::string target = url;
+  const HttpResponse response = fetch(target, "GET", headers, &sink);
+
+  // a range starting at the end of the file means it was complete
+  if(response.status_code == 416 && existing > 0) {
+    const auto range = content_range(response);
+    if(range && range->total == existing) {
+      return true;
+    }
+  }
+
+  if(response.status_code != 200 && response.status_code != 206) {
+    std::cerr << "Download failed: HTTP " << response.status_code << "\n";
+    return false;
   }
+
+  if(expected != 0 && offset != expected) {
+    std::cerr << "Download failed: got " << offset << " of " << expected << " bytes\n";
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------
+// probes url with HEAD, preallocates the file and fetches its
+// ranges on parallel connections, each written at its offset.
+// falls back to one stream unless the server accepts ranges and
+// the file is large enough for two segments.
+//----------------------------------------
+bool HttpClient::download_segmented(const std::string& url, int fd, const DownloadOptions& options) {
+  const HttpHeaders headers{{"Accept-Encoding", "identity"}};
+
+  std::string target = url;
+  const HttpResponse probe = fetch(target, "HEAD", headers, nullptr);
+  const uint64_t size = content_length(probe).value_or(0);
+  const bool ranges = probe.status_code == 200 && iequals(probe.get_header("accept-ranges"), "bytes");
+
+  const uint64_t min_segment = std::max<uint64_t>(1, options.min_segment_size);
+  const uint64_t count = std::min<uint64_t>(options.segments, size / min_segment);
+  if(not ranges || count < 2) {
+    return download_stream(target, fd, 0, options);
+  }
+
+  // reserve the blocks up front, filesystems without fallocate just get the size
+  if(::posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0 && ::ftruncate(fd, static_cast<off_t>(size)) < 0) {
+    throw std::system_error(errno, std::system_category(), "ftruncate() failed");
+  }
+
+  DownloadProgress progress(options.progress);
+  progress.start(0, size);
+
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::vector<std::thread> workers;
+  workers.reserve(static_cast<size_t>(count));
+
+  const uint64_t step = size / count;
+  for(uint64_t i = 0; i < count; ++i) {
+    const uint64_t first = i * step;
+    const uint64_t last = i + 1 == count ? size - 1 : first + step - 1;
+
+    workers.emplace_back([&, first, last] {
+      try {
+        HttpHeaders segment_headers = headers;
+        segment_headers["Range"] = "bytes=" + std::to_string(first) + "-" + std::to_string(last);
+
+        uint64_t offset = first;
+        ResponseSink sink;
+        sink.accept = [&](const HttpResponse& response) {
+          const auto range = content_range(response);
+          return response.status_code == 206 && range && range->first == first;
+        };
+        sink.write = [&](std::string_view piece) {
+          if(piece.size() > last + 1 - offset) {
+            throw std::runtime_error("Server sent more than the requested range");
+          }
+          write_at(fd, piece, offset);
+          offset += piece.size();
+          progress.add(piece.size());
+        };
+
+        std::string segment_url = target;
+        const HttpResponse response = fetch(segment_url, "GET", segment_headers, &sink);
+        if(response.status_code != 206 || offset != last + 1) {
+          throw std::runtime_error("Range " + std::to_string(first) + "-" + std::to_string(last)
+            + " failed with HTTP " + std::to_string(response.status_code));
+        }
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+        if(not error) error = std::current_exception();
+      }
+    });
+  }
+
+  for(auto& worker : workers) {
+    worker.join();
+  }
+
+  if(error) {
+    std::rethrow_exception(error);
+  }
+  return true;
 }
 
 //----------------------------------------
@@ -693,26 +1914,24 @@ bool HttpClient::download(const std::string& url, const std::string& output_path
 std::map<std::string, std::string> HttpClient::get_cookies(const HttpResponse& response) {
   std::map<std::string, std::string> cookies;
     
-  // Look for Set-Cookie headers (there can be multiple)
-  for(const auto& [key, value] : response.headers) {
-    if(key == "set-cookie") {
-      // Parse cookie: name=value; other-attributes
-      size_t eq_pos = value.find('=');
-      size_t semi_pos = value.find(';');
-            
-      if(eq_pos != std::string::npos) {
-        std::string name = value.substr(0, eq_pos);
-        std::string val = value.substr(eq_pos + 1, 
-          semi_pos == std::string::npos ? std::string::npos : semi_pos - eq_pos - 1
-        );
-                
-        // Trim whitespace
-        name.erase(0, name.find_first_not_of(" \t"));
-        name.erase(name.find_last_not_of(" \t") + 1);
-        val.erase(0, val.find_first_not_of(" \t"));
-        val.erase(val.find_last_not_of(" \t") + 1);
-        cookies[name] = val;
-      }
+  // every Set-Cookie field was kept in cookies
+  for(const auto& value : response.cookies) {
+    // Parse cookie: name=value; other-attributes
+    size_t eq_pos = value.find('=');
+    size_t semi_pos = value.find(';');
+
+    if(eq_pos != std::string::npos) {
+      std::string name = value.substr(0, eq_pos);
+      std::string val = value.substr(eq_pos + 1, 
+        semi_pos == std::string::npos ? std::string::npos : semi_pos - eq_pos - 1
+      );
+
+      // Trim whitespace
+      name.erase(0, name.find_first_not_of(" \t"));
+      name.erase(name.find_last_not_of(" \t") + 1);
+      val.erase(0, val.find_first_not_of(" \t"));
+      val.erase(val.find_last_not_of(" \t") + 1);
+      cookies[name] = val;
     }
   }
     
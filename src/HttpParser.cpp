@@ -0,0 +1,203 @@
+#include <HttpParser.hpp>
+#include <HttpUtils.hpp>
+
+namespace cpppwn {
+namespace {
+
+//----------------------------------------
+// RFC 9110 token characters
+//----------------------------------------
+constexpr std::array<bool, 256> kTokenChars = [] {
+  std::array<bool, 256> table{};
+  for(int c = '0'; c <= '9'; ++c) table[c] = true;
+  for(int c = 'a'; c <= 'z'; ++c) table[c] = true;
+  for(int c = 'A'; c <= 'Z'; ++c) table[c] = true;
+  for(const char c : std::string_view("!#$%&'*+-.^_`|~")) table[static_cast<unsigned char>(c)] = true;
+  return table;
+}();
+
+//----------------------------------------
+//
+//----------------------------------------
+constexpr bool is_token(std::string_view text) noexcept {
+  if(text.empty()) return false;
+  for(const char c : text) {
+    if(not kTokenChars[static_cast<unsigned char>(c)]) return false;
+  }
+  return true;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+constexpr bool is_control(char c) noexcept {
+  return static_cast<unsigned char>(c) < 0x20 || c == 0x7f;
+}
+
+//----------------------------------------
+// the next line without its line ending. the head is complete,
+// so a '\n' is always ahead.
+//----------------------------------------
+std::string_view next_line(std::string_view buffer, size_t& pos) noexcept {
+  const size_t newline = buffer.find('\n', pos);
+  size_t end = newline;
+  if(end > pos && buffer[end - 1] == '\r') --end;
+
+  const std::string_view line = buffer.substr(pos, end - pos);
+  pos = newline + 1;
+  return line;
+}
+
+//----------------------------------------
+// "HTTP/1.x", giving x
+//----------------------------------------
+bool parse_version(std::string_view text, int& minor) noexcept {
+  if(text.size() != 8 || not text.starts_with("HTTP/1.") || text[7] < '0' || text[7] > '9') {
+    return false;
+  }
+  minor = text[7] - '0';
+  return true;
+}
+
+//----------------------------------------
+// header fields up to the empty line
+//----------------------------------------
+ParseResult parse_fields(std::string_view buffer, size_t pos, HttpHead& head) noexcept {
+  head.header_count = 0;
+
+  for(std::string_view line = next_line(buffer, pos); not line.empty(); line = next_line(buffer, pos)) {
+    // obsolete line folding is refused rather than unfolded
+    const size_t colon = line.find(':');
+    if(colon == std::string_view::npos || not is_token(line.substr(0, colon))) {
+      return ParseResult::Invalid;
+    }
+
+    std::string_view value = line.substr(colon + 1);
+    while(not value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while(not value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    for(const char c : value) {
+      if(is_control(c) && c != '\t') return ParseResult::Invalid;
+    }
+
+    if(head.header_count == HttpHead::max_headers) {
+      return ParseResult::Invalid;
+    }
+    head.headers[head.header_count++] = {line.substr(0, colon), value};
+  }
+  return ParseResult::Complete;
+}
+
+} // anonymous namespace
+
+//----------------------------------------
+//
+//----------------------------------------
+std::optional<std::string_view> HttpHead::header(std::string_view name) const noexcept {
+  for(const auto& field : fields()) {
+    if(iequals(field.name, name)) return field.value;
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------
+// offset just past the empty line ending the head, npos while
+// it hasn't arrived
+//----------------------------------------
+size_t HttpParser::find_end(std::string_view buffer) {
+  for(size_t pos = scanned_; ; ++pos) {
+    pos = buffer.find('\n', pos);
+    if(pos == std::string_view::npos) {
+      scanned_ = buffer.size();
+      return std::string_view::npos;
+    }
+
+    if(pos + 1 < buffer.size() && buffer[pos + 1] == '\n') return pos + 2;
+    if(pos + 2 < buffer.size() && buffer[pos + 1] == '\r' && buffer[pos + 2] == '\n') return pos + 3;
+
+    if(pos + 2 >= buffer.size()) {
+      // the terminator may still be on its way
+      scanned_ = pos;
+      return std::string_view::npos;
+    }
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+ParseResult HttpParser::parse_request(std::string_view buffer, HttpHead& head) {
+  const size_t end = find_end(buffer);
+  if(end == std::string_view::npos) {
+    return ParseResult::Incomplete;
+  }
+  scanned_ = 0;
+
+  buffer = buffer.substr(0, end);
+  size_t pos = 0;
+  const std::string_view line = next_line(buffer, pos);
+
+  const size_t first_space = line.find(' ');
+  const size_t second_space = line.find(' ', first_space + 1);
+  if(first_space == std::string_view::npos || second_space == std::string_view::npos) {
+    return ParseResult::Invalid;
+  }
+
+  head.method = line.substr(0, first_space);
+  head.target = line.substr(first_space + 1, second_space - first_space - 1);
+  if(not is_token(head.method) || head.target.empty()
+      || not parse_version(line.substr(second_space + 1), head.version_minor)) {
+    return ParseResult::Invalid;
+  }
+  for(const char c : head.target) {
+    if(is_control(c) || c == ' ') return ParseResult::Invalid;
+  }
+
+  const size_t question = head.target.find('?');
+  head.path = head.target.substr(0, question);
+  head.query = question == std::string_view::npos ? std::string_view{} : head.target.substr(question + 1);
+  head.status = 0;
+  head.reason = {};
+  head.size = end;
+
+  return parse_fields(buffer, pos, head);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+ParseResult HttpParser::parse_response(std::string_view buffer, HttpHead& head) {
+  const size_t end = find_end(buffer);
+  if(end == std::string_view::npos) {
+    return ParseResult::Incomplete;
+  }
+  scanned_ = 0;
+
+  buffer = buffer.substr(0, end);
+  size_t pos = 0;
+  const std::string_view line = next_line(buffer, pos);
+
+  // HTTP/1.x SP 3DIGIT [SP reason]
+  if(line.size() < 12 || not parse_version(line.substr(0, 8), head.version_minor) || line[8] != ' ') {
+    return ParseResult::Invalid;
+  }
+  int status = 0;
+  for(size_t i = 9; i < 12; ++i) {
+    if(line[i] < '0' || line[i] > '9') return ParseResult::Invalid;
+    status = status * 10 + (line[i] - '0');
+  }
+  if(line.size() > 12 && line[12] != ' ') {
+    return ParseResult::Invalid;
+  }
+
+  head.status = status;
+  head.reason = line.size() > 13 ? line.substr(13) : std::string_view{};
+  head.method = {};
+  head.target = {};
+  head.path = {};
+  head.query = {};
+  head.size = end;
+
+  return parse_fields(buffer, pos, head);
+}
+
+} // namespace cpppwn
@@ -1,32 +1,242 @@
 #include <HttpServer.hpp>
 #include <HttpUtils.hpp>
+#include <Compression.hpp>
 
 #include <sstream>
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <optional>
+#include <string_view>
 #include <iomanip>
 #include <regex>
 #include <fstream>
 #include <filesystem>
 #include <chrono>
 #include <ctime>
+#include <cctype>
+#include <fcntl.h>
 
 #include "Helpers.hpp"
 
 namespace cpppwn {
 
+namespace {
+  // set while a thread is running the server's event loop
+  thread_local bool tls_is_worker = false;
+
+  //----------------------------------------
+  // a per-thread buffer for response heads that keeps its
+  // capacity between responses. a plain function, a coroutine
+  // resumed on another thread has to get that thread's one.
+  //----------------------------------------
+  std::string& spare_head() {
+    thread_local std::string head;
+    return head;
+  }
+
+  //----------------------------------------
+  // head and body go out in one gather write, the body from
+  // where it already is. the writes are awaited, so a client
+  // that doesn't read holds no worker, and one that takes
+  // nothing for timeout is given up on. returns the bytes sent.
+  //----------------------------------------
+  asio::awaitable<uint64_t> send_response(Remote& client, const HttpResponse& response,
+                                          std::chrono::milliseconds timeout) {
+    std::string head = std::move(spare_head());
+    response.serialize_head(head);
+
+    const std::array<std::string_view, 2> parts{head, response.body};
+    co_await client.async_send_parts(std::span(parts.data(), response.body.empty() ? 1 : 2), timeout);
+
+    uint64_t sent = head.size() + response.body.size();
+    if(response.file) {
+      co_await client.async_send_file(*response.file->fd, response.file->offset, response.file->length, timeout);
+      sent += response.file->length;
+    }
+
+    spare_head() = std::move(head);
+    co_return sent;
+  }
+
+  //----------------------------------------
+  // answers with status and gives up on the connection, used
+  // when the rest of the request can't be trusted or isn't wanted
+  //----------------------------------------
+  asio::awaitable<uint64_t> reject(Remote& client, int status, std::chrono::milliseconds timeout) {
+    HttpResponse response(status);
+    response.set_header("Connection", "close").set_body(response.status_message);
+    co_return co_await send_response(client, response, timeout);
+  }
+
+  //----------------------------------------
+  // whether content_type, parameters aside, matches one of types.
+  // entries ending in '/' match the whole top-level type.
+  //----------------------------------------
+  bool mime_allowed(const std::vector<std::string>& types, std::string_view content_type) {
+    content_type = content_type.substr(0, content_type.find(';'));
+    while(not content_type.empty() && content_type.back() == ' ') content_type.remove_suffix(1);
+
+    return std::ranges::any_of(types, [content_type](const std::string& type) {
+      return type.ends_with('/') ? iequals(content_type.substr(0, type.size()), type) : iequals(content_type, type);
+    });
+  }
+
+  //----------------------------------------
+  // a Vary that already names Accept-Encoding means the handler
+  // negotiated the coding itself
+  //----------------------------------------
+  bool varies_by_encoding(const HttpResponse& response) {
+    const std::string vary = response.get_header("Vary");
+    return std::ranges::search(vary, std::string_view("accept-encoding"), [](char a, char b) {
+      return std::tolower(static_cast<unsigned char>(a)) == b;
+    }).begin() != vary.end();
+  }
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  void add_vary(HttpResponse& response) {
+    auto vary = response.headers.find("Vary");
+    if(vary == response.headers.end() || vary->second.empty()) {
+      response.set_header("Vary", "Accept-Encoding");
+    } else if(not varies_by_encoding(response)) {
+      vary->second.append(", Accept-Encoding");
+    }
+  }
+
+  //----------------------------------------
+  // the validator of an encoded representation, which must
+  // differ from the identity one: "tag" becomes "tag-br"
+  //----------------------------------------
+  std::string encoded_etag(const std::string& etag, ContentCoding coding) {
+    if(etag.size() < 2 || not etag.ends_with('"')) return etag;
+    std::string tagged = etag.substr(0, etag.size() - 1);
+    tagged.append("-").append(content_coding_name(coding)).append("\"");
+    return tagged;
+  }
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  struct ByteRange {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    bool satisfiable = true;
+  };
+
+  //----------------------------------------
+  // a single "bytes=" range of a size byte resource. nullopt for
+  // anything else, which is served as if no Range had been sent.
+  //----------------------------------------
+  std::optional<ByteRange> parse_byte_range(std::string_view header, uint64_t size) {
+    constexpr std::string_view unit = "bytes=";
+    if(not header.starts_with(unit) || header.find(',') != std::string_view::npos) {
+      return std::nullopt;
+    }
+    header.remove_prefix(unit.size());
+
+    const size_t dash = header.find('-');
+    if(dash == std::string_view::npos) return std::nullopt;
+
+    const auto number = [](std::string_view text, uint64_t& value) {
+      if(text.empty()) return false;
+      auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+      return ec == std::errc() && end == text.data() + text.size();
+    };
+
+    uint64_t first = 0;
+    uint64_t last = 0;
+    const std::string_view first_text = header.substr(0, dash);
+    const std::string_view last_text = header.substr(dash + 1);
+
+    if(first_text.empty()) {
+      // suffix range, the final last bytes
+      if(not number(last_text, last)) return std::nullopt;
+      if(last == 0 || size == 0) return ByteRange{0, 0, false};
+      last = std::min(last, size);
+      return ByteRange{size - last, last, true};
+    }
+
+    if(not number(first_text, first)) return std::nullopt;
+    if(last_text.empty()) {
+      last = size == 0 ? 0 : size - 1;
+    } else if(not number(last_text, last) || last < first) {
+      return std::nullopt;
+    }
+
+    if(first >= size) return ByteRange{0, 0, false};
+    last = std::min(last, size - 1);
+    return ByteRange{first, last - first + 1, true};
+  }
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  std::optional<std::time_t> parse_http_date(const std::string& text) {
+    std::tm tm{};
+    const char* end = strptime(text.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(not end || *end != '\0') return std::nullopt;
+    return timegm(&tm);
+  }
+
+  //----------------------------------------
+  // whether If-None-Match, or failing that If-Modified-Since,
+  // says the client's copy is current
+  //----------------------------------------
+  bool not_modified(const HttpRequest& request, const StaticFile& file, const std::string& etag) {
+    if(request.has_header("if-none-match")) {
+      const std::string header = request.get_header("if-none-match");
+      if(header == "*") return true;
+
+      // weak comparison, a W/ prefix doesn't matter here
+      std::string_view rest = header;
+      while(not rest.empty()) {
+        const size_t comma = rest.find(',');
+        std::string_view tag = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+        while(not tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+        while(not tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+        if(tag.starts_with("W/")) tag.remove_prefix(2);
+        if(tag == etag) return true;
+      }
+      return false;
+    }
+
+    if(request.has_header("if-modified-since")) {
+      const auto since = parse_http_date(request.get_header("if-modified-since"));
+      return since && file.modified.tv_sec <= *since;
+    }
+    return false;
+  }
+
+  //----------------------------------------
+  // a Range only applies while If-Range, if sent, still names
+  // this version of the file
+  //----------------------------------------
+  bool range_applies(const HttpRequest& request, const StaticFile& file) {
+    if(not request.has_header("if-range")) return true;
+    const std::string validator = request.get_header("if-range");
+    return validator.starts_with('"') ? validator == file.etag : validator == file.last_modified;
+  }
+}
+
 //----------------------------------------
 //
 //----------------------------------------
-HttpServer::HttpServer(uint16_t port, const std::string& bind_addr)
-    : server_(std::make_unique<Server>(port, bind_addr)), running_(false) {
+HttpServer::HttpServer(uint16_t port, const std::string& bind_addr, const ServerOptions& options)
+    : server_(std::make_unique<Server>(port, bind_addr, options)), running_(false),
+      idle_timer_(asio::make_strand(server_->context())) {
 }
 
 //----------------------------------------
 //
 //----------------------------------------
 HttpServer::HttpServer(uint16_t port, const TlsConfig& tls_config, 
-  const std::string& bind_addr)
-  : server_(std::make_unique<Server>(port, tls_config, bind_addr)), running_(false) {
+  const std::string& bind_addr, const ServerOptions& options)
+  : server_(std::make_unique<Server>(port, tls_config, bind_addr, options)), running_(false),
+    idle_timer_(asio::make_strand(server_->context())) {
 }
 
 //----------------------------------------
@@ -41,7 +251,29 @@ HttpServer::~HttpServer() {
 //----------------------------------------
 void HttpServer::route(const std::string& method, const std::string& path, 
   RouteHandler handler) {
-    routes_[method + " " + path] = std::move(handler);
+    router_.add(method, path, Route{std::move(handler), {}, metrics_.route(method, path)});
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HttpServer::route_stream(const std::string& method, const std::string& path,
+  StreamingHandler handler) {
+    router_.add(method, path, Route{{}, std::move(handler), metrics_.route(method, path)});
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HttpServer::post_stream(const std::string& path, StreamingHandler handler) {
+  route_stream("POST", path, std::move(handler));
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void HttpServer::put_stream(const std::string& path, StreamingHandler handler) {
+  route_stream("PUT", path, std::move(handler));
 }
 
 //----------------------------------------
@@ -90,221 +322,633 @@ void HttpServer::use_middleware(Middleware middleware) {
 //
 //----------------------------------------
 void HttpServer::serve_static(const std::string& url_prefix, const std::string& directory) {
-  static_routes_[url_prefix] = directory;
+  std::string prefix = url_prefix;
+  while(not prefix.empty() && prefix.back() == '/') {
+    prefix.pop_back();
+  }
+
+  // files are resolved against the canonical directory, so the
+  // containment check in handle_static_file compares like with like
+  fs::path root = fs::weakly_canonical(fs::absolute(directory));
+  if(root.filename().empty()) {
+    root = root.parent_path();
+  }
+
+  const std::string pattern = prefix + "/*path";
+  router_.add("*", pattern, Route{[this, root = root.string()](const HttpRequest& request) {
+    return handle_static_file(request, root, request.get_path_param("path"));
+  }, {}, metrics_.route("*", pattern)});
 }
 
 //----------------------------------------
 //
 //----------------------------------------
-HttpRequest HttpServer::parse_request(const std::string& raw_request) const {
+void HttpServer::serve_metrics(const std::string& path) {
+  if constexpr(metrics_enabled) {
+    get(path, [this](const HttpRequest&) {
+      HttpResponse response;
+      response.set_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+      response.set_header("Cache-Control", "no-store");
+      response.body = metrics_.render();
+      return response;
+    });
+  }
+}
+
+//----------------------------------------
+// throws std::invalid_argument unless raw_request is a complete
+// request head
+//----------------------------------------
+HttpRequest HttpServer::parse_request(std::string_view raw_request) const {
+  HttpParser parser;
+  HttpHead head;
+  if(parser.parse_request(raw_request, head) != ParseResult::Complete) {
+    throw std::invalid_argument("Malformed request head");
+  }
+
   HttpRequest request;
-  std::istringstream stream(raw_request);
-    
-  // Parse request line
-  std::string request_line;
-  std::getline(stream, request_line);
-    
-  std::istringstream line_stream(request_line);
-  std::string full_path;
-  line_stream >> request.method >> full_path >> request.http_version;
-    
-  // Parse path and query string
-  size_t query_pos = full_path.find('?');
-  if(query_pos != std::string::npos) {
-    request.path = full_path.substr(0, query_pos);
-    std::string query = full_path.substr(query_pos + 1);
-    request.query_params = parse_query_string(query);
-  } else {
-    request.path = full_path;
-  }
-    
-  // Parse headers
-  std::string header_line;
-  while(std::getline(stream, header_line) && header_line != "\r") {
-    if(header_line.back() == '\r') header_line.pop_back();
-    if(header_line.empty()) break;
-        
-    size_t colon = header_line.find(':');
-    if(colon != std::string::npos) {
-      std::string key = header_line.substr(0, colon);
-      std::string value = header_line.substr(colon + 1);
-            
-      // Trim whitespace
-      value.erase(0, value.find_first_not_of(" \t"));
-      value.erase(value.find_last_not_of(" \t\r\n") + 1);
-            
-      // Convert to lowercase for case-insensitive lookup
-      std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-      request.headers[key] = value;
-    }
-  }
-    
-  // Parse cookies
-  if(request.has_header("cookie")) {
-    request.cookies = parse_cookies(request.get_header("cookie"));
-  }
-    
-  // Parse body
-  std::ostringstream body_stream;
-  body_stream << stream.rdbuf();
-  request.body = body_stream.str();
-    
-  // Parse form data if applicable
-  if(request.get_header("content-type")
-      .find("application/x-www-form-urlencoded") != std::string::npos) {
-        request.form_data = parse_query_string(request.body);
-  }
-    
+  request.method = head.method;
+  request.path = head.path;
+  request.http_version = "HTTP/1." + std::to_string(head.version_minor);
+  request.query_params.assign(std::string(head.query), LazyParams::Syntax::Query);
+
+  for(const auto& field : head.fields()) {
+    auto [it, inserted] = request.headers.try_emplace(std::string(field.name), field.value);
+    if(not inserted) {
+      // repeated fields fold into one list
+      it->second.append(", ").append(field.value);
+    }
+  }
+
+  if(auto cookie = head.header("cookie")) {
+    request.cookies.assign(std::string(*cookie), LazyParams::Syntax::Cookies);
+  }
+
   return request;
 }
 
 //----------------------------------------
 //
 //----------------------------------------
-HttpResponse HttpServer::handle_static_file(const HttpRequest& request) const {
+HttpResponse HttpServer::handle_static_file(const HttpRequest& request, const std::string& directory,
+  const std::string& relative_path) const {
   HttpResponse response;
-    
-  // Check each static route
-  for(const auto& [prefix, directory] : static_routes_) {
-    if(request.path.find(prefix) == 0) {
-      std::string relative_path = request.path.substr(prefix.length());
-      
-      // prevent directory traversal
-      if(relative_path.find("..") != std::string::npos) {
-        return response.set_status(403).set_body("Forbidden");
-      }
-            
-      fs::path file_path = fs::path(directory) / relative_path;
-            
-      // If path is directory, try index.html
-      if(fs::is_directory(file_path)) {
-        file_path /= "index.html";
-      }
-            
-      // Check if file exists
-      if(not fs::exists(file_path) || not fs::is_regular_file(file_path)) {
-        return response.set_status(404).set_body("Not Found");
-      }
-            
-      // Read file
-      std::ifstream file(file_path, std::ios::binary);
-      if(not file.is_open()) {
-        return response.set_status(500).set_body("Internal Server Error");
+
+  // prevent directory traversal. an absolute capture, e.g. from
+  // "/static//etc/passwd", would replace directory when appended
+  const fs::path relative(relative_path);
+  if(relative_path.find("..") != std::string::npos || relative_path.find('\\') != std::string::npos
+      || (not relative_path.empty() && relative_path.front() == '/') || relative.has_root_path()) {
+    return response.set_status(403).set_body("Forbidden");
+  }
+
+  const fs::path root(directory);
+  const fs::path target = (root / relative).lexically_normal();
+  if(std::mismatch(root.begin(), root.end(), target.begin(), target.end()).first != root.end()) {
+    return response.set_status(403).set_body("Forbidden");
+  }
+
+  // directories resolve to their index.html
+  const auto file = static_cache_.lookup(target);
+  if(not file) {
+    return not_found(request);
+  }
+
+  const bool ranged = request.has_header("range") && range_applies(request, *file);
+
+  // small files are served from precompressed copies kept in the cache.
+  // ranges always refer to the identity representation.
+  ContentCoding coding = ContentCoding::Identity;
+  std::shared_ptr<const std::string> encoded;
+  if(config_.compression.enabled && file->content && file->size >= config_.compression.min_size
+      && mime_allowed(config_.compression.mime_types, file->content_type)) {
+    response.set_header("Vary", "Accept-Encoding");
+    coding = ranged ? ContentCoding::Identity : negotiate_content_coding(request.get_header("accept-encoding"));
+    if(coding != ContentCoding::Identity) {
+      encoded = static_cache_.encoded(*file, coding);
+      if(not encoded || encoded->size() >= file->size) {
+        coding = ContentCoding::Identity;
+        encoded.reset();
       }
-            
-      std::string content((std::istreambuf_iterator<char>(file)), 
-          std::istreambuf_iterator<char>());
-            
-      // Set MIME type
-      std::string mime_type = get_mime_type(file_path.string());
-            
-      return response.set_status(200)
-        .set_header("Content-Type", mime_type)
-        .set_body(content);
-    }
-  }
-  return response.set_status(404).set_body("Not Found");
+    }
+  }
+
+  const std::string etag = coding == ContentCoding::Identity ? file->etag : encoded_etag(file->etag, coding);
+
+  response.set_header("Content-Type", file->content_type)
+    .set_header("ETag", etag)
+    .set_header("Last-Modified", file->last_modified)
+    .set_header("Accept-Ranges", "bytes");
+
+  if(not_modified(request, *file, etag)) {
+    return response.set_status(304);
+  }
+
+  if(encoded) {
+    response.set_header("Content-Encoding", std::string(content_coding_name(coding)));
+    if(request.method == "HEAD") {
+      return response.set_header("Content-Length", std::to_string(encoded->size()));
+    }
+    return response.set_body(*encoded);
+  }
+
+  uint64_t offset = 0;
+  uint64_t length = file->size;
+
+  if(ranged) {
+    const auto range = parse_byte_range(request.get_header("range"), file->size);
+    if(range && not range->satisfiable) {
+      return response.set_status(416)
+        .set_header("Content-Range", "bytes */" + std::to_string(file->size))
+        .set_body("");
+    }
+    if(range) {
+      offset = range->offset;
+      length = range->length;
+      response.set_status(206)
+        .set_header("Content-Range", "bytes " + std::to_string(offset) + "-"
+          + std::to_string(offset + length - 1) + "/" + std::to_string(file->size));
+    }
+  }
+
+  if(request.method == "HEAD") {
+    return response.set_header("Content-Length", std::to_string(length));
+  }
+
+  if(file->content) {
+    return response.set_body(file->content->substr(offset, length));
+  }
+
+  const int fd = ::open(file->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    return not_found(request);
+  }
+  return response.set_file(fd, offset, length);
 }
 
 //----------------------------------------
 //
 //----------------------------------------
-void HttpServer::handle_client(std::unique_ptr<Remote> client) {
+bool HttpServer::compressible(const HttpResponse& response) const {
+  return config_.compression.enabled
+    && not response.file
+    && response.body.size() >= config_.compression.min_size
+    && response.status_code >= 200 && response.status_code != 206 && response.status_code != 304
+    && not response.has_header("Content-Encoding")
+    && not varies_by_encoding(response)
+    && mime_allowed(config_.compression.mime_types, response.get_header("Content-Type"));
+}
+
+//----------------------------------------
+// encodes the body in the best coding the client accepts.
+// bodies that would not shrink are left as they are.
+//----------------------------------------
+void HttpServer::compress_response(const HttpRequest& request, HttpResponse& response) const {
+  if(request.method == "HEAD" || not compressible(response)) {
+    return;
+  }
+
+  add_vary(response);
+
+  const ContentCoding coding = negotiate_content_coding(request.get_header("accept-encoding"));
+  if(coding == ContentCoding::Identity) {
+    return;
+  }
+
+  std::string encoded = compress(response.body, coding, config_.compression.level);
+  if(encoded.size() >= response.body.size()) {
+    return;
+  }
+
+  response.body = std::move(encoded);
+  response.set_header("Content-Encoding", std::string(content_coding_name(coding)))
+          .set_header("Content-Length", std::to_string(response.body.size()));
+
+  // a strong validator names the exact bytes, which just changed
+  auto etag = response.headers.find("ETag");
+  if(etag != response.headers.end() && not etag->second.starts_with("W/")) {
+    etag->second = encoded_etag(etag->second, coding);
+  }
+}
+
+//----------------------------------------
+// the GET /404 route if one was registered as a plain path
+//----------------------------------------
+HttpResponse HttpServer::not_found(const HttpRequest& request) const {
+  PathParams params;
+  const RouteMatch match = router_.match("GET", "/404", params);
+  if(match.status == RouteStatus::Found && params.count == 0 && match.route->handler) {
+    return match.route->handler(request);
+  }
+
+  HttpResponse response;
+  return response.set_status(404)
+    .set_html("<html><body><h1>404 Not Found</h1></body></html>");
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<bool> HttpServer::handle_client(Remote& client, size_t served) {
+  const auto started = metrics_enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+  RouteMetrics* route_metrics = &metrics_.unmatched();
+  uint64_t received = 0;
+
+  // one sample per answered request, against its route if it had one
+  auto observe = [&](int status, uint64_t sent) {
+    if constexpr(metrics_enabled) {
+      route_metrics->observe(status, std::chrono::steady_clock::now() - started);
+      metrics_.add_received(received);
+      metrics_.add_sent(sent);
+    }
+  };
+
+  int refused = 0;           // the status a broken request is turned away with
+  bool responding = false;   // a timeout from here on is the client not reading
+
   try {
-    std::string raw_request = client->recvuntil("\r\n\r\n");
-        
-    // Check if there's a body to read
-    auto content_length_pos = raw_request.find("Content-Length:");
-    if(content_length_pos != std::string::npos) {
-      size_t start = content_length_pos + 15;
-      size_t end = raw_request.find("\r\n", start);
-      std::string length_str = raw_request.substr(start, end - start);
-            
-      // Trim whitespace
-      length_str.erase(0, length_str.find_first_not_of(" \t"));
-      length_str.erase(length_str.find_last_not_of(" \t\r\n") + 1);
-            
-      size_t content_length = std::stoull(length_str);
-      if(content_length > 0) {
-        std::string body = client->recv(content_length);
-        raw_request += body;
-      }
+    // a worker blocks on these reads, so a client trickling its
+    // request in must not hold it for longer than the timeouts
+    const auto head_deadline = config_.header_timeout.count() == 0
+      ? std::chrono::steady_clock::time_point::max()
+      : std::chrono::steady_clock::now() + config_.header_timeout;
+    client.set_read_timeout(std::chrono::milliseconds{0}, head_deadline);
+
+    HttpRequest request;
+    try {
+      const std::string_view head = client.recvuntil_view("\r\n\r\n", config_.max_header_size);
+      received = head.size();
+      request = parse_request(head);
+    } catch (const std::length_error&) {
+      refused = 431;
+    } catch (const std::invalid_argument&) {
+      refused = 400;
     }
-        
-    // Parse request
-    HttpRequest request = parse_request(raw_request);
+    if(refused != 0) {
+      responding = true;
+      observe(refused, co_await reject(client, refused, config_.send_timeout));
+      co_return false;
+    }
+    client.set_read_timeout(config_.body_read_timeout);
     HttpResponse response;
-        
-    // Apply middlewares
-    bool should_continue = true;
-    for(const auto& middleware : middlewares_) {
-      should_continue = middleware(request, response);
-      if(not should_continue) break;
-    }
-        
-    if(should_continue) {
-      // Try to find matching route
-      std::string route_key = request.method + " " + request.path;
-      auto route_it = routes_.find(route_key);
-            
-      if(route_it != routes_.end()) {
-        response = route_it->second(request);
-      } else {
-        // Try static file serving
-        response = handle_static_file(request);
-                
-        // If still not found, return 404
-        if(response.status_code == 404 && !routes_.empty()) {
-          // Check if 404 handler exists
-          auto not_found = routes_.find("GET /404");
-          if(not_found != routes_.end()) {
-            response = not_found->second(request);
-          } else {
-            response.set_status(404)
-                    .set_html("<html><body><h1>404 Not Found</h1></body></html>");
-          }
+
+    // the route decides whether the body is buffered or streamed
+    const RouteMatch match = router_.match(request.method, request.path, request.path_params);
+    const bool streaming = match.status == RouteStatus::Found && match.route->streaming;
+    const uint64_t body_limit = streaming ? config_.max_streamed_body_size : config_.max_body_size;
+
+    if(match.status == RouteStatus::Found && match.route->metrics) {
+      route_metrics = match.route->metrics.get();
+    }
+
+    std::optional<BodyReader> body;
+    try {
+      body.emplace(client, request, body_limit);
+    } catch (const std::invalid_argument&) {
+      refused = 400;
+    } catch (const std::domain_error&) {
+      refused = 501;
+    }
+
+    // refuse before the client sends a byte of an oversized body
+    if(refused == 0 && body_limit != 0 && body->content_length() && *body->content_length() > body_limit) {
+      refused = 413;
+    }
+    if(refused != 0) {
+      responding = true;
+      observe(refused, co_await reject(client, refused, config_.send_timeout));
+      co_return false;
+    }
+
+    try {
+      if(not streaming) {
+        request.body = body->read_all();
+
+        // Parse form data if applicable
+        if(request.get_header("content-type")
+            .find("application/x-www-form-urlencoded") != std::string::npos) {
+              request.form_data.assign(request.body, LazyParams::Syntax::Query);
+        }
+      }
+
+      // Apply middlewares
+      bool should_continue = true;
+      for(const auto& middleware : middlewares_) {
+        should_continue = middleware(request, response);
+        if(not should_continue) break;
+      }
+
+      if(should_continue) {
+        if(match.status == RouteStatus::Found) {
+          response = streaming ? match.route->streaming(request, *body) : match.route->handler(request);
+        } else if(match.status == RouteStatus::MethodNotAllowed) {
+          response.set_status(405)
+                  .set_header("Allow", std::string(match.allow))
+                  .set_body("Method Not Allowed");
+        } else {
+          response = not_found(request);
         }
       }
+    } catch (const std::length_error&) {
+      response = HttpResponse(413);
+      response.set_body("Payload Too Large");
     }
-        
+
+    compress_response(request, response);
+
+    // Decide whether the connection outlives this request
+    const std::string connection = request.get_header("connection");
+    bool keep_alive = (request.http_version == "HTTP/1.1")
+      ? not iequals(connection, "close")
+      : iequals(connection, "keep-alive");
+
+    auto response_connection = response.headers.find("Connection");
+    if(response_connection != response.headers.end() && iequals(response_connection->second, "close")) {
+      keep_alive = false;
+    }
+
+    if(served + 1 >= config_.max_keep_alive_requests || not running_) {
+      keep_alive = false;
+    }
+
+    // whatever is left of an unread body would be taken for the next request
+    if(not body->finished()) {
+      keep_alive = false;
+    }
+
+    // Without a length the client could only find the end of the body by EOF
+    const bool bodyless = response.status_code < 200 || response.status_code == 204 || response.status_code == 304;
+    if(not bodyless && response.headers.find("Content-Length") == response.headers.end()) {
+      response.set_header("Content-Length", std::to_string(response.body.size()));
+    }
+
+    response.set_header("Connection", keep_alive ? "keep-alive" : "close");
+
     // Send response
-    client->send(response.to_string());
-    client->close();
+    responding = true;
+    const uint64_t sent = co_await send_response(client, response, config_.send_timeout);
+    received += body->received();
+    observe(response.status_code, sent);
+    co_return keep_alive;
+  } catch (const asio::system_error& e) {
+    // a client too slow to take its response isn't sent another
+    if(e.code() == asio::error::timed_out) {
+      refused = responding ? 0 : 408;
+    } else if(e.code() != asio::error::eof && e.code() != asio::error::connection_reset) {
+      // a keep-alive client hanging up between requests is business as usual
+      std::cerr << "Error handling client: " << e.what() << "\n";
+      if constexpr(metrics_enabled) metrics_.count_error();
+    }
   } catch (const std::exception& e) {
     std::cerr << "Error handling client: " << e.what() << "\n";
+    if constexpr(metrics_enabled) metrics_.count_error();
+  }
+
+  if(refused == 408) {
+    try {
+      observe(408, co_await reject(client, 408, config_.send_timeout));
+    } catch (const std::exception&) {
+      // the client is gone or not reading either
+    }
+  }
+  co_return false;
+}
+
+//----------------------------------------
+// arms the next accept on acceptor. re-armed as soon as the TCP
+// connection is in, before a TLS handshake, until the connection
+// limit or stop() is hit. with several acceptors the limit may
+// be overshot by the accepts already in flight.
+//----------------------------------------
+void HttpServer::do_accept(size_t acceptor) {
+  auto admitted = std::make_shared<bool>(false);
+
+  auto admit = [this, acceptor, admitted] {
+    *admitted = true;
+
+    bool accept_more = false;
+    {
+      std::lock_guard lock(connections_mutex_);
+      ++active_connections_;
+      accept_more = running_ && active_connections_ < config_.max_connections;
+      if constexpr(metrics_enabled) metrics_.connection_opened();
+      if(running_ && not accept_more) {
+        paused_acceptors_.push_back(acceptor);
+      }
+    }
+
+    if(accept_more) {
+      do_accept(acceptor);
+    }
+  };
+
+  server_->async_accept(acceptor, [this, acceptor, admitted](const asio::error_code& ec, std::unique_ptr<Remote> client) {
+    if(ec && *admitted) {
+      // the TLS handshake failed, the accept already moved on
+      release_connection();
+      return;
+    }
+
+    if(ec) {
+      if(ec == asio::error::operation_aborted || not running_) {
+        return;
+      }
+      std::cerr << "Error accepting client: " << ec.message() << "\n";
+      do_accept(acceptor);
+      return;
+    }
+
+    serve_connection(std::shared_ptr<Remote>(std::move(client)));
+  }, std::move(admit));
+}
+
+//----------------------------------------
+// parks the connection on the event loop until the next request
+// arrives, so idle keep-alive clients don't hold a worker thread.
+// requests already sitting in the receive buffer (pipelining)
+// are picked up right away.
+//----------------------------------------
+void HttpServer::serve_connection(std::shared_ptr<Remote> client, size_t served) {
+  {
+    std::lock_guard lock(connections_mutex_);
+    if(not running_) {
+      client->close();
+      --active_connections_;
+      if constexpr(metrics_enabled) metrics_.connection_closed();
+      return;
+    }
+    idle_connections_[client.get()] = std::chrono::steady_clock::now() + config_.keep_alive_timeout;
+  }
+
+  client->async_wait([this, client, served](const asio::error_code& ec) {
+    bool closed_by_server = false;
+    {
+      std::lock_guard lock(connections_mutex_);
+      closed_by_server = idle_connections_.erase(client.get()) == 0;
+    }
+
+    if(ec || closed_by_server) {
+      client->close();
+      release_connection();
+      return;
+    }
+
+    asio::co_spawn(server_->context(), handle_client(*client, served),
+      [this, client, served](std::exception_ptr error, bool keep_alive) {
+        if(not error && keep_alive) {
+          serve_connection(client, served + 1);
+          return;
+        }
+
+        client->close();
+        release_connection();
+      });
+  });
+}
+
+//----------------------------------------
+// closes connections that sat idle past keep_alive_timeout.
+// runs once a second for as long as the server is running.
+//----------------------------------------
+void HttpServer::sweep_idle_connections() {
+  idle_timer_.expires_after(std::chrono::seconds(1));
+  idle_timer_.async_wait([this](const asio::error_code& ec) {
+    if(ec || not running_) {
+      return;
+    }
+
+    {
+      const auto now = std::chrono::steady_clock::now();
+      std::lock_guard lock(connections_mutex_);
+
+      for(auto it = idle_connections_.begin(); it != idle_connections_.end();) {
+        if(it->second <= now) {
+          it->first->close();
+          it = idle_connections_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    sweep_idle_connections();
+  });
+}
+
+//----------------------------------------
+// resumes accepting if we were paused at the connection limit
+//----------------------------------------
+void HttpServer::release_connection() {
+  std::optional<size_t> resume;
+  {
+    std::lock_guard lock(connections_mutex_);
+    --active_connections_;
+    if constexpr(metrics_enabled) metrics_.connection_closed();
+    if(not paused_acceptors_.empty() && running_ && active_connections_ < config_.max_connections) {
+      resume = paused_acceptors_.front();
+      paused_acceptors_.pop_front();
+    }
+  }
+
+  if(resume) {
+    do_accept(*resume);
   }
 }
 
+//----------------------------------------
+//
+//----------------------------------------
+void HttpServer::run_worker() {
+  tls_is_worker = true;
+
+  while(true) {
+    try {
+      server_->context().run();
+      break;
+    } catch (const std::exception& e) {
+      std::cerr << "Error in worker: " << e.what() << "\n";
+    }
+  }
+
+  tls_is_worker = false;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
 void HttpServer::start() {
-  if(running_) {
+  if(running_.exchange(true)) {
     throw std::runtime_error("Server is already running");
   }
-  running_ = true;
+  
+  {
+    std::lock_guard lock(loop_mutex_);
+    loop_active_ = true;
+  }
+  
+  {
+    std::lock_guard lock(connections_mutex_);
+    paused_acceptors_.clear();
+  }
+
+  server_->context().restart();
+  for(size_t acceptor = 0; acceptor < server_->acceptor_count(); ++acceptor) {
+    do_accept(acceptor);
+  }
+  sweep_idle_connections();
   std::cout << "Server started and listening...\n";
-    
-  while(running_) {
-    try {
-      auto client = server_->accept();
-      std::thread(&HttpServer::handle_client, this, std::move(client)).detach();
-    } catch (const std::exception& e) {
-      if(running_) {
-        std::cerr << "Error accepting client: " << e.what() << "\n";
-      }
+
+  const size_t thread_count = std::max<size_t>(1, config_.worker_threads);
+  workers_.reserve(thread_count - 1);
+
+  for(size_t i = 1; i < thread_count; ++i) {
+    workers_.emplace_back(&HttpServer::run_worker, this);
+  }
+
+  // the calling thread is one of the workers
+  run_worker();
+
+  for(auto& worker : workers_) {
+    if(worker.joinable()) {
+      worker.join();
     }
   }
+  workers_.clear();
+
+  {
+    std::lock_guard lock(loop_mutex_);
+    loop_active_ = false;
+  }
+  loop_cv_.notify_all();
 }
 
 //----------------------------------------
 //
 //----------------------------------------
 void HttpServer::stop() {
-  if(running_) {
-    running_ = false;
+  if(not running_.exchange(false)) {
+    return;
+  }
+
+  // the acceptor and idle timer belong to the event loop, close them from there.
+  // posting through the timer's strand keeps us clear of a concurrent re-arm.
+  asio::post(idle_timer_.get_executor(), [this] {
     server_->close();
+    idle_timer_.cancel();
+
+    std::lock_guard lock(connections_mutex_);
+    for(auto& [client, deadline] : idle_connections_) {
+      client->close();
+    }
+    idle_connections_.clear();
+  });
+
+  if(tls_is_worker) {
+    return;
   }
+
+  std::unique_lock lock(loop_mutex_);
+  loop_cv_.wait(lock, [this] { return not loop_active_; });
 }
 
 //----------------------------------------
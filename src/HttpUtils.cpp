@@ -1,16 +1,92 @@
 #include <HttpUtils.hpp>
 #include <sstream>
+#include <charconv>
+#include <ctime>
+#include <unistd.h>
 
 #include "Helpers.hpp"
 
+namespace {
+  //----------------------------------------
+  // sorted by code for the binary search in status_text()
+  //----------------------------------------
+  constexpr std::array<std::pair<int, std::string_view>, 26> status_messages{{
+    {200, "OK"},
+    {201, "Created"},
+    {204, "No Content"},
+    {206, "Partial Content"},
+    {301, "Moved Permanently"},
+    {302, "Found"},
+    {303, "See Other"},
+    {304, "Not Modified"},
+    {307, "Temporary Redirect"},
+    {308, "Permanent Redirect"},
+    {400, "Bad Request"},
+    {401, "Unauthorized"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {408, "Request Timeout"},
+    {409, "Conflict"},
+    {413, "Payload Too Large"},
+    {415, "Unsupported Media Type"},
+    {416, "Range Not Satisfiable"},
+    {429, "Too Many Requests"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {502, "Bad Gateway"},
+    {503, "Service Unavailable"}
+  }};
+
+  static_assert(std::ranges::is_sorted(status_messages, {}, &std::pair<int, std::string_view>::first));
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  constexpr std::string_view status_text(int code) noexcept {
+    const auto it = std::ranges::lower_bound(status_messages, code, {}, &std::pair<int, std::string_view>::first);
+    return (it != status_messages.end() && it->first == code) ? it->second : "Unknown";
+  }
+
+  //----------------------------------------
+  // the Date header value, formatted at most once a second per
+  // thread. the view stays valid until the thread's next call.
+  //----------------------------------------
+  std::string_view cached_http_date() {
+    thread_local std::time_t formatted_for = -1;
+    thread_local char buffer[32];
+    thread_local size_t length = 0;
+
+    const std::time_t now = std::time(nullptr);
+    if(now != formatted_for) {
+      std::tm gmt;
+      gmtime_r(&now, &gmt);
+      length = std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+      formatted_for = now;
+    }
+    return std::string_view(buffer, length);
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+const LazyParams::map_type& LazyParams::get() const {
+  if(not parsed_) {
+    params_ = syntax_ == Syntax::Query ? parse_query_string(source_) : parse_cookies(source_);
+    source_.clear();
+    source_.shrink_to_fit();
+    parsed_ = true;
+  }
+  return params_;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
 std::string HttpRequest::get_header(const std::string& name) const {
-  std::string lower_name = name;
-  std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
-    
-  auto it = headers.find(lower_name);
+  auto it = headers.find(name);
   return (it != headers.end()) ? it->second : "";
 }
 
@@ -18,9 +94,7 @@ std::string HttpRequest::get_header(const std::string& name) const {
 //
 //----------------------------------------
 bool HttpRequest::has_header(const std::string& name) const {
-  std::string lower_name = name;
-  std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
-  return headers.find(lower_name) != headers.end();
+  return headers.find(name) != headers.end();
 }
 
 //----------------------------------------
@@ -39,6 +113,19 @@ std::string HttpRequest::get_param(const std::string& name) const {
   return (it != query_params.end()) ? it->second : "";
 }
 
+//----------------------------------------
+//
+//----------------------------------------
+std::string HttpRequest::get_path_param(const std::string& name) const {
+  for(size_t i = 0; i < path_params.count; ++i) {
+    const PathParam& param = path_params.items[i];
+    if(param.name == name && param.offset + param.length <= path.size()) {
+      return path.substr(param.offset, param.length);
+    }
+  }
+  return "";
+}
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -74,10 +161,7 @@ bool HttpResponse::ok() const noexcept {
 //
 //----------------------------------------
 std::string HttpResponse::get_header(const std::string& key) const {
-  std::string lower_key = key;
-  std::transform(lower_key.begin(), lower_key.end(), lower_key.begin(), ::tolower);
-        
-  auto it = headers.find(lower_key);
+  auto it = headers.find(key);
   return (it != headers.end()) ? it->second : "";
 }
     
@@ -85,9 +169,7 @@ std::string HttpResponse::get_header(const std::string& key) const {
 //
 //----------------------------------------
 bool HttpResponse::has_header(const std::string& key) const {
-  std::string lower_key = key;
-  std::transform(lower_key.begin(), lower_key.end(), lower_key.begin(), ::tolower);
-  return headers.find(lower_key) != headers.end();
+  return headers.find(key) != headers.end();
 }
 
 //----------------------------------------
@@ -131,10 +213,28 @@ HttpResponse& HttpResponse::set_cookie(const std::string& name, const std::strin
 //----------------------------------------
 HttpResponse& HttpResponse::set_body(const std::string& content) {
   body = content;
+  file.reset();
   set_header("Content-Length", std::to_string(body.size()));
   return *this;
 }
 
+//----------------------------------------
+//
+//----------------------------------------
+HttpResponse& HttpResponse::set_file(int fd, uint64_t offset, uint64_t length) {
+  body.clear();
+  file = FileBody{
+    std::shared_ptr<const int>(new int(fd), [](const int* owned) {
+      ::close(*owned);
+      delete owned;
+    }),
+    offset,
+    length
+  };
+  set_header("Content-Length", std::to_string(length));
+  return *this;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -164,60 +264,41 @@ HttpResponse& HttpResponse::redirect(const std::string& location, int code) {
 //----------------------------------------
 //
 //----------------------------------------
-std::string HttpResponse::to_string() const {
-  std::ostringstream response;
-  response << "HTTP/1.1 " << status_code << " " << status_message << "\r\n";
-  response << "Date: " << get_http_date() << "\r\n";
-  response << "Server: cpppwn-http/1.0\r\n";
+void HttpResponse::serialize_head(std::string& out) const {
+  out.clear();
+
+  char code[16];
+  const auto [code_end, ec] = std::to_chars(code, code + sizeof(code), status_code);
+  static_cast<void>(ec);
+
+  out.append("HTTP/1.1 ").append(code, code_end).append(" ").append(status_message).append("\r\n");
+  out.append("Date: ").append(cached_http_date()).append("\r\n");
+  out.append("Server: cpppwn-http/1.0\r\n");
 
-  // Headers
   for(const auto& [name, value] : headers) {
-    response << name << ": " << value << "\r\n";
+    out.append(name).append(": ").append(value).append("\r\n");
   }
-    
+
   for(const auto& cookie : cookies) {
-    response << "Set-Cookie: " << cookie << "\r\n";
+    out.append("Set-Cookie: ").append(cookie).append("\r\n");
   }
-    
-  response << "\r\n";
 
-  // Body
-  if(not body.empty()) {
-    response << body;
-  }
-    
-  return response.str();
+  out.append("\r\n");
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string HttpResponse::to_string() const {
+  std::string response;
+  serialize_head(response);
+  response.append(body);
+  return response;
 }
 
 //----------------------------------------
 //
 //----------------------------------------
 std::string HttpResponse::get_status_message(int code) {
-  static const std::map<int, std::string> status_messages = {
-    {200, "OK"},
-    {201, "Created"},
-    {204, "No Content"},
-    {301, "Moved Permanently"},
-    {302, "Found"},
-    {303, "See Other"},
-    {304, "Not Modified"},
-    {307, "Temporary Redirect"},
-    {308, "Permanent Redirect"},
-    {400, "Bad Request"},
-    {401, "Unauthorized"},
-    {403, "Forbidden"},
-    {404, "Not Found"},
-    {405, "Method Not Allowed"},
-    {409, "Conflict"},
-    {413, "Payload Too Large"},
-    {415, "Unsupported Media Type"},
-    {429, "Too Many Requests"},
-    {500, "Internal Server Error"},
-    {501, "Not Implemented"},
-    {502, "Bad Gateway"},
-    {503, "Service Unavailable"}
-  };
-    
-  auto it = status_messages.find(code);
-  return (it != status_messages.end()) ? it->second : "Unknown";
+  return std::string(status_text(code));
 }
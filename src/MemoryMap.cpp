@@ -0,0 +1,200 @@
+#include <MemoryMap.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <system_error>
+
+namespace cpppwn {
+
+namespace {
+
+//----------------------------------------
+// whole content of a /proc file, whose size stat() can't tell
+//----------------------------------------
+std::string readProcFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    throw std::system_error(errno, std::system_category(), "Cannot open " + path);
+  }
+
+  std::string content;
+  size_t used = 0;
+  for(;;) {
+    if(content.size() - used < 16 * 1024) {
+      content.resize(used + 64 * 1024);
+    }
+
+    const ssize_t n = read(fd, content.data() + used, content.size() - used);
+    if(n < 0 && errno == EINTR) continue;
+    if(n < 0) {
+      const int error = errno;
+      close(fd);
+      throw std::system_error(error, std::system_category(), "Cannot read " + path);
+    }
+    if(n == 0) break;
+    used += static_cast<size_t>(n);
+  }
+
+  close(fd);
+  content.resize(used);
+  return content;
+}
+
+//----------------------------------------
+// splits the next space separated field off line
+//----------------------------------------
+std::string_view nextField(std::string_view& line) noexcept {
+  const size_t begin = std::min(line.find_first_not_of(' '), line.size());
+  line.remove_prefix(begin);
+  const size_t end = std::min(line.find(' '), line.size());
+  const std::string_view field = line.substr(0, end);
+  line.remove_prefix(end);
+  return field;
+}
+
+template<typename T>
+T parseHex(std::string_view text) noexcept {
+  T value = 0;
+  std::from_chars(text.data(), text.data() + text.size(), value, 16);
+  return value;
+}
+
+} // anon namespace
+
+//----------------------------------------
+// Constructor
+//----------------------------------------
+MemoryMap::MemoryMap(pid_t pid) : pid_(pid) {
+  refresh();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool MemoryMap::refresh() {
+  const std::string content = readProcFile("/proc/" + std::to_string(pid_) + "/maps");
+  const size_t hash = std::hash<std::string_view>{}(content);
+
+  if(not regions_.empty() && hash == content_hash_ && content.size() == content_size_) {
+    return false;
+  }
+
+  parse(content);
+  content_hash_ = hash;
+  content_size_ = content.size();
+  return true;
+}
+
+//----------------------------------------
+// "start-end perms offset dev inode path" per line
+//----------------------------------------
+void MemoryMap::parse(std::string_view content) {
+  regions_.clear();
+  modules_.clear();
+
+  while(not content.empty()) {
+    const size_t eol = std::min(content.find('\n'), content.size());
+    std::string_view line = content.substr(0, eol);
+    content.remove_prefix(std::min(eol + 1, content.size()));
+
+    const std::string_view range = nextField(line);
+    const size_t dash = range.find('-');
+    if(dash == std::string_view::npos) continue;
+
+    MemoryRegion region;
+    region.start = parseHex<address_t>(range.substr(0, dash));
+    region.end = parseHex<address_t>(range.substr(dash + 1));
+    region.permissions = nextField(line);
+    region.offset = parseHex<size_t>(nextField(line));
+    nextField(line); // dev
+    nextField(line); // inode
+
+    const size_t path_begin = line.find_first_not_of(' ');
+    if(path_begin != std::string_view::npos) {
+      region.path = line.substr(path_begin);
+    }
+    regions_.push_back(std::move(region));
+  }
+
+  // the kernel lists mappings in address order, keep that guaranteed
+  std::sort(regions_.begin(), regions_.end(), [](const MemoryRegion& a, const MemoryRegion& b) {
+    return a.start < b.start;
+  });
+
+  for(const auto& region : regions_) {
+    if(region.path.empty()) continue;
+
+    modules_.emplace_back(region.path, region.start);
+    const size_t slash = region.path.rfind('/');
+    if(slash != std::string::npos) {
+      modules_.emplace_back(region.path.substr(slash + 1), region.start);
+    }
+  }
+
+  // stable so the lowest base of every name comes first
+  std::stable_sort(modules_.begin(), modules_.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+const MemoryRegion* MemoryMap::region_at(address_t address) const noexcept {
+  auto it = std::upper_bound(regions_.begin(), regions_.end(), address, [](address_t value, const MemoryRegion& region) {
+    return value < region.start;
+  });
+
+  if(it == regions_.begin()) {
+    return nullptr;
+  }
+  --it;
+  return it->contains(address) ? &*it : nullptr;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::optional<address_t> MemoryMap::module_base(std::string_view module) const {
+  const auto it = std::lower_bound(modules_.begin(), modules_.end(), module, [](const auto& entry, std::string_view name) {
+    return std::string_view(entry.first) < name;
+  });
+
+  if(it != modules_.end() && it->first == module) {
+    return it->second;
+  }
+
+  for(const auto& region : regions_) {
+    if(region.path.find(module) != std::string::npos) {
+      return region.start;
+    }
+  }
+  return std::nullopt;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::vector<const MemoryRegion*> MemoryMap::readable_regions(const ScanFilter& filter) const {
+  std::vector<const MemoryRegion*> regions;
+
+  for(const auto& region : regions_) {
+    if(not region.readable()) continue;
+    if(region.path == "[vvar]" || region.path == "[vsyscall]") continue;
+
+    const bool has_permissions = std::all_of(filter.permissions.begin(), filter.permissions.end(), [&](char flag) {
+      return flag == '-' || region.permissions.find(flag) != std::string::npos;
+    });
+    if(not has_permissions) continue;
+    if(not filter.module.empty() && region.path.find(filter.module) == std::string::npos) continue;
+
+    regions.push_back(&region);
+  }
+  return regions;
+}
+
+}
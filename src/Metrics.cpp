@@ -0,0 +1,216 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace cpppwn {
+  namespace {
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_number(std::string& out, uint64_t value) {
+      char buffer[24];
+      const auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+      out.append(buffer, end);
+    }
+
+    void append_number(std::string& out, int64_t value) {
+      char buffer[24];
+      const auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+      out.append(buffer, end);
+    }
+
+    void append_number(std::string& out, double value) {
+      char buffer[32];
+      const auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+      out.append(buffer, end);
+    }
+
+    //----------------------------------------
+    // label values may hold anything but \, " and newlines
+    //----------------------------------------
+    void append_label_value(std::string& out, std::string_view value) {
+      for(const char c : value) {
+        if(c == '\\') out += "\\\\";
+        else if(c == '"') out += "\\\"";
+        else if(c == '\n') out += "\\n";
+        else out += c;
+      }
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void append_header(std::string& out, std::string_view name, std::string_view type, std::string_view help) {
+      out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+      out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    //----------------------------------------
+    // a series without labels
+    //----------------------------------------
+    template<typename T>
+    void append_sample(std::string& out, std::string_view name, std::string_view type, std::string_view help, T value) {
+      append_header(out, name, type, help);
+      out.append(name).append(" ");
+      append_number(out, value);
+      out += '\n';
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    std::string route_labels(const RouteMetrics& route) {
+      std::string labels = "method=\"";
+      append_label_value(labels, route.method);
+      labels += "\",route=\"";
+      append_label_value(labels, route.route);
+      labels += '"';
+      return labels;
+    }
+  }
+
+//----------------------------------------
+//
+//----------------------------------------
+void LatencyHistogram::observe(std::chrono::nanoseconds elapsed) noexcept {
+  const auto ns = static_cast<uint64_t>(std::max<int64_t>(0, elapsed.count()));
+  const auto bucket = std::lower_bound(bounds_us.begin(), bounds_us.end(), (ns + 999) / 1000) - bounds_us.begin();
+
+  buckets_[static_cast<size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+//----------------------------------------
+// buckets are stored apart and summed up here, so observe()
+// touches a single one
+//----------------------------------------
+void LatencyHistogram::render(std::string& out, std::string_view name, std::string_view labels) const {
+  uint64_t cumulative = 0;
+  for(size_t i = 0; i < buckets_.size(); ++i) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+
+    out.append(name).append("_bucket{").append(labels).append(",le=\"");
+    if(i < bounds_us.size()) {
+      append_number(out, static_cast<double>(bounds_us[i]) / 1e6);
+    } else {
+      out += "+Inf";
+    }
+    out += "\"} ";
+    append_number(out, cumulative);
+    out += '\n';
+  }
+
+  out.append(name).append("_sum{").append(labels).append("} ");
+  append_number(out, static_cast<double>(sum_ns_.load(std::memory_order_relaxed)) / 1e9);
+  out += '\n';
+
+  out.append(name).append("_count{").append(labels).append("} ");
+  append_number(out, cumulative);
+  out += '\n';
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void RouteMetrics::observe(int status, std::chrono::nanoseconds elapsed) noexcept {
+  const int status_class = std::clamp(status / 100, 1, 5);
+  responses[static_cast<size_t>(status_class - 1)].fetch_add(1, std::memory_order_relaxed);
+  latency.observe(elapsed);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+ServerMetrics::ServerMetrics() : unmatched_(std::make_shared<RouteMetrics>()) {
+  unmatched_->route = "unmatched";
+}
+
+//----------------------------------------
+// called while routes are registered, never per request
+//----------------------------------------
+std::shared_ptr<RouteMetrics> ServerMetrics::route(std::string_view method, std::string_view pattern) {
+  if constexpr(not metrics_enabled) {
+    return nullptr;
+  }
+
+  std::lock_guard lock(mutex_);
+  for(const auto& route : routes_) {
+    if(route->method == method && route->route == pattern) {
+      return route;
+    }
+  }
+
+  auto route = std::make_shared<RouteMetrics>();
+  route->method = method;
+  route->route = pattern;
+  routes_.push_back(route);
+  return route;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void ServerMetrics::connection_opened() noexcept {
+  active_connections_.fetch_add(1, std::memory_order_relaxed);
+  connections_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::connection_closed() noexcept {
+  active_connections_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string ServerMetrics::render() const {
+  std::lock_guard lock(mutex_);
+
+  std::vector<const RouteMetrics*> routes;
+  routes.reserve(routes_.size() + 1);
+  for(const auto& route : routes_) {
+    routes.push_back(route.get());
+  }
+  routes.push_back(unmatched_.get());
+
+  std::string out;
+  out.reserve(512 + routes.size() * 2048);
+
+  static constexpr std::array<std::string_view, 5> classes{"1xx", "2xx", "3xx", "4xx", "5xx"};
+
+  append_header(out, "cpppwn_http_requests_total", "counter", "Responses sent, by route and status class.");
+  for(const RouteMetrics* route : routes) {
+    const std::string labels = route_labels(*route);
+    for(size_t i = 0; i < classes.size(); ++i) {
+      const uint64_t count = route->responses[i].load(std::memory_order_relaxed);
+      if(count == 0) {
+        continue;
+      }
+      out.append("cpppwn_http_requests_total{").append(labels).append(",status=\"").append(classes[i]).append("\"} ");
+      append_number(out, count);
+      out += '\n';
+    }
+  }
+
+  append_header(out, "cpppwn_http_request_duration_seconds", "histogram",
+    "Time from reading a request to having sent its response.");
+  for(const RouteMetrics* route : routes) {
+    route->latency.render(out, "cpppwn_http_request_duration_seconds", route_labels(*route));
+  }
+
+  append_sample(out, "cpppwn_http_active_connections", "gauge", "Connections open right now.",
+    active_connections_.load(std::memory_order_relaxed));
+  append_sample(out, "cpppwn_http_connections_total", "counter", "Connections accepted.",
+    connections_.load(std::memory_order_relaxed));
+  append_sample(out, "cpppwn_http_received_bytes_total", "counter", "Request heads and bodies received.",
+    bytes_received_.load(std::memory_order_relaxed));
+  append_sample(out, "cpppwn_http_sent_bytes_total", "counter", "Response heads and bodies sent.",
+    bytes_sent_.load(std::memory_order_relaxed));
+  append_sample(out, "cpppwn_http_errors_total", "counter", "Connections dropped by an error while serving them.",
+    errors_.load(std::memory_order_relaxed));
+
+  return out;
+}
+
+}
@@ -10,6 +10,10 @@
 #include <signal.h>
 #include <dlfcn.h>
 
+#include <asio/redirect_error.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
 #include <stdexcept>
 #include <system_error>
 #include <vector>
@@ -27,6 +31,8 @@
 #include <optional>
 #include <array>
 #include <span>
+#include <mutex>
+#include <limits>
 
 namespace fs = std::filesystem;
 
@@ -168,39 +174,226 @@ std::string readFileContent(const fs::path& path) {
 }
     
 //----------------------------------------
-// Parse byte pattern with wildcards
+// one unit of scan work, a slice of a region
 //----------------------------------------
-std::vector<std::optional<std::byte>> parseSignature(std::string_view signature) {
-  std::vector<std::optional<std::byte>> pattern;
-  std::istringstream iss{std::string(signature)};
-  std::string token;
-        
-  while(iss >> token) {
-    if(token == "?" || token == "??") {
-      pattern.push_back(std::nullopt);
-    } else {
-      pattern.push_back(std::byte{static_cast<unsigned char>(std::stoi(token, nullptr, 16))});
+struct ScanChunk {
+  address_t start;
+  size_t size;      // bytes a match may start in
+  size_t read_size; // size plus the overlap into the next slice
+};
+
+constexpr size_t kScanChunkSize = 1 << 20;
+
+//----------------------------------------
+// reads as much of [address, address + size) as is mapped.
+// process_vm_readv first, /proc/[pid]/mem if that is refused.
+//----------------------------------------
+size_t readChunk(pid_t pid, int mem_fd, address_t address, std::byte* buffer, size_t size) {
+  iovec local{buffer, size};
+  iovec remote{reinterpret_cast<void*>(address), size};
+
+  const ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+  if(n >= 0) {
+    return static_cast<size_t>(n);
+  }
+
+  if((errno == EPERM || errno == ENOSYS) && mem_fd >= 0) {
+    const ssize_t m = pread(mem_fd, buffer, size, static_cast<off_t>(address));
+    return m > 0 ? static_cast<size_t>(m) : 0;
+  }
+  return 0;
+}
+
+//----------------------------------------
+// splits the regions into overlapping chunks and hands them to
+// scan on all cores. skip is asked first so a chunk that can no
+// longer improve the result is never read.
+//----------------------------------------
+template<typename Skip, typename Scan>
+void forEachChunk(pid_t pid, int mem_fd, const std::vector<const MemoryRegion*>& regions, size_t overlap,
+                  Skip&& skip, Scan&& scan) {
+  std::vector<ScanChunk> chunks;
+  for(const auto* region : regions) {
+    for(address_t start = region->start; start < region->end; start += kScanChunkSize) {
+      const size_t size = std::min<size_t>(kScanChunkSize, region->end - start);
+      const size_t read_size = std::min<size_t>(size + overlap, region->end - start);
+      chunks.push_back({start, size, read_size});
     }
   }
-        
-  return pattern;
+
+  std::atomic<size_t> next_chunk{0};
+
+  const auto worker = [&] {
+    std::vector<std::byte> buffer(kScanChunkSize + overlap);
+
+    for(size_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+      const auto& chunk = chunks[i];
+      if(skip(chunk)) continue;
+
+      const size_t got = readChunk(pid, mem_fd, chunk.start, buffer.data(), chunk.read_size);
+      scan(chunk, std::span<const std::byte>(buffer.data(), got));
+    }
+  };
+
+  const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(1, chunks.size()));
+  std::vector<std::thread> threads;
+  for(size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for(auto& thread : threads) {
+    thread.join();
+  }
 }
-    
+
 //----------------------------------------
-// Match Pattern in Buffer
+// lowers best to candidate if that is smaller
 //----------------------------------------
-bool matchPattern(std::span<const std::byte> buffer, std::span<const std::optional<std::byte>> pattern) {
-  if(buffer.size() < pattern.size()) return false;
-        
-    for(size_t i = 0; i < pattern.size(); ++i) {
-      if(pattern[i].has_value() && buffer[i] != *pattern[i]) {
-        return false;
-      }
+void storeMinimum(std::atomic<address_t>& best, address_t candidate) noexcept {
+  address_t current = best.load(std::memory_order_relaxed);
+  while(candidate < current && not best.compare_exchange_weak(current, candidate)) {
+  }
+}
+
+//----------------------------------------
+// "0x" followed by the address in hex, for error messages
+//----------------------------------------
+std::string hexAddress(address_t address) {
+  std::ostringstream out;
+  out << "0x" << std::hex << address;
+  return out.str();
+}
+
+//----------------------------------------
+// reads or writes all of data at address through /proc/[pid]/mem,
+// which unlike process_vm_writev can also patch read-only pages
+//----------------------------------------
+void preadFully(int mem_fd, address_t address, std::byte* data, size_t size) {
+  while(size > 0) {
+    const ssize_t n = pread(mem_fd, data, size, static_cast<off_t>(address));
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) {
+      throw std::system_error(n < 0 ? errno : EIO, std::system_category(),
+        "Failed to read memory at " + hexAddress(address));
+    }
+    address += static_cast<size_t>(n);
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+void pwriteFully(int mem_fd, address_t address, const std::byte* data, size_t size) {
+  while(size > 0) {
+    const ssize_t n = pwrite(mem_fd, data, size, static_cast<off_t>(address));
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) {
+      throw std::system_error(n < 0 ? errno : EIO, std::system_category(),
+        "Failed to write memory at " + hexAddress(address));
+    }
+    address += static_cast<size_t>(n);
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+// iovecs per process_vm_readv/writev call, well below IOV_MAX
+constexpr size_t kMaxBatch = 256;
+
+//----------------------------------------
+// moves every op through process_vm_readv/writev, kMaxBatch at
+// a time. the op a call stopped in is finished by fallback, as
+// is every op once the syscalls turn out to be refused.
+//----------------------------------------
+template<typename Op, typename VmCall, typename Fallback>
+void transferBatched(std::span<const Op> ops, std::atomic<bool>& vm_available, VmCall&& vm_call, Fallback&& fallback) {
+  std::array<iovec, kMaxBatch> local;
+  std::array<iovec, kMaxBatch> remote;
+
+  size_t index = 0;
+  while(index < ops.size()) {
+    if(not vm_available) {
+      fallback(ops[index++], 0);
+      continue;
+    }
+
+    const size_t end = index + std::min(kMaxBatch, ops.size() - index);
+    for(size_t i = index; i < end; ++i) {
+      local[i - index] = {const_cast<std::byte*>(ops[i].data.data()), ops[i].data.size()};
+      remote[i - index] = {reinterpret_cast<void*>(ops[i].address), ops[i].data.size()};
+    }
+
+    const ssize_t n = vm_call(local.data(), remote.data(), end - index);
+    if(n < 0 && (errno == EPERM || errno == ENOSYS)) {
+      vm_available = false;
+      continue;
+    }
+
+    size_t done = n > 0 ? static_cast<size_t>(n) : 0;
+    while(index < end && done >= ops[index].data.size()) {
+      done -= ops[index++].data.size();
+    }
+    if(index < end) {
+      fallback(ops[index++], done);
     }
-    return true;
   }
 }
 
+constexpr address_t kNoMatch = std::numeric_limits<address_t>::max();
+
+//----------------------------------------
+// scans readable memory of pid for signature. with first_only
+// the scan settles on the lowest match and skips any chunk above
+// the best one found so far.
+//----------------------------------------
+std::vector<address_t> scanMemory(pid_t pid, int mem_fd, const std::vector<const MemoryRegion*>& regions,
+                                  const Signature& signature, size_t max_matches, bool first_only) {
+  if(signature.empty() || max_matches == 0) {
+    return {};
+  }
+
+  std::atomic<address_t> best{kNoMatch};
+  std::mutex results_mutex;
+  std::vector<address_t> results;
+
+  forEachChunk(pid, mem_fd, regions, signature.size() - 1,
+    [&](const ScanChunk& chunk) {
+      return first_only && chunk.start >= best.load(std::memory_order_relaxed);
+    },
+    [&](const ScanChunk& chunk, std::span<const std::byte> data) {
+      thread_local std::vector<size_t> hits;
+      hits.clear();
+      signature.scan(data, hits, first_only ? 1 : max_matches);
+
+      // matches starting in the overlap belong to the next chunk
+      while(not hits.empty() && hits.back() >= chunk.size) {
+        hits.pop_back();
+      }
+      if(hits.empty()) return;
+
+      if(first_only) {
+        storeMinimum(best, chunk.start + hits.front());
+        return;
+      }
+
+      std::lock_guard lock(results_mutex);
+      for(const size_t offset : hits) {
+        results.push_back(chunk.start + offset);
+      }
+    });
+
+  if(first_only) {
+    return best == kNoMatch ? std::vector<address_t>{} : std::vector<address_t>{best.load()};
+  }
+
+  std::sort(results.begin(), results.end());
+  if(results.size() > max_matches) {
+    results.resize(max_matches);
+  }
+  return results;
+}
+
+} // anon namespace
+
 //----------------------------------------
 // Attach to a running process by name
 //----------------------------------------
@@ -353,9 +546,28 @@ void Process::send(const std::string& data) {
     throw std::runtime_error("Cannot send data: process not started with pipes");
   }
     
-  const ssize_t written = write(child_stdin_, data.data(), data.size());
-  if(written < 0) {
-    throw std::system_error(errno, std::system_category(), "write() failed");
+  send_bytes(data);
+}
+
+//----------------------------------------
+// Send raw bytes to process stdin, all of them
+//----------------------------------------
+void Process::send_bytes(std::span<const char> data) {
+  if(child_stdin_ == -1) {
+    throw std::runtime_error("Cannot send data: process not started with pipes");
+  }
+
+  while(not data.empty()) {
+    const ssize_t written = ::write(child_stdin_, data.data(), data.size());
+    if(written < 0 && errno == EINTR) continue;
+    if(written < 0 && errno == EAGAIN) {
+      wait_ready(child_stdin_, POLLOUT);
+      continue;
+    }
+    if(written < 0) {
+      throw std::system_error(errno, std::system_category(), "write() failed");
+    }
+    data = data.subspan(static_cast<size_t>(written));
   }
 }
 
@@ -381,44 +593,115 @@ int Process::getOutputStream() noexcept {
 }
 
 //----------------------------------------
-// Receive fixed amount of data
+// Read as much as the pipe has into recv_buf_, false on EOF
 //----------------------------------------
-std::string Process::recv(std::size_t size) {
+bool Process::fill_recv_buffer() {
+  auto space = recv_buf_.prepare(16 * 1024);
+
+  ssize_t n;
+  while(true) {
+    n = ::read(child_stdout_, space.data(), space.size());
+    if(n < 0 && errno == EINTR) continue;
+    // awaiting the pipe left it non-blocking
+    if(n < 0 && errno == EAGAIN) {
+      wait_ready(child_stdout_, POLLIN);
+      continue;
+    }
+    break;
+  }
+
+  if(n < 0) {
+    throw std::system_error(errno, std::system_category(), "read() failed");
+  }
+
+  recv_buf_.commit(static_cast<size_t>(n));
+  return n > 0;
+}
+
+//----------------------------------------
+// Receive into buffer, buffered data first. 0 on EOF.
+//----------------------------------------
+std::size_t Process::recv_into(std::span<char> buffer) {
   if(child_stdout_ == -1) {
     throw std::runtime_error("Cannot receive data: process not started with pipes");
   }
-    
-  std::vector<char> buf(size);
-  const ssize_t n = read(child_stdout_, buf.data(), size);
-    
+
+  if(not recv_buf_.empty()) {
+    const size_t len = std::min(buffer.size(), recv_buf_.size());
+    std::memcpy(buffer.data(), recv_buf_.data().data(), len);
+    recv_buf_.consume(len);
+    return len;
+  }
+
+  ssize_t n;
+  while(true) {
+    n = ::read(child_stdout_, buffer.data(), buffer.size());
+    if(n < 0 && errno == EINTR) continue;
+    if(n < 0 && errno == EAGAIN) {
+      wait_ready(child_stdout_, POLLIN);
+      continue;
+    }
+    break;
+  }
+
   if(n < 0) {
     throw std::system_error(errno, std::system_category(), "read() failed");
   }
+  return static_cast<size_t>(n);
+}
+
+//----------------------------------------
+// Hand out what was read ahead
+//----------------------------------------
+std::string Process::take_buffered() {
+  std::string ahead(recv_buf_.data());
+  recv_buf_.clear();
+  return ahead;
+}
+
+//----------------------------------------
+// Receive up to size bytes, buffered data first
+//----------------------------------------
+std::string Process::recv(std::size_t size) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
     
-  return std::string(buf.begin(), buf.begin() + n);
+  if(recv_buf_.empty()) {
+    fill_recv_buffer();
+  }
+
+  const size_t n = std::min(size, recv_buf_.size());
+  std::string result(recv_buf_.data().substr(0, n));
+  recv_buf_.consume(n);
+  return result;
 }
 
 //----------------------------------------
-// Receive until delimiter
+// Receive until delimiter, or everything left on EOF
 //----------------------------------------
 std::string Process::recvuntil(const std::string& delim) {
   if(child_stdout_ == -1) {
     throw std::runtime_error("Cannot receive data: process not started with pipes");
   }
     
-  std::string out;
-  out.reserve(1024); // Pre-allocate for efficiency
-    
-  char ch;
-  while(read(child_stdout_, &ch, 1) == 1) {
-    out += ch;
-        
-    if(out.size() >= delim.size() &&
-      std::string_view(out).substr(out.size() - delim.size()) == delim) {
-      break;
+  // only bytes that arrived since the last miss are searched
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    if(not fill_recv_buffer()) {
+      std::string out(recv_buf_.data());
+      recv_buf_.clear();
+      return out;
     }
+    pos = recv_buf_.find(delim, searched);
   }
-    
+
+  const size_t len = pos + delim.size();
+  std::string out(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
   return out;
 }
 
@@ -437,17 +720,294 @@ std::string Process::recvall() {
     throw std::runtime_error("Cannot receive data: process not started with pipes");
   }
     
-  std::string result;
-  std::array<char, 4096> buf;
-  ssize_t n;
-    
-  while((n = read(child_stdout_, buf.data(), buf.size())) > 0) {
-    result.append(buf.data(), n);
+  while(fill_recv_buffer()) {
   }
     
+  std::string result(recv_buf_.data());
+  recv_buf_.clear();
   return result;
 }
 
+//----------------------------------------
+// Receive up to size bytes, empty on timeout
+//----------------------------------------
+std::string Process::recv(std::size_t size, std::chrono::milliseconds timeout) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  if(recv_buf_.empty() && not wait_readable(child_stdout_, std::chrono::steady_clock::now() + timeout)) {
+    return {};
+  }
+  return recv(size);
+}
+
+//----------------------------------------
+// Receive until delimiter, empty on timeout
+//----------------------------------------
+std::string Process::recvuntil(const std::string& delim, std::chrono::milliseconds timeout) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    if(not wait_readable(child_stdout_, deadline)) {
+      return {};
+    }
+    if(not fill_recv_buffer()) {
+      std::string out(recv_buf_.data());
+      recv_buf_.clear();
+      return out;
+    }
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  std::string out(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
+  return out;
+}
+
+//----------------------------------------
+// Receive line, empty on timeout
+//----------------------------------------
+std::string Process::recvline(std::chrono::milliseconds timeout) {
+  return recvuntil("\n", timeout);
+}
+
+//----------------------------------------
+// Bind the pipes to the awaiting coroutine's executor
+//----------------------------------------
+asio::awaitable<void> Process::bind_pipes() {
+  const auto executor = co_await asio::this_coro::executor;
+
+  if(not async_stdin_ && child_stdin_ != -1) {
+    async_stdin_.emplace(executor, child_stdin_);
+  }
+  if(not async_stdout_ && child_stdout_ != -1) {
+    async_stdout_.emplace(executor, child_stdout_);
+  }
+}
+
+//----------------------------------------
+// Hand the pipes back from asio without closing them
+//----------------------------------------
+void Process::release_pipes() noexcept {
+  if(async_stdin_) {
+    (void)async_stdin_->release();
+    async_stdin_.reset();
+  }
+  if(async_stdout_) {
+    (void)async_stdout_->release();
+    async_stdout_.reset();
+  }
+}
+
+//----------------------------------------
+// Await as much as the pipe has into recv_buf_, false on EOF
+//----------------------------------------
+asio::awaitable<bool> Process::async_fill_recv_buffer() {
+  auto space = recv_buf_.prepare(16 * 1024);
+
+  asio::error_code ec;
+  const size_t n = co_await async_stdout_->async_read_some(asio::buffer(space.data(), space.size()),
+                                                           asio::redirect_error(asio::use_awaitable, ec));
+  if(ec == asio::error::eof) {
+    co_return false;
+  }
+  if(ec) {
+    throw asio::system_error(ec);
+  }
+
+  recv_buf_.commit(n);
+  co_return true;
+}
+
+//----------------------------------------
+// Timed fill, false on timeout and eof set on EOF
+//----------------------------------------
+asio::awaitable<bool> Process::async_fill_recv_buffer(std::chrono::steady_clock::time_point deadline, bool& eof) {
+  bool filled = false;
+  const bool in_time = co_await await_until(*async_stdout_, deadline, [&]() -> asio::awaitable<void> {
+    filled = co_await async_fill_recv_buffer();
+  });
+
+  eof = in_time && not filled;
+  co_return in_time;
+}
+
+//----------------------------------------
+// Send data to process stdin, all of it
+//----------------------------------------
+asio::awaitable<void> Process::async_send(std::string data) {
+  if(child_stdin_ == -1) {
+    throw std::runtime_error("Cannot send data: process not started with pipes");
+  }
+
+  co_await bind_pipes();
+  co_await asio::async_write(*async_stdin_, asio::buffer(data), asio::use_awaitable);
+}
+
+//----------------------------------------
+// Send line to process stdin
+//----------------------------------------
+asio::awaitable<void> Process::async_sendline(std::string data) {
+  data += '\n';
+  co_await async_send(std::move(data));
+}
+
+//----------------------------------------
+// Receive up to size bytes, buffered data first
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recv(std::size_t size) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  co_await bind_pipes();
+  if(recv_buf_.empty()) {
+    co_await async_fill_recv_buffer();
+  }
+
+  const size_t n = std::min(size, recv_buf_.size());
+  std::string result(recv_buf_.data().substr(0, n));
+  recv_buf_.consume(n);
+  co_return result;
+}
+
+//----------------------------------------
+// Receive until delimiter, or everything left on EOF
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recvuntil(std::string delim) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  co_await bind_pipes();
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    if(not co_await async_fill_recv_buffer()) {
+      std::string out(recv_buf_.data());
+      recv_buf_.clear();
+      co_return out;
+    }
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  std::string out(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
+  co_return out;
+}
+
+//----------------------------------------
+// Receive line
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recvline() {
+  co_return co_await async_recvuntil("\n");
+}
+
+//----------------------------------------
+// Receive everything until EOF
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recvall() {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  co_await bind_pipes();
+  while(co_await async_fill_recv_buffer()) {
+  }
+
+  std::string result(recv_buf_.data());
+  recv_buf_.clear();
+  co_return result;
+}
+
+//----------------------------------------
+// Receive up to size bytes, empty on timeout
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recv(std::size_t size, std::chrono::milliseconds timeout) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  co_await bind_pipes();
+  if(recv_buf_.empty()) {
+    bool eof = false;
+    if(not co_await async_fill_recv_buffer(std::chrono::steady_clock::now() + timeout, eof) || eof) {
+      co_return std::string();
+    }
+  }
+
+  const size_t n = std::min(size, recv_buf_.size());
+  std::string result(recv_buf_.data().substr(0, n));
+  recv_buf_.consume(n);
+  co_return result;
+}
+
+//----------------------------------------
+// Receive until delimiter, empty on timeout
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recvuntil(std::string delim, std::chrono::milliseconds timeout) {
+  if(child_stdout_ == -1) {
+    throw std::runtime_error("Cannot receive data: process not started with pipes");
+  }
+
+  co_await bind_pipes();
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+
+    bool eof = false;
+    if(not co_await async_fill_recv_buffer(deadline, eof)) {
+      co_return std::string();
+    }
+    if(eof) {
+      std::string out(recv_buf_.data());
+      recv_buf_.clear();
+      co_return out;
+    }
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  std::string out(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
+  co_return out;
+}
+
+//----------------------------------------
+// Receive line, empty on timeout
+//----------------------------------------
+asio::awaitable<std::string> Process::async_recvline(std::chrono::milliseconds timeout) {
+  co_return co_await async_recvuntil("\n", timeout);
+}
+
+//----------------------------------------
+// Check whether output is ready
+//----------------------------------------
+bool Process::can_recv(std::chrono::milliseconds timeout) {
+  if(child_stdout_ == -1) {
+    return false;
+  }
+  return not recv_buf_.empty() || wait_readable(child_stdout_, std::chrono::steady_clock::now() + timeout);
+}
+
 //----------------------------------------
 // Check if process is alive
 //----------------------------------------
@@ -463,6 +1023,8 @@ bool Process::is_alive() const noexcept {
 // Close process and cleanup
 //----------------------------------------
 void Process::close() {
+  release_pipes();
+
   if(child_stdin_ != -1) {
     ::close(child_stdin_);
     child_stdin_ = -1;
@@ -473,6 +1035,12 @@ void Process::close() {
     child_stdout_ = -1;
   }
 
+  if(process_handle_ != -1) {
+    ::close(process_handle_);
+    process_handle_ = -1;
+  }
+  memory_map_.reset();
+
   if(pid_ > 0) {
     kill(pid_, SIGTERM);
     waitpid(pid_, nullptr, 0);
@@ -498,120 +1066,174 @@ void Process::interactive() {
 Process::~Process() {
   if(is_alive()) {
     close();
+  } else if(process_handle_ != -1) {
+    ::close(process_handle_);
   }
 }
 
 //----------------------------------------
 // Find signature/pattern in process memory
 //----------------------------------------
-std::optional<address_t> Process::findSignature(const std::string& signature) {
+std::optional<address_t> Process::findSignature(const std::string& signature, const ScanFilter& filter) {
+  return findSignature(Signature(signature), filter);
+}
+
+//----------------------------------------
+// Lowest address matching a compiled signature
+//----------------------------------------
+std::optional<address_t> Process::findSignature(const Signature& signature, const ScanFilter& filter) {
   if(pid_ < 1) {
     throw std::runtime_error("No valid process");
   }
-    
-  // Parse signature pattern
-  const auto pattern = parseSignature(signature);
-  if(pattern.empty()) {
+
+  const auto matches = scanMemory(pid_, memoryHandle(), memoryMap().readable_regions(filter), signature, 1, true);
+  if(matches.empty()) {
     return std::nullopt;
   }
-    
-  // Read /proc/[pid]/maps to find memory regions
-  const fs::path maps_path = fs::path("/proc") / std::to_string(pid_) / "maps";
-  std::ifstream maps_file(maps_path);
-    
-  if(not maps_file) {
-    throw std::system_error(errno, std::system_category(), "Cannot open " + maps_path.string());
-  }
-    
-  const fs::path mem_path = fs::path("/proc") / std::to_string(pid_) / "mem";
-    
-  std::string line;
-  while(std::getline(maps_file, line)) {
-    std::istringstream line_stream(line);
-    std::string addr_range, perms;
-    line_stream >> addr_range >> perms;
-        
-    // Only search readable regions
-    if(perms[0] != 'r') continue;
-        
-    // Parse address range
-    const size_t dash_pos = addr_range.find('-');
-    const address_t start = std::stoull(addr_range.substr(0, dash_pos), nullptr, 16);
-    const address_t end = std::stoull(addr_range.substr(dash_pos + 1), nullptr, 16);
-    const size_t region_size = end - start;
-        
-    // Read memory region
-    FileDescriptor mem_fd(open(mem_path.c_str(), O_RDONLY));
-    if(not mem_fd.valid())
-      continue;
-        
-    std::vector<std::byte> buffer(region_size);
-    if(pread(mem_fd.get(), buffer.data(), region_size, start) != static_cast<ssize_t>(region_size)) {
-      continue;
-    }
-        
-    // Search for pattern using sliding window
-    for (size_t i{ 0 }; i <= buffer.size() - pattern.size(); ++i) {
-      std::span<const std::byte> window(buffer.data() + i, pattern.size());
-      if(matchPattern(window, pattern)) {
-        return start + i;
-      }
-    }
+  return matches.front();
+}
+
+//----------------------------------------
+// Every address matching a compiled signature
+//----------------------------------------
+std::vector<address_t> Process::findSignatureAll(const Signature& signature, size_t max_matches, const ScanFilter& filter) {
+  if(pid_ < 1) {
+    throw std::runtime_error("No valid process");
   }
-    
-  return std::nullopt;
+  return scanMemory(pid_, memoryHandle(), memoryMap().readable_regions(filter), signature, max_matches, false);
 }
 
 //----------------------------------------
-// Write to process memory
+// Lowest match of each signature, all in one pass over memory
 //----------------------------------------
-void Process::writeMemory(const address_t address, const buffer_t& buffer) {
+std::vector<std::optional<address_t>> Process::findSignatures(std::span<const Signature> signatures, const ScanFilter& filter) {
   if(pid_ < 1) {
     throw std::runtime_error("No valid process");
   }
-    
-  const fs::path mem_path = fs::path("/proc") / std::to_string(pid_) / "mem";
-  FileDescriptor mem_fd(open(mem_path.c_str(), O_WRONLY));
-    
-  if(not mem_fd.valid()) {
-    throw std::system_error(errno, std::system_category(), 
-      "Cannot open " + mem_path.string()
-    );
+
+  const SignatureSet set(signatures);
+  std::vector<std::atomic<address_t>> best(set.size());
+  for(auto& address : best) {
+    address.store(kNoMatch, std::memory_order_relaxed);
   }
-    
-  const ssize_t written = pwrite(mem_fd.get(), buffer.data(), buffer.size(), address);
-    
-  if(written != static_cast<ssize_t>(buffer.size())) {
-    throw std::system_error(errno, std::system_category(), 
-      "Failed to write memory at 0x" + std::to_string(address)
-    );
+
+  // lowest chunk start any signature still cares about
+  const auto still_needed = [&](address_t start) {
+    return std::any_of(best.begin(), best.end(), [&](const auto& address) {
+      return address.load(std::memory_order_relaxed) > start;
+    });
+  };
+
+  if(set.max_size() > 0) {
+    forEachChunk(pid_, memoryHandle(), memoryMap().readable_regions(filter), set.max_size() - 1,
+      [&](const ScanChunk& chunk) {
+        return not still_needed(chunk.start);
+      },
+      [&](const ScanChunk& chunk, std::span<const std::byte> data) {
+        set.scan(data, [&](size_t index, size_t offset) {
+          // matches starting in the overlap belong to the next chunk
+          if(offset < chunk.size) {
+            storeMinimum(best[index], chunk.start + offset);
+          }
+        });
+      });
+  }
+
+  std::vector<std::optional<address_t>> results;
+  results.reserve(best.size());
+  for(const auto& address : best) {
+    const address_t value = address.load();
+    results.push_back(value == kNoMatch ? std::nullopt : std::optional<address_t>(value));
   }
+  return results;
 }
 
 //----------------------------------------
-// Read from process memory
+// /proc/[pid]/mem, opened on first use and kept until close()
 //----------------------------------------
-buffer_t Process::readMemory(const address_t address, size_t size) {
+int Process::memoryHandle() {
+  std::lock_guard lock(memory_handle_mutex_);
+
+  if(process_handle_ != -1) {
+    return process_handle_;
+  }
   if(pid_ < 1) {
     throw std::runtime_error("No valid process");
   }
-    
+
   const fs::path mem_path = fs::path("/proc") / std::to_string(pid_) / "mem";
-  FileDescriptor mem_fd(open(mem_path.c_str(), O_RDONLY));
-    
-  if(not mem_fd.valid()) {
+  int fd = open(mem_path.c_str(), O_RDWR | O_CLOEXEC);
+  if(fd < 0 && (errno == EACCES || errno == EPERM)) {
+    fd = open(mem_path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if(fd < 0) {
     throw std::system_error(errno, std::system_category(), "Cannot open " + mem_path.string());
   }
-    
-  buffer_t buffer(size);
-  const ssize_t bytes_read = pread(mem_fd.get(), buffer.data(), size, address);
-    
-  if(bytes_read != static_cast<ssize_t>(size)) {
-    throw std::system_error(errno, std::system_category(), 
-        "Failed to read memory at 0x" + std::to_string(address)
-    );
+
+  process_handle_ = fd;
+  return fd;
+}
+
+//----------------------------------------
+// Write several ranges to process memory
+//----------------------------------------
+void Process::writeMemory(std::span<const MemoryWrite> writes) {
+  if(pid_ < 1) {
+    throw std::runtime_error("No valid process");
   }
-    
+
+  transferBatched(writes, vm_rw_available_,
+    [this](iovec* local, iovec* remote, size_t count) {
+      return process_vm_writev(pid_, local, count, remote, count, 0);
+    },
+    [this](const MemoryWrite& op, size_t offset) {
+      pwriteFully(memoryHandle(), op.address + offset, op.data.data() + offset, op.data.size() - offset);
+    });
+}
+
+//----------------------------------------
+// Write to process memory
+//----------------------------------------
+void Process::writeMemory(const address_t address, std::span<const std::byte> data) {
+  const MemoryWrite op{address, data};
+  writeMemory(std::span<const MemoryWrite>(&op, 1));
+}
+
+void Process::writeMemory(const address_t address, const buffer_t& buffer) {
+  writeMemory(address, std::span<const std::byte>(buffer));
+}
+
+//----------------------------------------
+// Read several ranges of process memory
+//----------------------------------------
+void Process::readMemory(std::span<const MemoryRead> reads) {
+  if(pid_ < 1) {
+    throw std::runtime_error("No valid process");
+  }
+
+  transferBatched(reads, vm_rw_available_,
+    [this](iovec* local, iovec* remote, size_t count) {
+      return process_vm_readv(pid_, local, count, remote, count, 0);
+    },
+    [this](const MemoryRead& op, size_t offset) {
+      preadFully(memoryHandle(), op.address + offset, op.data.data() + offset, op.data.size() - offset);
+    });
+}
+
+//----------------------------------------
+// Read from process memory into buffer
+//----------------------------------------
+void Process::readMemory(const address_t address, std::span<std::byte> buffer) {
+  const MemoryRead op{address, buffer};
+  readMemory(std::span<const MemoryRead>(&op, 1));
+}
+
+//----------------------------------------
+// Read from process memory
+//----------------------------------------
+buffer_t Process::readMemory(const address_t address, size_t size) {
+  buffer_t buffer(size);
+  readMemory(address, std::span<std::byte>(buffer));
   return buffer;
 }
 
@@ -622,42 +1244,39 @@ address_t Process::getBaseAddress(const std::string& module_name) {
   if(pid_ < 1) {
     throw std::runtime_error("No valid process");
   }
-    
-  const fs::path maps_path = fs::path("/proc") / std::to_string(pid_) / "maps";
-  std::ifstream maps_file(maps_path);
-    
-  if(not maps_file) {
-    throw std::system_error(errno, std::system_category(), "Cannot open " + maps_path.string());
-  }
-    
-  std::string line;
 
-  while(std::getline(maps_file, line)) {
-    bool is_target = false;
-        
-    if(module_name.empty()) {
-      // Find first executable mapping
-      std::istringstream iss(line);
-      std::string addr, perms;
-      iss >> addr >> perms;
-      is_target = (perms.find('x') != std::string::npos);
-    } else {
-      is_target = (line.find(module_name) != std::string::npos);
-    }
-        
-    if(is_target) {
-      std::istringstream iss(line);
-      std::string addr_range;
-      iss >> addr_range;
-            
-      const size_t dash_pos = addr_range.find('-');
-      return std::stoull(addr_range.substr(0, dash_pos), nullptr, 16);
+  const MemoryMap& map = memoryMap();
+
+  if(module_name.empty()) {
+    // Find first executable mapping
+    for(const auto& region : map.regions()) {
+      if(region.executable()) {
+        return region.start;
+      }
     }
+  } else if(const auto base = map.module_base(module_name)) {
+    return *base;
   }
     
   throw std::runtime_error("Module not found: " + (module_name.empty() ? "executable" : module_name));
 }
 
+//----------------------------------------
+// Mappings of the process
+//----------------------------------------
+const MemoryMap& Process::memoryMap() {
+  if(pid_ < 1) {
+    throw std::runtime_error("No valid process");
+  }
+
+  if(memory_map_.has_value() && memory_map_->pid() == pid_) {
+    memory_map_->refresh();
+  } else {
+    memory_map_.emplace(pid_);
+  }
+  return *memory_map_;
+}
+
 //----------------------------------------
 // Load library into target process using ptrace
 //----------------------------------------
@@ -687,29 +1306,8 @@ void Process::loadLibrary(const std::string& path) {
   regs = orig_regs;
     
   // Find libc base address
-  const fs::path maps_path = fs::path("/proc") / std::to_string(pid_) / "maps";
-  std::ifstream maps_file(maps_path);
-    
-  if(not maps_file.is_open()) {
-    throw std::system_error(errno, std::system_category(), "Cannot open " + maps_path.string());
-  }
-    
-  address_t libc_base = 0;
-  std::string line;
-    
-  while(std::getline(maps_file, line)) {
-    if(line.find("libc") != std::string::npos && 
-      line.find("r-xp") != std::string::npos) {
-      std::istringstream iss(line);
-      std::string addr_range;
-      iss >> addr_range;
-      const size_t dash = addr_range.find('-');
-      libc_base = std::stoull(addr_range.substr(0, dash), nullptr, 16);
-      break;
-    }
-  }
-    
-  if(libc_base < 1) {
+  const auto libc_base = memoryMap().module_base("libc.so.6");
+  if(not libc_base.has_value()) {
     throw std::runtime_error("Could not find libc in target process");
   }
     
@@ -743,44 +1341,21 @@ void Process::loadLibrary(const std::string& path) {
   }
     
   // Calculate dlopen offset
-  const fs::path self_maps_path{"/proc/self/maps"};
-  std::ifstream self_maps(self_maps_path);
-  address_t self_libc_base = 0;
-    
-  while(std::getline(self_maps, line)) {
-    if(line.find("libc") != std::string::npos && line.find("r-xp") != std::string::npos) {
-      std::istringstream iss(line);
-      std::string addr_range;
-      iss >> addr_range;
-      const size_t dash = addr_range.find('-');
-      self_libc_base = std::stoull(addr_range.substr(0, dash), nullptr, 16);
-      break;
-    }
-  }
-    
-  if(self_libc_base < 1) {
+  const auto self_libc_base = MemoryMap(getpid()).module_base("libc.so.6");
+  if(not self_libc_base.has_value()) {
     throw std::runtime_error("Could not determine libc base in current process");
   }
     
-  const address_t dlopen_offset = reinterpret_cast<address_t>(local_dlopen) - self_libc_base;
-  const address_t dlopen_addr = libc_base + dlopen_offset;
+  const address_t dlopen_offset = reinterpret_cast<address_t>(local_dlopen) - *self_libc_base;
+  const address_t dlopen_addr = *libc_base + dlopen_offset;
     
   // Setup memory for library path
   const address_t stack_addr = regs.rsp - 0x1000;
   const std::string lib_path_str = lib_path.string();
   const size_t path_len = lib_path_str.length() + 1;
     
-  const fs::path mem_path = fs::path("/proc") / std::to_string(pid_) / "mem";
-  FileDescriptor mem_fd(open(mem_path.c_str(), O_RDWR));
-    
-  if(not mem_fd.valid()) {
-    throw std::system_error(errno, std::system_category(), "Cannot open " + mem_path.string());
-  }
-    
   // Write path string
-  if(pwrite(mem_fd.get(), lib_path_str.c_str(), path_len, stack_addr) != static_cast<ssize_t>(path_len)) {
-    throw std::system_error(errno, std::system_category(), "Failed to write library path to process memory");
-  }
+  writeMemory(stack_addr, std::as_bytes(std::span(lib_path_str.c_str(), path_len)));
     
   // Setup registers for dlopen call (x86_64 calling convention)
   regs.rdi = stack_addr;                  // First argument: filename
@@ -792,14 +1367,11 @@ void Process::loadLibrary(const std::string& path) {
   const address_t return_addr = stack_addr + return_addr_offset;
   constexpr uint64_t trap = 0xCCCCCCCCCCCCCCCC; // INT3 instructions
     
-  if(pwrite(mem_fd.get(), &trap, sizeof(trap), return_addr) != sizeof(trap)) {
-    throw std::system_error(errno, std::system_category(), "Failed to write trap instruction");
-  }
-    
   regs.rsp = return_addr - 8;
-  if(pwrite(mem_fd.get(), &return_addr, sizeof(return_addr), regs.rsp) != sizeof(return_addr)) {
-    throw std::system_error(errno, std::system_category(), "Failed to write return address");
-  }
+  writeMemory(std::array{
+    MemoryWrite{return_addr, std::as_bytes(std::span(&trap, 1))},
+    MemoryWrite{regs.rsp, std::as_bytes(std::span(&return_addr, 1))}
+  });
     
   // Set modified registers and execute
   if(ptrace(PTRACE_SETREGS, pid_, nullptr, &regs) < 0) {
@@ -94,62 +94,72 @@ std::string RESTClient::build_url(const std::string& endpoint) const {
 }
 
 //----------------------------------------
-// Generic request with JSON body
+// Generic request in the client's wire format
 //----------------------------------------
-std::string RESTClient::request_json(
+HttpResponse RESTClient::send(
   const std::string& method,
   const std::string& endpoint,
-  const std::string& json_body,
+  const std::string* body,
   const HttpHeaders& headers) {
     
   auto full_headers = build_headers(headers);
-  full_headers["Content-Type"] = "application/json";
+  if(body) {
+    full_headers["Content-Type"] = std::string(content_type_of(format_));
+  }
+  if(format_ == WireFormat::Beve) {
+    full_headers["Accept"] = std::string(beve_content_type);
+  }
     
-  std::string url = build_url(endpoint);
-  auto response = client_.request(method, url, full_headers, json_body);
+  auto response = client_.request(method, build_url(endpoint), full_headers, body ? *body : std::string());
     
   if(not response.ok()) {
     throw RESTException(response.status_code, response.status_message, response.body);
   }
     
-  return response.body;
+  return response;
 }
 
 //----------------------------------------
-// GET request (raw JSON string)
+// Batch of requests, replies surface through the futures
 //----------------------------------------
-std::string RESTClient::get(const std::string& endpoint, const HttpHeaders& headers) {
+std::vector<std::future<HttpResponse>> RESTClient::send_batch(
+  const std::string& method,
+  const std::vector<std::pair<std::string, std::string>>& requests,
+  const HttpHeaders& headers) {
+
   auto full_headers = build_headers(headers);
-  std::string url = build_url(endpoint);
-    
-  auto response = client_.get(url, full_headers);
-    
-  if(not response.ok()) {
-    throw RESTException(response.status_code, response.status_message, response.body);
+  if(method != "GET") {
+    full_headers["Content-Type"] = std::string(content_type_of(format_));
+  }
+  if(format_ == WireFormat::Beve) {
+    full_headers["Accept"] = std::string(beve_content_type);
   }
-    
-  return response.body;
-}
 
-//----------------------------------------
-// POST request (raw JSON string)
-//----------------------------------------
-std::string RESTClient::post(const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers) { 
-  return request_json("POST", endpoint, json_body, headers);
-}
+  std::vector<BatchRequest> batch;
+  batch.reserve(requests.size());
 
-//----------------------------------------
-// PUT request (raw JSON string)
-//----------------------------------------
-std::string RESTClient::put(const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers) {
-  return request_json("PUT", endpoint, json_body, headers);
-}
+  for(const auto& [endpoint, body] : requests) {
+    batch.push_back(BatchRequest{method, build_url(endpoint), full_headers, body});
+  }
 
-//----------------------------------------
-// PATCH request (raw JSON string)
-//----------------------------------------
-std::string RESTClient::patch(const std::string& endpoint, const std::string& json_body, const HttpHeaders& headers) {
-  return request_json("PATCH", endpoint, json_body, headers);
+  auto responses = client_.request_batch(batch);
+
+  std::vector<std::future<HttpResponse>> checked;
+  checked.reserve(responses.size());
+
+  for(auto& response : responses) {
+    checked.push_back(std::async(std::launch::deferred, [response = std::move(response)]() mutable {
+      HttpResponse result = response.get();
+
+      if(not result.ok()) {
+        throw RESTException(result.status_code, result.status_message, result.body);
+      }
+
+      return result;
+    }));
+  }
+
+  return checked;
 }
 
 //----------------------------------------
@@ -169,9 +179,9 @@ std::string RESTClient::del(const std::string& endpoint, const HttpHeaders& head
 }
 
 //----------------------------------------
-// List resources (GET collection)
+// Collection endpoint with its query string
 //----------------------------------------
-std::string RESTClient::list(const std::string& resource, const std::map<std::string, std::string>& query_params, const HttpHeaders& headers) {
+std::string RESTClient::list_endpoint(const std::string& resource, const std::map<std::string, std::string>& query_params) {
   std::string endpoint = "/" + resource;
     
   if(not query_params.empty()) {
@@ -185,35 +195,7 @@ std::string RESTClient::list(const std::string& resource, const std::map<std::st
     }
   }
     
-  return get(endpoint, headers);
-}
-
-//----------------------------------------
-// Get single resource
-//----------------------------------------
-std::string RESTClient::retrieve(const std::string& resource, const std::string& id, const HttpHeaders& headers) {
-  return get("/" + resource + "/" + id, headers);
-}
-
-//----------------------------------------
-// Create resource (POST)
-//----------------------------------------
-std::string RESTClient::create(const std::string& resource, const std::string& json_body, const HttpHeaders& headers) {
-  return post("/" + resource, json_body, headers);
-}
-
-//----------------------------------------
-// Update resource (PUT)
-//----------------------------------------
-std::string RESTClient::update(const std::string& resource, const std::string& id, const std::string& json_body, const HttpHeaders& headers) {
-  return put("/" + resource + "/" + id, json_body, headers);
-}
-
-//----------------------------------------
-// Partial update (PATCH)
-//----------------------------------------
-std::string RESTClient::partial_update(const std::string& resource, const std::string& id, const std::string& json_body, const HttpHeaders& headers) {
-  return patch("/" + resource + "/" + id, json_body, headers);
+  return endpoint;
 }
 
 //----------------------------------------
@@ -237,15 +219,11 @@ PaginatedResponse RESTClient::get_paginated(
   url += "page=" + std::to_string(page);
   url += "&per_page=" + std::to_string(per_page);
     
-  auto full_headers = build_headers(headers);
-  auto response = client_.get(build_url(url), full_headers);
-    
-  if(not response.ok()) {
-    throw RESTException(response.status_code, response.status_message, response.body);
-  }
+  auto response = send("GET", url, nullptr, headers);
     
   PaginatedResponse result;
-  result.data = response.body;
+  result.data = std::move(response.body);
+  result.content_type = response.get_header("content-type");
   result.page = page;
   result.per_page = per_page;
     
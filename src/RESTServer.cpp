@@ -8,15 +8,17 @@ namespace cpppwn {
 //----------------------------------------
 //
 //----------------------------------------
-RESTServer::RESTServer(uint16_t port, const std::string& bind_addr): server_(port, bind_addr) {
+RESTServer::RESTServer(uint16_t port, const std::string& bind_addr, const ServerOptions& options)
+  : server_(port, bind_addr, options) {
   setup_error_handlers();
 }
 
 //----------------------------------------
 //
 //----------------------------------------
-RESTServer::RESTServer(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr)
-  : server_(port, tls_config, bind_addr) {
+RESTServer::RESTServer(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr,
+  const ServerOptions& options)
+  : server_(port, tls_config, bind_addr, options) {
     setup_error_handlers();
 }
 
@@ -131,51 +133,38 @@ void RESTServer::resource(const std::string& name, const ResourceHandlers& handl
     
   // RETRIEVE: GET /resource/:id
   if(handlers.retrieve) {
-    get(id_path, [handlers, name](const HttpRequest& req) {
-      // Extract ID from path
-      std::string id = extract_id_from_path(req.path, name);
+    get(id_path, [handlers](const HttpRequest& req) {
+      std::string id = req.get_path_param("id");
       return handlers.retrieve(req, id);
     });
   }
     
   // UPDATE: PUT /resource/:id
   if(handlers.update) {
-    put(id_path, [handlers, name](const HttpRequest& req) {
-      std::string id = extract_id_from_path(req.path, name);
+    put(id_path, [handlers](const HttpRequest& req) {
+      std::string id = req.get_path_param("id");
       return handlers.update(req, id);
     });
   }
     
   // PARTIAL_UPDATE: PATCH /resource/:id
   if(handlers.partial_update) {
-    patch(id_path, [handlers, name](const HttpRequest& req) {
-      std::string id = extract_id_from_path(req.path, name);
+    patch(id_path, [handlers](const HttpRequest& req) {
+      std::string id = req.get_path_param("id");
       return handlers.partial_update(req, id);
     });
   }
     
   // DELETE: DELETE /resource/:id
   if(handlers.destroy) {
-    del(id_path, [handlers, name](const HttpRequest& req) {
-      std::string id = extract_id_from_path(req.path, name);
+    del(id_path, [handlers](const HttpRequest& req) {
+      std::string id = req.get_path_param("id");
       handlers.destroy(req, id);
       return json_response(204); // No Content
     });
   }
 }
 
-//----------------------------------------
-// Extract ID from path like /users/123
-//----------------------------------------
-std::string RESTServer::extract_id_from_path(const std::string& path, const std::string& resource) {
-  // Path format: /resource/id
-  std::string prefix = "/" + resource + "/";
-  if(path.find(prefix) == 0) {
-    return path.substr(prefix.length());
-  }
-  return "";
-}
-
 //----------------------------------------
 // Middleware
 //----------------------------------------
@@ -222,15 +211,23 @@ HttpResponse RESTServer::json_response(
   int status_code,
   const std::map<std::string, std::string>& data) {
     
-  std::string json = "{";
-  bool first = true;
-  for(const auto& [key, value] : data) {
-    if(not first) json += ",";
-      json += "\"" + key + "\":\"" + value + "\"";
-      first = false;
+  // glaze escapes quotes and control characters in messages
+  return encode_response(status_code, data, WireFormat::Json);
+}
+
+//----------------------------------------
+// BEVE only for clients that ask for it, or that sent BEVE
+// and left the reply format open
+//----------------------------------------
+WireFormat RESTServer::reply_format(const HttpRequest& req) {
+  const std::string accept = req.get_header("accept");
+  if(accept.find(beve_content_type) != std::string::npos) {
+    return WireFormat::Beve;
+  }
+  if(accept.empty() || accept == "*/*") {
+    return wire_format_of(req.get_header("content-type"));
   }
-  json += "}";
-  return HttpResponse(status_code).set_json(json);
+  return WireFormat::Json;
 }
 
 //----------------------------------------
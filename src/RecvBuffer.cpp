@@ -0,0 +1,85 @@
+#include <RecvBuffer.hpp>
+
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+namespace cpppwn {
+
+//----------------------------------------
+// Constructor
+//----------------------------------------
+RecvBuffer::RecvBuffer(std::size_t initial_capacity) : storage_(initial_capacity) {
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void RecvBuffer::consume(std::size_t n) noexcept {
+  begin_ += std::min(n, size());
+
+  // rewinding an empty buffer is free and avoids later compaction
+  if(begin_ == end_) {
+    begin_ = end_ = 0;
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::span<char> RecvBuffer::prepare(std::size_t min_size) {
+  if(storage_.size() - end_ < min_size) {
+    const std::size_t used = size();
+
+    if(begin_ > 0) {
+      std::memmove(storage_.data(), storage_.data() + begin_, used);
+      begin_ = 0;
+      end_ = used;
+    }
+
+    if(storage_.size() - end_ < min_size) {
+      storage_.resize(std::max(storage_.size() * 2, used + min_size));
+    }
+  }
+
+  return {storage_.data() + end_, storage_.size() - end_};
+}
+
+//----------------------------------------
+// short delimiters use memchr for the first byte and memcmp for
+// the rest. longer ones go through Boyer-Moore-Horspool, which
+// skips ahead by up to delim.size() bytes per comparison.
+//----------------------------------------
+std::size_t RecvBuffer::find(std::string_view delim, std::size_t from) const noexcept {
+  const std::string_view haystack = data();
+
+  if(delim.empty()) {
+    return from <= haystack.size() ? from : npos;
+  }
+  if(from >= haystack.size() || haystack.size() - from < delim.size()) {
+    return npos;
+  }
+
+  if(delim.size() >= 4) {
+    const auto it = std::search(haystack.begin() + from, haystack.end(),
+      std::boyer_moore_horspool_searcher(delim.begin(), delim.end()));
+    return it == haystack.end() ? npos : static_cast<std::size_t>(it - haystack.begin());
+  }
+
+  const char* p = haystack.data() + from;
+  const char* last = haystack.data() + haystack.size() - delim.size();
+
+  while(p <= last) {
+    p = static_cast<const char*>(std::memchr(p, delim[0], static_cast<std::size_t>(last - p) + 1));
+    if(not p) {
+      return npos;
+    }
+    if(std::memcmp(p + 1, delim.data() + 1, delim.size() - 1) == 0) {
+      return static_cast<std::size_t>(p - haystack.data());
+    }
+    ++p;
+  }
+  return npos;
+}
+
+}
@@ -0,0 +1,520 @@
+#include <RelayHub.hpp>
+#include "Helpers.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace cpppwn {
+
+namespace {
+
+// rounds one direction may run per wakeup, so a busy one can't starve the rest
+constexpr unsigned kMaxRounds = 16;
+
+constexpr unsigned kSpliceFlags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE;
+
+//----------------------------------------
+// one direction of a session. bytes go through pipe, or through
+// buffer when splice() turned out unsupported. pending bytes
+// block further reads, which is the backpressure.
+//----------------------------------------
+struct Channel {
+  Stream* source = nullptr;
+  Stream* dest = nullptr;
+  int in = -1;         // source->read_fd()
+  int out = -1;        // dest->write_fd()
+  std::size_t capacity = 0;
+  std::atomic<std::uint64_t>* counter = nullptr;
+  std::unique_ptr<SplicePipe> pipe;
+  std::vector<char> buffer;
+  std::size_t pending = 0;
+  std::size_t offset = 0;
+  bool done = false;   // source hit EOF or a side failed
+};
+
+//----------------------------------------
+// moves what it can without blocking. false once the source
+// hit EOF or a side failed.
+//----------------------------------------
+bool pump(Channel& c) {
+  for(unsigned round = 0; round < kMaxRounds; ++round) {
+    if(c.pending == 0) {
+      ssize_t n;
+      if(c.pipe) {
+        n = splice(c.in, nullptr, c.pipe->write_end(), nullptr, c.capacity, kSpliceFlags);
+        if(n < 0 && errno == EINVAL) {
+          c.pipe.reset();
+          c.buffer.resize(c.capacity);
+          continue;
+        }
+      } else {
+        n = ::read(c.in, c.buffer.data(), c.buffer.size());
+      }
+
+      if(n < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+      if(n <= 0) return false;
+      c.pending = static_cast<std::size_t>(n);
+      c.offset = 0;
+    }
+
+    ssize_t written;
+    if(c.pipe) {
+      written = splice(c.pipe->read_end(), nullptr, c.out, nullptr, c.pending, kSpliceFlags);
+    } else {
+      written = ::write(c.out, c.buffer.data() + c.offset, c.pending);
+    }
+
+    if(written < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+    if(written <= 0) return false;
+
+    c.pending -= static_cast<std::size_t>(written);
+    c.offset += static_cast<std::size_t>(written);
+    c.counter->fetch_add(static_cast<std::uint64_t>(written), std::memory_order_relaxed);
+  }
+  return true;
+}
+
+} // anon namespace
+
+//----------------------------------------
+//
+//----------------------------------------
+struct RelayHub::Counters {
+  std::atomic<std::uint64_t> a_to_b{0};
+  std::atomic<std::uint64_t> b_to_a{0};
+};
+
+//----------------------------------------
+// a stream pair and the descriptors its loop watches. epoll
+// events point at the Watch entries, which never move once the
+// session is started.
+//----------------------------------------
+struct RelayHub::Session {
+  struct Watch {
+    Session* session;
+    int fd;
+    int flags;             // fcntl flags before the relay, -1 while untouched
+    std::uint32_t events;  // currently registered, 0 while out of the epoll set
+  };
+
+  RelaySessionId id = 0;
+  std::unique_ptr<Stream> a;
+  std::unique_ptr<Stream> b;
+  std::shared_ptr<Counters> counters;
+  std::array<Channel, 2> channels;   // a -> b, b -> a
+  std::vector<Watch> watches;
+  bool ready = false;                // queued for a pump in the current wakeup
+};
+
+//----------------------------------------
+// one epoll loop and the sessions it owns. new sessions, close
+// requests and stop arrive through a queue and an eventfd.
+//----------------------------------------
+class RelayHub::Worker {
+  public:
+    explicit Worker(RelayHub& hub) : hub_(hub) {
+      epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+      if(epoll_fd_ < 0) {
+        throw std::system_error(errno, std::system_category(), "epoll_create1() failed");
+      }
+
+      wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if(wake_fd_ < 0) {
+        const int error = errno;
+        ::close(epoll_fd_);
+        throw std::system_error(error, std::system_category(), "eventfd() failed");
+      }
+
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.ptr = nullptr;
+      if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) < 0) {
+        const int error = errno;
+        ::close(wake_fd_);
+        ::close(epoll_fd_);
+        throw std::system_error(error, std::system_category(), "epoll_ctl() failed");
+      }
+
+      thread_ = std::thread(&Worker::run, this);
+    }
+
+    ~Worker() {
+      stop();
+      ::close(wake_fd_);
+      ::close(epoll_fd_);
+    }
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    //----------------------------------------
+    // false once the worker stopped
+    //----------------------------------------
+    bool post(std::unique_ptr<Session> session) {
+      {
+        std::lock_guard lock(mutex_);
+        if(stopping_) return false;
+        incoming_.push_back(std::move(session));
+      }
+      wake();
+      return true;
+    }
+
+    void post_close(RelaySessionId id) {
+      {
+        std::lock_guard lock(mutex_);
+        closing_.push_back(id);
+      }
+      wake();
+    }
+
+    void stop() {
+      {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+      }
+      wake();
+      if(thread_.joinable()) {
+        thread_.join();
+      }
+    }
+
+  private:
+    RelayHub& hub_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Session>> incoming_;
+    std::vector<RelaySessionId> closing_;
+    bool stopping_ = false;
+
+    // loop thread only
+    std::unordered_map<RelaySessionId, std::unique_ptr<Session>> sessions_;
+
+    void wake() {
+      const std::uint64_t one = 1;
+      [[maybe_unused]] const auto ignored = ::write(wake_fd_, &one, sizeof(one));
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void run() {
+      SigpipeBlock sigpipe_block;
+      std::array<epoll_event, 64> events;
+      std::vector<Session*> ready;
+
+      for(;;) {
+        const int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+        if(count < 0) {
+          if(errno == EINTR) continue;
+          break;
+        }
+
+        bool woken = false;
+        ready.clear();
+        for(int i = 0; i < count; ++i) {
+          if(events[i].data.ptr == nullptr) {
+            woken = true;
+            continue;
+          }
+
+          auto* session = static_cast<Session::Watch*>(events[i].data.ptr)->session;
+          if(not session->ready) {
+            session->ready = true;
+            ready.push_back(session);
+          }
+        }
+
+        for(auto* session : ready) {
+          session->ready = false;
+          service(*session);
+        }
+
+        if(woken && not drain_requests()) {
+          break;
+        }
+      }
+
+      for(auto it = sessions_.begin(); it != sessions_.end(); it = sessions_.begin()) {
+        finish(*it->second);
+      }
+    }
+
+    //----------------------------------------
+    // false once stop was requested
+    //----------------------------------------
+    bool drain_requests() {
+      std::uint64_t value;
+      [[maybe_unused]] const auto ignored = ::read(wake_fd_, &value, sizeof(value));
+
+      std::vector<std::unique_ptr<Session>> incoming;
+      std::vector<RelaySessionId> closing;
+      bool stopping;
+      {
+        std::lock_guard lock(mutex_);
+        incoming.swap(incoming_);
+        closing.swap(closing_);
+        stopping = stopping_;
+      }
+
+      for(auto& session : incoming) {
+        start(std::move(session));
+      }
+
+      for(const auto id : closing) {
+        const auto it = sessions_.find(id);
+        if(it != sessions_.end()) {
+          finish(*it->second);
+        }
+      }
+      return not stopping;
+    }
+
+    //----------------------------------------
+    // forwards read-ahead bytes, switches the descriptors to
+    // non-blocking and pumps once, since buffered streams may
+    // already have data. service() registers what to wait for.
+    //----------------------------------------
+    void start(std::unique_ptr<Session> owned) {
+      Session& session = *owned;
+      sessions_.emplace(session.id, std::move(owned));
+
+      session.watches.reserve(4);
+      for(const auto& channel : session.channels) {
+        for(const int fd : {channel.in, channel.out}) {
+          if(std::none_of(session.watches.begin(), session.watches.end(), [&](const auto& w) { return w.fd == fd; })) {
+            session.watches.push_back({&session, fd, -1, 0});
+          }
+        }
+      }
+
+      try {
+        for(auto& channel : session.channels) {
+          const std::string ahead = channel.source->take_buffered();
+          if(not ahead.empty()) {
+            channel.dest->send_bytes(ahead);
+            channel.counter->fetch_add(ahead.size(), std::memory_order_relaxed);
+          }
+        }
+
+        for(auto& watch : session.watches) {
+          const int flags = fcntl(watch.fd, F_GETFL);
+          if(flags < 0 || fcntl(watch.fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            throw std::system_error(errno, std::system_category(), "fcntl() failed");
+          }
+          watch.flags = flags;
+        }
+      } catch(...) {
+        finish(session);
+        return;
+      }
+
+      service(session);
+    }
+
+    //----------------------------------------
+    // pumps both directions, then waits for input where a
+    // direction is empty and for output where it is not. once a
+    // direction ended the other one only flushes what its pipe
+    // still holds, then the session finishes like bridge() does.
+    //----------------------------------------
+    void service(Session& session) {
+      try {
+        for(auto& channel : session.channels) {
+          if(not channel.done && not pump(channel)) {
+            channel.done = true;
+          }
+        }
+      } catch(...) {
+        finish(session);
+        return;
+      }
+
+      const auto& channels = session.channels;
+      if(std::any_of(channels.begin(), channels.end(), [](const Channel& c) { return c.done; })
+          && std::all_of(channels.begin(), channels.end(), [](const Channel& c) { return c.done || c.pending == 0; })) {
+        finish(session);
+        return;
+      }
+
+      // a descriptor nobody waits on leaves the set, EPOLLHUP and
+      // EPOLLERR are reported regardless and would spin the loop
+      for(auto& watch : session.watches) {
+        std::uint32_t wanted = 0;
+        for(const auto& channel : session.channels) {
+          if(channel.done) continue;
+          if(channel.pending == 0 && channel.in == watch.fd) wanted |= EPOLLIN;
+          if(channel.pending > 0 && channel.out == watch.fd) wanted |= EPOLLOUT;
+        }
+
+        if(wanted != watch.events) {
+          epoll_event event{};
+          event.events = wanted;
+          event.data.ptr = &watch;
+          const int op = wanted == 0 ? EPOLL_CTL_DEL : watch.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+          if(epoll_ctl(epoll_fd_, op, watch.fd, &event) < 0) {
+            finish(session);
+            return;
+          }
+          watch.events = wanted;
+        }
+      }
+    }
+
+    //----------------------------------------
+    // unregisters and closes both streams, then drops the session
+    //----------------------------------------
+    void finish(Session& session) {
+      for(const auto& watch : session.watches) {
+        if(watch.events != 0) {
+          epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, watch.fd, nullptr);
+        }
+        if(watch.flags >= 0) {
+          fcntl(watch.fd, F_SETFL, watch.flags);
+        }
+      }
+
+      for(Stream* stream : {session.a.get(), session.b.get()}) {
+        try {
+          stream->close();
+        } catch(...) {
+          // tearing down anyway
+        }
+      }
+
+      const RelayStats stats{session.counters->a_to_b.load(), session.counters->b_to_a.load()};
+      const RelaySessionId id = session.id;
+      sessions_.erase(id);
+      hub_.session_closed(id, stats);
+    }
+};
+
+//----------------------------------------
+// Constructor
+//----------------------------------------
+RelayHub::RelayHub(RelayHubConfig config) : config_(std::move(config)) {
+  config_.buffer_size = std::max<std::size_t>(config_.buffer_size, 4096);
+
+  const std::size_t threads = std::max<std::size_t>(config_.threads, 1);
+  for(std::size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>(*this));
+  }
+}
+
+//----------------------------------------
+// Destructor
+//----------------------------------------
+RelayHub::~RelayHub() {
+  stop();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+RelaySessionId RelayHub::add(std::unique_ptr<Stream> a, std::unique_ptr<Stream> b) {
+  if(not a || not b) {
+    throw std::invalid_argument("RelayHub::add() needs two streams");
+  }
+
+  auto session = std::make_unique<Session>();
+  session->id = next_id_++;
+  session->counters = std::make_shared<Counters>();
+
+  const std::array<std::pair<Stream*, Stream*>, 2> ends{{{a.get(), b.get()}, {b.get(), a.get()}}};
+  for(std::size_t i = 0; i < ends.size(); ++i) {
+    Channel& channel = session->channels[i];
+    channel.source = ends[i].first;
+    channel.dest = ends[i].second;
+    channel.in = channel.source->read_fd();
+    channel.out = channel.dest->write_fd();
+    channel.capacity = config_.buffer_size;
+    channel.counter = i == 0 ? &session->counters->a_to_b : &session->counters->b_to_a;
+
+    // a TLS stream can't be read or written without blocking the
+    // loop and every other session on it
+    if(channel.in < 0 || channel.out < 0) {
+      throw std::invalid_argument("RelayHub needs streams with raw descriptors, bridge() the others");
+    }
+    channel.pipe = std::make_unique<SplicePipe>(channel.capacity);
+  }
+
+  session->a = std::move(a);
+  session->b = std::move(b);
+
+  const RelaySessionId id = session->id;
+  {
+    std::lock_guard lock(counters_mutex_);
+    counters_.emplace(id, session->counters);
+  }
+
+  if(not workers_[id % workers_.size()]->post(std::move(session))) {
+    std::lock_guard lock(counters_mutex_);
+    counters_.erase(id);
+    throw std::runtime_error("RelayHub is stopped");
+  }
+  return id;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void RelayHub::close(RelaySessionId id) {
+  workers_[id % workers_.size()]->post_close(id);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::optional<RelayStats> RelayHub::stats(RelaySessionId id) const {
+  std::lock_guard lock(counters_mutex_);
+
+  const auto it = counters_.find(id);
+  if(it == counters_.end()) {
+    return std::nullopt;
+  }
+  return RelayStats{it->second->a_to_b.load(), it->second->b_to_a.load()};
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::size_t RelayHub::size() const {
+  std::lock_guard lock(counters_mutex_);
+  return counters_.size();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void RelayHub::stop() {
+  for(auto& worker : workers_) {
+    worker->stop();
+  }
+}
+
+//----------------------------------------
+// called by a worker once a session ended
+//----------------------------------------
+void RelayHub::session_closed(RelaySessionId id, const RelayStats& stats) {
+  {
+    std::lock_guard lock(counters_mutex_);
+    counters_.erase(id);
+  }
+
+  if(config_.on_close) {
+    config_.on_close(id, stats);
+  }
+}
+
+}
@@ -1,11 +1,24 @@
 #include <Remote.hpp>
+#include "DnsCache.hpp"
+#include "Metrics.hpp"
 #include "Helpers.hpp"
 
 #include <asio/read_until.hpp>
 #include <asio/write.hpp>
 #include <asio/ssl.hpp>
+#include <asio/redirect_error.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <sys/sendfile.h>
+#include <algorithm>
+#include <array>
+#include <span>
 #include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <mutex>
 #include <regex>
+#include <unordered_map>
 
 namespace cpppwn {
   namespace {
@@ -186,6 +199,386 @@ namespace cpppwn {
             + std::to_string(status_code) + " " + status_message);
       }
     }
+
+    //----------------------------------------
+    // whether the server still honours session, going by the
+    // lifetime it gave the session
+    //----------------------------------------
+    bool session_expired(const SSL_SESSION* session, std::time_t now) {
+      return SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <= now;
+    }
+
+    //----------------------------------------
+    // client sessions of one SSL_CTX, keyed by host:port. holds
+    // at most max_sessions, dropping expired sessions first and
+    // then the least recently used.
+    //----------------------------------------
+    struct SessionStore {
+      struct Entry {
+        SSL_SESSION* session;
+        std::chrono::steady_clock::time_point used;
+      };
+
+      static constexpr std::size_t max_sessions = 1024;
+
+      std::mutex mutex;
+      std::unordered_map<std::string, Entry> sessions;
+
+      //----------------------------------------
+      // makes room for one more session
+      //----------------------------------------
+      void evict() {
+        const std::time_t now = std::time(nullptr);
+        std::erase_if(sessions, [now](auto& entry) {
+          if(not session_expired(entry.second.session, now)) {
+            return false;
+          }
+          SSL_SESSION_free(entry.second.session);
+          return true;
+        });
+
+        while(not sessions.empty() && sessions.size() >= max_sessions) {
+          auto oldest = sessions.begin();
+          for(auto it = sessions.begin(); it != sessions.end(); ++it) {
+            if(it->second.used < oldest->second.used) oldest = it;
+          }
+          SSL_SESSION_free(oldest->second.session);
+          sessions.erase(oldest);
+        }
+      }
+
+      ~SessionStore() {
+        for(auto& [key, entry] : sessions) {
+          SSL_SESSION_free(entry.session);
+        }
+      }
+    };
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void free_session_store(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+      delete static_cast<SessionStore*>(ptr);
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void free_session_key(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+      delete static_cast<std::string*>(ptr);
+    }
+
+    //----------------------------------------
+    // ex_data slot holding the SessionStore on an SSL_CTX
+    //----------------------------------------
+    int session_store_index() {
+      static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, free_session_store);
+      return index;
+    }
+
+    //----------------------------------------
+    // ex_data slot holding the host:port key on an SSL
+    //----------------------------------------
+    int session_key_index() {
+      static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, free_session_key);
+      return index;
+    }
+
+    //----------------------------------------
+    // called by OpenSSL whenever the server hands out a session
+    // or, for TLS 1.3, a ticket after the handshake
+    //----------------------------------------
+    int on_new_session(SSL* ssl, SSL_SESSION* session) {
+      auto* store = static_cast<SessionStore*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), session_store_index()));
+      auto* key = static_cast<std::string*>(SSL_get_ex_data(ssl, session_key_index()));
+
+      if(not store || not key || not SSL_SESSION_is_resumable(session)) {
+        return 0;
+      }
+
+      std::lock_guard lock(store->mutex);
+      if(store->sessions.size() >= SessionStore::max_sessions && not store->sessions.contains(*key)) {
+        store->evict();
+      }
+
+      const SessionStore::Entry entry{session, std::chrono::steady_clock::now()};
+      auto [it, inserted] = store->sessions.try_emplace(*key, entry);
+      if(not inserted) {
+        SSL_SESSION_free(it->second.session);
+        it->second = entry;
+      }
+      return 1; // we keep the reference
+    }
+
+    //----------------------------------------
+    // offers a cached session for host:port on the next handshake.
+    // no-op when resumption was not enabled on the context.
+    //----------------------------------------
+    void attach_cached_session(SSL* ssl, const std::string& host, uint16_t port) {
+      auto* store = static_cast<SessionStore*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), session_store_index()));
+      if(not store) {
+        return;
+      }
+
+      auto key = std::make_unique<std::string>(host + ":" + std::to_string(port));
+
+      {
+        std::lock_guard lock(store->mutex);
+        auto it = store->sessions.find(*key);
+        if(it != store->sessions.end() && session_expired(it->second.session, std::time(nullptr))) {
+          SSL_SESSION_free(it->second.session);
+          store->sessions.erase(it);
+        } else if(it != store->sessions.end()) {
+          SSL_set_session(ssl, it->second.session);
+          it->second.used = std::chrono::steady_clock::now();
+        }
+      }
+
+      if(SSL_set_ex_data(ssl, session_key_index(), key.get())) {
+        key.release();
+      }
+    }
+
+    //----------------------------------------
+    // drops a session that led to a failed handshake
+    //----------------------------------------
+    void forget_cached_session(SSL* ssl) {
+      auto* store = static_cast<SessionStore*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), session_store_index()));
+      auto* key = static_cast<std::string*>(SSL_get_ex_data(ssl, session_key_index()));
+      if(not store || not key) {
+        return;
+      }
+
+      std::lock_guard lock(store->mutex);
+      auto it = store->sessions.find(*key);
+      if(it != store->sessions.end()) {
+        SSL_SESSION_free(it->second.session);
+        store->sessions.erase(it);
+      }
+    }
+
+    //----------------------------------------
+    // writes parts back to back as one buffer sequence, a few
+    // at a time so no vector has to be built for them
+    //----------------------------------------
+    template <typename SyncWriteStream>
+    void write_gather(SyncWriteStream& stream, std::span<const std::string_view> parts) {
+      constexpr std::size_t kBatch = 8;
+      std::array<asio::const_buffer, kBatch> buffers;
+
+      while(not parts.empty()) {
+        const std::size_t count = std::min(parts.size(), kBatch);
+        for(std::size_t i = 0; i < count; ++i) {
+          buffers[i] = asio::buffer(parts[i]);
+        }
+        asio::write(stream, std::span<const asio::const_buffer>(buffers.data(), count));
+        parts = parts.subspan(count);
+      }
+    }
+
+    //----------------------------------------
+    // RFC 8305 order: the families alternate, starting with the
+    // one getaddrinfo() sorted first
+    //----------------------------------------
+    std::vector<asio::ip::tcp::endpoint> interleave_families(const std::vector<asio::ip::tcp::endpoint>& endpoints) {
+      if(endpoints.empty()) {
+        return {};
+      }
+
+      const bool first_v6 = endpoints.front().address().is_v6();
+      std::vector<asio::ip::tcp::endpoint> preferred;
+      std::vector<asio::ip::tcp::endpoint> other;
+      for(const auto& endpoint : endpoints) {
+        (endpoint.address().is_v6() == first_v6 ? preferred : other).push_back(endpoint);
+      }
+
+      std::vector<asio::ip::tcp::endpoint> ordered;
+      ordered.reserve(endpoints.size());
+      for(std::size_t i = 0; i < std::max(preferred.size(), other.size()); ++i) {
+        if(i < preferred.size()) ordered.push_back(preferred[i]);
+        if(i < other.size()) ordered.push_back(other[i]);
+      }
+      return ordered;
+    }
+
+    //----------------------------------------
+    // races connects to endpoints in order on executor. each
+    // attempt has attempt_delay to itself before the next one
+    // starts, a failure starts the next at once. the first socket
+    // to connect wins, the others are closed. its callbacks keep
+    // the race alive, done runs exactly once.
+    //----------------------------------------
+    class ConnectRace : public std::enable_shared_from_this<ConnectRace> {
+      public:
+        using Handler = std::function<void(const asio::error_code&, asio::ip::tcp::socket)>;
+
+        ConnectRace(asio::any_io_executor executor, std::vector<asio::ip::tcp::endpoint> endpoints,
+                    const ConnectOptions& options, Handler done)
+          : executor_(std::move(executor)), strand_(asio::make_strand(executor_)), endpoints_(std::move(endpoints)),
+            options_(options), done_(std::move(done)), attempts_(endpoints_.size()), stagger_(executor_),
+            deadline_(executor_) {}
+
+        //----------------------------------------
+        // the executor may be run by several threads, so the race
+        // itself and every handler of it run on strand_
+        //----------------------------------------
+        void start() {
+          asio::post(strand_, [self = shared_from_this()] { self->begin(); });
+        }
+
+      private:
+        void begin() {
+          if(endpoints_.empty()) {
+            finish(asio::error::host_not_found);
+            return;
+          }
+
+          if(options_.timeout.count() > 0) {
+            deadline_.expires_after(options_.timeout);
+            deadline_.async_wait(asio::bind_executor(strand_, [self = shared_from_this()](const asio::error_code& ec) {
+              if(not ec && not self->finished_) {
+                self->finish(asio::error::timed_out);
+              }
+            }));
+          }
+          start_next();
+        }
+
+        void start_next() {
+          if(finished_ || next_ == endpoints_.size()) {
+            return;
+          }
+
+          const std::size_t index = next_++;
+          attempts_[index].emplace(executor_);
+          ++pending_;
+          attempts_[index]->async_connect(endpoints_[index],
+            asio::bind_executor(strand_, [self = shared_from_this(), index](const asio::error_code& ec) {
+              self->attempt_done(index, ec);
+            }));
+
+          if(next_ < endpoints_.size()) {
+            stagger_.expires_after(options_.attempt_delay);
+            stagger_.async_wait(asio::bind_executor(strand_, [self = shared_from_this()](const asio::error_code&) {
+              self->start_next();
+            }));
+          }
+        }
+
+        void attempt_done(std::size_t index, const asio::error_code& ec) {
+          --pending_;
+          if(finished_) {
+            return;
+          }
+          if(not ec) {
+            finish({}, index);
+            return;
+          }
+
+          // no need to wait out the delay for the next address
+          last_error_ = ec;
+          if(next_ < endpoints_.size()) {
+            stagger_.cancel();
+          } else if(pending_ == 0) {
+            finish(last_error_);
+          }
+        }
+
+        void finish(const asio::error_code& ec, std::optional<std::size_t> winner = std::nullopt) {
+          finished_ = true;
+          stagger_.cancel();
+          deadline_.cancel();
+
+          for(std::size_t i = 0; i < attempts_.size(); ++i) {
+            if(attempts_[i] && winner != i) {
+              asio::error_code ignored;
+              attempts_[i]->close(ignored);
+            }
+          }
+
+          const Handler done = std::move(done_);
+          done(ec, winner ? std::move(*attempts_[*winner]) : asio::ip::tcp::socket(executor_));
+        }
+
+        asio::any_io_executor executor_;   // the sockets', the winner goes back with it
+        asio::strand<asio::any_io_executor> strand_;
+        std::vector<asio::ip::tcp::endpoint> endpoints_;
+        ConnectOptions options_;
+        Handler done_;
+        std::vector<std::optional<asio::ip::tcp::socket>> attempts_;
+        asio::steady_timer stagger_;
+        asio::steady_timer deadline_;
+        asio::error_code last_error_ = asio::error::host_not_found;
+        std::size_t next_ = 0;
+        std::size_t pending_ = 0;
+        bool finished_ = false;
+    };
+
+    //----------------------------------------
+    // ConnectRace on a private io, blocking until it is decided
+    //----------------------------------------
+    asio::ip::tcp::socket race_connect(asio::io_context& io, const std::vector<asio::ip::tcp::endpoint>& endpoints,
+                                       const ConnectOptions& options) {
+      if(endpoints.size() == 1 && options.timeout.count() <= 0) {
+        asio::ip::tcp::socket socket(io);
+        socket.connect(endpoints.front());
+        return socket;
+      }
+
+      asio::error_code error;
+      std::optional<asio::ip::tcp::socket> connected;
+      std::make_shared<ConnectRace>(io.get_executor(), endpoints, options,
+        [&](const asio::error_code& ec, asio::ip::tcp::socket socket) {
+          error = ec;
+          connected.emplace(std::move(socket));
+        })->start();
+
+      io.run();
+      io.restart();
+
+      if(error) {
+        throw asio::system_error(error, "connect");
+      }
+      return std::move(*connected);
+    }
+
+    //----------------------------------------
+    // ConnectRace on the awaiting coroutine's executor
+    //----------------------------------------
+    asio::awaitable<asio::ip::tcp::socket> async_race_connect(std::vector<asio::ip::tcp::endpoint> endpoints,
+                                                             ConnectOptions options) {
+      const auto executor = co_await asio::this_coro::executor;
+
+      co_return co_await asio::async_initiate<decltype(asio::use_awaitable), void(asio::error_code, asio::ip::tcp::socket)>(
+        [&](auto handler) {
+          // the race wants a copyable callback, the coroutine's handler is move-only
+          auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+          std::make_shared<ConnectRace>(executor, std::move(endpoints), options,
+            [shared](const asio::error_code& ec, asio::ip::tcp::socket socket) {
+              (*shared)(ec, std::move(socket));
+            })->start();
+        }, asio::use_awaitable);
+    }
+
+    //----------------------------------------
+    // phase timing for connect_timing(), folded away when
+    // metrics are compiled out
+    //----------------------------------------
+    std::chrono::steady_clock::time_point phase_start() noexcept {
+      if constexpr(metrics_enabled) {
+        return std::chrono::steady_clock::now();
+      } else {
+        return {};
+      }
+    }
+
+    std::chrono::nanoseconds phase_since(std::chrono::steady_clock::time_point start) noexcept {
+      if constexpr(metrics_enabled) {
+        return std::chrono::steady_clock::now() - start;
+      } else {
+        return {};
+      }
+    }
   } // anon namespace
 
 //----------------------------------------
@@ -193,13 +586,25 @@ namespace cpppwn {
 //----------------------------------------
 class Remote::SocketImpl {
   public:
-    virtual void write(const std::string& data) = 0;
+    virtual void write(std::string_view data) = 0;
+    virtual void write(std::span<const std::string_view> parts) = 0;
     virtual size_t read(char* buffer, size_t size) = 0;
     virtual size_t read_some(char* buffer, size_t size, asio::error_code& ec) = 0;
-    virtual void read_until(asio::streambuf& buf, const std::string& delim) = 0;
+    virtual size_t read_nonblocking(char* buffer, size_t size, asio::error_code& ec) = 0;
+    virtual size_t sendfile_nonblocking(int fd, off_t& position, size_t count, asio::error_code& ec) = 0;
+    virtual bool wait_readable(std::chrono::steady_clock::time_point deadline) = 0;
+    virtual void async_wait(std::function<void(const asio::error_code&)> handler) = 0;
+    virtual asio::awaitable<size_t> async_read_some(char* buffer, size_t size, asio::error_code& ec) = 0;
+    virtual asio::awaitable<void> async_write(std::string_view data) = 0;
+    virtual asio::awaitable<size_t> async_write_some(std::span<const asio::const_buffer> buffers) = 0;
+    virtual asio::awaitable<void> async_wait_writable() = 0;
+    virtual void cancel() = 0;
+    virtual asio::any_io_executor get_executor() = 0;
     virtual bool is_open() const = 0;
     virtual void close() = 0;
     virtual int native_handle() = 0;
+    virtual bool is_tls() const noexcept = 0;
+    virtual std::string_view alpn_protocol() = 0;
     virtual ~SocketImpl() = default;
 };
 
@@ -217,10 +622,17 @@ class TcpSocketImpl : public Remote::SocketImpl {
     //----------------------------------------
     //
     //----------------------------------------
-    void write(const std::string& data) override {
+    void write(std::string_view data) override {
       asio::write(socket_, asio::buffer(data));
     }
     
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void write(std::span<const std::string_view> parts) override {
+      write_gather(socket_, parts);
+    }
+    
     //----------------------------------------
     //
     //----------------------------------------
@@ -235,11 +647,95 @@ class TcpSocketImpl : public Remote::SocketImpl {
       return socket_.read_some(asio::buffer(buffer, size), ec);
     }
     
+    //----------------------------------------
+    // would_block when nothing is there yet
+    //----------------------------------------
+    size_t read_nonblocking(char* buffer, size_t size, asio::error_code& ec) override {
+      socket_.non_blocking(true, ec);
+      if(ec) return 0;
+
+      const size_t len = socket_.read_some(asio::buffer(buffer, size), ec);
+
+      asio::error_code ignored;
+      socket_.non_blocking(false, ignored);
+      return len;
+    }
+    
+    //----------------------------------------
+    // sendfile() as far as the send buffer allows, would_block
+    // when it is full
+    //----------------------------------------
+    size_t sendfile_nonblocking(int fd, off_t& position, size_t count, asio::error_code& ec) override {
+      socket_.non_blocking(true, ec);
+      if(ec) return 0;
+
+      SigpipeBlock sigpipe_block;
+      ssize_t sent;
+      do {
+        sent = ::sendfile(socket_.native_handle(), fd, &position, count);
+      } while(sent < 0 && errno == EINTR);
+      ec = sent < 0 ? asio::error_code(errno, asio::error::get_system_category()) : asio::error_code{};
+
+      asio::error_code ignored;
+      socket_.non_blocking(false, ignored);
+      return sent < 0 ? 0 : static_cast<size_t>(sent);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    bool wait_readable(std::chrono::steady_clock::time_point deadline) override {
+      return ::wait_readable(socket_.native_handle(), deadline);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void async_wait(std::function<void(const asio::error_code&)> handler) override {
+      socket_.async_wait(asio::ip::tcp::socket::wait_read, std::move(handler));
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::awaitable<size_t> async_read_some(char* buffer, size_t size, asio::error_code& ec) override {
+      co_return co_await socket_.async_read_some(asio::buffer(buffer, size), asio::redirect_error(asio::use_awaitable, ec));
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::awaitable<void> async_write(std::string_view data) override {
+      co_await asio::async_write(socket_, asio::buffer(data), asio::use_awaitable);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::awaitable<size_t> async_write_some(std::span<const asio::const_buffer> buffers) override {
+      co_return co_await socket_.async_write_some(buffers, asio::use_awaitable);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::awaitable<void> async_wait_writable() override {
+      co_await socket_.async_wait(asio::ip::tcp::socket::wait_write, asio::use_awaitable);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void cancel() override {
+      asio::error_code ignored;
+      socket_.cancel(ignored);
+    }
+    
     //----------------------------------------
     //
     //----------------------------------------
-    void read_until(asio::streambuf& buf, const std::string& delim) override {
-      asio::read_until(socket_, buf, delim);
+    asio::any_io_executor get_executor() override {
+      return socket_.get_executor();
     }
     
     //----------------------------------------
@@ -264,6 +760,20 @@ class TcpSocketImpl : public Remote::SocketImpl {
       return socket_.native_handle();
     }
     
+    //----------------------------------------
+    //
+    //----------------------------------------
+    bool is_tls() const noexcept override {
+      return false;
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    std::string_view alpn_protocol() override {
+      return {};
+    }
+    
   private:
     asio::ip::tcp::socket socket_;
 };
@@ -282,10 +792,17 @@ class TlsSocketImpl : public Remote::SocketImpl {
     //----------------------------------------
     //
     //----------------------------------------
-    void write(const std::string& data) override {
+    void write(std::string_view data) override {
       asio::write(socket_, asio::buffer(data));
     }
     
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void write(std::span<const std::string_view> parts) override {
+      write_gather(socket_, parts);
+    }
+    
     //----------------------------------------
     //
     //----------------------------------------
@@ -300,11 +817,95 @@ class TlsSocketImpl : public Remote::SocketImpl {
       return socket_.read_some(asio::buffer(buffer, size), ec);
     }
     
+    //----------------------------------------
+    // would_block also covers a record that is only partly in.
+    // openssl keeps the partial record for the next attempt.
+    //----------------------------------------
+    size_t read_nonblocking(char* buffer, size_t size, asio::error_code& ec) override {
+      socket_.lowest_layer().non_blocking(true, ec);
+      if(ec) return 0;
+
+      const size_t len = socket_.read_some(asio::buffer(buffer, size), ec);
+
+      asio::error_code ignored;
+      socket_.lowest_layer().non_blocking(false, ignored);
+      return len;
+    }
+    
+    //----------------------------------------
+    // the file has to be encrypted, it can't skip userspace
+    //----------------------------------------
+    size_t sendfile_nonblocking(int, off_t&, size_t, asio::error_code& ec) override {
+      ec = asio::error::operation_not_supported;
+      return 0;
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    bool wait_readable(std::chrono::steady_clock::time_point deadline) override {
+      if(has_buffered()) {
+        return true;
+      }
+      return ::wait_readable(socket_.lowest_layer().native_handle(), deadline);
+    }
+    
+    //----------------------------------------
+    // decrypted bytes may already sit inside openssl,
+    // in which case the socket itself never becomes readable
+    //----------------------------------------
+    void async_wait(std::function<void(const asio::error_code&)> handler) override {
+      if(has_buffered()) {
+        asio::post(socket_.get_executor(), [handler = std::move(handler)] {
+          handler(asio::error_code{});
+        });
+        return;
+      }
+      socket_.lowest_layer().async_wait(asio::ip::tcp::socket::wait_read, std::move(handler));
+    }
+    
+    //----------------------------------------
+    // records already decrypted are handed out without touching
+    // the socket
+    //----------------------------------------
+    asio::awaitable<size_t> async_read_some(char* buffer, size_t size, asio::error_code& ec) override {
+      co_return co_await socket_.async_read_some(asio::buffer(buffer, size), asio::redirect_error(asio::use_awaitable, ec));
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::awaitable<void> async_write(std::string_view data) override {
+      co_await asio::async_write(socket_, asio::buffer(data), asio::use_awaitable);
+    }
+    
+    //----------------------------------------
+    // at most one record goes out per call
+    //----------------------------------------
+    asio::awaitable<size_t> async_write_some(std::span<const asio::const_buffer> buffers) override {
+      co_return co_await socket_.async_write_some(buffers, asio::use_awaitable);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::awaitable<void> async_wait_writable() override {
+      co_await socket_.lowest_layer().async_wait(asio::ip::tcp::socket::wait_write, asio::use_awaitable);
+    }
+    
     //----------------------------------------
     //
     //----------------------------------------
-    void read_until(asio::streambuf& buf, const std::string& delim) override {
-      asio::read_until(socket_, buf, delim);
+    void cancel() override {
+      asio::error_code ignored;
+      socket_.lowest_layer().cancel(ignored);
+    }
+    
+    //----------------------------------------
+    //
+    //----------------------------------------
+    asio::any_io_executor get_executor() override {
+      return socket_.get_executor();
     }
     
     //----------------------------------------
@@ -318,6 +919,10 @@ class TlsSocketImpl : public Remote::SocketImpl {
     //
     //----------------------------------------
     void close() override {
+      // without a recorded shutdown OpenSSL marks the session
+      // unresumable when the stream is freed
+      SSL_set_shutdown(socket_.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+
       asio::error_code ec;
       socket_.lowest_layer().close(ec);
     }
@@ -329,36 +934,55 @@ class TlsSocketImpl : public Remote::SocketImpl {
       return socket_.lowest_layer().native_handle();
     }
     
+    //----------------------------------------
+    //
+    //----------------------------------------
+    bool is_tls() const noexcept override {
+      return true;
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    std::string_view alpn_protocol() override {
+      const unsigned char* protocol = nullptr;
+      unsigned int length = 0;
+      SSL_get0_alpn_selected(socket_.native_handle(), &protocol, &length);
+      return {reinterpret_cast<const char*>(protocol), length};
+    }
+    
   private:
+    //----------------------------------------
+    // decrypted bytes, or records asio already pulled off the
+    // socket into its bio pair. either way the socket itself
+    // may never become readable for them.
+    //----------------------------------------
+    bool has_buffered() {
+      SSL* ssl = socket_.native_handle();
+      return SSL_pending(ssl) > 0 || BIO_ctrl_pending(SSL_get_rbio(ssl)) > 0;
+    }
+
     asio::ssl::stream<asio::ip::tcp::socket> socket_;
 };
 
 //----------------------------------------
 //
 //----------------------------------------
-Remote::Remote(const std::string& host, uint16_t port)
+Remote::Remote(const std::string& host, uint16_t port, const ConnectOptions& connect)
   : io_(), socket_(nullptr) {
 
-  asio::ip::tcp::socket socket(io_);
-  asio::ip::tcp::resolver resolver(io_);
-  auto endpoints = resolver.resolve(host, std::to_string(port));
-  asio::connect(socket, endpoints);
-
-  socket_ = std::make_unique<TcpSocketImpl>(std::move(socket));
+  socket_ = std::make_unique<TcpSocketImpl>(connect_to(host, port, connect));
 }
 
 //----------------------------------------
 //
 //----------------------------------------
-Remote::Remote(const std::string& host, uint16_t port, bool use_tls, bool verify_certificate)
+Remote::Remote(const std::string& host, uint16_t port, bool use_tls, bool verify_certificate,
+               const ConnectOptions& connect)
   : io_(), socket_(nullptr) {
     
   if(not use_tls) {
-    asio::ip::tcp::socket socket(io_);
-    asio::ip::tcp::resolver resolver(io_);
-    auto endpoints = resolver.resolve(host, std::to_string(port));
-    asio::connect(socket, endpoints);
-    socket_ = std::make_unique<TcpSocketImpl>(std::move(socket));
+    socket_ = std::make_unique<TcpSocketImpl>(connect_to(host, port, connect));
     return;
   }
     
@@ -371,18 +995,16 @@ Remote::Remote(const std::string& host, uint16_t port, bool use_tls, bool verify
     ssl_ctx.set_verify_mode(asio::ssl::verify_none);
   }
     
-  asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(io_, ssl_ctx);
+  // Connect to server
+  asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(connect_to(host, port, connect), ssl_ctx);
     
   if(not SSL_set_tlsext_host_name(ssl_socket.native_handle(), host.c_str())) {
     throw std::runtime_error("Failed to set SNI hostname");
   }
     
-  // Connect to server
-  asio::ip::tcp::resolver resolver(io_);
-  auto endpoints = resolver.resolve(host, std::to_string(port));
-  asio::connect(ssl_socket.lowest_layer(), endpoints);
-    
+  const auto handshake_started = phase_start();
   ssl_socket.handshake(asio::ssl::stream_base::client);
+  connect_timing_.tls_handshake = phase_since(handshake_started);
   socket_ = std::make_unique<TlsSocketImpl>(std::move(ssl_socket));
 }
 
@@ -390,7 +1012,8 @@ Remote::Remote(const std::string& host, uint16_t port, bool use_tls, bool verify
 //
 //----------------------------------------
 Remote::Remote(const std::string& host, uint16_t port, 
-               const std::string& proxy_url, bool use_tls): io_(), socket_(nullptr) {
+               const std::string& proxy_url, bool use_tls, const ConnectOptions& connect)
+  : io_(), socket_(nullptr) {
 
     auto proxy_config = parseProxyUrl(proxy_url);
 
@@ -399,17 +1022,16 @@ Remote::Remote(const std::string& host, uint16_t port,
     }
     
     // Connect to proxy server
-    asio::ip::tcp::socket socket(io_);
-    asio::ip::tcp::resolver resolver(io_);
-    auto proxy_endpoints = resolver.resolve(proxy_config->host, std::to_string(proxy_config->port));
-    asio::connect(socket, proxy_endpoints);
+    asio::ip::tcp::socket socket = connect_to(proxy_config->host, proxy_config->port, connect);
     
     // Perform proxy handshake
+    const auto proxy_started = phase_start();
     if(proxy_config->type == ProxyConfig::Type::SOCKS) {
       socks5Connect(socket, host, port, proxy_config->username, proxy_config->password);
     } else {
       httpProxyConnect(socket, host, port, proxy_config->username, proxy_config->password);
     }
+    connect_timing_.connect += phase_since(proxy_started);
     
     // If TLS is requested, wrap the socket in SSL
     if(use_tls) {
@@ -423,7 +1045,9 @@ Remote::Remote(const std::string& host, uint16_t port,
         throw std::runtime_error("Failed to set SNI hostname");
       }
         
+      const auto handshake_started = phase_start();
       ssl_socket.handshake(asio::ssl::stream_base::client);
+      connect_timing_.tls_handshake = phase_since(handshake_started);
       socket_ = std::make_unique<TlsSocketImpl>(std::move(ssl_socket));
     } else {
       socket_ = std::make_unique<TcpSocketImpl>(std::move(socket));
@@ -434,31 +1058,75 @@ Remote::Remote(const std::string& host, uint16_t port,
 //
 //----------------------------------------
 Remote::Remote(const std::string& host, uint16_t port, 
-  std::shared_ptr<asio::ssl::context> ssl_ctx): io_(), socket_(nullptr) {
+  std::shared_ptr<asio::ssl::context> ssl_ctx, const ConnectOptions& connect): io_(), socket_(nullptr) {
   
   if (not ssl_ctx) {
     throw std::invalid_argument("SSL context cannot be null");
   }
     
-  // Create SSL stream with custom context
-  asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(io_, *ssl_ctx);
+  // Connect to server, then create SSL stream with custom context
+  asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(connect_to(host, port, connect), *ssl_ctx);
     
   // Set SNI hostname
   if(not SSL_set_tlsext_host_name(ssl_socket.native_handle(), host.c_str())) {
     throw std::runtime_error("Failed to set SNI hostname");
   }
     
-  // Connect to server
-  asio::ip::tcp::resolver resolver(io_);
-  auto endpoints = resolver.resolve(host, std::to_string(port));
-  asio::connect(ssl_socket.lowest_layer(), endpoints);
+  // Offer a previous session for an abbreviated handshake
+  attach_cached_session(ssl_socket.native_handle(), host, port);
     
   // Perform TLS handshake
-  ssl_socket.handshake(asio::ssl::stream_base::client);
+  const auto handshake_started = phase_start();
+  try {
+    ssl_socket.handshake(asio::ssl::stream_base::client);
+    connect_timing_.tls_handshake = phase_since(handshake_started);
+  } catch (...) {
+    forget_cached_session(ssl_socket.native_handle());
+    throw;
+  }
     
   socket_ = std::make_unique<TlsSocketImpl>(std::move(ssl_socket));
 }
 
+//----------------------------------------
+// a cached address that stopped accepting sends the next
+// connect back to DNS
+//----------------------------------------
+asio::ip::tcp::socket Remote::connect_to(const std::string& host, uint16_t port, const ConnectOptions& connect) {
+  auto started = phase_start();
+  auto endpoints = interleave_families(DnsCache::global().resolve(host, port));
+  connect_timing_.dns = phase_since(started);
+
+  started = phase_start();
+  try {
+    auto socket = race_connect(io_, endpoints, connect);
+    connect_timing_.connect = phase_since(started);
+    return socket;
+  } catch (const asio::system_error&) {
+    DnsCache::global().forget(host);
+    throw;
+  }
+}
+
+//----------------------------------------
+// Enable client-side session resumption on a shared context
+//----------------------------------------
+void Remote::enable_session_resumption(asio::ssl::context& ssl_ctx) {
+  SSL_CTX* ctx = ssl_ctx.native_handle();
+  if(SSL_CTX_get_ex_data(ctx, session_store_index())) {
+    return;
+  }
+
+  auto store = std::make_unique<SessionStore>();
+  if(not SSL_CTX_set_ex_data(ctx, session_store_index(), store.get())) {
+    throw std::runtime_error("Failed to attach TLS session store");
+  }
+  store.release();
+
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, on_new_session);
+}
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -469,6 +1137,83 @@ void Remote::send(const std::string& data) {
   socket_->write(data);
 }
 
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::send_bytes(std::span<const char> data) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+  socket_->write(std::string_view(data.data(), data.size()));
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::send_parts(std::span<const std::string_view> parts) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+  socket_->write(parts);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::send_file(int fd, std::uint64_t offset, std::uint64_t length) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
+  constexpr std::uint64_t kChunk = 1 << 20;
+  SigpipeBlock sigpipe_block;
+
+  if(not socket_->is_tls()) {
+    const int out = socket_->native_handle();
+    off_t position = static_cast<off_t>(offset);
+
+    while(length > 0) {
+      const ssize_t sent = ::sendfile(out, fd, &position, std::min(length, kChunk));
+      if(sent < 0 && errno == EINTR) continue;
+      if(sent < 0 && errno == EAGAIN) {
+        // a non-blocking socket, this call blocks like send() does
+        wait_ready(out, POLLOUT);
+        continue;
+      }
+      if(sent < 0 && (errno == EINVAL || errno == ENOSYS) && position == static_cast<off_t>(offset)) {
+        // not a file sendfile() can read from, copy it below
+        break;
+      }
+      if(sent < 0) {
+        throw std::system_error(errno, std::system_category(), "sendfile() failed");
+      }
+      if(sent == 0) {
+        throw std::runtime_error("File ended before " + std::to_string(length) + " more bytes were sent");
+      }
+      length -= static_cast<std::uint64_t>(sent);
+    }
+    if(length == 0) {
+      return;
+    }
+  }
+
+  std::vector<char> buffer(static_cast<std::size_t>(std::min(length, kChunk / 16)));
+  while(length > 0) {
+    const ssize_t count = ::pread(fd, buffer.data(), std::min<std::uint64_t>(length, buffer.size()),
+                                  static_cast<off_t>(offset));
+    if(count < 0 && errno == EINTR) continue;
+    if(count < 0) {
+      throw std::system_error(errno, std::system_category(), "pread() failed");
+    }
+    if(count == 0) {
+      throw std::runtime_error("File ended before " + std::to_string(length) + " more bytes were sent");
+    }
+    socket_->write(std::string_view(buffer.data(), static_cast<std::size_t>(count)));
+    offset += static_cast<std::uint64_t>(count);
+    length -= static_cast<std::uint64_t>(count);
+  }
+}
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -476,6 +1221,76 @@ void Remote::sendline(const std::string& data) {
   send(data + "\n");
 }
 
+//----------------------------------------
+// reads whatever the socket has into recv_buf_. throws on eof
+// or error, leaving buffered bytes in place.
+//----------------------------------------
+std::size_t Remote::fill_recv_buffer() {
+  // under a read timeout a peer trickling a partial TLS record
+  // must not block us, so go through the non-blocking fill
+  const auto deadline = read_deadline();
+  if(deadline != std::chrono::steady_clock::time_point::max()) {
+    const size_t before = recv_buf_.size();
+    if(not fill_recv_buffer(deadline)) {
+      throw asio::system_error(asio::error::timed_out);
+    }
+    return recv_buf_.size() - before;
+  }
+
+  auto space = recv_buf_.prepare(4096);
+
+  asio::error_code ec;
+  const size_t len = socket_->read_some(space.data(), space.size(), ec);
+  if(ec) {
+    throw asio::system_error(ec);
+  }
+
+  recv_buf_.commit(len);
+  return len;
+}
+
+//----------------------------------------
+// timed fill. false once the deadline passes without data,
+// throws on eof or error like the untimed one.
+//----------------------------------------
+bool Remote::fill_recv_buffer(std::chrono::steady_clock::time_point deadline) {
+  while(socket_->wait_readable(deadline)) {
+    auto space = recv_buf_.prepare(4096);
+
+    asio::error_code ec;
+    const size_t len = socket_->read_nonblocking(space.data(), space.size(), ec);
+    if(ec == asio::error::would_block || ec == asio::error::try_again) {
+      continue;
+    }
+    if(ec) {
+      throw asio::system_error(ec);
+    }
+
+    recv_buf_.commit(len);
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------
+// when the next blocking read has to give up, time_point::max()
+// without set_read_timeout
+//----------------------------------------
+std::chrono::steady_clock::time_point Remote::read_deadline() const {
+  if(read_timeout_.count() == 0) {
+    return read_deadline_;
+  }
+  return std::min(read_deadline_, std::chrono::steady_clock::now() + read_timeout_);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::set_read_timeout(std::chrono::milliseconds idle, std::chrono::steady_clock::time_point deadline) {
+  read_timeout_ = idle;
+  read_deadline_ = deadline;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
@@ -484,22 +1299,209 @@ std::string Remote::recv(std::size_t size) {
     throw std::runtime_error("No socket available!");
   }
 
-  std::vector<char> buf(size);
-  size_t len = socket_->read(buf.data(), size);
-  return std::string(buf.begin(), buf.begin() + len);
+  if(read_deadline() != std::chrono::steady_clock::time_point::max()) {
+    return std::string(recv_view(size));
+  }
+
+  // serve whatever an earlier call read ahead first, then read
+  // the rest straight into the result
+  const size_t buffered = std::min(size, recv_buf_.size());
+  std::string result(recv_buf_.data().substr(0, buffered));
+  recv_buf_.consume(buffered);
+
+  if(buffered < size) {
+    result.resize(size);
+    const size_t len = socket_->read(result.data() + buffered, size - buffered);
+    result.resize(buffered + len);
+  }
+  return result;
+}
+
+//----------------------------------------
+// buffered bytes first, otherwise one read straight into buffer
+//----------------------------------------
+std::size_t Remote::recv_into(std::span<char> buffer) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
+  if(not recv_buf_.empty()) {
+    const size_t len = std::min(buffer.size(), recv_buf_.size());
+    std::memcpy(buffer.data(), recv_buf_.data().data(), len);
+    recv_buf_.consume(len);
+    return len;
+  }
+
+  if(read_deadline() != std::chrono::steady_clock::time_point::max()) {
+    try {
+      fill_recv_buffer();
+    } catch (const asio::system_error& e) {
+      if(e.code() == asio::error::eof || e.code() == asio::ssl::error::stream_truncated) {
+        return 0;
+      }
+      throw;
+    }
+    return recv_into(buffer);
+  }
+
+  asio::error_code ec;
+  const size_t len = socket_->read_some(buffer.data(), buffer.size(), ec);
+  if(ec == asio::error::eof || ec == asio::ssl::error::stream_truncated) {
+    return 0;
+  }
+  if(ec) {
+    throw asio::system_error(ec);
+  }
+  return len;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Remote::take_buffered() {
+  std::string ahead(recv_buf_.data());
+  recv_buf_.clear();
+  return ahead;
+}
+
+//----------------------------------------
+// the socket itself when the bytes on it are not encrypted
+//----------------------------------------
+int Remote::read_fd() noexcept {
+  return socket_ && not socket_->is_tls() ? socket_->native_handle() : -1;
+}
+
+int Remote::write_fd() noexcept {
+  return read_fd();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string_view Remote::recv_view(std::size_t size) {
+  const std::string_view view = peek(size);
+  recv_buf_.consume(size);
+  return view;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string_view Remote::peek(std::size_t size) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
+  while(recv_buf_.size() < size) {
+    fill_recv_buffer();
+  }
+  return recv_buf_.data().substr(0, size);
 }
 
 //----------------------------------------
 //
 //----------------------------------------
 std::string Remote::recvuntil(const std::string& delim) {
+  return std::string(recvuntil_view(delim));
+}
+
+//----------------------------------------
+// only bytes that arrived since the last miss are searched.
+// anything read past the delimiter stays buffered.
+//----------------------------------------
+std::string_view Remote::recvuntil_view(std::string_view delim, std::size_t max_size) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    if(recv_buf_.size() >= max_size) {
+      throw std::length_error("Delimiter not found within " + std::to_string(max_size) + " bytes");
+    }
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    fill_recv_buffer();
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  if(len > max_size) {
+    throw std::length_error("Delimiter not found within " + std::to_string(max_size) + " bytes");
+  }
+  const std::string_view view = recv_buf_.data().substr(0, len);
+  recv_buf_.consume(len);
+  return view;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Remote::recv(std::size_t size, std::chrono::milliseconds timeout) {
   if(not socket_) {
     throw std::runtime_error("No socket available!");
   }
 
-  asio::streambuf buf;
-  socket_->read_until(buf, delim);
-  return std::string(asio::buffers_begin(buf.data()), asio::buffers_end(buf.data()));
+  if(recv_buf_.empty() && not fill_recv_buffer(std::chrono::steady_clock::now() + timeout)) {
+    return {};
+  }
+
+  const size_t n = std::min(size, recv_buf_.size());
+  std::string result(recv_buf_.data().substr(0, n));
+  recv_buf_.consume(n);
+  return result;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Remote::recvuntil(const std::string& delim, std::chrono::milliseconds timeout) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    if(not fill_recv_buffer(deadline)) {
+      return {};
+    }
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  std::string result(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
+  return result;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Remote::recvline(std::chrono::milliseconds timeout) {
+  return recvuntil("\n", timeout);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool Remote::can_recv(std::chrono::milliseconds timeout) {
+  if(not socket_) {
+    return false;
+  }
+  return not recv_buf_.empty() || socket_->wait_readable(std::chrono::steady_clock::now() + timeout);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Remote::alpn_protocol() const {
+  return socket_ ? std::string(socket_->alpn_protocol()) : std::string();
 }
 
 //----------------------------------------
@@ -563,25 +1565,508 @@ std::string Remote::recvline() {
 //
 //----------------------------------------
 std::string Remote::recvall() {
-  std::string result;
-  std::array<char, 4096> buf;
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
   asio::error_code ec;
 
   while(true) {
-    size_t len = socket_->read_some(buf.data(), buf.size(), ec);
+    auto space = recv_buf_.prepare(4096);
+    size_t len = socket_->read_some(space.data(), space.size(), ec);
 
     if(ec == asio::error::eof || ec == asio::error::connection_reset) break;
     if(ec) throw std::runtime_error("recvall failed: " + ec.message());
         
-    result.append(buf.data(), len);
+    recv_buf_.commit(len);
   }
+
+  std::string result(recv_buf_.data());
+  recv_buf_.clear();
   return result;
 }
 
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::async_wait(std::function<void(const asio::error_code&)> handler) {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+
+  // pipelined data we already hold is readable right away
+  if(not recv_buf_.empty()) {
+    asio::post(socket_->get_executor(), [handler = std::move(handler)] {
+      handler(asio::error_code{});
+    });
+    return;
+  }
+  socket_->async_wait(std::move(handler));
+}
+
+//----------------------------------------
+// awaiting a socket on the private io_context would never
+// complete, nobody runs it
+//----------------------------------------
+void Remote::require_shared_executor() {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+  if(socket_->get_executor() == asio::any_io_executor(io_.get_executor())) {
+    throw std::logic_error("Remote is bound to its own io_context, open it with async_connect to await it");
+  }
+}
+
+//----------------------------------------
+// the opposite: run_io() runs the private io_context itself and
+// must not steal handlers from a loop somebody else runs
+//----------------------------------------
+void Remote::require_own_executor() {
+  if(not socket_) {
+    throw std::runtime_error("No socket available!");
+  }
+  if(socket_->get_executor() != asio::any_io_executor(io_.get_executor())) {
+    throw std::logic_error("Remote runs on a shared executor, use the awaitable calls on it");
+  }
+}
+
+//----------------------------------------
+// buffers of the operations in flight stay put until they
+// complete
+//----------------------------------------
+struct Remote::DrivenIo {
+  std::string sending;                  // the write in flight
+  std::string queued;                   // waiting behind it
+  std::array<char, 64 << 10> incoming;  // the read in flight
+  asio::error_code read_error;
+  bool writing = false;
+  bool reading = false;
+  std::exception_ptr error;
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::queue_send(std::string_view data) {
+  if(not driven_) {
+    driven_ = std::make_unique<DrivenIo>();
+  }
+  driven_->queued.append(data);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::size_t Remote::unsent() const noexcept {
+  return driven_ ? driven_->sending.size() + driven_->queued.size() : 0;
+}
+
+//----------------------------------------
+// keeps one read and one write in flight. both are asio's
+// asynchronous operations, so with TLS the stream itself sorts
+// out records that need the other direction first.
+//----------------------------------------
+void Remote::run_io(std::chrono::milliseconds timeout) {
+  require_own_executor();
+  if(not driven_) {
+    driven_ = std::make_unique<DrivenIo>();
+  }
+  DrivenIo& driven = *driven_;
+  if(driven.error) {
+    std::rethrow_exception(driven.error);
+  }
+
+  if(not driven.writing && not driven.queued.empty()) {
+    driven.sending.swap(driven.queued);
+    driven.queued.clear();
+    driven.writing = true;
+    asio::co_spawn(io_, socket_->async_write(driven.sending), [&driven](std::exception_ptr error) {
+      driven.writing = false;
+      driven.sending.clear();
+      if(error && not driven.error) driven.error = error;
+    });
+  }
+
+  if(not driven.reading && not driven.error) {
+    driven.reading = true;
+    asio::co_spawn(io_, socket_->async_read_some(driven.incoming.data(), driven.incoming.size(), driven.read_error),
+      [this, &driven](std::exception_ptr error, size_t length) {
+        driven.reading = false;
+        if(not error && driven.read_error) {
+          error = std::make_exception_ptr(asio::system_error(driven.read_error));
+        }
+        if(error) {
+          if(not driven.error) driven.error = error;
+          return;
+        }
+        auto space = recv_buf_.prepare(length);
+        std::memcpy(space.data(), driven.incoming.data(), length);
+        recv_buf_.commit(length);
+      });
+  }
+
+  if(io_.stopped()) {
+    io_.restart();
+  }
+  if(timeout.count() > 0 && io_.run_one_for(timeout) == 0) {
+    return;
+  }
+  io_.poll();
+
+  if(driven.error) {
+    std::rethrow_exception(driven.error);
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Remote::wake_io() {
+  asio::post(io_, [] {});
+}
+
+//----------------------------------------
+// awaits whatever the socket has into recv_buf_. throws on eof
+// or error, leaving buffered bytes in place.
+//----------------------------------------
+asio::awaitable<void> Remote::async_fill_recv_buffer() {
+  auto space = recv_buf_.prepare(4096);
+
+  asio::error_code ec;
+  const size_t len = co_await socket_->async_read_some(space.data(), space.size(), ec);
+  if(ec) {
+    throw asio::system_error(ec);
+  }
+  recv_buf_.commit(len);
+}
+
+//----------------------------------------
+// timed fill. false once the deadline passes without data.
+//----------------------------------------
+asio::awaitable<bool> Remote::async_fill_recv_buffer(std::chrono::steady_clock::time_point deadline) {
+  co_return co_await await_until(*socket_, deadline, [this] { return async_fill_recv_buffer(); });
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<void> Remote::async_send(std::string data) {
+  require_shared_executor();
+  co_await socket_->async_write(data);
+}
+
+//----------------------------------------
+// one write at a time, so the timeout covers each wait for the
+// peer to take more rather than the whole transfer
+//----------------------------------------
+asio::awaitable<void> Remote::async_send_parts(std::span<const std::string_view> parts,
+                                               std::chrono::milliseconds timeout) {
+  require_shared_executor();
+
+  constexpr std::size_t kBatch = 8;
+  std::array<asio::const_buffer, kBatch> buffers;
+  std::size_t done = 0;   // of parts.front()
+
+  while(not parts.empty()) {
+    const std::size_t count = std::min(parts.size(), kBatch);
+    for(std::size_t i = 0; i < count; ++i) {
+      buffers[i] = asio::buffer(parts[i]);
+    }
+    buffers[0] += done;
+
+    std::size_t written = 0;
+    auto write = [&]() -> asio::awaitable<void> {
+      written = co_await socket_->async_write_some(std::span<const asio::const_buffer>(buffers.data(), count));
+    };
+    if(timeout.count() == 0) {
+      co_await write();
+    } else if(not co_await await_until(*socket_, std::chrono::steady_clock::now() + timeout, write)) {
+      throw asio::system_error(asio::error::timed_out);
+    }
+
+    written += done;
+    while(not parts.empty() && written >= parts.front().size()) {
+      written -= parts.front().size();
+      parts = parts.subspan(1);
+    }
+    done = written;
+  }
+}
+
+//----------------------------------------
+// the awaitable send_file(). a full send buffer is waited out
+// on the executor instead of in poll().
+//----------------------------------------
+asio::awaitable<void> Remote::async_send_file(int fd, std::uint64_t offset, std::uint64_t length,
+                                              std::chrono::milliseconds timeout) {
+  require_shared_executor();
+
+  constexpr std::uint64_t kChunk = 1 << 20;
+
+  if(not socket_->is_tls()) {
+    off_t position = static_cast<off_t>(offset);
+
+    while(length > 0) {
+      asio::error_code ec;
+      const size_t sent = socket_->sendfile_nonblocking(fd, position, std::min(length, kChunk), ec);
+      if(ec == asio::error::would_block || ec == asio::error::try_again) {
+        auto writable = [this] { return socket_->async_wait_writable(); };
+        if(timeout.count() == 0) {
+          co_await writable();
+        } else if(not co_await await_until(*socket_, std::chrono::steady_clock::now() + timeout, writable)) {
+          throw asio::system_error(asio::error::timed_out);
+        }
+        continue;
+      }
+      if((ec.value() == EINVAL || ec.value() == ENOSYS) && position == static_cast<off_t>(offset)) {
+        // not a file sendfile() can read from, copy it below
+        break;
+      }
+      if(ec) {
+        throw asio::system_error(ec, "sendfile");
+      }
+      if(sent == 0) {
+        throw std::runtime_error("File ended before " + std::to_string(length) + " more bytes were sent");
+      }
+      length -= sent;
+    }
+    if(length == 0) {
+      co_return;
+    }
+  }
+
+  std::vector<char> buffer(static_cast<std::size_t>(std::min(length, kChunk / 16)));
+  while(length > 0) {
+    const ssize_t count = ::pread(fd, buffer.data(), std::min<std::uint64_t>(length, buffer.size()),
+                                  static_cast<off_t>(offset));
+    if(count < 0 && errno == EINTR) continue;
+    if(count < 0) {
+      throw std::system_error(errno, std::system_category(), "pread() failed");
+    }
+    if(count == 0) {
+      throw std::runtime_error("File ended before " + std::to_string(length) + " more bytes were sent");
+    }
+    const std::array<std::string_view, 1> chunk{std::string_view(buffer.data(), static_cast<std::size_t>(count))};
+    co_await async_send_parts(chunk, timeout);
+    offset += static_cast<std::uint64_t>(count);
+    length -= static_cast<std::uint64_t>(count);
+  }
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<void> Remote::async_sendline(std::string data) {
+  data += '\n';
+  co_await async_send(std::move(data));
+}
+
+//----------------------------------------
+// exactly size bytes, like recv(size)
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recv(std::size_t size) {
+  require_shared_executor();
+
+  while(recv_buf_.size() < size) {
+    co_await async_fill_recv_buffer();
+  }
+
+  std::string result(recv_buf_.data().substr(0, size));
+  recv_buf_.consume(size);
+  co_return result;
+}
+
+//----------------------------------------
+// only bytes that arrived since the last miss are searched.
+// anything read past the delimiter stays buffered.
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recvuntil(std::string delim) {
+  require_shared_executor();
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    co_await async_fill_recv_buffer();
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  std::string result(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
+  co_return result;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recvline() {
+  co_return co_await async_recvuntil("\n");
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recvall() {
+  require_shared_executor();
+
+  while(true) {
+    auto space = recv_buf_.prepare(4096);
+
+    asio::error_code ec;
+    const size_t len = co_await socket_->async_read_some(space.data(), space.size(), ec);
+    if(ec == asio::error::eof || ec == asio::error::connection_reset) break;
+    if(ec) throw std::runtime_error("recvall failed: " + ec.message());
+
+    recv_buf_.commit(len);
+  }
+
+  std::string result(recv_buf_.data());
+  recv_buf_.clear();
+  co_return result;
+}
+
+//----------------------------------------
+// whatever arrived, at most size bytes, empty on timeout
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recv(std::size_t size, std::chrono::milliseconds timeout) {
+  require_shared_executor();
+
+  if(recv_buf_.empty() && not co_await async_fill_recv_buffer(std::chrono::steady_clock::now() + timeout)) {
+    co_return std::string();
+  }
+
+  const size_t n = std::min(size, recv_buf_.size());
+  std::string result(recv_buf_.data().substr(0, n));
+  recv_buf_.consume(n);
+  co_return result;
+}
+
+//----------------------------------------
+// empty on timeout, keeping what arrived so far buffered
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recvuntil(std::string delim, std::chrono::milliseconds timeout) {
+  require_shared_executor();
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  size_t searched = 0;
+  size_t pos = recv_buf_.find(delim);
+
+  while(pos == RecvBuffer::npos) {
+    searched = recv_buf_.size() >= delim.size() ? recv_buf_.size() - delim.size() + 1 : 0;
+    if(not co_await async_fill_recv_buffer(deadline)) {
+      co_return std::string();
+    }
+    pos = recv_buf_.find(delim, searched);
+  }
+
+  const size_t len = pos + delim.size();
+  std::string result(recv_buf_.data().substr(0, len));
+  recv_buf_.consume(len);
+  co_return result;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Remote::async_recvline(std::chrono::milliseconds timeout) {
+  co_return co_await async_recvuntil("\n", timeout);
+}
+
+//----------------------------------------
+// async counterpart of connect_to(). names missing from the
+// DnsCache are looked up by asio's resolver, which runs
+// getaddrinfo() off the awaiting thread, and cached for both.
+//----------------------------------------
+asio::awaitable<asio::ip::tcp::socket> Remote::async_connect_to(std::string host, uint16_t port,
+                                                                ConnectOptions connect, ConnectTiming& timing) {
+  auto started = phase_start();
+  std::vector<asio::ip::tcp::endpoint> endpoints;
+  if(auto cached = DnsCache::global().find(host, port)) {
+    endpoints = std::move(*cached);
+  } else {
+    asio::ip::tcp::resolver resolver(co_await asio::this_coro::executor);
+    const auto results = co_await resolver.async_resolve(host, std::to_string(port), asio::use_awaitable);
+    for(const auto& entry : results) {
+      endpoints.push_back(entry.endpoint());
+    }
+    DnsCache::global().insert(host, endpoints);
+  }
+  timing.dns = phase_since(started);
+
+  started = phase_start();
+  std::optional<asio::ip::tcp::socket> socket;
+  try {
+    socket.emplace(co_await async_race_connect(interleave_families(endpoints), connect));
+  } catch (const asio::system_error&) {
+    DnsCache::global().forget(host);
+    throw;
+  }
+  timing.connect = phase_since(started);
+  co_return std::move(*socket);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::unique_ptr<Remote>> Remote::async_connect(std::string host, uint16_t port,
+                                                               bool use_tls, bool verify_certificate, ConnectOptions connect) {
+  if(not use_tls) {
+    ConnectTiming timing;
+    auto remote = std::make_unique<Remote>(co_await async_connect_to(host, port, connect, timing));
+    remote->connect_timing_ = timing;
+    co_return remote;
+  }
+
+  auto ssl_ctx = std::make_shared<asio::ssl::context>(asio::ssl::context::tlsv12_client);
+  if(verify_certificate) {
+    ssl_ctx->set_default_verify_paths();
+    ssl_ctx->set_verify_mode(asio::ssl::verify_peer);
+  } else {
+    ssl_ctx->set_verify_mode(asio::ssl::verify_none);
+  }
+  co_return co_await async_connect(std::move(host), port, std::move(ssl_ctx), connect);
+}
+
+//----------------------------------------
+// a shared context with resumption enabled offers the host's
+// cached session, like the blocking constructor
+//----------------------------------------
+asio::awaitable<std::unique_ptr<Remote>> Remote::async_connect(std::string host, uint16_t port,
+                                                               std::shared_ptr<asio::ssl::context> ssl_ctx,
+                                                               ConnectOptions connect) {
+  if(not ssl_ctx) {
+    throw std::invalid_argument("SSL context cannot be null");
+  }
+
+  ConnectTiming timing;
+  asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(co_await async_connect_to(host, port, connect, timing), *ssl_ctx);
+  if(not SSL_set_tlsext_host_name(ssl_socket.native_handle(), host.c_str())) {
+    throw std::runtime_error("Failed to set SNI hostname");
+  }
+  attach_cached_session(ssl_socket.native_handle(), host, port);
+
+  const auto handshake_started = phase_start();
+  asio::error_code ec;
+  co_await ssl_socket.async_handshake(asio::ssl::stream_base::client, asio::redirect_error(asio::use_awaitable, ec));
+  if(ec) {
+    forget_cached_session(ssl_socket.native_handle());
+    throw asio::system_error(ec, "handshake");
+  }
+  timing.tls_handshake = phase_since(handshake_started);
+
+  auto remote = std::make_unique<Remote>(std::move(ssl_socket));
+  remote->connect_timing_ = timing;
+  co_return remote;
+}
+
 //----------------------------------------
 //
 //----------------------------------------
 void Remote::swap_socket(asio::ip::tcp::socket&& socket) {
+  recv_buf_.clear();
   socket_ = std::make_unique<TcpSocketImpl>(std::move(socket));
 }
 
@@ -0,0 +1,203 @@
+#include <Router.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace cpppwn {
+
+//----------------------------------------
+//
+//----------------------------------------
+struct Router::Node {
+  std::string label;                                                // literal segment leading here
+  std::vector<std::unique_ptr<Node>> children;                      // literal children, sorted by label
+  std::unique_ptr<Node> param;                                      // the :name child
+  std::string param_name;
+  std::unique_ptr<Node> wildcard;                                   // the *name child, always a leaf
+  std::string wildcard_name;
+  std::vector<std::pair<std::string, Route>> handlers;              // by method
+  std::string allow;                                                // handlers' methods for a 405
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  [[nodiscard]] const Node* child(std::string_view segment) const {
+    auto it = std::lower_bound(children.begin(), children.end(), segment,
+      [](const std::unique_ptr<Node>& node, std::string_view key) { return node->label < key; });
+    return (it != children.end() && (*it)->label == segment) ? it->get() : nullptr;
+  }
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  Node& add_child(std::string_view segment) {
+    auto it = std::lower_bound(children.begin(), children.end(), segment,
+      [](const std::unique_ptr<Node>& node, std::string_view key) { return node->label < key; });
+    if(it == children.end() || (*it)->label != segment) {
+      it = children.insert(it, std::make_unique<Node>());
+      (*it)->label = segment;
+    }
+    return **it;
+  }
+
+  //----------------------------------------
+  // pos is the end of the path or the '/' ahead of the next segment
+  //----------------------------------------
+  const Node* walk(std::string_view path, size_t pos, PathParams& params) const {
+    if(pos == path.size()) {
+      if(not handlers.empty()) return this;
+      if(wildcard) return capture(params, wildcard_name, pos, 0) ? wildcard.get() : nullptr;
+      return nullptr;
+    }
+
+    const size_t start = pos + 1;
+    size_t end = path.find('/', start);
+    if(end == std::string_view::npos) end = path.size();
+    const std::string_view segment = path.substr(start, end - start);
+    const size_t saved = params.count;
+
+    if(const Node* next = child(segment)) {
+      if(const Node* found = next->walk(path, end, params)) return found;
+      params.count = saved;
+    }
+
+    if(param && not segment.empty() && capture(params, param_name, start, segment.size())) {
+      if(const Node* found = param->walk(path, end, params)) return found;
+      params.count = saved;
+    }
+
+    if(wildcard && capture(params, wildcard_name, start, path.size() - start)) {
+      return wildcard.get();
+    }
+    return nullptr;
+  }
+
+  //----------------------------------------
+  //
+  //----------------------------------------
+  static bool capture(PathParams& params, std::string_view name, size_t offset, size_t length) {
+    if(params.count == PathParams::max_params) return false;
+    params.items[params.count++] = {name, offset, length};
+    return true;
+  }
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+Router::Router() : root_(std::make_unique<Node>()) {
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+Router::~Router() = default;
+
+//----------------------------------------
+//
+//----------------------------------------
+Router::Router(Router&&) noexcept = default;
+
+//----------------------------------------
+//
+//----------------------------------------
+Router& Router::operator=(Router&&) noexcept = default;
+
+//----------------------------------------
+//
+//----------------------------------------
+void Router::add(std::string_view method, std::string_view pattern, Route route) {
+  if(pattern.empty() || pattern.front() != '/') {
+    throw std::invalid_argument("Route pattern must start with '/': " + std::string(pattern));
+  }
+
+  Node* node = root_.get();
+  size_t captures = 0;
+
+  for(size_t pos = 0; pos < pattern.size(); ) {
+    const size_t start = pos + 1;
+    size_t end = pattern.find('/', start);
+    if(end == std::string_view::npos) end = pattern.size();
+    const std::string_view segment = pattern.substr(start, end - start);
+    pos = end;
+
+    if(segment.size() > 1 && (segment.front() == ':' || segment.front() == '*')) {
+      if(++captures > PathParams::max_params) {
+        throw std::invalid_argument("Route pattern captures too many parameters: " + std::string(pattern));
+      }
+
+      const std::string_view name = segment.substr(1);
+      std::unique_ptr<Node>& next = segment.front() == ':' ? node->param : node->wildcard;
+      std::string& next_name = segment.front() == ':' ? node->param_name : node->wildcard_name;
+
+      if(segment.front() == '*' && end != pattern.size()) {
+        throw std::invalid_argument("Wildcard must be the last route segment: " + std::string(pattern));
+      }
+      if(next && next_name != name) {
+        throw std::invalid_argument("Route parameter '" + std::string(segment) + "' conflicts with '"
+          + std::string(1, segment.front()) + next_name + "': " + std::string(pattern));
+      }
+      if(not next) {
+        next = std::make_unique<Node>();
+        next_name = name;
+      }
+      node = next.get();
+    } else {
+      node = &node->add_child(segment);
+    }
+  }
+
+  auto it = std::find_if(node->handlers.begin(), node->handlers.end(),
+    [&](const auto& entry) { return entry.first == method; });
+  if(it != node->handlers.end()) {
+    it->second = std::move(route);
+    return;
+  }
+
+  node->handlers.emplace_back(method, std::move(route));
+  node->allow += node->allow.empty() ? "" : ", ";
+  node->allow += method;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+RouteMatch Router::match(std::string_view method, std::string_view path, PathParams& params) const {
+  params.count = 0;
+  if(path.empty() || path.front() != '/') {
+    return {};
+  }
+
+  const Node* node = root_->walk(path, 0, params);
+  if(not node) {
+    params.count = 0;
+    return {};
+  }
+
+  const Route* any = nullptr;
+  for(const auto& [route_method, route] : node->handlers) {
+    if(route_method == method) {
+      return {RouteStatus::Found, &route, {}};
+    }
+    if(route_method == "*") {
+      any = &route;
+    }
+  }
+  if(any) {
+    return {RouteStatus::Found, any, {}};
+  }
+
+  params.count = 0;
+  return {RouteStatus::MethodNotAllowed, nullptr, node->allow};
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool Router::empty() const noexcept {
+  return root_->children.empty() && not root_->param && not root_->wildcard && root_->handlers.empty();
+}
+
+} // namespace cpppwn
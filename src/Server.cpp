@@ -3,16 +3,207 @@
 
 #include <asio/ip/tcp.hpp>
 #include <asio/ssl.hpp>
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <filesystem>
 #include <stdexcept>
 #include <fstream>
+#include <vector>
+#include <system_error>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 namespace fs = std::filesystem;
 
 namespace cpppwn {
 
+namespace {
+
+    //----------------------------------------
+    // 0.0.0.0 and :: listen on every address of their family,
+    // anything else is resolved
+    //----------------------------------------
+    asio::ip::tcp::endpoint listen_endpoint(asio::io_context& io, uint16_t port, const std::string& bind_addr) {
+      if(bind_addr.empty() || bind_addr == "0.0.0.0") {
+        return asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port);
+      }
+      if(bind_addr == "::") {
+        return asio::ip::tcp::endpoint(asio::ip::tcp::v6(), port);
+      }
+
+      asio::ip::tcp::resolver resolver(io);
+      auto results = resolver.resolve(bind_addr, std::to_string(port));
+      return *results.begin();
+    }
+
+    //----------------------------------------
+    // options asio has no type for
+    //----------------------------------------
+    [[maybe_unused]] void set_int_option(asio::ip::tcp::acceptor& acceptor, int level, int name, int value) {
+      if(::setsockopt(acceptor.native_handle(), level, name, &value, sizeof(value)) != 0) {
+        throw std::system_error(errno, std::system_category(), "setsockopt() failed");
+      }
+    }
+
+    //----------------------------------------
+    // the listening sockets of a server, all bound to the same
+    // endpoint. accepted sockets are set up as options asks.
+    //----------------------------------------
+    class Listener {
+    public:
+      //----------------------------------------
+      //
+      //----------------------------------------
+      Listener(asio::io_context& io, uint16_t port, const std::string& bind_addr, const ServerOptions& options)
+        : options_(options) {
+        auto endpoint = listen_endpoint(io, port, bind_addr);
+        const size_t count = std::max<size_t>(1, options.acceptors);
+
+#ifndef SO_REUSEPORT
+        if(count > 1) {
+          throw std::runtime_error("SO_REUSEPORT is not supported here, use a single acceptor");
+        }
+#endif
+
+        acceptors_.reserve(count);
+        for(size_t i = 0; i < count; ++i) {
+          auto& acceptor = acceptors_.emplace_back(io);
+          acceptor.open(endpoint.protocol());
+          acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+          if(count > 1) {
+            set_int_option(acceptor, SOL_SOCKET, SO_REUSEPORT, 1);
+          }
+#endif
+
+          // accepted sockets inherit these. they have to be set
+          // before listen() for the window scale to match.
+          if(options.receive_buffer_size > 0) {
+            acceptor.set_option(asio::socket_base::receive_buffer_size(options.receive_buffer_size));
+          }
+          if(options.send_buffer_size > 0) {
+            acceptor.set_option(asio::socket_base::send_buffer_size(options.send_buffer_size));
+          }
+
+          acceptor.bind(endpoint);
+          // port 0 picked a port, the other acceptors share it
+          endpoint.port(acceptor.local_endpoint().port());
+
+#ifdef TCP_FASTOPEN
+          if(options.tcp_fastopen > 0) {
+            set_int_option(acceptor, IPPROTO_TCP, TCP_FASTOPEN, options.tcp_fastopen);
+          }
+#endif
+#ifdef TCP_DEFER_ACCEPT
+          if(options.defer_accept > 0) {
+            set_int_option(acceptor, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.defer_accept);
+          }
+#endif
+
+          acceptor.listen(options.backlog);
+          if(count > 1) {
+            acceptor.non_blocking(true);
+          }
+        }
+      }
+
+      //----------------------------------------
+      // blocks until one of the acceptors has a connection
+      //----------------------------------------
+      void accept(asio::ip::tcp::socket::lowest_layer_type& socket) {
+        if(acceptors_.size() == 1) {
+          acceptors_.front().accept(socket);
+          configure(socket);
+          return;
+        }
+
+        std::vector<pollfd> fds;
+        fds.reserve(acceptors_.size());
+        for(auto& acceptor : acceptors_) {
+          fds.push_back({acceptor.native_handle(), POLLIN, 0});
+        }
+
+        while(true) {
+          if(::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "poll() failed");
+          }
+
+          for(size_t i = 0; i < fds.size(); ++i) {
+            if(fds[i].revents == 0) continue;
+
+            // another thread may have taken it first
+            asio::error_code ec;
+            acceptors_[i].accept(socket, ec);
+            if(ec == asio::error::would_block || ec == asio::error::try_again) continue;
+            if(ec) {
+              throw asio::system_error(ec);
+            }
+
+            configure(socket);
+            return;
+          }
+        }
+      }
+
+      //----------------------------------------
+      // the accepted socket runs on executor
+      //----------------------------------------
+      template<typename Handler>
+      void async_accept(size_t index, const asio::any_io_executor& executor, Handler handler) {
+        if(index >= acceptors_.size()) {
+          throw std::out_of_range("Server has no acceptor " + std::to_string(index));
+        }
+
+        acceptors_[index].async_accept(executor,
+          [this, handler = std::move(handler)](const asio::error_code& ec, asio::ip::tcp::socket socket) mutable {
+            if(not ec) {
+              configure(socket);
+            }
+            handler(ec, std::move(socket));
+          });
+      }
+
+      //----------------------------------------
+      //
+      //----------------------------------------
+      void close() {
+        for(auto& acceptor : acceptors_) {
+          asio::error_code ec;
+          acceptor.close(ec);
+        }
+      }
+
+      //----------------------------------------
+      //
+      //----------------------------------------
+      bool is_open() const {
+        return std::ranges::any_of(acceptors_, [](const auto& acceptor) { return acceptor.is_open(); });
+      }
+
+      size_t size() const noexcept { return acceptors_.size(); }
+
+      const ServerOptions& options() const noexcept { return options_; }
+
+    private:
+      //----------------------------------------
+      //
+      //----------------------------------------
+      void configure(asio::ip::tcp::socket::lowest_layer_type& socket) const {
+        if(options_.tcp_nodelay) {
+          asio::error_code ignored;
+          socket.set_option(asio::ip::tcp::no_delay(true), ignored);
+        }
+      }
+
+      ServerOptions options_;
+      std::vector<asio::ip::tcp::acceptor> acceptors_;
+    };
+}
+
 //----------------------------------------
 // Server Implementation (Pimpl pattern)
 //----------------------------------------
@@ -20,6 +211,8 @@ class Server::ServerImpl {
 public:
   virtual ~ServerImpl() = default;
   virtual std::unique_ptr<Remote> accept() = 0;
+  virtual void async_accept(size_t acceptor, AcceptHandler handler, ConnectHandler on_connect) = 0;
+  virtual size_t acceptor_count() const noexcept = 0;
   virtual void close() = 0;
   virtual bool is_open() const = 0;
 };
@@ -32,52 +225,60 @@ public:
   //----------------------------------------
   //
   //----------------------------------------
-  explicit TcpServerImpl(asio::io_context& io, uint16_t port, const std::string& bind_addr) 
-  : acceptor_(io) {
-    asio::ip::tcp::endpoint endpoint;
-        
-    if(bind_addr.empty() || bind_addr == "0.0.0.0") {
-      endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port);
-    } else if(bind_addr == "::") {
-      endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v6(), port);
-    } else {
-      asio::ip::tcp::resolver resolver(io);
-      auto results = resolver.resolve(bind_addr, std::to_string(port));
-      endpoint = *results.begin();
-    }
-        
-    acceptor_.open(endpoint.protocol());
-    acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-    acceptor_.bind(endpoint);
-    acceptor_.listen();
+  explicit TcpServerImpl(asio::io_context& io, uint16_t port, const std::string& bind_addr, const ServerOptions& options) 
+  : io_(io), listener_(io, port, bind_addr, options) {
   }
     
     //----------------------------------------
     //
     //----------------------------------------
     std::unique_ptr<Remote> accept() override {
-      asio::ip::tcp::socket socket(acceptor_.get_executor());
-      acceptor_.accept(socket);
+      asio::ip::tcp::socket socket(io_);
+      listener_.accept(socket);
       return std::make_unique<Remote>(std::move(socket));
     }
     
+    //----------------------------------------
+    //
+    //----------------------------------------
+    void async_accept(size_t acceptor, Server::AcceptHandler handler, Server::ConnectHandler on_connect) override {
+      listener_.async_accept(acceptor, io_.get_executor(),
+        [handler = std::move(handler), on_connect = std::move(on_connect)](const asio::error_code& ec, asio::ip::tcp::socket socket) {
+          if(ec) {
+            handler(ec, nullptr);
+            return;
+          }
+          if(on_connect) {
+            on_connect();
+          }
+          handler(ec, std::make_unique<Remote>(std::move(socket)));
+        });
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    size_t acceptor_count() const noexcept override {
+      return listener_.size();
+    }
+    
     //----------------------------------------
     //
     //----------------------------------------
     void close() override {
-      asio::error_code ec;
-      acceptor_.close(ec);
+      listener_.close();
     }
     
     //----------------------------------------
     //
     //----------------------------------------
     bool is_open() const override {
-      return acceptor_.is_open();
+      return listener_.is_open();
     }
     
 private:
-    asio::ip::tcp::acceptor acceptor_;
+    asio::io_context& io_;
+    Listener listener_;
 };
 
 //----------------------------------------
@@ -89,8 +290,8 @@ public:
     //----------------------------------------
     //
     //----------------------------------------
-    const std::string& bind_addr, const TlsConfig& tls_config)
-        : acceptor_(io), ssl_ctx_(asio::ssl::context::tlsv12_server) {
+    const std::string& bind_addr, const TlsConfig& tls_config, const ServerOptions& options)
+        : io_(io), ssl_ctx_(asio::ssl::context::tlsv12_server) {
         
           // Load certificate and private key
           if(not fs::exists(tls_config.cert_file)) {
@@ -121,68 +322,115 @@ public:
             SSL_CTX_set_cipher_list(ssl_ctx_.native_handle(), tls_config.cipher_list->c_str());
           }
         
-          // Set up acceptor
-          asio::ip::tcp::endpoint endpoint;
-        
-          if(bind_addr.empty() || bind_addr == "0.0.0.0") {
-            endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port);
-          } else if(bind_addr == "::") {
-            endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v6(), port);
-          } else {
-            asio::ip::tcp::resolver resolver(io);
-            auto results = resolver.resolve(bind_addr, std::to_string(port));
-            endpoint = *results.begin();
-          }
-        
-          acceptor_.open(endpoint.protocol());
-          acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-          acceptor_.bind(endpoint);
-          acceptor_.listen();
+          // Set up acceptors once the certificate loaded
+          listener_.emplace(io, port, bind_addr, options);
     }
     
     //----------------------------------------
     //
     //----------------------------------------
     std::unique_ptr<Remote> accept() override {
-      asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(acceptor_.get_executor(), ssl_ctx_);
-      acceptor_.accept(ssl_socket.lowest_layer());
+      asio::ssl::stream<asio::ip::tcp::socket> ssl_socket(io_, ssl_ctx_);
+      listener_->accept(ssl_socket.lowest_layer());
       ssl_socket.handshake(asio::ssl::stream_base::server);
       return std::make_unique<Remote>(std::move(ssl_socket));
     }
     
+    //----------------------------------------
+    // each connection gets a strand of its own, the handshake
+    // runs there while the acceptor moves on
+    //----------------------------------------
+    void async_accept(size_t acceptor, Server::AcceptHandler handler, Server::ConnectHandler on_connect) override {
+      listener_->async_accept(acceptor, asio::make_strand(io_),
+        [this, handler = std::move(handler), on_connect = std::move(on_connect)](const asio::error_code& ec, asio::ip::tcp::socket socket) mutable {
+          if(ec) {
+            handler(ec, nullptr);
+            return;
+          }
+          if(on_connect) {
+            on_connect();
+          }
+          handshake(std::move(socket), std::move(handler));
+        });
+    }
+
+    //----------------------------------------
+    //
+    //----------------------------------------
+    size_t acceptor_count() const noexcept override {
+      return listener_->size();
+    }
+    
     //----------------------------------------
     //
     //----------------------------------------
     void close() override {
-      asio::error_code ec;
-      acceptor_.close(ec);
+      listener_->close();
     }
     
     //----------------------------------------
     //
     //----------------------------------------
     bool is_open() const override {
-        return acceptor_.is_open();
+        return listener_->is_open();
     }
     
 private:
-  asio::ip::tcp::acceptor acceptor_;
+  //----------------------------------------
+  // races the handshake against handshake_timeout. the timer
+  // shares the connection's strand, so closing the socket
+  // cannot overlap the handshake's own work on it.
+  //----------------------------------------
+  void handshake(asio::ip::tcp::socket socket, Server::AcceptHandler handler) {
+    auto ssl_socket = std::make_shared<asio::ssl::stream<asio::ip::tcp::socket>>(std::move(socket), ssl_ctx_);
+    auto timer = std::make_shared<asio::steady_timer>(ssl_socket->get_executor());
+    const auto timeout = listener_->options().handshake_timeout;
+
+    asio::dispatch(ssl_socket->get_executor(), [ssl_socket, timer, timeout, handler = std::move(handler)] {
+      auto timed_out = std::make_shared<bool>(false);
+
+      if(timeout.count() > 0) {
+        timer->expires_after(timeout);
+        timer->async_wait([ssl_socket, timed_out](const asio::error_code& ec) {
+          if(ec) {
+            return;
+          }
+          *timed_out = true;
+          asio::error_code ignored;
+          ssl_socket->lowest_layer().close(ignored);
+        });
+      }
+
+      ssl_socket->async_handshake(asio::ssl::stream_base::server, [ssl_socket, timer, timed_out, handler](const asio::error_code& ec) {
+        timer->cancel();
+        if(ec || *timed_out) {
+          handler(*timed_out ? asio::error::timed_out : ec, nullptr);
+          return;
+        }
+        handler(ec, std::make_unique<Remote>(std::move(*ssl_socket)));
+      });
+    });
+  }
+
+  asio::io_context& io_;
   asio::ssl::context ssl_ctx_;
+  std::optional<Listener> listener_;
 };
 
 //----------------------------------------
 // Plain TCP server constructor
 //----------------------------------------
-Server::Server(uint16_t port, const std::string& bind_addr): io_(), impl_(nullptr) {
-  impl_ = std::make_unique<TcpServerImpl>(io_, port, bind_addr);
+Server::Server(uint16_t port, const std::string& bind_addr, const ServerOptions& options): io_(), impl_(nullptr) {
+  impl_ = std::make_unique<TcpServerImpl>(io_, port, bind_addr, options);
 }
 
 //----------------------------------------
 // TLS/SSL server constructor
 //----------------------------------------
-Server::Server(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr)
+Server::Server(uint16_t port, const TlsConfig& tls_config, const std::string& bind_addr,
+  const ServerOptions& options)
   : io_(), impl_(nullptr) {
-    impl_ = std::make_unique<TlsServerImpl>(io_, port, bind_addr, tls_config);
+    impl_ = std::make_unique<TlsServerImpl>(io_, port, bind_addr, tls_config, options);
 }
 
 //----------------------------------------
@@ -195,6 +443,30 @@ std::unique_ptr<Remote> Server::accept() {
   return impl_->accept();
 }
 
+//----------------------------------------
+// Accept incoming connection asynchronously
+//----------------------------------------
+void Server::async_accept(size_t acceptor, AcceptHandler handler, ConnectHandler on_connect) {
+  if(not impl_) {
+    throw std::runtime_error("Server not initialized");
+  }
+  impl_->async_accept(acceptor, std::move(handler), std::move(on_connect));
+}
+
+//----------------------------------------
+// Number of listening sockets sharing the port
+//----------------------------------------
+size_t Server::acceptor_count() const noexcept {
+  return impl_ ? impl_->acceptor_count() : 0;
+}
+
+//----------------------------------------
+// Event loop the acceptor and accepted sockets run on
+//----------------------------------------
+asio::io_context& Server::context() noexcept {
+  return io_;
+}
+
 //----------------------------------------
 // Close the server
 //----------------------------------------
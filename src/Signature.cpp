@@ -0,0 +1,409 @@
+#include <Signature.hpp>
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <queue>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define CPPPWN_SIGNATURE_X86 1
+#endif
+
+namespace cpppwn {
+
+namespace {
+
+//----------------------------------------
+// how common a byte is in x86-64 code and data, higher is more
+// common. the values follow the usual histogram of PE/ELF text
+// sections; anything not listed counts as rare.
+//----------------------------------------
+constexpr std::array<std::uint8_t, 256> kByteFrequency = [] {
+  std::array<std::uint8_t, 256> frequency{};
+
+  constexpr std::uint8_t common[] = {
+    0x00, 0xFF, 0xCC, 0x48, 0x8B, 0x89, 0x0F, 0xE8, 0x24, 0x44, 0x4C, 0x01,
+    0x20, 0x85, 0x83, 0x74, 0xC0, 0x8D, 0x45, 0x08, 0x10, 0x75, 0x41, 0x90,
+    0xC3, 0x40, 0x49, 0x02, 0x04, 0x18, 0xEB, 0xC7, 0x4D, 0x50, 0x28, 0x30,
+    0x38, 0xF8, 0x03, 0x05, 0x66, 0x80, 0x84, 0xC4, 0xE0, 0x55, 0x5D, 0x33
+  };
+
+  std::uint8_t rank = 255;
+  for(const auto byte : common) {
+    frequency[byte] = rank--;
+  }
+  return frequency;
+}();
+
+//----------------------------------------
+// the pieces of a Signature the kernels need
+//----------------------------------------
+struct ScanPlan {
+  const std::uint8_t* bytes;
+  const std::uint8_t* mask;
+  std::size_t size;
+  std::size_t anchor;
+  std::size_t filter;
+  std::uint8_t anchor_byte;
+  std::uint8_t filter_byte;
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+inline bool verify(const ScanPlan& plan, const std::uint8_t* data) noexcept {
+  for(std::size_t i = 0; i < plan.size; ++i) {
+    if((data[i] & plan.mask[i]) != plan.bytes[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------
+// memchr on the anchor byte over positions [from, last]
+//----------------------------------------
+void scan_scalar(const ScanPlan& plan, const std::uint8_t* data, std::size_t from, std::size_t last,
+                 std::vector<std::size_t>& out, std::size_t max_matches) {
+  std::size_t pos = from;
+
+  while(pos <= last && out.size() < max_matches) {
+    const auto* hit = static_cast<const std::uint8_t*>(
+      std::memchr(data + pos + plan.anchor, plan.anchor_byte, last - pos + 1));
+    if(not hit) {
+      return;
+    }
+
+    pos = static_cast<std::size_t>(hit - data) - plan.anchor;
+    if(verify(plan, data + pos)) {
+      out.push_back(pos);
+    }
+    ++pos;
+  }
+}
+
+#ifdef CPPPWN_SIGNATURE_X86
+
+//----------------------------------------
+// compares the anchor and filter byte for 16 positions at once,
+// only positions where both hit get a full compare. returns the
+// first position left for the scalar tail.
+//----------------------------------------
+std::size_t scan_sse2(const ScanPlan& plan, const std::uint8_t* data, std::size_t last,
+                      std::vector<std::size_t>& out, std::size_t max_matches) {
+  const __m128i anchor = _mm_set1_epi8(static_cast<char>(plan.anchor_byte));
+  const __m128i filter = _mm_set1_epi8(static_cast<char>(plan.filter_byte));
+
+  std::size_t pos = 0;
+  for(; pos + 16 <= last + 1; pos += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + plan.anchor));
+    const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + plan.filter));
+
+    auto hits = static_cast<std::uint32_t>(
+      _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, anchor), _mm_cmpeq_epi8(f, filter))));
+
+    while(hits) {
+      const std::size_t candidate = pos + static_cast<std::size_t>(__builtin_ctz(hits));
+      if(verify(plan, data + candidate)) {
+        out.push_back(candidate);
+        if(out.size() >= max_matches) return last + 1;
+      }
+      hits &= hits - 1;
+    }
+  }
+  return pos;
+}
+
+//----------------------------------------
+// same as scan_sse2 with 32 positions per step
+//----------------------------------------
+__attribute__((target("avx2")))
+std::size_t scan_avx2(const ScanPlan& plan, const std::uint8_t* data, std::size_t last,
+                      std::vector<std::size_t>& out, std::size_t max_matches) {
+  const __m256i anchor = _mm256_set1_epi8(static_cast<char>(plan.anchor_byte));
+  const __m256i filter = _mm256_set1_epi8(static_cast<char>(plan.filter_byte));
+
+  std::size_t pos = 0;
+  for(; pos + 32 <= last + 1; pos += 32) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + plan.anchor));
+    const __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + plan.filter));
+
+    auto hits = static_cast<std::uint32_t>(
+      _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, anchor), _mm256_cmpeq_epi8(f, filter))));
+
+    while(hits) {
+      const std::size_t candidate = pos + static_cast<std::size_t>(__builtin_ctz(hits));
+      if(verify(plan, data + candidate)) {
+        out.push_back(candidate);
+        if(out.size() >= max_matches) return last + 1;
+      }
+      hits &= hits - 1;
+    }
+  }
+  return pos;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool cpu_has_avx2() noexcept {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+#endif
+
+} // anon namespace
+
+//----------------------------------------
+// Constructor
+//----------------------------------------
+Signature::Signature(std::string_view pattern) {
+  std::size_t pos = 0;
+
+  while(pos < pattern.size()) {
+    pos = pattern.find_first_not_of(" \t\r\n", pos);
+    if(pos == std::string_view::npos) break;
+
+    std::size_t end = pattern.find_first_of(" \t\r\n", pos);
+    if(end == std::string_view::npos) end = pattern.size();
+    const std::string_view token = pattern.substr(pos, end - pos);
+    pos = end;
+
+    if(token == "?" || token == "??") {
+      bytes_.push_back(std::byte{0});
+      mask_.push_back(std::byte{0});
+      continue;
+    }
+
+    unsigned value = 0;
+    const auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value, 16);
+    if(ec != std::errc() || ptr != token.data() + token.size() || value > 0xFF) {
+      throw std::invalid_argument("Invalid signature byte: " + std::string(token));
+    }
+
+    bytes_.push_back(static_cast<std::byte>(value));
+    mask_.push_back(std::byte{0xFF});
+  }
+
+  // pick the two rarest fixed bytes as anchor and filter
+  std::size_t best = npos;
+  std::size_t second = npos;
+
+  for(std::size_t i = 0; i < bytes_.size(); ++i) {
+    if(is_wildcard(i)) continue;
+
+    const auto rank = kByteFrequency[static_cast<std::uint8_t>(bytes_[i])];
+    if(best == npos || rank < kByteFrequency[static_cast<std::uint8_t>(bytes_[best])]) {
+      second = best;
+      best = i;
+    } else if(second == npos || rank < kByteFrequency[static_cast<std::uint8_t>(bytes_[second])]) {
+      second = i;
+    }
+  }
+
+  has_fixed_ = best != npos;
+  anchor_ = has_fixed_ ? best : 0;
+  filter_ = second != npos ? second : anchor_;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool Signature::matches(const std::byte* data) const noexcept {
+  for(std::size_t i = 0; i < bytes_.size(); ++i) {
+    if((data[i] & mask_[i]) != bytes_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Signature::scan(std::span<const std::byte> buffer, std::vector<std::size_t>& out, std::size_t max_matches) const {
+  if(bytes_.empty() || buffer.size() < bytes_.size() || out.size() >= max_matches) {
+    return;
+  }
+
+  const std::size_t last = buffer.size() - bytes_.size();
+
+  // nothing to anchor on, every position matches
+  if(not has_fixed_) {
+    for(std::size_t pos = 0; pos <= last && out.size() < max_matches; ++pos) {
+      out.push_back(pos);
+    }
+    return;
+  }
+
+  const ScanPlan plan{
+    reinterpret_cast<const std::uint8_t*>(bytes_.data()),
+    reinterpret_cast<const std::uint8_t*>(mask_.data()),
+    bytes_.size(),
+    anchor_,
+    filter_,
+    static_cast<std::uint8_t>(bytes_[anchor_]),
+    static_cast<std::uint8_t>(bytes_[filter_])
+  };
+  const auto* data = reinterpret_cast<const std::uint8_t*>(buffer.data());
+
+  std::size_t pos = 0;
+#ifdef CPPPWN_SIGNATURE_X86
+  pos = cpu_has_avx2() ? scan_avx2(plan, data, last, out, max_matches)
+                       : scan_sse2(plan, data, last, out, max_matches);
+#endif
+
+  scan_scalar(plan, data, pos, last, out, max_matches);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::optional<std::size_t> Signature::find(std::span<const std::byte> buffer) const {
+  std::vector<std::size_t> hits;
+  scan(buffer, hits, 1);
+
+  if(hits.empty()) {
+    return std::nullopt;
+  }
+  return hits.front();
+}
+
+//----------------------------------------
+// SignatureSet constructor, builds the automaton as a full DFA
+//----------------------------------------
+SignatureSet::SignatureSet(std::span<const Signature> signatures)
+  : signatures_(signatures.begin(), signatures.end()),
+    key_end_(signatures_.size(), 0) {
+
+  constexpr std::size_t kMaxKey = 16;
+  constexpr std::uint32_t kNone = static_cast<std::uint32_t>(-1);
+
+  std::vector<std::uint32_t> next(256, kNone);
+  std::vector<std::vector<std::uint32_t>> outputs(1);
+
+  for(std::size_t index = 0; index < signatures_.size(); ++index) {
+    const Signature& signature = signatures_[index];
+    max_size_ = std::max(max_size_, signature.size());
+    if(signature.empty()) continue;
+
+    // longest run of fixed bytes
+    std::size_t best_start = 0;
+    std::size_t best_length = 0;
+    for(std::size_t i = 0; i < signature.size();) {
+      if(signature.is_wildcard(i)) { ++i; continue; }
+
+      std::size_t j = i;
+      while(j < signature.size() && not signature.is_wildcard(j)) ++j;
+      if(j - i > best_length) {
+        best_start = i;
+        best_length = j - i;
+      }
+      i = j;
+    }
+
+    if(best_length == 0) {
+      unanchored_.push_back(index);
+      continue;
+    }
+
+    best_length = std::min(best_length, kMaxKey);
+    key_end_[index] = best_start + best_length;
+
+    std::uint32_t state = 0;
+    for(std::size_t i = best_start; i < key_end_[index]; ++i) {
+      const auto byte = static_cast<std::uint8_t>(signature.bytes()[i]);
+      std::uint32_t& target = next[state * 256 + byte];
+
+      if(target == kNone) {
+        target = static_cast<std::uint32_t>(outputs.size());
+        outputs.emplace_back();
+        next.resize(next.size() + 256, kNone);
+      }
+      state = next[state * 256 + byte];
+    }
+    outputs[state].push_back(static_cast<std::uint32_t>(index));
+  }
+
+  // breadth-first pass filling in failure transitions
+  std::vector<std::uint32_t> fail(outputs.size(), 0);
+  std::queue<std::uint32_t> pending;
+
+  for(std::size_t byte = 0; byte < 256; ++byte) {
+    std::uint32_t& target = next[byte];
+    if(target == kNone) {
+      target = 0;
+    } else {
+      pending.push(target);
+    }
+  }
+
+  while(not pending.empty()) {
+    const std::uint32_t state = pending.front();
+    pending.pop();
+
+    const auto& inherited = outputs[fail[state]];
+    outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+    for(std::size_t byte = 0; byte < 256; ++byte) {
+      std::uint32_t& target = next[state * 256 + byte];
+      const std::uint32_t fallback = next[fail[state] * 256 + byte];
+
+      if(target == kNone) {
+        target = fallback;
+      } else {
+        fail[target] = fallback;
+        pending.push(target);
+      }
+    }
+  }
+
+  transitions_ = std::move(next);
+  output_begin_.reserve(outputs.size() + 1);
+  for(const auto& list : outputs) {
+    output_begin_.push_back(static_cast<std::uint32_t>(outputs_.size()));
+    outputs_.insert(outputs_.end(), list.begin(), list.end());
+  }
+  output_begin_.push_back(static_cast<std::uint32_t>(outputs_.size()));
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void SignatureSet::scan(std::span<const std::byte> buffer, const MatchHandler& on_match) const {
+  const auto* data = reinterpret_cast<const std::uint8_t*>(buffer.data());
+  const std::size_t size = buffer.size();
+
+  std::uint32_t state = 0;
+  for(std::size_t pos = 0; pos < size; ++pos) {
+    state = transitions_[state * 256 + data[pos]];
+
+    for(std::uint32_t i = output_begin_[state]; i < output_begin_[state + 1]; ++i) {
+      const std::size_t index = outputs_[i];
+      const Signature& signature = signatures_[index];
+
+      if(pos + 1 < key_end_[index]) continue;
+      const std::size_t start = pos + 1 - key_end_[index];
+
+      if(start + signature.size() <= size && signature.matches(buffer.data() + start)) {
+        on_match(index, start);
+      }
+    }
+  }
+
+  std::vector<std::size_t> hits;
+  for(const std::size_t index : unanchored_) {
+    hits.clear();
+    signatures_[index].scan(buffer, hits);
+    for(const std::size_t offset : hits) {
+      on_match(index, offset);
+    }
+  }
+}
+
+}
@@ -0,0 +1,244 @@
+#include <StaticFileCache.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include "Helpers.hpp"
+
+namespace cpppwn {
+namespace {
+
+//----------------------------------------
+// stats path, falling back to its index.html when it is a
+// directory. false unless a regular file turned up.
+//----------------------------------------
+bool stat_file(std::string& path, struct stat& info) {
+  if(::stat(path.c_str(), &info) < 0) return false;
+  if(S_ISDIR(info.st_mode)) {
+    path = (std::filesystem::path(path) / "index.html").string();
+    if(::stat(path.c_str(), &info) < 0) return false;
+  }
+  return S_ISREG(info.st_mode);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool same_file(const StaticFile& file, const struct stat& info) {
+  return file.device == info.st_dev && file.inode == info.st_ino
+    && file.size == static_cast<uint64_t>(info.st_size)
+    && file.modified.tv_sec == info.st_mtim.tv_sec && file.modified.tv_nsec == info.st_mtim.tv_nsec;
+}
+
+//----------------------------------------
+// the whole file, or null if it changed size while reading
+//----------------------------------------
+std::shared_ptr<const std::string> read_file(const std::string& path, size_t size) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) return nullptr;
+
+  auto content = std::make_shared<std::string>(size, '\0');
+  size_t done = 0;
+  while(done < size) {
+    const ssize_t count = ::read(fd, content->data() + done, size - done);
+    if(count < 0 && errno == EINTR) continue;
+    if(count <= 0) break;
+    done += static_cast<size_t>(count);
+  }
+  ::close(fd);
+
+  return done == size ? content : nullptr;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::shared_ptr<StaticFile> describe(std::string path, const struct stat& info, size_t max_file_size) {
+  auto file = std::make_shared<StaticFile>();
+  file->size = static_cast<uint64_t>(info.st_size);
+  file->device = info.st_dev;
+  file->inode = info.st_ino;
+  file->modified = info.st_mtim;
+
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "\"%llx-%llx-%llx\"",
+    static_cast<unsigned long long>(info.st_ino), static_cast<unsigned long long>(info.st_size),
+    static_cast<unsigned long long>(info.st_mtim.tv_sec) * 1000000000ull
+      + static_cast<unsigned long long>(info.st_mtim.tv_nsec));
+  file->etag = buffer;
+
+  std::tm gmt;
+  gmtime_r(&info.st_mtim.tv_sec, &gmt);
+  std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+  file->last_modified = buffer;
+
+  file->content_type = get_mime_type(path);
+  if(file->size <= max_file_size) {
+    file->content = read_file(path, static_cast<size_t>(file->size));
+  }
+  file->path = std::move(path);
+  return file;
+}
+
+//----------------------------------------
+// memory held by file, counted against max_bytes
+//----------------------------------------
+size_t content_bytes(const StaticFile& file) {
+  size_t bytes = file.content ? file.content->size() : 0;
+  for(const auto& variant : file.encoded) {
+    bytes += variant ? variant->size() : 0;
+  }
+  return bytes;
+}
+
+} // anonymous namespace
+
+//----------------------------------------
+//
+//----------------------------------------
+StaticFileCache::StaticFileCache(StaticFileCacheConfig config) : config_(config) {
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void StaticFileCache::configure(const StaticFileCacheConfig& config) {
+  std::lock_guard lock(mutex_);
+  config_ = config;
+  for(auto& [key, entry] : entries_) {
+    entry.file->cached = false;
+  }
+  entries_.clear();
+  lru_.clear();
+  content_bytes_ = 0;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::shared_ptr<const StaticFile> StaticFileCache::lookup(const std::filesystem::path& path) {
+  std::string key = path.string();
+  const auto now = std::chrono::steady_clock::now();
+  size_t max_file_size;
+
+  {
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(key);
+    if(it != entries_.end() && now - it->second.checked < config_.revalidate_after) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return it->second.file;
+    }
+    max_file_size = config_.max_file_size;
+  }
+
+  // stat and read outside the lock, other lookups go on meanwhile
+  std::string resolved = key;
+  struct stat info;
+  const bool found = stat_file(resolved, info);
+
+  {
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(key);
+    if(not found) {
+      if(it != entries_.end()) erase(it);
+      return nullptr;
+    }
+    if(it != entries_.end() && it->second.file->path == resolved && same_file(*it->second.file, info)) {
+      it->second.checked = now;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return it->second.file;
+    }
+  }
+
+  std::shared_ptr<const StaticFile> file = describe(resolved, info, max_file_size);
+
+  std::lock_guard lock(mutex_);
+  auto it = entries_.find(key);
+  if(it != entries_.end()) erase(it);
+
+  lru_.push_front(key);
+  entries_.emplace(std::move(key), Entry{file, now, lru_.begin()});
+  file->cached = true;
+  content_bytes_ += content_bytes(*file);
+  evict();
+  return file;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::shared_ptr<const std::string> StaticFileCache::encoded(const StaticFile& file, ContentCoding coding) {
+  if(not file.content || coding == ContentCoding::Identity) {
+    return file.content;
+  }
+
+  auto& slot = file.encoded[static_cast<size_t>(coding)];
+  int level;
+  {
+    std::lock_guard lock(mutex_);
+    if(slot) return slot;
+    level = config_.compression_level;
+  }
+
+  // runs on the request's event loop thread. brotli 11 spends a
+  // quarter second on a 256 KiB file, the default level 5 a few
+  // milliseconds for a copy only about 10% larger.
+  auto variant = std::make_shared<const std::string>(compress(*file.content, coding, level));
+
+  std::lock_guard lock(mutex_);
+  if(slot) return slot;
+
+  slot = variant;
+  if(file.cached) {
+    content_bytes_ += variant->size();
+    evict();
+  }
+  return variant;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void StaticFileCache::clear() {
+  std::lock_guard lock(mutex_);
+  for(auto& [key, entry] : entries_) {
+    entry.file->cached = false;
+  }
+  entries_.clear();
+  lru_.clear();
+  content_bytes_ = 0;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+size_t StaticFileCache::size() const {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+//----------------------------------------
+// callers hold mutex_
+//----------------------------------------
+void StaticFileCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+  content_bytes_ -= content_bytes(*it->second.file);
+  it->second.file->cached = false;
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+//----------------------------------------
+// drops least recently used entries until both limits hold.
+// callers hold mutex_
+//----------------------------------------
+void StaticFileCache::evict() {
+  while(not lru_.empty() && (content_bytes_ > config_.max_bytes || entries_.size() > config_.max_entries)) {
+    erase(entries_.find(lru_.back()));
+  }
+}
+
+} // namespace cpppwn
@@ -1,64 +1,467 @@
-#include "Stream.hpp"
-
-#include <atomic>
-#include <thread>
-#include <vector>
-
-namespace cpppwn {
-namespace {
-
-constexpr std::size_t kBufferSize = 4096;
-
-//----------------------------------------
-// copies data from source stream to destination stream until stopped.
-// on exit, closes dest to unblock the other thread reading from it.
-//----------------------------------------
-void copy_stream_to_stream(Stream* source, Stream* dest, std::atomic<bool>& running) noexcept {
-  try {
-    while (running.load(std::memory_order_acquire) && source->is_alive()) {
-      std::string data = source->recv(kBufferSize);
-      if (data.empty()) {
-        // clean disconnect if we get nothing back
-        break;
-      }
-      dest->send(data);
-    }
-  } catch (...) {
-    // swallow the error. usually just a socket disconnect
-  }
-
-  // tell the other thread the party is over
-  running.store(false, std::memory_order_release);
-
-  // nuke the destination to force the other thread out of its blocking recv
-  try {
-    dest->close();
-  } catch (...) {
-    // were tearing down anyway, ignore errors
-  }
-}
-
-} // anonymous namespace
-
-//----------------------------------------
-//
-//----------------------------------------
-void bridge(Stream& a, Stream& b) {
-  std::atomic<bool> running{true};
-
-  // thread 1: a -> b
-  std::thread a_to_b_thread(copy_stream_to_stream, &a, &b, std::ref(running));
-
-  // thread 2: b -> a
-  std::thread b_to_a_thread(copy_stream_to_stream, &b, &a, std::ref(running));
-
-  // block until both threads complete
-  if (a_to_b_thread.joinable()) {
-    a_to_b_thread.join();
-  }
-  if (b_to_a_thread.joinable()) {
-    b_to_a_thread.join();
-  }
-}
-
-} // namespace cpppwn
+#include "Stream.hpp"
+#include "Helpers.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace cpppwn {
+namespace {
+
+constexpr std::size_t kBufferSize = 64 * 1024;
+
+// bytes asked for per splice(), also the pipe size requested
+constexpr std::size_t kSpliceSize = 1 << 20;
+
+// how often a buffered copy checks whether the bridge stopped
+constexpr std::chrono::milliseconds kPollInterval{100};
+
+//----------------------------------------
+// splices in to out until in hits EOF, a side fails or stop_fd
+// becomes readable. false if the descriptors can't be spliced,
+// in which case nothing was moved.
+//----------------------------------------
+bool splice_until_stopped(int in, int out, int stop_fd) {
+  SplicePipe pipe(kSpliceSize);
+  bool moved = false;
+  std::array<pollfd, 2> fds{{{in, POLLIN, 0}, {stop_fd, POLLIN, 0}}};
+
+  for (;;) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      return true;
+    }
+    if (fds[1].revents != 0) {
+      return true;
+    }
+
+    ssize_t n = splice(in, nullptr, pipe.write_end(), nullptr, kSpliceSize, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+    if (n < 0 && errno == EINVAL && not moved) {
+      return false;
+    }
+    if (n <= 0) {
+      return true;
+    }
+    moved = true;
+
+    while (n > 0) {
+      const ssize_t written = splice(pipe.read_end(), nullptr, out, nullptr, static_cast<size_t>(n),
+                                     SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (written < 0 && errno == EINTR) continue;
+      if (written <= 0) {
+        return true;
+      }
+      n -= written;
+    }
+  }
+}
+
+//----------------------------------------
+// copies through one reused buffer until EOF or until the
+// bridge stopped
+//----------------------------------------
+void copy_buffered(Stream* source, Stream* dest, std::atomic<bool>& running) {
+  std::vector<char> buffer(kBufferSize);
+
+  // a stream without a descriptor has nothing to poll. its reads
+  // block, and the other direction closing it ends them.
+  const bool pollable = source->read_fd() >= 0;
+
+  while (running.load(std::memory_order_acquire) && source->is_alive()) {
+    if (pollable && not source->can_recv(kPollInterval)) {
+      continue;
+    }
+
+    const std::size_t len = source->recv_into(buffer);
+    if (len == 0) {
+      // clean disconnect if we get nothing back
+      break;
+    }
+    dest->send_bytes(std::span<const char>(buffer.data(), len));
+  }
+}
+
+//----------------------------------------
+// copies data from source stream to destination stream until stopped.
+// on exit, closes dest to unblock the other thread reading from it.
+//----------------------------------------
+void copy_stream_to_stream(Stream* source, Stream* dest, std::atomic<bool>& running, int stop_fd) noexcept {
+  try {
+    SigpipeBlock sigpipe_block;
+
+    // bytes the source read ahead never show up on its descriptor
+    const std::string ahead = source->take_buffered();
+    if (not ahead.empty()) {
+      dest->send_bytes(ahead);
+    }
+
+    const int in = source->read_fd();
+    const int out = dest->write_fd();
+    if (in < 0 || out < 0 || not splice_until_stopped(in, out, stop_fd)) {
+      copy_buffered(source, dest, running);
+    }
+  } catch (...) {
+    // swallow the error. usually just a socket disconnect
+  }
+
+  // tell the other thread the party is over
+  running.store(false, std::memory_order_release);
+  const std::uint64_t one = 1;
+  [[maybe_unused]] const auto ignored = ::write(stop_fd, &one, sizeof(one));
+
+  // nuke the destination to force the other thread out of its blocking recv
+  try {
+    dest->close();
+  } catch (...) {
+    // were tearing down anyway, ignore errors
+  }
+}
+
+//----------------------------------------
+// one direction of an epoll bridge. moves data through the
+// pipe, or through buffer when splice() turned out unsupported.
+//----------------------------------------
+struct Direction {
+  Direction(int in_fd, int out_fd) : in(in_fd), out(out_fd), pipe(kSpliceSize) {}
+
+  int in;
+  int out;
+  SplicePipe pipe;
+  std::size_t pending = 0;    // bytes read but not written yet
+  bool use_splice = true;
+  std::vector<char> buffer;
+  std::size_t buffer_offset = 0;
+  bool done = false;          // in hit EOF or a side failed
+};
+
+//----------------------------------------
+// moves what it can without blocking, a bounded number of
+// rounds so one busy direction can't starve the other. false
+// once in hit EOF or a side failed.
+//----------------------------------------
+bool pump(Direction& d) {
+  constexpr unsigned kMaxRounds = 16;
+  constexpr unsigned kFlags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE;
+
+  for (unsigned round = 0; round < kMaxRounds; ++round) {
+    if (d.pending == 0) {
+      ssize_t n;
+      if (d.use_splice) {
+        n = splice(d.in, nullptr, d.pipe.write_end(), nullptr, kSpliceSize, kFlags);
+        if (n < 0 && errno == EINVAL) {
+          d.use_splice = false;
+          d.buffer.resize(kBufferSize);
+          continue;
+        }
+      } else {
+        n = ::read(d.in, d.buffer.data(), d.buffer.size());
+        d.buffer_offset = 0;
+      }
+
+      if (n < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+      if (n <= 0) return false;
+      d.pending = static_cast<std::size_t>(n);
+    }
+
+    const ssize_t written = d.use_splice
+      ? splice(d.pipe.read_end(), nullptr, d.out, nullptr, d.pending, kFlags)
+      : ::write(d.out, d.buffer.data() + d.buffer_offset, d.pending);
+
+    if (written < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+    if (written <= 0) return false;
+
+    d.pending -= static_cast<std::size_t>(written);
+    d.buffer_offset += static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+//----------------------------------------
+// serves both directions from one thread. the descriptors are
+// switched to non-blocking for the duration and restored after.
+//----------------------------------------
+void bridge_epoll(Stream& a, Stream& b) {
+  SigpipeBlock sigpipe_block;
+
+  for (auto [source, dest] : {std::pair{&a, &b}, std::pair{&b, &a}}) {
+    const std::string ahead = source->take_buffered();
+    if (not ahead.empty()) {
+      dest->send_bytes(ahead);
+    }
+  }
+
+  std::array<Direction, 2> directions{{
+    {a.read_fd(), b.write_fd()},
+    {b.read_fd(), a.write_fd()}
+  }};
+
+  // a socket is both the read and the write side, register every descriptor once
+  struct Watched {
+    int fd;
+    int flags;
+    std::uint32_t events;
+    bool registered;
+  };
+  std::vector<Watched> watched;
+  for (const int fd : {a.read_fd(), a.write_fd(), b.read_fd(), b.write_fd()}) {
+    if (std::none_of(watched.begin(), watched.end(), [&](const Watched& w) { return w.fd == fd; })) {
+      const int flags = fcntl(fd, F_GETFL);
+      if (flags < 0) {
+        throw std::system_error(errno, std::system_category(), "fcntl() failed");
+      }
+      watched.push_back({fd, flags, 0, false});
+    }
+  }
+
+  const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    throw std::system_error(errno, std::system_category(), "epoll_create1() failed");
+  }
+
+  const auto restore = [&] {
+    for (const auto& w : watched) {
+      fcntl(w.fd, F_SETFL, w.flags);
+    }
+    ::close(epoll_fd);
+  };
+
+  // once a direction ended the other one only flushes what it
+  // already has, the bridge closes both ends like the threaded one
+  const auto finished = [&] {
+    return std::any_of(directions.begin(), directions.end(), [](const Direction& d) { return d.done; })
+        && std::all_of(directions.begin(), directions.end(), [](const Direction& d) { return d.done || d.pending == 0; });
+  };
+
+  try {
+    for (const auto& w : watched) {
+      if (fcntl(w.fd, F_SETFL, w.flags | O_NONBLOCK) < 0) {
+        throw std::system_error(errno, std::system_category(), "fcntl() failed");
+      }
+    }
+
+    std::array<epoll_event, 4> events;
+    while (not finished()) {
+      // wait for input while a pipe is empty, for output while it holds data.
+      // descriptors nobody waits on leave the set, a hangup would keep waking us
+      for (auto& w : watched) {
+        std::uint32_t wanted = 0;
+        for (const auto& d : directions) {
+          if (d.done) continue;
+          if (d.pending == 0 && d.in == w.fd) wanted |= EPOLLIN;
+          if (d.pending > 0 && d.out == w.fd) wanted |= EPOLLOUT;
+        }
+        if (wanted == w.events && (wanted != 0) == w.registered) {
+          continue;
+        }
+
+        epoll_event event{};
+        event.events = wanted;
+        event.data.fd = w.fd;
+        const int op = wanted == 0 ? EPOLL_CTL_DEL : w.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (epoll_ctl(epoll_fd, op, w.fd, &event) < 0) {
+          throw std::system_error(errno, std::system_category(), "epoll_ctl() failed");
+        }
+        w.events = wanted;
+        w.registered = wanted != 0;
+      }
+
+      if (epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1) < 0) {
+        if (errno == EINTR) continue;
+        throw std::system_error(errno, std::system_category(), "epoll_wait() failed");
+      }
+
+      // both every time, what is readable on one side still goes
+      // through when the other just ended
+      for (auto& d : directions) {
+        if (not d.done && not pump(d)) {
+          d.done = true;
+        }
+      }
+    }
+  } catch (...) {
+    restore();
+    throw;
+  }
+
+  restore();
+}
+
+} // anonymous namespace
+
+//----------------------------------------
+// default on top of recv(), streams with a buffer do better
+//----------------------------------------
+std::size_t Stream::recv_into(std::span<char> buffer) {
+  const std::string data = recv(buffer.size());
+  std::memcpy(buffer.data(), data.data(), data.size());
+  return data.size();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void Stream::send_bytes(std::span<const char> data) {
+  send(std::string(data.begin(), data.end()));
+}
+
+//----------------------------------------
+// bytes the stream read ahead are not seen by the poll, streams
+// keeping a buffer override this
+//----------------------------------------
+bool Stream::can_recv(std::chrono::milliseconds timeout) {
+  const int fd = read_fd();
+  if (fd < 0) {
+    throw std::logic_error("Stream::can_recv() needs read_fd() or an override");
+  }
+  return wait_readable(fd, std::chrono::steady_clock::now() + timeout);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Stream::recv(std::size_t size, std::chrono::milliseconds timeout) {
+  if (not can_recv(timeout)) {
+    return {};
+  }
+
+  std::string data(size, '\0');
+  data.resize(recv_into(data));
+  return data;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Stream::recvuntil(const std::string&, std::chrono::milliseconds) {
+  throw std::logic_error("Stream::recvuntil() with a timeout is not implemented by this stream");
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+std::string Stream::recvline(std::chrono::milliseconds timeout) {
+  return recvuntil("\n", timeout);
+}
+
+//----------------------------------------
+// blocking fallbacks for streams without an asio socket
+//----------------------------------------
+asio::awaitable<void> Stream::async_send(std::string data) {
+  send(data);
+  co_return;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<void> Stream::async_sendline(std::string data) {
+  sendline(data);
+  co_return;
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recv(std::size_t size) {
+  co_return recv(size);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recvuntil(std::string delim) {
+  co_return recvuntil(delim);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recvline() {
+  co_return recvline();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recvall() {
+  co_return recvall();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recv(std::size_t size, std::chrono::milliseconds timeout) {
+  co_return recv(size, timeout);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recvuntil(std::string delim, std::chrono::milliseconds timeout) {
+  co_return recvuntil(delim, timeout);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+asio::awaitable<std::string> Stream::async_recvline(std::chrono::milliseconds timeout) {
+  co_return recvline(timeout);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void bridge(Stream& a, Stream& b, BridgeMode mode) {
+  const bool raw = a.read_fd() >= 0 && a.write_fd() >= 0 && b.read_fd() >= 0 && b.write_fd() >= 0;
+
+  if (mode == BridgeMode::Epoll && raw) {
+    try {
+      bridge_epoll(a, b);
+    } catch (...) {
+      // same as a dropped connection
+    }
+
+    a.close();
+    b.close();
+    return;
+  }
+
+  const int stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd < 0) {
+    throw std::system_error(errno, std::system_category(), "eventfd() failed");
+  }
+
+  std::atomic<bool> running{true};
+
+  // thread 1: a -> b
+  std::thread a_to_b_thread(copy_stream_to_stream, &a, &b, std::ref(running), stop_fd);
+
+  // thread 2: b -> a
+  std::thread b_to_a_thread(copy_stream_to_stream, &b, &a, std::ref(running), stop_fd);
+
+  // block until both threads complete
+  if (a_to_b_thread.joinable()) {
+    a_to_b_thread.join();
+  }
+  if (b_to_a_thread.joinable()) {
+    b_to_a_thread.join();
+  }
+
+  ::close(stop_fd);
+}
+
+} // namespace cpppwn
@@ -0,0 +1,646 @@
+#include <ValueScan.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define CPPPWN_VALUE_SCAN_X86 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace cpppwn {
+
+namespace {
+
+constexpr size_t kChunkSize = 1 << 20;
+
+// values tested per kernel step
+constexpr size_t kGroup = 64;
+
+//----------------------------------------
+// candidates inside one chunk of memory. a dense block holds
+// every slot from base on and keeps the raw memory, a sparse
+// block keeps the offset and value of each candidate.
+//----------------------------------------
+struct Block {
+  address_t base = 0;
+  size_t count = 0;
+  bool dense = false;
+  std::vector<uint32_t> offsets;   // sparse only, from base
+  std::vector<std::byte> values;   // dense: memory from base, sparse: count values back to back
+  size_t values_size = 0;          // values.size(), kept while spilled
+  bool spilled = false;            // offsets and values live in the spill file
+  uint64_t file_offset = 0;
+
+  [[nodiscard]] size_t bytes() const noexcept {
+    return offsets.size() * sizeof(uint32_t) + values.size();
+  }
+};
+
+//----------------------------------------
+//
+//----------------------------------------
+void writeAll(int fd, const void* data, size_t size, uint64_t offset) {
+  const auto* bytes = static_cast<const char*>(data);
+  while(size > 0) {
+    const ssize_t n = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) {
+      throw std::system_error(n < 0 ? errno : EIO, std::system_category(), "Failed to write scan spill file");
+    }
+    bytes += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+}
+
+void readAll(int fd, void* data, size_t size, uint64_t offset) {
+  auto* bytes = static_cast<char*>(data);
+  while(size > 0) {
+    const ssize_t n = pread(fd, bytes, size, static_cast<off_t>(offset));
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) {
+      throw std::system_error(n < 0 ? errno : EIO, std::system_category(), "Failed to read scan spill file");
+    }
+    bytes += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+}
+
+//----------------------------------------
+// runs fn(0) .. fn(count - 1) on all cores, rethrowing the
+// first exception once every thread stopped
+//----------------------------------------
+template<typename Fn>
+void parallelFor(size_t count, Fn&& fn) {
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  const auto worker = [&] {
+    for(size_t i = next++; i < count; i = next++) {
+      try {
+        fn(i);
+      } catch(...) {
+        std::lock_guard lock(error_mutex);
+        if(not error) {
+          error = std::current_exception();
+        }
+        next = count;
+      }
+    }
+  };
+
+  const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(1, count));
+  std::vector<std::thread> threads;
+  for(size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for(auto& thread : threads) {
+    thread.join();
+  }
+
+  if(error) {
+    std::rethrow_exception(error);
+  }
+}
+
+template<typename T>
+inline T load(const std::byte* data) noexcept {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+template<ScanCompare Op, typename T>
+inline bool test(T current, T previous, T value) noexcept {
+  if constexpr(Op == ScanCompare::Equal) return current == value;
+  else if constexpr(Op == ScanCompare::Changed) return current != previous;
+  else if constexpr(Op == ScanCompare::Unchanged) return current == previous;
+  else if constexpr(Op == ScanCompare::Increased) return current > previous;
+  else return current < previous;
+}
+
+//----------------------------------------
+// appends to keep the index of every value in current passing
+// Op. a group of values is tested into a flag array first, a
+// loop of fixed length the compiler turns into vector compares.
+//----------------------------------------
+template<ScanCompare Op, typename T>
+[[gnu::always_inline]] inline void filterKernel(const std::byte* current, const std::byte* previous, T value,
+                                                size_t count, std::vector<uint32_t>& keep) {
+  size_t i = 0;
+  for(; i + kGroup <= count; i += kGroup) {
+    const std::byte* now = current + i * sizeof(T);
+    const std::byte* before = previous + i * sizeof(T);
+
+    alignas(64) std::uint8_t hits[kGroup];
+    for(size_t j = 0; j < kGroup; ++j) {
+      hits[j] = test<Op>(load<T>(now + j * sizeof(T)), load<T>(before + j * sizeof(T)), value);
+    }
+
+    for(size_t word = 0; word < kGroup; word += 8) {
+      std::uint64_t any;
+      std::memcpy(&any, hits + word, sizeof(any));
+      if(any == 0) continue;
+
+      for(size_t j = word; j < word + 8; ++j) {
+        if(hits[j]) keep.push_back(static_cast<uint32_t>(i + j));
+      }
+    }
+  }
+
+  for(; i < count; ++i) {
+    if(test<Op>(load<T>(current + i * sizeof(T)), load<T>(previous + i * sizeof(T)), value)) {
+      keep.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+template<ScanCompare Op, typename T>
+void filterDefault(const std::byte* current, const std::byte* previous, T value, size_t count, std::vector<uint32_t>& keep) {
+  filterKernel<Op>(current, previous, value, count, keep);
+}
+
+#ifdef CPPPWN_VALUE_SCAN_X86
+
+template<ScanCompare Op, typename T>
+__attribute__((target("avx2")))
+void filterAvx2(const std::byte* current, const std::byte* previous, T value, size_t count, std::vector<uint32_t>& keep) {
+  filterKernel<Op>(current, previous, value, count, keep);
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+bool cpu_has_avx2() noexcept {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+#endif
+
+template<ScanCompare Op, typename T>
+void filterTyped(const std::byte* current, const std::byte* previous, T value, size_t count, std::vector<uint32_t>& keep) {
+#ifdef CPPPWN_VALUE_SCAN_X86
+  if(cpu_has_avx2()) {
+    filterAvx2<Op>(current, previous, value, count, keep);
+    return;
+  }
+#endif
+  filterDefault<Op>(current, previous, value, count, keep);
+}
+
+template<typename T>
+void filterAs(ScanCompare compare, const std::byte* current, const std::byte* previous, const std::byte* value,
+              size_t count, std::vector<uint32_t>& keep) {
+  const T operand = load<T>(value);
+  switch(compare) {
+    case ScanCompare::Equal: return filterTyped<ScanCompare::Equal>(current, previous, operand, count, keep);
+    case ScanCompare::Changed: return filterTyped<ScanCompare::Changed>(current, previous, operand, count, keep);
+    case ScanCompare::Unchanged: return filterTyped<ScanCompare::Unchanged>(current, previous, operand, count, keep);
+    case ScanCompare::Increased: return filterTyped<ScanCompare::Increased>(current, previous, operand, count, keep);
+    case ScanCompare::Decreased: return filterTyped<ScanCompare::Decreased>(current, previous, operand, count, keep);
+  }
+}
+
+//----------------------------------------
+// indices of the count values passing compare, appended to keep.
+// current and previous hold values back to back, value is only
+// read by ScanCompare::Equal. floats count as changed when their
+// bits differ so that NaNs can be tracked too.
+//----------------------------------------
+void filterValues(ValueType type, size_t value_size, ScanCompare compare, const std::byte* current,
+                  const std::byte* previous, const std::byte* value, size_t count, std::vector<uint32_t>& keep) {
+  const bool bitwise = compare == ScanCompare::Changed || compare == ScanCompare::Unchanged;
+
+  switch(type) {
+    case ValueType::Int8: return filterAs<int8_t>(compare, current, previous, value, count, keep);
+    case ValueType::Int16: return filterAs<int16_t>(compare, current, previous, value, count, keep);
+    case ValueType::Int32: return filterAs<int32_t>(compare, current, previous, value, count, keep);
+    case ValueType::Int64: return filterAs<int64_t>(compare, current, previous, value, count, keep);
+    case ValueType::Float:
+      if(bitwise) return filterAs<uint32_t>(compare, current, previous, value, count, keep);
+      return filterAs<float>(compare, current, previous, value, count, keep);
+    case ValueType::Double:
+      if(bitwise) return filterAs<uint64_t>(compare, current, previous, value, count, keep);
+      return filterAs<double>(compare, current, previous, value, count, keep);
+    case ValueType::Bytes:
+      break;
+  }
+
+  for(size_t i = 0; i < count; ++i) {
+    const std::byte* now = current + i * value_size;
+    const bool hit = compare == ScanCompare::Equal ? std::memcmp(now, value, value_size) == 0
+                   : compare == ScanCompare::Changed ? std::memcmp(now, previous + i * value_size, value_size) != 0
+                   : std::memcmp(now, previous + i * value_size, value_size) == 0;
+    if(hit) keep.push_back(static_cast<uint32_t>(i));
+  }
+}
+
+//----------------------------------------
+// the value of every slot of memory back to back, slot i being
+// at i * stride. memory itself if the slots already are.
+//----------------------------------------
+const std::byte* packSlots(const std::byte* memory, size_t count, size_t stride, size_t size, std::vector<std::byte>& packed) {
+  if(stride == size) {
+    return memory;
+  }
+
+  packed.resize(count * size);
+  for(size_t i = 0; i < count; ++i) {
+    std::memcpy(packed.data() + i * size, memory + i * stride, size);
+  }
+  return packed.data();
+}
+
+//----------------------------------------
+// natural size of type, value_size for byte arrays
+//----------------------------------------
+size_t valueSize(ValueType type, size_t value_size) {
+  size_t natural = 0;
+  switch(type) {
+    case ValueType::Int8: natural = 1; break;
+    case ValueType::Int16: natural = 2; break;
+    case ValueType::Int32: natural = 4; break;
+    case ValueType::Int64: natural = 8; break;
+    case ValueType::Float: natural = 4; break;
+    case ValueType::Double: natural = 8; break;
+    case ValueType::Bytes:
+      if(value_size == 0) {
+        throw std::invalid_argument("Byte array scans need a value size");
+      }
+      return value_size;
+  }
+
+  if(value_size != 0 && value_size != natural) {
+    throw std::invalid_argument("Value size does not match the value type");
+  }
+  return natural;
+}
+
+} // anon namespace
+
+//----------------------------------------
+// the blocks of a scan, the ones past memory_limit written to an
+// unlinked temporary file
+//----------------------------------------
+class ValueScan::Candidates {
+public:
+    Candidates(size_t memory_limit, fs::path spill_directory)
+      : memory_limit_(memory_limit), spill_directory_(std::move(spill_directory)) {}
+
+    ~Candidates() {
+      if(spill_fd_ != -1) {
+        ::close(spill_fd_);
+      }
+    }
+
+    Candidates(const Candidates&) = delete;
+    Candidates& operator=(const Candidates&) = delete;
+
+    [[nodiscard]] size_t count() const noexcept { return count_; }
+    [[nodiscard]] size_t blocks() const noexcept { return blocks_.size(); }
+
+    //----------------------------------------
+    // safe to call from several threads
+    //----------------------------------------
+    void add(Block block) {
+      block.values_size = block.values.size();
+
+      std::lock_guard lock(mutex_);
+      if(memory_bytes_ + block.bytes() > memory_limit_) {
+        const int fd = spill_fd();
+        block.file_offset = spill_size_;
+        writeAll(fd, block.offsets.data(), block.offsets.size() * sizeof(uint32_t), spill_size_);
+        writeAll(fd, block.values.data(), block.values.size(), spill_size_ + block.offsets.size() * sizeof(uint32_t));
+        spill_size_ += block.bytes();
+
+        block.offsets = {};
+        block.values = {};
+        block.spilled = true;
+      } else {
+        memory_bytes_ += block.bytes();
+      }
+
+      count_ += block.count;
+      blocks_.push_back(std::move(block));
+    }
+
+    //----------------------------------------
+    // block index, read into scratch if it was spilled
+    //----------------------------------------
+    const Block& load(size_t index, Block& scratch) const {
+      const Block& block = blocks_[index];
+      if(not block.spilled) {
+        return block;
+      }
+
+      scratch.base = block.base;
+      scratch.count = block.count;
+      scratch.dense = block.dense;
+      scratch.offsets.resize(block.dense ? 0 : block.count);
+      scratch.values.resize(block.values_size);
+
+      const size_t offsets_size = scratch.offsets.size() * sizeof(uint32_t);
+      readAll(spill_fd_, scratch.offsets.data(), offsets_size, block.file_offset);
+      readAll(spill_fd_, scratch.values.data(), scratch.values.size(), block.file_offset + offsets_size);
+      return scratch;
+    }
+
+    void sort() {
+      std::sort(blocks_.begin(), blocks_.end(), [](const Block& a, const Block& b) {
+        return a.base < b.base;
+      });
+    }
+
+private:
+    size_t memory_limit_;
+    fs::path spill_directory_;
+    std::mutex mutex_;
+    std::vector<Block> blocks_;
+    size_t count_ = 0;
+    size_t memory_bytes_ = 0;
+    int spill_fd_ = -1;
+    uint64_t spill_size_ = 0;
+
+    int spill_fd() {
+      if(spill_fd_ != -1) {
+        return spill_fd_;
+      }
+
+      const fs::path directory = spill_directory_.empty() ? fs::temp_directory_path() : spill_directory_;
+      int fd = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+      if(fd < 0) {
+        std::string path = (directory / "cpppwn-scan-XXXXXX").string();
+        fd = mkostemp(path.data(), O_CLOEXEC);
+        if(fd >= 0) {
+          unlink(path.c_str());
+        }
+      }
+
+      if(fd < 0) {
+        throw std::system_error(errno, std::system_category(), "Cannot create spill file in " + directory.string());
+      }
+      spill_fd_ = fd;
+      return fd;
+    }
+};
+
+//----------------------------------------
+// Constructor
+//----------------------------------------
+ValueScan::ValueScan(Process& process, ValueType type, size_t value_size, ValueScanOptions options)
+  : process_(process),
+    type_(type),
+    value_size_(valueSize(type, value_size)),
+    stride_(options.alignment),
+    options_(std::move(options)) {
+
+  if(stride_ == 0) {
+    stride_ = type_ == ValueType::Bytes ? 1 : value_size_;
+  }
+}
+
+//----------------------------------------
+// Destructor
+//----------------------------------------
+ValueScan::~ValueScan() = default;
+
+//----------------------------------------
+//
+//----------------------------------------
+bool ValueScan::started() const noexcept {
+  return candidates_ != nullptr;
+}
+
+size_t ValueScan::count() const noexcept {
+  return candidates_ ? candidates_->count() : 0;
+}
+
+void ValueScan::reset() {
+  candidates_.reset();
+}
+
+//----------------------------------------
+//
+//----------------------------------------
+void ValueScan::check_value(std::span<const std::byte> value) const {
+  if(value.size() != value_size_) {
+    throw std::invalid_argument("Scan value has " + std::to_string(value.size()) +
+      " bytes, expected " + std::to_string(value_size_));
+  }
+}
+
+//----------------------------------------
+// First scan for an exact value
+//----------------------------------------
+void ValueScan::first_scan(std::span<const std::byte> value) {
+  check_value(value);
+  scan_memory(value);
+}
+
+//----------------------------------------
+// First scan keeping every slot, for an unknown initial value
+//----------------------------------------
+void ValueScan::first_scan_unknown() {
+  scan_memory({});
+}
+
+//----------------------------------------
+// reads the filtered regions in chunks on all cores. an empty
+// value keeps the chunks as snapshots, otherwise only the slots
+// equal to value are kept.
+//----------------------------------------
+void ValueScan::scan_memory(std::span<const std::byte> value) {
+  struct Chunk {
+    address_t start;
+    size_t size;       // bytes a slot may start in
+    size_t read_size;  // size plus the overlap into the next chunk
+  };
+
+  std::vector<Chunk> chunks;
+  for(const auto* region : process_.memoryMap().readable_regions(options_.filter)) {
+    for(address_t start = region->start; start < region->end; start += kChunkSize) {
+      const size_t size = std::min<size_t>(kChunkSize, region->end - start);
+      const size_t read_size = std::min<size_t>(size + value_size_ - 1, region->end - start);
+      chunks.push_back({start, size, read_size});
+    }
+  }
+
+  auto candidates = std::make_unique<Candidates>(options_.memory_limit, options_.spill_directory);
+
+  parallelFor(chunks.size(), [&](size_t i) {
+    const Chunk& chunk = chunks[i];
+    if(chunk.read_size < value_size_) return;
+
+    const size_t slots = std::min((chunk.size + stride_ - 1) / stride_, (chunk.read_size - value_size_) / stride_ + 1);
+
+    std::vector<std::byte> memory(chunk.read_size);
+    try {
+      process_.readMemory(chunk.start, std::span<std::byte>(memory));
+    } catch(const std::system_error&) {
+      return; // unmapped since the map was read
+    }
+
+    Block block;
+    block.base = chunk.start;
+
+    if(value.empty()) {
+      block.dense = true;
+      block.count = slots;
+      block.values = std::move(memory);
+    } else {
+      thread_local std::vector<std::byte> packed;
+      thread_local std::vector<uint32_t> keep;
+      keep.clear();
+
+      const std::byte* current = packSlots(memory.data(), slots, stride_, value_size_, packed);
+      filterValues(type_, value_size_, ScanCompare::Equal, current, current, value.data(), slots, keep);
+      if(keep.empty()) return;
+
+      block.count = keep.size();
+      block.offsets.resize(keep.size());
+      block.values.resize(keep.size() * value_size_);
+      for(size_t k = 0; k < keep.size(); ++k) {
+        block.offsets[k] = static_cast<uint32_t>(keep[k] * stride_);
+        std::memcpy(block.values.data() + k * value_size_, current + keep[k] * value_size_, value_size_);
+      }
+    }
+
+    candidates->add(std::move(block));
+  });
+
+  candidates->sort();
+  candidates_ = std::move(candidates);
+}
+
+//----------------------------------------
+// Narrow the candidates down. candidates whose memory can no
+// longer be read are dropped.
+//----------------------------------------
+void ValueScan::next_scan(ScanCompare compare, std::span<const std::byte> value) {
+  if(not candidates_) {
+    throw std::runtime_error("next_scan() needs a first scan");
+  }
+
+  std::vector<std::byte> operand(value_size_);
+  if(compare == ScanCompare::Equal) {
+    check_value(value);
+    std::copy(value.begin(), value.end(), operand.begin());
+  } else if(type_ == ValueType::Bytes && (compare == ScanCompare::Increased || compare == ScanCompare::Decreased)) {
+    throw std::invalid_argument("Byte arrays can only be compared for equality");
+  }
+
+  const Candidates& current = *candidates_;
+  auto next = std::make_unique<Candidates>(options_.memory_limit, options_.spill_directory);
+
+  parallelFor(current.blocks(), [&](size_t b) {
+    Block scratch;
+    const Block& block = current.load(b, scratch);
+    if(block.count == 0) return;
+
+    thread_local std::vector<std::byte> memory;
+    thread_local std::vector<std::byte> packed_now;
+    thread_local std::vector<std::byte> packed_before;
+    thread_local std::vector<uint32_t> keep;
+
+    const std::byte* now = nullptr;
+    const std::byte* before = nullptr;
+
+    try {
+      if(block.dense) {
+        memory.resize(block.values.size());
+        process_.readMemory(block.base, std::span<std::byte>(memory));
+        now = packSlots(memory.data(), block.count, stride_, value_size_, packed_now);
+        before = packSlots(block.values.data(), block.count, stride_, value_size_, packed_before);
+      } else {
+        packed_now.resize(block.count * value_size_);
+        const size_t extent = block.offsets.back() + value_size_;
+
+        // few candidates spread far apart are read one by one, in batches
+        if(extent <= block.count * value_size_ * 16) {
+          memory.resize(extent);
+          process_.readMemory(block.base, std::span<std::byte>(memory));
+          for(size_t i = 0; i < block.count; ++i) {
+            std::memcpy(packed_now.data() + i * value_size_, memory.data() + block.offsets[i], value_size_);
+          }
+        } else {
+          std::vector<MemoryRead> reads;
+          reads.reserve(block.count);
+          for(size_t i = 0; i < block.count; ++i) {
+            reads.push_back({block.base + block.offsets[i], std::span(packed_now.data() + i * value_size_, value_size_)});
+          }
+          process_.readMemory(reads);
+        }
+        now = packed_now.data();
+        before = block.values.data();
+      }
+    } catch(const std::system_error&) {
+      return;
+    }
+
+    keep.clear();
+    filterValues(type_, value_size_, compare, now, before, operand.data(), block.count, keep);
+    if(keep.empty()) return;
+
+    Block result;
+    result.base = block.base;
+    result.count = keep.size();
+
+    // a snapshot nothing was dropped from stays a snapshot
+    if(block.dense && keep.size() == block.count) {
+      result.dense = true;
+      result.values = memory;
+      next->add(std::move(result));
+      return;
+    }
+
+    result.offsets.resize(keep.size());
+    result.values.resize(keep.size() * value_size_);
+    for(size_t k = 0; k < keep.size(); ++k) {
+      result.offsets[k] = block.dense ? static_cast<uint32_t>(keep[k] * stride_) : block.offsets[keep[k]];
+      std::memcpy(result.values.data() + k * value_size_, now + keep[k] * value_size_, value_size_);
+    }
+    next->add(std::move(result));
+  });
+
+  next->sort();
+  candidates_ = std::move(next);
+}
+
+//----------------------------------------
+// Addresses of the current candidates
+//----------------------------------------
+std::vector<address_t> ValueScan::addresses(size_t max_results) const {
+  std::vector<address_t> results;
+  if(not candidates_) {
+    return results;
+  }
+
+  results.reserve(std::min(max_results, candidates_->count()));
+  Block scratch;
+
+  for(size_t b = 0; b < candidates_->blocks() && results.size() < max_results; ++b) {
+    const Block& block = candidates_->load(b, scratch);
+    for(size_t i = 0; i < block.count && results.size() < max_results; ++i) {
+      results.push_back(block.base + (block.dense ? i * stride_ : block.offsets[i]));
+    }
+  }
+  return results;
+}
+
+}